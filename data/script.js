@@ -5,6 +5,12 @@ class GPSTracker {
         this.statusIndicator = document.getElementById('statusIndicator');
         this.mainContent = document.getElementById('main');
         this.downloadList = document.getElementById('downloadList');
+        this.logBox = document.getElementById('logBox');
+        this.skyView = document.getElementById('skyView');
+        this.geoSection = document.getElementById('geoSection');
+        this.geoView = document.getElementById('geoView');
+        this.logNext = 0; // 下一次请求的日志序号
+        this.maxLogLines = 200;
         this.isOnline = true;
         this.lastUpdateTime = Date.now();
         
@@ -14,11 +20,19 @@ class GPSTracker {
     init() {
         // 页面加载完成后立即获取数据
         this.fetchData();
+        this.fetchLog();
         this.fetchDownloadList();
+        this.fetchSky();
         
-        // 设置定时刷新
-        setInterval(() => this.fetchData(), 500);
-        setInterval(() => this.fetchDownloadList(), 10000); // 下载列表更新频率较低
+        // 优先使用服务器推送；不支持或断开时退回定时轮询
+        this.pollTimers = null;
+        if (!this.connectEvents()) {
+            this.startPolling();
+        }
+        setInterval(() => this.fetchLog(), 500);
+        setInterval(() => this.fetchSky(), 2000); // 卫星视图约每秒更新一次，不走推送
+        // 推送模式下“最后更新”秒数在本地递增，无需设备发送
+        setInterval(() => this.tickAge(), 1000);
         
         // 监听网络状态
         window.addEventListener('online', () => this.setOnlineStatus(true));
@@ -30,46 +44,344 @@ class GPSTracker {
     
     async fetchData() {
         try {
-          const response = await fetch("/data");
-          if (!response.ok) throw new Error("Network response was not ok");
-
-          const html = await response.text();
-          this.mainContent.innerHTML = html;
-          // 自动滚动日志到底部
-          const logBox = this.mainContent.querySelector(".log-box");
-          if (logBox) {
-            logBox.scrollTop = logBox.scrollHeight;
-          }
-          this.setOnlineStatus(true);
-          this.lastUpdateTime = Date.now();
+            // 设备返回 ETag，浏览器自动带 If-None-Match，状态未变时只有 304
+            const response = await fetch('/api/state', { cache: 'no-cache' });
+            if (!response.ok) throw new Error('Network response was not ok');
+
+            this.applyState(await response.text());
+            this.setOnlineStatus(true);
+            this.lastUpdateTime = Date.now();
         } catch (error) {
             console.error('Failed to fetch GPS data:', error);
+            this.lastStateText = null;
             this.setOnlineStatus(false);
             this.showErrorMessage('无法获取GPS数据，请检查网络连接');
         }
     }
+
+    connectEvents() {
+        if (!window.EventSource) return false;
+        const events = new EventSource('/events');
+        events.addEventListener('state', (e) => {
+            this.applyState(e.data);
+            this.setOnlineStatus(true);
+        });
+        events.onopen = () => this.stopPolling();
+        // 浏览器会自动重连，期间先轮询
+        events.onerror = () => this.startPolling();
+        return true;
+    }
+
+    startPolling() {
+        if (this.pollTimers) return;
+        this.pollTimers = [
+            setInterval(() => this.fetchData(), 500),
+            setInterval(() => this.fetchDownloadList(), 10000) // 下载列表更新频率较低
+        ];
+    }
+
+    stopPolling() {
+        if (!this.pollTimers) return;
+        this.pollTimers.forEach((t) => clearInterval(t));
+        this.pollTimers = null;
+        this.fetchData();
+    }
+
+    applyState(text) {
+        this.stateReceivedAt = Date.now();
+        if (text === this.lastStateText) return;
+        this.lastStateText = text;
+        const state = JSON.parse(text);
+        // 码表开始/结束时文件列表才会变化
+        if (this.state && this.state.trip.active !== state.trip.active) {
+            this.fetchDownloadList();
+        }
+        // 围栏状态只在有新的进出事件时拉取
+        if (state.geo.zones > 0 && (!this.state || this.state.geo.seq !== state.geo.seq || this.geoSection.style.display === 'none')) {
+            this.geoSection.style.display = '';
+            this.fetchGeofence();
+        }
+        this.state = state;
+        this.renderState(state);
+    }
+
+    tickAge() {
+        const s = this.state;
+        if (!s || this.pollTimers || (!s.valid && !s.trip.active)) return;
+        const elapsed = Math.floor((Date.now() - this.stateReceivedAt) / 1000);
+        if (elapsed === 0) return;
+        const age = s.valid ? s.age + elapsed : s.age;
+        const trip = s.trip.active ? { ...s.trip, secs: s.trip.secs + elapsed } : s.trip;
+        this.renderState({ ...s, age, trip, timeout: s.timeout || (s.valid && age > 10) });
+    }
+
+    renderState(s) {
+        let html = "<div class='gps-data'><h2>GPS 实时数据</h2>";
+        if (s.valid && !s.timeout) {
+            html += `<p>纬度: <b>${s.fix.lat.toFixed(6)}</b></p>`;
+            html += `<p>经度: <b>${s.fix.lng.toFixed(6)}</b></p>`;
+            html += `<p>海拔: <b>${s.fix.alt.toFixed(2)} m</b></p>`;
+            html += `<p>速度: <b>${s.fix.spd.toFixed(2)} km/h</b></p>`;
+            html += `<p style='color:#666;'>最后更新: <b>${s.age} 秒前</b></p>`;
+        } else if (s.timeout) {
+            html += `<p style='color:#ff6600;'>⚠️ GPS数据超时 (${s.age} 秒未更新)</p>`;
+            html += "<p style='color:#c00;'>请检查GPS模块连接或等待卫星信号...</p>";
+        } else {
+            html += "<p style='color:#c00;'>等待 GPS 定位数据...</p>";
+        }
+        if (s.trip.active) {
+            const m = Math.floor(s.trip.secs / 60);
+            const sec = String(s.trip.secs % 60).padStart(2, '0');
+            html += `<p>码表: <b>进行中 ${m}:${sec}</b></p>`;
+            const st = s.trip.stats;
+            const mm = Math.floor(st.moving / 60);
+            const ms = String(st.moving % 60).padStart(2, '0');
+            html += `<p>里程: <b>${(st.dist / 1000).toFixed(2)} km</b>, 运动时间: <b>${mm}:${ms}</b></p>`;
+            html += `<p>平均/最高: <b>${st.avg.toFixed(1)} / ${st.max.toFixed(1)} km/h</b>, 爬升/下降: <b>${Math.round(st.asc)} / ${Math.round(st.desc)} m</b></p>`;
+        }
+        const wifiNames = { sta: 'WiFi', ap: 'AP 热点', config: '配置模式', lost: '已断开', connecting: '连接中' };
+        html += `<p style='color:#666;'>网络: <b>${wifiNames[s.wifi.mode] || s.wifi.mode}</b> ${s.wifi.ip}${s.wifi.retrying ? ' (重连中)' : ''}</p>`;
+        if (s.uart.ovf > 0 || s.uart.drop > 0) {
+            html += `<p style='color:#ff6600;'>串口溢出: <b>${s.uart.ovf}</b> 次, 丢弃: <b>${s.uart.drop}</b> 字节</p>`;
+        }
+        html += '</div>';
+        this.mainContent.innerHTML = html;
+    }
+    
+    async fetchLog() {
+        if (this.logFetching) return;
+        this.logFetching = true;
+        try {
+            const response = await fetch(`/log?since=${this.logNext}`);
+            if (!response.ok) throw new Error('Network response was not ok');
+
+            const next = parseInt(response.headers.get('X-Log-Next'), 10);
+            const text = await response.text();
+            // 设备重启后序号会变小，清空后下次从头拉取
+            if (next < this.logNext) {
+                this.logBox.textContent = '';
+                this.logNext = 0;
+                return;
+            }
+            if (!Number.isNaN(next)) {
+                this.logNext = next;
+            }
+            this.appendLogLines(text);
+        } catch (error) {
+            console.error('Failed to fetch log:', error);
+        } finally {
+            this.logFetching = false;
+        }
+    }
+
+    appendLogLines(text) {
+        if (!text) return;
+        const atBottom = this.logBox.scrollTop + this.logBox.clientHeight >= this.logBox.scrollHeight - 4;
+        const fragment = document.createDocumentFragment();
+        for (const line of text.split('\n')) {
+            if (!line) continue;
+            const div = document.createElement('div');
+            div.textContent = line;
+            fragment.appendChild(div);
+        }
+        this.logBox.appendChild(fragment);
+        // 只保留最近的若干行
+        while (this.logBox.childElementCount > this.maxLogLines) {
+            this.logBox.removeChild(this.logBox.firstElementChild);
+        }
+        // 用户未向上翻看时自动滚动到底部
+        if (atBottom) {
+            this.logBox.scrollTop = this.logBox.scrollHeight;
+        }
+    }
     
     async fetchDownloadList() {
         try {
-            const response = await fetch('/downloads');
+            // 浏览器按 ETag 重新验证，列表未变化时设备只回 304
+            const page = this.downloadPage || 0;
+            const response = await fetch(`/downloads?page=${page}`, { cache: 'no-cache' });
             if (!response.ok) throw new Error('Network response was not ok');
             
-            const html = await response.text();
-            // 提取下载列表部分
-            const parser = new DOMParser();
-            const doc = parser.parseFromString(html, 'text/html');
-            const downloadSection = doc.querySelector('.download-list');
-            
-            if (downloadSection) {
-                this.downloadList.innerHTML = downloadSection.innerHTML;
+            const list = await response.json();
+            // 删除后当前页可能已超出范围
+            if (list.trips.length === 0 && list.page > 0) {
+                this.downloadPage = Math.max(0, Math.ceil(list.total / list.per) - 1);
+                return this.fetchDownloadList();
             }
+            const key = `${list.version}/${list.page}/${list.gpslog}`;
+            // 列表、页码和位置日志大小都未变化时不重新渲染（正在记录的码表除外）
+            if (key === this.downloadKey && !list.trips.some((t) => t.active)) return;
+            this.downloadKey = key;
+            this.renderDownloadList(list);
             
         } catch (error) {
             console.error('Failed to fetch download list:', error);
+            this.downloadKey = null;
             this.downloadList.innerHTML = '<div class="no-data">📭 无法加载下载列表</div>';
         }
     }
     
+    renderDownloadList(list) {
+        const kb = (bytes) => `${Math.ceil(bytes / 1024)} KB`;
+        let html = '<div class="download-list">';
+        // 分段位置日志合并为一个文件下载
+        html += `<div class="download-item"><a href="/gpslog" download>gpslog.txt (${kb(list.gpslog)})</a></div>`;
+        for (const t of list.trips) {
+            const file = encodeURIComponent(t.file);
+            const bin = t.file.endsWith('.bin');
+            const name = t.file.substring(1, t.file.length - 4);
+            const mm = Math.floor(t.secs / 60);
+            const ss = String(t.secs % 60).padStart(2, '0');
+            const info = [];
+            if (t.start) info.push(new Date(t.start * 1000).toLocaleString());
+            if (bin) info.push(`${mm}:${ss}`);
+            info.push(t.active ? '记录中' : kb(t.size));
+            html += `<div class="download-item"><a href="/download?file=${file}" download>${name}.csv <span class="download-info">${info.join(' · ')}</span></a>`;
+            // 二进制码表下载时转换，另提供GPX/GeoJSON/KML
+            let extra = '';
+            if (bin) {
+                extra += `<a href="/download?file=${file}&format=gpx" download>GPX</a>`;
+                extra += `<a href="/download?file=${file}&format=geojson" download>GeoJSON</a>`;
+                extra += `<a href="/download?file=${file}&format=kml" download>KML</a>`;
+                extra += `<a href="#" data-preview="${file}">轨迹</a>`;
+            }
+            if (t.summary) extra += `<a href="/download?file=${encodeURIComponent('/' + name + '.json')}" target="_blank">统计</a>`;
+            if (extra) html += `<div class="download-extra">${extra}</div>`;
+            if (bin) html += '<div class="track-preview"></div>';
+            html += '</div>';
+        }
+        if (list.total === 0) {
+            html += '<div class="no-data">暂无码表数据</div>';
+        }
+        const pages = Math.ceil(list.total / list.per);
+        if (pages > 1) {
+            html += '<div class="download-pager">';
+            html += `<button class="btn" data-page="${list.page - 1}" ${list.page > 0 ? '' : 'disabled'}>上一页</button>`;
+            html += `<span>${list.page + 1} / ${pages}</span>`;
+            html += `<button class="btn" data-page="${list.page + 1}" ${list.page + 1 < pages ? '' : 'disabled'}>下一页</button>`;
+            html += '</div>';
+        }
+        html += '</div>';
+        this.downloadList.innerHTML = html;
+        this.downloadList.querySelectorAll('a[data-preview]').forEach((link) => {
+            link.addEventListener('click', (e) => {
+                e.preventDefault();
+                this.showTrackPreview(link.dataset.preview, link.closest('.download-item').querySelector('.track-preview'));
+            });
+        });
+        this.downloadList.querySelectorAll('.download-pager button').forEach((btn) => {
+            btn.addEventListener('click', () => {
+                this.downloadPage = Number(btn.dataset.page);
+                this.fetchDownloadList();
+            });
+        });
+    }
+    
+    async fetchSky() {
+        try {
+            const response = await fetch('/api/sky', { cache: 'no-cache' });
+            if (!response.ok) throw new Error('Network response was not ok');
+            const text = await response.text();
+            if (text === this.lastSkyText) return;
+            this.lastSkyText = text;
+            this.renderSky(JSON.parse(text));
+        } catch (error) {
+            console.error('Failed to fetch satellite view:', error);
+        }
+    }
+
+    // 天空图：圆心为天顶，外圈为地平线，上方为北；实心为参与定位的卫星，颜色表示信噪比
+    renderSky(sky) {
+        if (sky.sats.length === 0) {
+            this.skyView.innerHTML = '<div class="no-data">未收到卫星数据</div>';
+            return;
+        }
+        const color = (snr) => snr >= 35 ? '#27ae60' : snr >= 25 ? '#f39c12' : snr > 0 ? '#e74c3c' : '#95a5a6';
+        let svg = '<svg class="sky-plot" viewBox="-52 -52 104 104">';
+        [45, 30, 15].forEach((r) => { svg += `<circle r="${r}" class="sky-grid"/>`; });
+        svg += '<line x1="-45" y1="0" x2="45" y2="0" class="sky-grid"/><line x1="0" y1="-45" x2="0" y2="45" class="sky-grid"/>';
+        svg += '<text x="0" y="-47" class="sky-label">N</text><text x="49" y="1.5" class="sky-label">E</text>' +
+            '<text x="0" y="51" class="sky-label">S</text><text x="-49" y="1.5" class="sky-label">W</text>';
+        sky.sats.forEach(([prn, sys, elev, az, snr, used]) => {
+            if (elev < 0 || az < 0) return; // 尚无星历，只在下方柱状图中显示
+            const r = (90 - elev) / 90 * 45;
+            const a = az * Math.PI / 180;
+            const x = (r * Math.sin(a)).toFixed(1);
+            const y = (-r * Math.cos(a)).toFixed(1);
+            svg += `<circle cx="${x}" cy="${y}" r="3" fill="${used ? color(snr) : '#fff'}" stroke="${color(snr)}"><title>${sys} ${prn}: ${snr} dB-Hz</title></circle>`;
+            svg += `<text x="${x}" y="${(y - 4).toFixed(1)}" class="sky-prn">${prn}</text>`;
+        });
+        svg += '</svg>';
+        let bars = '<div class="snr-bars">';
+        sky.sats.forEach(([prn, sys, elev, az, snr, used]) => {
+            bars += `<div class="snr-bar${used ? ' used' : ''}" title="${sys} ${prn}: ${snr} dB-Hz">` +
+                `<div class="snr-fill" style="height:${Math.min(snr, 50) * 2}%;background:${color(snr)}"></div><span>${prn}</span></div>`;
+        });
+        bars += '</div>';
+        const fixNames = { 1: '未定位', 2: '二维定位', 3: '三维定位' };
+        const dop = (v) => v > 0 ? v.toFixed(2) : '-';
+        this.skyView.innerHTML = svg + bars +
+            `<div class="sky-info">可见 <b>${sky.sats.length}</b> 颗，参与定位 <b>${sky.used}</b> 颗，${fixNames[sky.fix] || '模式未知'}` +
+            `<br>PDOP <b>${dop(sky.pdop)}</b>，HDOP <b>${dop(sky.hdop)}</b>，VDOP <b>${dop(sky.vdop)}</b>` +
+            `${sky.age > 5 ? `<br><span style='color:#ff6600;'>${sky.age} 秒未更新</span>` : ''}</div>`;
+    }
+
+    async fetchGeofence() {
+        try {
+            const response = await fetch('/geofence', { cache: 'no-store' });
+            if (!response.ok) throw new Error('Network response was not ok');
+            this.renderGeofence(await response.json());
+        } catch (error) {
+            console.error('Failed to fetch geofence:', error);
+        }
+    }
+
+    renderGeofence(g) {
+        const esc = (s) => s.replace(/&/g, '&amp;').replace(/</g, '&lt;');
+        let html = `<div class="geo-info">共 <b>${g.zones}</b> 个区域，当前在 <b>${g.inside.length}</b> 个区域内</div>`;
+        if (g.inside.length > 0) {
+            html += '<div class="geo-inside">' +
+                g.inside.map((z) => `<span class="geo-zone">${z.id} ${esc(z.name)}</span>`).join('') + '</div>';
+        }
+        if (g.events.length === 0) {
+            html += '<div class="no-data">暂无进出记录</div>';
+        } else {
+            html += '<ul class="geo-events">' + g.events.map((e) =>
+                `<li class="${e.enter ? 'enter' : 'exit'}">${e.enter ? '进入' : '离开'} <b>${e.id} ${esc(e.name)}</b>` +
+                `<span>${e.age} 秒前</span></li>`).join('') + '</ul>';
+        }
+        this.geoView.innerHTML = html;
+    }
+
+    // 抽稀后的轨迹画成 SVG 折线（等距矩形投影），再次点击收起
+    async showTrackPreview(file, box) {
+        if (box.innerHTML) {
+            box.innerHTML = '';
+            return;
+        }
+        box.innerHTML = '<div class="loading-text">正在加载轨迹...</div>';
+        try {
+            const response = await fetch(`/trip/preview?file=${file}`);
+            if (!response.ok) throw new Error('Network response was not ok');
+            const track = await response.json();
+            if (track.coords.length < 2) {
+                box.innerHTML = '<div class="no-data">没有定位数据</div>';
+                return;
+            }
+            const k = Math.cos(track.coords[0][0] * Math.PI / 180);
+            const xs = track.coords.map((c) => c[1] * k);
+            const ys = track.coords.map((c) => -c[0]);
+            const minX = Math.min(...xs), minY = Math.min(...ys);
+            const span = Math.max(Math.max(...xs) - minX, Math.max(...ys) - minY) || 1e-6;
+            const pts = xs.map((x, i) => `${((x - minX) / span * 100).toFixed(2)},${((ys[i] - minY) / span * 100).toFixed(2)}`).join(' ');
+            box.innerHTML = `<svg viewBox="-2 -2 104 104"><polyline points="${pts}"/></svg>` +
+                `<div class="track-info">${track.points} / ${track.total} 点，容差 ${track.tolerance} m</div>`;
+        } catch (error) {
+            console.error('Failed to fetch track preview:', error);
+            box.innerHTML = '<div class="no-data">无法加载轨迹</div>';
+        }
+    }
+    
     setOnlineStatus(online) {
         this.isOnline = online;
         if (this.statusIndicator) {
@@ -0,0 +1,29 @@
+# gzip_assets.py
+# 构建前把 data/ 下的网页资源压缩为 .gz，固件在客户端支持 gzip 时直接发送压缩版本。
+# 仅在源文件比 .gz 新时重新压缩；mtime 固定为 0，保证输出可复现。
+import gzip
+import os
+
+Import("env")
+
+DATA_DIR = os.path.join(env.subst("$PROJECT_DIR"), "data")
+EXTENSIONS = (".html", ".css", ".js")
+
+
+def compress_assets():
+    for name in sorted(os.listdir(DATA_DIR)):
+        if not name.endswith(EXTENSIONS):
+            continue
+        src = os.path.join(DATA_DIR, name)
+        dst = src + ".gz"
+        if os.path.exists(dst) and os.path.getmtime(dst) >= os.path.getmtime(src):
+            continue
+        with open(src, "rb") as f:
+            raw = f.read()
+        with open(dst, "wb") as out:
+            with gzip.GzipFile(filename=name, mode="wb", fileobj=out, compresslevel=9, mtime=0) as gz:
+                gz.write(raw)
+        print("gzip_assets: %s %d -> %d bytes" % (name, len(raw), os.path.getsize(dst)))
+
+
+compress_assets()
@@ -0,0 +1,62 @@
+#pragma once
+// 无头屏幕：绘图调用只记录次数，不做光栅化；文本经 Print 接口计入 textBytes
+#include "Arduino.h"
+
+class Adafruit_GFX : public Print
+{
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h) {}
+
+  virtual void drawPixel(int16_t, int16_t, uint16_t) {}
+  virtual void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t) { fillCalls++; }
+  virtual void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+  void drawRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  void drawFastHLine(int16_t, int16_t, int16_t, uint16_t) {}
+  void drawFastVLine(int16_t, int16_t, int16_t, uint16_t) {}
+  void drawCircle(int16_t, int16_t, int16_t, uint16_t) {}
+  void fillCircle(int16_t, int16_t, int16_t, uint16_t) {}
+  void setCursor(int16_t x, int16_t y)
+  {
+    _cursorX = x;
+    _cursorY = y;
+  }
+  int16_t getCursorX() const { return _cursorX; }
+  int16_t getCursorY() const { return _cursorY; }
+  void setTextColor(uint16_t) {}
+  void setTextColor(uint16_t, uint16_t) {}
+  void setTextSize(uint8_t s) { _textSize = s ? s : 1; }
+  void setTextWrap(bool) {}
+  void setRotation(uint8_t r)
+  {
+    if ((r ^ _rotation) & 1)
+      std::swap(_width, _height);
+    _rotation = r & 3;
+  }
+  void getTextBounds(const char *s, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h)
+  {
+    *x1 = x;
+    *y1 = y;
+    *w = (uint16_t)(strlen(s) * 6 * _textSize);
+    *h = (uint16_t)(8 * _textSize);
+  }
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  size_t write(uint8_t) override
+  {
+    textBytes++;
+    _cursorX += 6 * _textSize;
+    return 1;
+  }
+  using Print::write;
+
+  uint32_t fillCalls = 0;
+  uint32_t textBytes = 0;
+
+protected:
+  int16_t _width, _height;
+  int16_t _cursorX = 0, _cursorY = 0;
+  uint8_t _textSize = 1;
+  uint8_t _rotation = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+// 主机模拟器（pio run -e native）用的 Arduino 核心垫片：只提供固件实际用到的接口，
+// 时间函数走 sim 模拟时钟，可按 --speedup 倍速运行。
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define PROGMEM
+#define PGM_P const char *
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+
+using std::max;
+using std::min;
+template <class T, class L, class H>
+inline T constrain(T v, L lo, H hi)
+{
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+uint32_t esp_random();
+
+// 板级引脚名，只为让屏幕构造参数能编译
+#define D3 3
+#define D4 4
+#define D8 8
+
+class EspClass
+{
+public:
+  void restart();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getHeapSize();
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 160; }
+  const char *getSdkVersion() { return "sim"; }
+};
+extern EspClass ESP;
+
+// 模拟器不校时：time() 直接是主机时间
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char *server1, const char *server2 = nullptr,
+                const char *server3 = nullptr);
@@ -0,0 +1,11 @@
+#pragma once
+// 模拟器不做强制门户 DNS：浏览器直接访问 127.0.0.1:<port>
+#include "IPAddress.h"
+
+class DNSServer
+{
+public:
+  bool start(uint16_t, const String &, const IPAddress &) { return true; }
+  void processNextRequest() {}
+  void stop() {}
+};
@@ -0,0 +1,66 @@
+#pragma once
+// 模拟 UART：0 号口输出到终端；其他口的接收端由回放线程按波特率注入字节，
+// 接收缓冲区大小、满时丢字节和 onReceive/onReceiveError 回调时机与 ESP32 驱动一致。
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Stream.h"
+
+#define SERIAL_8N1 0x800001c
+
+typedef enum
+{
+  UART_NO_ERROR,
+  UART_BREAK_ERROR,
+  UART_BUFFER_FULL_ERROR,
+  UART_FIFO_OVF_ERROR,
+  UART_FRAME_ERROR,
+  UART_PARITY_ERROR
+} hardwareSerial_error_t;
+
+typedef std::function<void(void)> OnReceiveCb;
+typedef std::function<void(hardwareSerial_error_t)> OnReceiveErrorCb;
+
+class HardwareSerial : public Stream
+{
+public:
+  explicit HardwareSerial(int uartNr) : _uartNr(uartNr) {}
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1,
+             bool invert = false, unsigned long timeoutMs = 20000UL, uint8_t rxfifoFull = 112);
+  void end() {}
+  void updateBaudRate(unsigned long baud) { _baud = baud; }
+  unsigned long baudRate() const { return _baud; }
+  size_t setRxBufferSize(size_t size);
+  void onReceive(OnReceiveCb cb, bool onlyOnTimeout = false);
+  void onReceiveError(OnReceiveErrorCb cb);
+  bool setRxFIFOFull(uint8_t) { return true; }
+  bool setRxTimeout(uint8_t) { return true; }
+
+  int available() override;
+  int peek() override;
+  int read() override;
+  size_t read(uint8_t *buf, size_t size);
+  size_t read(char *buf, size_t size) { return read((uint8_t *)buf, size); }
+  int availableForWrite() { return 128; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  void flush() override;
+  operator bool() const { return true; }
+
+  // 仅供模拟器回放线程调用：注入接收数据并在 UART 事件上下文中触发回调
+  void simInject(const uint8_t *data, size_t len);
+
+private:
+  int _uartNr;
+  volatile unsigned long _baud = 0;
+  size_t _rxCap = 256;
+  std::vector<uint8_t> _rx;
+  size_t _rxHead = 0, _rxCount = 0;
+  std::recursive_mutex _lock;
+  OnReceiveCb _onReceive;
+  OnReceiveErrorCb _onError;
+};
+
+extern HardwareSerial Serial;
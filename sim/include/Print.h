@@ -0,0 +1,77 @@
+#pragma once
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+    {
+      if (!write(*buf++))
+        break;
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+  size_t write(const char *buf, size_t size) { return write((const uint8_t *)buf, size); }
+  virtual void flush() {}
+
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char stackBuf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(stackBuf, sizeof(stackBuf), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+      return 0;
+    if ((size_t)n < sizeof(stackBuf))
+      return write((const uint8_t *)stackBuf, n);
+    std::string big(n + 1, '\0');
+    va_start(ap, fmt);
+    vsnprintf(&big[0], big.size(), fmt, ap);
+    va_end(ap);
+    return write((const uint8_t *)big.data(), n);
+  }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(unsigned long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(long long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(unsigned long long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(double v, int digits = 2) { return print(String(v, (unsigned int)digits)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &v)
+  {
+    size_t n = print(v);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T &v, int fmt)
+  {
+    size_t n = print(v, fmt);
+    return n + println();
+  }
+};
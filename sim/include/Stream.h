@@ -0,0 +1,64 @@
+#pragma once
+#include "Print.h"
+
+unsigned long millis();
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long ms) { _timeout = ms; }
+  unsigned long getTimeout() const { return _timeout; }
+
+  size_t readBytes(char *buf, size_t len) { return readBytes((uint8_t *)buf, len); }
+  virtual size_t readBytes(uint8_t *buf, size_t len)
+  {
+    size_t n = 0;
+    while (n < len)
+    {
+      int c = timedRead();
+      if (c < 0)
+        break;
+      buf[n++] = (uint8_t)c;
+    }
+    return n;
+  }
+  String readString()
+  {
+    String s;
+    int c;
+    while ((c = timedRead()) >= 0)
+      s += (char)c;
+    return s;
+  }
+  String readStringUntil(char terminator)
+  {
+    String s;
+    int c;
+    while ((c = timedRead()) >= 0 && c != terminator)
+      s += (char)c;
+    return s;
+  }
+
+protected:
+  int timedRead()
+  {
+    unsigned long start = millis();
+    do
+    {
+      int c = read();
+      if (c >= 0)
+        return c;
+      if (!waitForData())
+        return -1;
+    } while (millis() - start < _timeout);
+    return -1;
+  }
+  // 文件等非阻塞数据源读到末尾即结束，不等待超时
+  virtual bool waitForData() { return false; }
+
+  unsigned long _timeout = 1000;
+};
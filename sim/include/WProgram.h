@@ -0,0 +1,4 @@
+#pragma once
+// Arduino 1.0 之前的核心头文件名。native 环境不定义 ARDUINO 宏，TinyGPSPlus 等库据此
+// 包含 WProgram.h 而不是 Arduino.h
+#include "Arduino.h"
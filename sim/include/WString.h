@@ -0,0 +1,239 @@
+#pragma once
+// 模拟器用 Arduino String：以 std::string 存储，接口与 arduino-esp32 的 WString 一致
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+class String
+{
+public:
+  String() {}
+  String(const char *c) : _s(c ? c : "") {}
+  String(const std::string &s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  String(int v, unsigned char base = 10) { fromLong(v, base); }
+  String(unsigned int v, unsigned char base = 10) { fromULong(v, base); }
+  String(long v, unsigned char base = 10) { fromLong(v, base); }
+  String(unsigned long v, unsigned char base = 10) { fromULong(v, base); }
+  String(long long v, unsigned char base = 10) { fromLong(v, base); }
+  String(unsigned long long v, unsigned char base = 10) { fromULong(v, base); }
+  String(unsigned char v, unsigned char base = 10) { fromULong(v, base); }
+  String(float v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+  String(double v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  bool isEmpty() const { return _s.empty(); }
+  const char *c_str() const { return _s.c_str(); }
+  bool reserve(unsigned int size)
+  {
+    _s.reserve(size);
+    return true;
+  }
+
+  bool concat(const String &o)
+  {
+    _s += o._s;
+    return true;
+  }
+  bool concat(const char *c)
+  {
+    if (c)
+      _s += c;
+    return true;
+  }
+  bool concat(const char *c, unsigned int len)
+  {
+    _s.append(c, len);
+    return true;
+  }
+  bool concat(char c)
+  {
+    _s += c;
+    return true;
+  }
+  String &operator+=(const String &o) { return concat(o), *this; }
+  String &operator+=(const char *c) { return concat(c), *this; }
+  String &operator+=(char c) { return concat(c), *this; }
+  String &operator+=(int v) { return concat(String(v)), *this; }
+  String &operator+=(unsigned int v) { return concat(String(v)), *this; }
+  String &operator+=(long v) { return concat(String(v)), *this; }
+  String &operator+=(unsigned long v) { return concat(String(v)), *this; }
+
+  char charAt(unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char &operator[](unsigned int i) { return _s[i]; }
+
+  int compareTo(const String &o) const { return _s.compare(o._s); }
+  bool equals(const String &o) const { return _s == o._s; }
+  bool equals(const char *c) const { return _s == (c ? c : ""); }
+  bool equalsIgnoreCase(const String &o) const { return strcasecmp(_s.c_str(), o._s.c_str()) == 0; }
+  bool operator==(const String &o) const { return equals(o); }
+  bool operator==(const char *c) const { return equals(c); }
+  bool operator!=(const String &o) const { return !equals(o); }
+  bool operator!=(const char *c) const { return !equals(c); }
+  bool operator<(const String &o) const { return _s < o._s; }
+  bool operator>(const String &o) const { return _s > o._s; }
+  bool operator<=(const String &o) const { return _s <= o._s; }
+  bool operator>=(const String &o) const { return _s >= o._s; }
+
+  bool startsWith(const String &p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+  bool startsWith(const String &p, unsigned int offset) const
+  {
+    return offset <= _s.size() && _s.compare(offset, p._s.size(), p._s) == 0;
+  }
+  bool endsWith(const String &p) const
+  {
+    return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(_s.find(c, from)); }
+  int indexOf(const String &p, unsigned int from = 0) const { return pos(_s.find(p._s, from)); }
+  int lastIndexOf(char c) const { return pos(_s.rfind(c)); }
+  int lastIndexOf(char c, unsigned int from) const { return pos(_s.rfind(c, from)); }
+  int lastIndexOf(const String &p) const { return pos(_s.rfind(p._s)); }
+  int lastIndexOf(const String &p, unsigned int from) const { return pos(_s.rfind(p._s, from)); }
+
+  String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const
+  {
+    if (from > to)
+    {
+      unsigned int t = from;
+      from = to;
+      to = t;
+    }
+    if (from >= _s.size())
+      return String();
+    return String(_s.substr(from, to - from));
+  }
+
+  void replace(char find, char with)
+  {
+    for (char &c : _s)
+      if (c == find)
+        c = with;
+  }
+  void replace(const String &find, const String &with)
+  {
+    if (find._s.empty())
+      return;
+    size_t at = 0;
+    while ((at = _s.find(find._s, at)) != std::string::npos)
+    {
+      _s.replace(at, find._s.size(), with._s);
+      at += with._s.size();
+    }
+  }
+  void remove(unsigned int index) { remove(index, (unsigned int)-1); }
+  void remove(unsigned int index, unsigned int count)
+  {
+    if (index < _s.size())
+      _s.erase(index, count);
+  }
+  void toLowerCase()
+  {
+    for (char &c : _s)
+      if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+  }
+  void toUpperCase()
+  {
+    for (char &c : _s)
+      if (c >= 'a' && c <= 'z')
+        c -= 'a' - 'A';
+  }
+  void trim()
+  {
+    size_t b = _s.find_first_not_of(" \t\r\n\v\f");
+    if (b == std::string::npos)
+    {
+      _s.clear();
+      return;
+    }
+    size_t e = _s.find_last_not_of(" \t\r\n\v\f");
+    _s = _s.substr(b, e - b + 1);
+  }
+
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return (float)atof(_s.c_str()); }
+  double toDouble() const { return atof(_s.c_str()); }
+  void toCharArray(char *buf, unsigned int size, unsigned int index = 0) const
+  {
+    if (!size)
+      return;
+    size_t n = index < _s.size() ? _s.copy(buf, size - 1, index) : 0;
+    buf[n] = '\0';
+  }
+  void getBytes(unsigned char *buf, unsigned int size, unsigned int index = 0) const
+  {
+    toCharArray((char *)buf, size, index);
+  }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  void fromLong(long long v, unsigned char base)
+  {
+    if (v < 0 && base == 10)
+    {
+      fromULong((unsigned long long)(-(v + 1)) + 1, base);
+      _s.insert(0, 1, '-');
+    }
+    else
+      fromULong((unsigned long long)v, base);
+  }
+  void fromULong(unsigned long long v, unsigned char base)
+  {
+    char buf[72];
+    char *p = buf + sizeof(buf) - 1;
+    *p = '\0';
+    if (base < 2)
+      base = 10;
+    do
+    {
+      unsigned d = (unsigned)(v % base);
+      *--p = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+      v /= base;
+    } while (v);
+    _s = p;
+  }
+  void fromDouble(double v, unsigned int decimals)
+  {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    _s = buf;
+  }
+
+  std::string _s;
+};
+
+inline String operator+(const String &a, const String &b)
+{
+  String r(a);
+  r += b;
+  return r;
+}
+inline String operator+(const String &a, const char *b)
+{
+  String r(a);
+  r += b;
+  return r;
+}
+inline String operator+(const char *a, const String &b)
+{
+  String r(a);
+  r += b;
+  return r;
+}
+inline String operator+(const String &a, char c)
+{
+  String r(a);
+  r += c;
+  return r;
+}
+inline String operator+(const String &a, int v) { return a + String(v); }
+inline String operator+(const String &a, unsigned int v) { return a + String(v); }
+inline String operator+(const String &a, long v) { return a + String(v); }
+inline String operator+(const String &a, unsigned long v) { return a + String(v); }
+inline String operator+(const String &a, double v) { return a + String(v); }
@@ -0,0 +1,134 @@
+#pragma once
+// 单连接同步 HTTP/1.1 服务器，语义按 arduino-esp32 WebServer：
+// 每次 handleClient() 至多处理一个请求，响应后关闭连接；只保存 collectHeaders() 登记过的请求头；
+// setContentLength(CONTENT_LENGTH_UNKNOWN) 后 send() 使用 chunked 编码，sendContent("") 结束。
+#include "FS.h"
+#include "WiFiClient.h"
+
+enum HTTPMethod
+{
+  HTTP_ANY,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_PATCH,
+  HTTP_DELETE,
+  HTTP_OPTIONS
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+class WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80) : _port(port) {}
+  ~WebServer() { close(); }
+
+  void begin();
+  void begin(uint16_t port)
+  {
+    _port = port;
+    begin();
+  }
+  void close();
+  void stop() { close(); }
+  void handleClient();
+  void enableDelay(bool value) { _nullDelay = value; }
+
+  void on(const String &uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+  void on(const String &uri, HTTPMethod method, THandlerFunction fn) { _routes.push_back({uri, method, fn}); }
+  void onNotFound(THandlerFunction fn) { _notFound = fn; }
+
+  String uri() const { return _uri; }
+  HTTPMethod method() const { return _method; }
+  WiFiClient &client() { return _client; }
+
+  String arg(const String &name) const;
+  String arg(int i) const { return i < args() ? _args[i].value : String(); }
+  String argName(int i) const { return i < args() ? _args[i].key : String(); }
+  int args() const { return (int)_args.size(); }
+  bool hasArg(const String &name) const;
+
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+  String header(const String &name) const;
+  String header(int i) const { return i < headers() ? _headers[i].value : String(); }
+  String headerName(int i) const { return i < headers() ? _headers[i].key : String(); }
+  int headers() const { return (int)_headers.size(); }
+  bool hasHeader(const String &name) const;
+  String hostHeader() const { return _host; }
+
+  void send(int code, const char *contentType = nullptr, const String &content = String(""));
+  void send(int code, const char *contentType, const char *content) { send(code, contentType, String(content)); }
+  void send(int code, const String &contentType, const String &content) { send(code, contentType.c_str(), content); }
+  void send(int code, const char *contentType, const char *content, size_t len);
+  void send_P(int code, PGM_P contentType, PGM_P content) { send(code, contentType, content); }
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t len) { send(code, contentType, content, len); }
+  void setContentLength(const size_t len) { _contentLength = len; }
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *content, size_t len);
+  void sendContent_P(PGM_P content) { sendContent(content, strlen(content)); }
+  void sendContent_P(PGM_P content, size_t len) { sendContent(content, len); }
+
+  template <typename T>
+  size_t streamFile(T &file, const String &contentType, const int code = 200)
+  {
+    String path(file.path());
+    setContentLength(file.size());
+    if (path.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream")
+      sendHeader("Content-Encoding", "gzip");
+    send(code, contentType.c_str(), String(""));
+    if (_method == HTTP_HEAD)
+      return 0;
+    uint8_t buf[1436];
+    size_t total = 0;
+    size_t n;
+    while ((n = file.read(buf, sizeof(buf))) > 0)
+    {
+      size_t sent = writeRaw((const char *)buf, n);
+      total += sent;
+      if (sent < n)
+        break;
+    }
+    return total;
+  }
+
+private:
+  struct KeyValue
+  {
+    String key;
+    String value;
+  };
+  struct Route
+  {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+  };
+
+  bool parseRequest();
+  void parseArgs(const String &data);
+  void finalizeResponse();
+  size_t writeRaw(const char *data, size_t len);
+
+  int _port;
+  int _listenFd = -1;
+  bool _nullDelay = true;
+  WiFiClient _client;
+  std::vector<Route> _routes;
+  THandlerFunction _notFound;
+
+  HTTPMethod _method = HTTP_ANY;
+  String _uri;
+  String _host;
+  std::vector<KeyValue> _args;
+  std::vector<KeyValue> _headers;
+  std::vector<String> _collected;
+  String _responseHeaders;
+  size_t _contentLength = CONTENT_LENGTH_NOT_SET;
+  bool _chunked = false;
+};
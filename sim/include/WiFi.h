@@ -0,0 +1,98 @@
+#pragma once
+// 模拟 WiFi：STA 在 --wifi 指定的时刻连上/断开，并从事件线程投递 GOT_IP/DISCONNECTED，
+// 顺序与 ESP32 事件任务一致；AP 模式总是成功。
+#include <atomic>
+#include "IPAddress.h"
+#include "WiFiClient.h"
+
+typedef enum
+{
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF,
+  WIFI_STA,
+  WIFI_AP,
+  WIFI_AP_STA
+} wifi_mode_t;
+
+typedef enum
+{
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_STA_START,
+  ARDUINO_EVENT_WIFI_STA_STOP,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP,
+  ARDUINO_EVENT_WIFI_AP_START,
+  ARDUINO_EVENT_WIFI_AP_STOP,
+  ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef struct
+{
+  uint8_t reason;
+} arduino_event_info_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef size_t wifi_event_id_t;
+typedef void (*WiFiEventCb)(arduino_event_id_t event);
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+
+class WiFiClass
+{
+public:
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+  wl_status_t begin() { return begin(nullptr); }
+  bool disconnect(bool wifioff = false, bool eraseap = false);
+  bool reconnect() { return begin() != WL_CONNECT_FAILED; }
+  bool setAutoReconnect(bool) { return true; }
+  wl_status_t status() { return _status; }
+  bool mode(wifi_mode_t m)
+  {
+    _mode = m;
+    return true;
+  }
+  wifi_mode_t getMode() { return _mode; }
+  bool setSleep(bool) { return true; }
+  bool softAP(const char *ssid, const char *passphrase = nullptr, int channel = 1, int ssidHidden = 0,
+              int maxConnection = 4);
+  bool softAPConfig(IPAddress local, IPAddress gateway, IPAddress subnet);
+  bool softAPdisconnect(bool = false) { return true; }
+  IPAddress softAPIP() { return _apIp; }
+  uint8_t softAPgetStationNum() { return 0; }
+  IPAddress localIP() { return _status == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+  int8_t RSSI() { return _status == WL_CONNECTED ? -55 : 0; }
+  String SSID() { return String(_ssid.c_str()); }
+
+  wifi_event_id_t onEvent(WiFiEventCb cb, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+  wifi_event_id_t onEvent(WiFiEventFuncCb cb, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+
+  // 仅供模拟器事件线程调用
+  void simSetStatus(wl_status_t s, arduino_event_id_t event, uint8_t reason = 0);
+
+private:
+  std::atomic<wl_status_t> _status{WL_IDLE_STATUS};
+  wifi_mode_t _mode = WIFI_OFF;
+  IPAddress _apIp = IPAddress(192, 168, 4, 1);
+  std::string _ssid;
+  struct Handler
+  {
+    WiFiEventFuncCb cb;
+    arduino_event_id_t event;
+  };
+  std::vector<Handler> _handlers;
+};
+
+extern WiFiClass WiFi;
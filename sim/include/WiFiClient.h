@@ -0,0 +1,35 @@
+#pragma once
+// TCP 连接：句柄在副本之间共享，最后一个引用释放时才关闭 socket。
+// stop() 只释放本副本的引用，与 arduino-esp32 行为一致（SSE 依赖这一点接管连接）。
+#include <memory>
+#include "IPAddress.h"
+
+class WiFiClient : public Stream
+{
+public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd);
+
+  int fd() const;
+  uint8_t connected();
+  operator bool() { return connected(); }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size);
+  int peek() override;
+  void flush() override {}
+  void stop();
+  int setNoDelay(bool nodelay);
+  IPAddress remoteIP() const;
+  uint16_t remotePort() const;
+
+protected:
+  bool waitForData() override;
+
+private:
+  struct Handle;
+  std::shared_ptr<Handle> _h;
+};
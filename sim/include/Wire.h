@@ -0,0 +1,19 @@
+#pragma once
+// I2C 总线丢弃所有写入，只统计字节数，便于对比 OLED 局部刷新的总线流量
+#include "Arduino.h"
+
+class TwoWire : public Print
+{
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+  void setClock(uint32_t) {}
+  void beginTransmission(uint8_t) {}
+  uint8_t endTransmission(bool = true) { return 0; }
+  size_t write(uint8_t) override { return ++bytesWritten, 1; }
+  size_t write(const uint8_t *, size_t n) override { return bytesWritten += n, n; }
+  using Print::write;
+
+  uint64_t bytesWritten = 0;
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,8 @@
+#pragma once
+// lwIP 的 BSD socket 接口在主机上直接对应 POSIX socket
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
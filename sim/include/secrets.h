@@ -0,0 +1,6 @@
+#pragma once
+// 模拟器默认凭据；工程 include/ 下有 secrets.h 时以它为准
+#ifndef wifi_ssid
+#define wifi_ssid "sim"
+#define wifi_password "simulator"
+#endif
@@ -0,0 +1,165 @@
+# nmea_to_ubx.py
+# 由 sample.nmea 生成等价的 UBX 录制数据 sample.ubx 和期望结果 sample.ubx.expect，
+# 供 UBX 模式的回放（--replay sim/replay/sample.ubx）和解码检查（--check-ubx）使用。
+#
+# 数据按 NEO-6M 切到 UBX 后的实际输出排列：开头是切换前的几行 NMEA 和对配置报文的
+# ACK（其中一条 NAK），之后每个历元依次为 NAV-POSLLH/VELNED/SOL/DOP/SVINFO。
+# 另在固定历元注入几种错误，检验解码器的历元拼接和校验：
+#   20 POSLLH 校验和错误          -> 本历元不输出
+#   40 VELNED 负载中一个字节翻转  -> 校验失败，本历元不输出
+#   50 历元前插入噪声（含孤立的 0xB5）和一个长度字段异常的帧头 -> 丢弃后照常输出
+#   60 NAV-SOL 重复发送           -> 本历元只输出一次
+#   70 三条报文乱序（SOL、POSLLH、VELNED）-> 照常输出
+# 输出是确定性的；修改后重新运行：python3 sim/replay/nmea_to_ubx.py
+import os
+import struct
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SRC = os.path.join(HERE, "sample.nmea")
+OUT = os.path.join(HERE, "sample.ubx")
+EXPECT = OUT + ".expect"
+
+TOW_DAY = 6  # 录制日为周六，iTOW = (星期 × 86400 + 当日秒) × 1000
+
+
+def frame(cls, msg_id, payload):
+    body = bytes([cls, msg_id]) + struct.pack("<H", len(payload)) + payload
+    a = b = 0
+    for c in body:
+        a = (a + c) & 0xFF
+        b = (b + a) & 0xFF
+    return b"\xb5\x62" + body + bytes([a, b])
+
+
+def nmea_deg_e7(value, hemi, deg_digits):
+    if not value:
+        return 0
+    deg = int(value[:deg_digits])
+    minutes = float(value[deg_digits:])
+    e7 = int(round((deg + minutes / 60) * 1e7))
+    return -e7 if hemi in ("S", "W") else e7
+
+
+def parse_epochs():
+    epochs = []
+    cur = None
+    for line in open(SRC, encoding="ascii"):
+        line = line.strip()
+        if not line.startswith("$") or "*" not in line:
+            continue
+        f = line[1:line.index("*")].split(",")
+        kind = f[0][2:]
+        if kind == "RMC":
+            cur = {"time": f[1], "knots": f[7], "course": f[8], "sats": [], "used": set()}
+            epochs.append(cur)
+        elif cur is None:
+            continue
+        elif kind == "GGA":
+            cur["fix"] = f[6] not in ("", "0")
+            cur["lat"] = nmea_deg_e7(f[2], f[3], 2)
+            cur["lng"] = nmea_deg_e7(f[4], f[5], 3)
+            cur["alt_mm"] = int(round(float(f[9]) * 1000)) if f[9] else 0
+            cur["numsv"] = int(f[7] or 0)
+        elif kind == "GSA":
+            cur["used"] = {int(p) for p in f[3:15] if p}
+            cur["pdop"] = int(round(float(f[15]) * 100))
+            cur["hdop"] = int(round(float(f[16]) * 100))
+            cur["vdop"] = int(round(float(f[17]) * 100))
+        elif kind == "GSV":
+            for i in range(4, len(f) - 3, 4):
+                if f[i]:
+                    elev = int(f[i + 1]) if f[i + 1] else None
+                    az = int(f[i + 2]) if f[i + 2] else None
+                    cur["sats"].append((int(f[i]), elev, az, int(f[i + 3] or 0)))
+    return epochs
+
+
+def tow_ms(hhmmss):
+    h, m, s = int(hhmmss[0:2]), int(hhmmss[2:4]), float(hhmmss[4:])
+    return int(round((TOW_DAY * 86400 + h * 3600 + m * 60 + s) * 1000))
+
+
+def nav_frames(e, tow):
+    speed = int(round(float(e["knots"] or 0) * 51.4444))
+    heading = int(round(float(e["course"] or 0) * 1e5))
+    posllh = struct.pack("<IiiiiII", tow, e["lng"], e["lat"], e["alt_mm"] + 7000, e["alt_mm"], 2500, 3500)
+    velned = struct.pack("<IiiiIIiII", tow, 0, 0, 0, speed, speed, heading, 50, 100000)
+    gps_fix = 3 if e["fix"] else 0
+    flags = 0x0D if e["fix"] else 0x0C
+    sol = struct.pack("<IiHBB", tow, 0, 2100, gps_fix, flags) + bytes(32) + struct.pack(
+        "<HBBI", e.get("pdop", 9999), 0, e["numsv"], 0)
+    dop = struct.pack("<IHHHHHHH", tow, 0, e.get("pdop", 9999), 0, e.get("vdop", 9999), e.get("hdop", 9999), 0, 0)
+    svinfo = struct.pack("<IBBH", tow, len(e["sats"]), 0x04, 0)
+    for ch, (prn, elev, az, cno) in enumerate(e["sats"]):
+        sv_flags = (0x01 if prn in e["used"] else 0) | (0x04 if elev is not None else 0)
+        svinfo += struct.pack("<BBBBBbhi", ch, prn, sv_flags, 0x04 if cno else 0x01, cno, elev or 0, az or 0, 0)
+    return {
+        "posllh": frame(0x01, 0x02, posllh),
+        "velned": frame(0x01, 0x12, velned),
+        "sol": frame(0x01, 0x06, sol),
+        "dop": frame(0x01, 0x04, dop),
+        "svinfo": frame(0x01, 0x30, svinfo),
+    }
+
+
+def main():
+    epochs = parse_epochs()
+    out = bytearray()
+    frames_ok = checksum_errors = 0
+
+    # 切换前模块仍在输出 NMEA
+    with open(SRC, "rb") as f:
+        out += b"".join(f.readlines()[:3])
+    # 对 CFG-PRT/CFG-RATE 和 5 条 CFG-MSG 的应答，其中 NAV-SVINFO 那条被拒绝（NAK）
+    acks = [(0x06, 0x00), (0x06, 0x08), (0x06, 0x01), (0x06, 0x01), (0x06, 0x01), (0x06, 0x01)]
+    for cls, msg_id in acks:
+        out += frame(0x05, 0x01, bytes([cls, msg_id]))
+        frames_ok += 1
+    out += frame(0x05, 0x00, bytes([0x06, 0x01]))
+    frames_ok += 1
+    naks = 1
+
+    expected = []
+    for n, e in enumerate(epochs):
+        tow = tow_ms(e["time"])
+        fr = nav_frames(e, tow)
+        order = ["posllh", "velned", "sol", "dop", "svinfo"]
+        emitted = True
+        if n == 20:
+            bad = bytearray(fr["posllh"])
+            bad[-1] ^= 0xFF
+            fr["posllh"] = bytes(bad)
+            emitted = False
+        elif n == 40:
+            bad = bytearray(fr["velned"])
+            bad[6 + 20] ^= 0x01
+            fr["velned"] = bytes(bad)
+            emitted = False
+        elif n == 50:
+            out += b"\x00\x13\xb5\x00\x7f\xb5"  # 孤立的 0xB5 不能吞掉后面的帧
+            out += b"\xb5\x62\x01\x02\xff\xff"  # 长度 65535：误同步，须立即丢弃而不是吞掉后续数据
+        elif n == 60:
+            order = ["posllh", "velned", "sol", "sol", "dop", "svinfo"]
+        elif n == 70:
+            order = ["sol", "posllh", "velned", "dop", "svinfo"]
+        for name in order:
+            out += fr[name]
+        frames_ok += len(order) - (0 if emitted else 1)
+        checksum_errors += 0 if emitted else 1
+        if emitted:
+            speed = int(round(float(e["knots"] or 0) * 51.4444))
+            expected.append((tow, 1 if e["fix"] else 0, e["lat"], e["lng"], e["alt_mm"] // 10, speed))
+
+    with open(OUT, "wb") as f:
+        f.write(out)
+    with open(EXPECT, "w", encoding="ascii") as f:
+        f.write("# generated by nmea_to_ubx.py; checked by program --check-ubx sim/replay/sample.ubx\n")
+        f.write("frames_ok %d\nchecksum_errors %d\nacks %d\nnaks %d\n" % (frames_ok, checksum_errors, len(acks), naks))
+        f.write("sats %d\n" % len(epochs[-1]["sats"]))
+        f.write("# epoch iTOW valid latE7 lngE7 altCm speedCmps\n")
+        for x in expected:
+            f.write("epoch %d %d %d %d %d %d\n" % x)
+    print("%s: %d bytes, %d epochs expected" % (OUT, len(out), len(expected)))
+
+
+main()
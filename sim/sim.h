@@ -0,0 +1,95 @@
+#pragma once
+// 主机模拟器内部接口：命令行配置、模拟时钟和各 HAL 垫片的统计计数。
+// 固件代码不包含本文件，只通过 sim/include 下的 Arduino/ESP32 同名头文件与之交互。
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+struct SimConfig
+{
+  std::string replayPath;        // GPS 串口回放文件（NMEA 或 UBX 原始字节）
+  uint32_t baud = 0;             // 回放波特率，0 表示跟随固件 begin()/updateBaudRate()
+  double speedup = 1.0;          // 模拟时钟倍速，millis()/delay() 与回放速率同比缩放
+  bool loopReplay = false;       // 回放到末尾后从头开始
+  bool replayTiming = true;      // 按录制数据中的历元时间（NMEA 时间字段/UBX iTOW）成批发送
+  std::string fsRoot = "sim_fs"; // LittleFS 映射的本地目录
+  std::string dataDir = "data";  // 首次启动时拷入 fsRoot 的网页资源目录
+  uint32_t fsSize = 1441792;     // 报告给 totalBytes() 的分区大小
+  uint16_t httpPort = 8080;      // 固件 WebServer(80) 实际监听的本地端口
+  double durationSec = 0;        // 模拟运行时长（模拟秒），0 表示回放结束后再运行 2 秒
+  bool wifiOk = true;            // false：STA 永远连不上，走 AP 回退
+  double wifiDropSec = 0;        // >0：在该模拟时刻断开 STA，检验重连逻辑
+  bool quiet = false;            // 不把固件的 Serial 输出打印到终端
+
+  bool bench = false;            // 运行 NMEA 解析基准后退出
+  std::string benchCorpus;       // 语料文件，空表示使用合成语料
+  size_t benchSentences = 200000; // 合成语料条数
+  std::string benchBaseline;     // 与之比较的基线文件
+  std::string benchSave;         // 结果另存为基线
+  double benchTolerance = 0.25;  // 单条耗时允许超出基线的比例
+
+  bool benchGeofence = false;    // 运行电子围栏基准后退出
+  uint32_t benchZones = 1000;    // 基准生成的区域数
+  bool benchGeo = false;         // 运行定点大地测量精度/速度基准后退出
+
+  std::string checkUbx;          // 解码该 UBX 录制文件并与 <文件>.expect 比较后退出
+  std::string checkFilter;       // 以该 UBX 录制文件为真值检查 TrackFilter 后退出
+};
+
+extern SimConfig simConfig;
+
+// 模拟时钟（已按 speedup 缩放）
+uint64_t simMicros();
+void simSleepMicros(uint64_t simUs);
+
+struct SimUartStats
+{
+  std::atomic<uint64_t> bytesReplayed{0}; // 写入模拟 UART 接收缓冲区的字节
+  std::atomic<uint64_t> bytesDropped{0};  // 接收缓冲区满被丢弃的字节
+  std::atomic<uint32_t> overflows{0};     // 触发 UART_BUFFER_FULL_ERROR 的次数
+  std::atomic<uint64_t> bytesTx{0};       // 固件发往 GPS 模块的字节（UBX 配置等）
+  std::atomic<bool> replayDone{false};
+  std::atomic<uint64_t> replayDoneUs{0};
+};
+
+struct SimFsStats
+{
+  std::atomic<uint64_t> bytesWritten{0};
+  std::atomic<uint64_t> writeCalls{0};
+  std::atomic<uint64_t> flushes{0};
+  std::atomic<uint64_t> opensForWrite{0};
+  std::atomic<uint64_t> bytesRead{0};
+};
+
+struct SimHttpStats
+{
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> bytesSent{0};
+};
+
+extern SimUartStats simUartStats;
+extern SimFsStats simFsStats;
+extern SimHttpStats simHttpStats;
+
+class HardwareSerial;
+// 由 GPS 口的 HardwareSerial::begin() 调用，启动回放线程
+void simReplayStart(HardwareSerial *port);
+// 由 WiFi.begin() 调用，按 simConfig 安排连接/断开事件
+void simWifiSchedule();
+// 把固件中的 LittleFS 路径（如 /trip_1.bin）映射为 fsRoot 下的本地路径
+std::string simFsPath(const char *path);
+// 首次运行时把 dataDir 拷入 fsRoot
+void simFsSeed();
+// --bench：返回进程退出码（0 通过，1 相对基线退化，2 无法运行）
+int simRunBench();
+// --bench-geofence：返回进程退出码（0 通过，1 索引结果与暴力比对不符、超出代价上限或分配了内存）
+int simRunGeofenceBench();
+// --bench-geo：返回进程退出码（0 通过，1 误差超出 geo_fixed.h 给出的上限）
+int simRunGeoBench();
+// --check-ubx：返回进程退出码（0 通过，1 与期望结果不符，2 无法打开文件）
+int simRunUbxCheck();
+// --check-filter：返回进程退出码（0 通过，1 误差、耗时或分配超出上限，2 无法读取数据）
+int simRunFilterCheck();
+// 本线程累计的堆分配次数（sim_bench.cpp 替换了全局 operator new）
+uint64_t simThreadAllocs();
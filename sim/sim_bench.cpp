@@ -0,0 +1,327 @@
+// NMEA 解析吞吐基准（--bench）
+//
+// 把语料逐条写入固件的 gpsRing，再调用固件自己的 drainGps()，测到的就是真机
+// loop() 里的完整接收路径：串口回显、gps.encode()、日志行拼接和定位更新后的写盘。
+// 每条语句单独计时并统计本线程的堆分配次数，按语句类型汇总。
+//
+// 默认语料为确定性合成数据（GGA/RMC/GSV/GSA/VTG/GLL，含校验错误和截断语句），
+// 也可用 --bench-corpus 指定录制文件。--bench-save 保存基线，--bench-baseline
+// 与基线比较，任一类型耗时超出容差或分配次数增加时以退出码 1 失败。
+// 计时为主机时间，基线只能在同一台机器上比较。
+#include <Arduino.h>
+#include <TinyGPS++.h>
+#include <chrono>
+#include <map>
+#include <new>
+#include "gps_ring.h"
+#include "sim.h"
+
+extern SpscRing<4096> gpsRing;
+extern TinyGPSPlus gps;
+void drainGps();
+
+// ---- 按线程统计堆分配 ----
+
+static thread_local uint64_t threadAllocs = 0;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(size_t size)
+{
+  threadAllocs++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+#pragma GCC diagnostic pop
+
+uint64_t simThreadAllocs() { return threadAllocs; }
+
+#ifdef GPS_USE_UBX
+
+int simRunBench()
+{
+  fprintf(stderr, "[BENCH] firmware built with GPS_USE_UBX, NMEA path not compiled\n");
+  return 2;
+}
+
+#else
+
+// ---- 语料 ----
+
+struct Sentence
+{
+  std::string text; // 含 \r\n
+  std::string type; // GGA/RMC/...，或 bad-checksum / truncated
+};
+
+static uint32_t lcgState = 12345;
+static uint32_t lcg(uint32_t range)
+{
+  lcgState = lcgState * 1664525u + 1013904223u;
+  return (lcgState >> 8) % range;
+}
+
+static std::string withChecksum(const std::string &body)
+{
+  uint8_t c = 0;
+  for (char ch : body)
+    c ^= (uint8_t)ch;
+  char tail[8];
+  snprintf(tail, sizeof(tail), "*%02X\r\n", c);
+  return "$" + body + tail;
+}
+
+static std::vector<Sentence> syntheticCorpus(size_t count)
+{
+  std::vector<Sentence> out;
+  out.reserve(count);
+  char body[96];
+  for (uint32_t epoch = 0; out.size() < count; epoch++)
+  {
+    unsigned hh = (epoch / 3600) % 24, mm = (epoch / 60) % 60, ss = epoch % 60;
+    unsigned latMin = 1390000 + lcg(20000), lngMin = 2844000 + lcg(20000); // 分 × 1e5
+    unsigned knots = lcg(30000), course = lcg(36000), alt = 1000 + lcg(5000);
+    char lat[16], lng[16];
+    snprintf(lat, sizeof(lat), "31%02u.%05u", latMin / 100000, latMin % 100000);
+    snprintf(lng, sizeof(lng), "121%02u.%05u", lngMin / 100000, lngMin % 100000);
+
+    std::vector<Sentence> epochSentences;
+    snprintf(body, sizeof(body), "GPRMC,%02u%02u%02u.00,A,%s,N,%s,E,%u.%03u,%u.%02u,171026,,,A", hh, mm, ss, lat, lng,
+             knots / 1000, knots % 1000, course / 100, course % 100);
+    epochSentences.push_back({withChecksum(body), "RMC"});
+    snprintf(body, sizeof(body), "GPVTG,%u.%02u,T,,M,%u.%03u,N,%u.%03u,K,A", course / 100, course % 100, knots / 1000,
+             knots % 1000, knots * 1852 / 1000000, knots * 1852 / 1000 % 1000);
+    epochSentences.push_back({withChecksum(body), "VTG"});
+    snprintf(body, sizeof(body), "GPGGA,%02u%02u%02u.00,%s,N,%s,E,1,%02u,%u.%02u,%u.%u,M,7.0,M,,", hh, mm, ss, lat, lng,
+             4 + lcg(9), 1 + lcg(2), lcg(100), alt / 10, alt % 10);
+    epochSentences.push_back({withChecksum(body), "GGA"});
+    snprintf(body, sizeof(body), "GPGSA,A,3,05,12,15,18,20,24,25,29,,,,,1.%02u,1.%02u,1.%02u", lcg(100), lcg(100),
+             lcg(100));
+    epochSentences.push_back({withChecksum(body), "GSA"});
+    for (unsigned i = 1; i <= 3; i++)
+    {
+      int n = snprintf(body, sizeof(body), "GPGSV,3,%u,12", i);
+      for (unsigned s = 0; s < 4; s++)
+        n += snprintf(body + n, sizeof(body) - n, ",%02u,%02u,%03u,%02u", i * 4 + s, lcg(90), lcg(360), lcg(50));
+      epochSentences.push_back({withChecksum(body), "GSV"});
+    }
+    snprintf(body, sizeof(body), "GPGLL,%s,N,%s,E,%02u%02u%02u.00,A,A", lat, lng, hh, mm, ss);
+    epochSentences.push_back({withChecksum(body), "GLL"});
+
+    for (Sentence &s : epochSentences)
+    {
+      size_t idx = out.size();
+      if (idx % 50 == 49)
+      {
+        // 改动一个数据字符，校验和不再匹配
+        s.text[7] = s.text[7] == '0' ? '1' : '0';
+        s.type = "bad-checksum";
+      }
+      else if (idx % 97 == 96)
+      {
+        // 语句中途断开（模块复位、串口丢字节），下一条从 $ 重新同步
+        s.text = s.text.substr(0, s.text.size() / 2) + "\r\n";
+        s.type = "truncated";
+      }
+      out.push_back(s);
+      if (out.size() == count)
+        break;
+    }
+  }
+  return out;
+}
+
+static std::string classify(const std::string &line)
+{
+  size_t star = line.rfind('*');
+  if (line.size() < 7 || line[0] != '$' || star == std::string::npos || star + 3 > line.size())
+    return "truncated";
+  uint8_t c = 0;
+  for (size_t i = 1; i < star; i++)
+    c ^= (uint8_t)line[i];
+  if (strtoul(line.substr(star + 1, 2).c_str(), nullptr, 16) != c)
+    return "bad-checksum";
+  return line.substr(3, 3);
+}
+
+static std::vector<Sentence> fileCorpus(const std::string &path)
+{
+  std::vector<Sentence> out;
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return out;
+  std::string line;
+  int ch;
+  while ((ch = fgetc(f)) != EOF)
+  {
+    line += (char)ch;
+    if (ch == '\n')
+    {
+      std::string trimmed = line.substr(0, line.find_last_not_of("\r\n") + 1);
+      out.push_back({line, classify(trimmed)});
+      line.clear();
+    }
+  }
+  fclose(f);
+  return out;
+}
+
+// ---- 计时 ----
+
+struct TypeStats
+{
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  uint64_t totalNs = 0;
+  uint64_t allocs = 0;
+  std::vector<uint32_t> samples; // 单条耗时（ns），用于 p99
+};
+
+static uint32_t p99(std::vector<uint32_t> &v)
+{
+  if (v.empty())
+    return 0;
+  size_t k = v.size() * 99 / 100;
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+static void feed(const Sentence &s)
+{
+  gpsRing.push((const uint8_t *)s.text.data(), s.text.size());
+  drainGps();
+}
+
+struct Baseline
+{
+  double nsPerSentence = 0;
+  double allocsPerSentence = 0;
+};
+
+static std::map<std::string, Baseline> loadBaseline(const std::string &path)
+{
+  std::map<std::string, Baseline> b;
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f)
+    return b;
+  char type[32];
+  double ns, allocs;
+  while (fscanf(f, "%31s %lf %lf", type, &ns, &allocs) == 3)
+    b[type] = {ns, allocs};
+  fclose(f);
+  return b;
+}
+
+int simRunBench()
+{
+  std::vector<Sentence> corpus = simConfig.benchCorpus.empty() ? syntheticCorpus(simConfig.benchSentences)
+                                                               : fileCorpus(simConfig.benchCorpus);
+  if (corpus.empty())
+  {
+    fprintf(stderr, "[BENCH] empty corpus\n");
+    return 2;
+  }
+
+  // 预热：填充指令缓存和日志环，不计入结果
+  for (size_t i = 0; i < corpus.size() && i < 1000; i++)
+    feed(corpus[i]);
+
+  uint32_t passedBefore = gps.passedChecksum();
+  uint32_t failedBefore = gps.failedChecksum();
+  std::map<std::string, TypeStats> stats;
+  TypeStats all;
+  for (const Sentence &s : corpus)
+  {
+    uint64_t allocs = threadAllocs;
+    auto t0 = std::chrono::steady_clock::now();
+    feed(s);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    allocs = threadAllocs - allocs;
+    for (TypeStats *t : {&stats[s.type], &all})
+    {
+      t->count++;
+      t->bytes += s.text.size();
+      t->totalNs += ns;
+      t->allocs += allocs;
+      t->samples.push_back((uint32_t)ns);
+    }
+  }
+
+  double seconds = all.totalNs / 1e9;
+  fprintf(stderr, "\n[BENCH] %llu sentences, %llu bytes, %.1f ms\n", (unsigned long long)all.count,
+          (unsigned long long)all.bytes, all.totalNs / 1e6);
+  fprintf(stderr, "[BENCH] throughput %.0f bytes/s (%.1f ns/byte); 10 Hz NEO-6M output is about 5000 bytes/s\n",
+          all.bytes / seconds, (double)all.totalNs / all.bytes);
+  fprintf(stderr, "[BENCH] TinyGPS checksums: passed=%lu failed=%lu\n",
+          (unsigned long)(gps.passedChecksum() - passedBefore), (unsigned long)(gps.failedChecksum() - failedBefore));
+  fprintf(stderr, "%-14s %9s %11s %10s %10s %12s\n", "type", "count", "ns/sentence", "p99 ns", "ns/byte",
+          "allocs/sent");
+  stats["all"] = all;
+  auto row = [](const std::string &name, TypeStats &t) {
+    fprintf(stderr, "%-14s %9llu %11.0f %10u %10.1f %12.2f\n", name.c_str(), (unsigned long long)t.count,
+            (double)t.totalNs / t.count, p99(t.samples), (double)t.totalNs / t.bytes, (double)t.allocs / t.count);
+  };
+  for (auto &kv : stats)
+  {
+    if (kv.first != "all")
+      row(kv.first, kv.second);
+  }
+  row("all", stats["all"]);
+
+  if (!simConfig.benchSave.empty())
+  {
+    FILE *f = fopen(simConfig.benchSave.c_str(), "w");
+    if (f)
+    {
+      for (auto &kv : stats)
+        fprintf(f, "%s %.1f %.3f\n", kv.first.c_str(), (double)kv.second.totalNs / kv.second.count,
+                (double)kv.second.allocs / kv.second.count);
+      fclose(f);
+      fprintf(stderr, "[BENCH] baseline saved to %s\n", simConfig.benchSave.c_str());
+    }
+  }
+
+  int rc = 0;
+  if (!simConfig.benchBaseline.empty())
+  {
+    std::map<std::string, Baseline> base = loadBaseline(simConfig.benchBaseline);
+    if (base.empty())
+    {
+      fprintf(stderr, "[BENCH] cannot read baseline %s\n", simConfig.benchBaseline.c_str());
+      return 2;
+    }
+    for (auto &kv : stats)
+    {
+      auto it = base.find(kv.first);
+      if (it == base.end())
+        continue;
+      double ns = (double)kv.second.totalNs / kv.second.count;
+      double allocs = (double)kv.second.allocs / kv.second.count;
+      if (ns > it->second.nsPerSentence * (1 + simConfig.benchTolerance))
+      {
+        fprintf(stderr, "[BENCH] REGRESSION %s: %.0f ns/sentence, baseline %.0f\n", kv.first.c_str(), ns,
+                it->second.nsPerSentence);
+        rc = 1;
+      }
+      if (allocs > it->second.allocsPerSentence + 0.01)
+      {
+        fprintf(stderr, "[BENCH] REGRESSION %s: %.2f allocs/sentence, baseline %.2f\n", kv.first.c_str(), allocs,
+                it->second.allocsPerSentence);
+        rc = 1;
+      }
+    }
+    if (!rc)
+      fprintf(stderr, "[BENCH] within %.0f%% of baseline\n", simConfig.benchTolerance * 100);
+  }
+  return rc;
+}
+
+#endif
@@ -0,0 +1,336 @@
+// 模拟时钟、串口、ESP 对象与 FreeRTOS 垫片
+#include <Arduino.h>
+#include <ESPmDNS.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "sim.h"
+
+// ESP32-C3 上 Arduino 应用可用的堆，约等于启动后 getFreeHeap() 的典型值
+#define SIM_HEAP_SIZE 262144
+
+SimConfig simConfig;
+SimUartStats simUartStats;
+SimFsStats simFsStats;
+SimHttpStats simHttpStats;
+
+HardwareSerial Serial(0);
+EspClass ESP;
+MDNSResponder MDNS;
+SPIClass SPI;
+TwoWire Wire;
+
+static const auto simEpoch = std::chrono::steady_clock::now();
+
+uint64_t simMicros()
+{
+  auto real = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - simEpoch);
+  return (uint64_t)(real.count() * simConfig.speedup);
+}
+
+void simSleepMicros(uint64_t simUs)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(simUs / simConfig.speedup)));
+}
+
+unsigned long millis() { return (unsigned long)(simMicros() / 1000); }
+unsigned long micros() { return (unsigned long)simMicros(); }
+void delay(uint32_t ms)
+{
+  if (ms == 0)
+    std::this_thread::yield();
+  else
+    simSleepMicros((uint64_t)ms * 1000);
+}
+void delayMicroseconds(uint32_t us) { simSleepMicros(us); }
+void yield() { std::this_thread::yield(); }
+uint32_t esp_random()
+{
+  static std::mt19937 rng(std::random_device{}());
+  return rng();
+}
+
+void configTime(long, int, const char *, const char *, const char *) {}
+
+// ---- HardwareSerial ----
+
+void HardwareSerial::begin(unsigned long baud, uint32_t, int8_t, int8_t, bool, unsigned long, uint8_t)
+{
+  {
+    std::lock_guard<std::recursive_mutex> g(_lock);
+    _baud = baud;
+    _rx.assign(_rxCap, 0);
+    _rxHead = _rxCount = 0;
+  }
+  if (_uartNr != 0)
+    simReplayStart(this);
+}
+
+size_t HardwareSerial::setRxBufferSize(size_t size)
+{
+  std::lock_guard<std::recursive_mutex> g(_lock);
+  _rxCap = size;
+  return size;
+}
+
+void HardwareSerial::onReceive(OnReceiveCb cb, bool)
+{
+  std::lock_guard<std::recursive_mutex> g(_lock);
+  _onReceive = cb;
+}
+
+void HardwareSerial::onReceiveError(OnReceiveErrorCb cb)
+{
+  std::lock_guard<std::recursive_mutex> g(_lock);
+  _onError = cb;
+}
+
+int HardwareSerial::available()
+{
+  std::lock_guard<std::recursive_mutex> g(_lock);
+  return (int)_rxCount;
+}
+
+int HardwareSerial::peek()
+{
+  std::lock_guard<std::recursive_mutex> g(_lock);
+  return _rxCount ? _rx[_rxHead] : -1;
+}
+
+int HardwareSerial::read()
+{
+  uint8_t c;
+  return read(&c, 1) ? c : -1;
+}
+
+size_t HardwareSerial::read(uint8_t *buf, size_t size)
+{
+  std::lock_guard<std::recursive_mutex> g(_lock);
+  size_t n = 0;
+  while (n < size && _rxCount)
+  {
+    buf[n++] = _rx[_rxHead];
+    _rxHead = (_rxHead + 1) % _rx.size();
+    _rxCount--;
+  }
+  return n;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{
+  if (_uartNr != 0)
+  {
+    simUartStats.bytesTx += size;
+    return size;
+  }
+  if (!simConfig.quiet)
+    fwrite(buf, 1, size, stdout);
+  return size;
+}
+
+void HardwareSerial::flush()
+{
+  if (_uartNr == 0 && !simConfig.quiet)
+    fflush(stdout);
+}
+
+// 驱动每收满一个 FIFO 阈值（约 120 字节）触发一次 onReceive，这里按同样粒度切片
+void HardwareSerial::simInject(const uint8_t *data, size_t len)
+{
+  const size_t FIFO_FULL = 120;
+  while (len)
+  {
+    size_t n = len < FIFO_FULL ? len : FIFO_FULL;
+    size_t dropped = 0;
+    OnReceiveCb onReceive;
+    OnReceiveErrorCb onError;
+    {
+      std::lock_guard<std::recursive_mutex> g(_lock);
+      for (size_t i = 0; i < n; i++)
+      {
+        if (_rx.empty() || _rxCount == _rx.size())
+        {
+          dropped++;
+          continue;
+        }
+        _rx[(_rxHead + _rxCount) % _rx.size()] = data[i];
+        _rxCount++;
+      }
+      onReceive = _onReceive;
+      onError = _onError;
+    }
+    simUartStats.bytesReplayed += n - dropped;
+    if (dropped)
+    {
+      simUartStats.bytesDropped += dropped;
+      simUartStats.overflows++;
+      if (onError)
+        onError(UART_BUFFER_FULL_ERROR);
+    }
+    if (onReceive)
+      onReceive();
+    data += n;
+    len -= n;
+  }
+}
+
+// ---- ESP ----
+
+static size_t heapInUse()
+{
+#ifdef __GLIBC__
+  static const size_t baseline = mallinfo2().uordblks;
+  size_t now = mallinfo2().uordblks;
+  return now > baseline ? now - baseline : 0;
+#else
+  return 0;
+#endif
+}
+
+static std::atomic<uint32_t> minFreeHeap{SIM_HEAP_SIZE};
+
+// 主机进程的堆增量折算为模拟堆占用，用来观察泄漏和峰值，绝对值仅供参考
+uint32_t EspClass::getFreeHeap()
+{
+  size_t used = heapInUse();
+  uint32_t free = used < SIM_HEAP_SIZE ? (uint32_t)(SIM_HEAP_SIZE - used) : 0;
+  if (free < minFreeHeap)
+    minFreeHeap = free;
+  return free;
+}
+uint32_t EspClass::getMinFreeHeap()
+{
+  getFreeHeap();
+  return minFreeHeap;
+}
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+uint32_t EspClass::getHeapSize() { return SIM_HEAP_SIZE; }
+// 按模拟时钟折算周期数；取纳秒精度，短分段（几微秒）的直方图才有意义
+uint32_t EspClass::getCycleCount()
+{
+  auto real = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - simEpoch);
+  return (uint32_t)(uint64_t)(real.count() * simConfig.speedup * getCpuFreqMHz() / 1000);
+}
+
+extern char **simArgv;
+
+// 重启即重新执行模拟器本身，LittleFS 目录保留，可用来检验断电/重启恢复
+void EspClass::restart()
+{
+  fprintf(stderr, "[SIM] ESP.restart()\n");
+  fflush(stdout);
+  fflush(stderr);
+  execvp(simArgv[0], simArgv);
+  _exit(1);
+}
+
+// ---- FreeRTOS ----
+
+struct SimSemaphore
+{
+  std::recursive_timed_mutex m;
+};
+
+struct SimTask
+{
+  std::thread thread;
+  uint32_t stackDepth = 0;
+  std::mutex notifyLock;
+  std::condition_variable notifyCv;
+  uint32_t notifyCount = 0;
+};
+
+static thread_local SimTask *currentTask = nullptr;
+
+static BaseType_t takeFor(SemaphoreHandle_t sem, TickType_t ticks)
+{
+  if (ticks == portMAX_DELAY)
+  {
+    sem->m.lock();
+    return pdTRUE;
+  }
+  auto wait = std::chrono::microseconds((int64_t)(ticks * 1000.0 / simConfig.speedup));
+  return sem->m.try_lock_for(wait) ? pdTRUE : pdFALSE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new SimSemaphore; }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new SimSemaphore; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) { return takeFor(sem, ticks); }
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks) { return takeFor(sem, ticks); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+  sem->m.unlock();
+  return pdTRUE;
+}
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) { return xSemaphoreGive(sem); }
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t stackDepth, void *param, UBaseType_t,
+                       TaskHandle_t *handle)
+{
+  SimTask *task = new SimTask;
+  task->stackDepth = stackDepth;
+  task->thread = std::thread([task, fn, param]()
+                             {
+                               currentTask = task;
+                               fn(param);
+                             });
+  task->thread.detach();
+  if (handle)
+    *handle = task;
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t)
+{
+  return xTaskCreate(fn, name, stackDepth, param, priority, handle);
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  if (!currentTask)
+    currentTask = new SimTask;
+  return currentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  {
+    std::lock_guard<std::mutex> g(task->notifyLock);
+    task->notifyCount++;
+  }
+  task->notifyCv.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+  SimTask *task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> g(task->notifyLock);
+  auto ready = [task]() { return task->notifyCount > 0; };
+  if (ticks == portMAX_DELAY)
+    task->notifyCv.wait(g, ready);
+  else
+    task->notifyCv.wait_for(g, std::chrono::microseconds((int64_t)(ticks * 1000.0 / simConfig.speedup)), ready);
+  uint32_t count = task->notifyCount;
+  if (count > 0)
+    task->notifyCount = clearOnExit ? 0 : count - 1;
+  return count;
+}
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+// 主机线程无法测量栈水位，返回配置的栈深度
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return task ? task->stackDepth : 0; }
@@ -0,0 +1,187 @@
+// 定位平滑检查（--check-filter 文件）
+//
+// 用 UbxDecoder 解码录制的 UBX 数据（如 sim/replay/sample.ubx），把解出的定位当作真值，
+// 按 HDOP 加上确定性的高斯噪声（每轴 σ = UERE × HDOP，速度 σ = TRACK_FILTER_VEL_CMPS × HDOP）
+// 后逐点送入 TrackFilter，多次使用不同噪声重复整段行程。比较原始/滤波后与真值的差：
+//   水平位置 RMS 和最大误差、速度 RMS、停车 3 秒以后的最大速度读数
+// 以及每次 update() 的主机耗时（折算为 160 MHz 周期）和堆分配次数。
+// 滤波后 RMS 不低于原始的 60%、单点误差超过 2.5 × UERE × HDOP、停车速度不比原始小、
+// p99 耗时超出 TRACK_FILTER_BUDGET_CYCLES 或有分配时以退出码 1 失败。
+// 主机比 C3 快得多，耗时检查只是必要条件，设备上的实际周期数看 /metrics 的 filter 分段。
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "geo_fixed.h"
+#include "sim.h"
+#include "track_filter.h"
+#include "ubx.h"
+
+#define FILTER_PASSES 200
+#define FILTER_WARMUP_FIXES 5 // 每段行程开头不计：滤波器刚初始化
+#define FILTER_MAX_ERR_SIGMA 2.5 // 滤波后单点水平误差上限，以 UERE × HDOP 为单位
+#define FILTER_STOP_FIXES 3       // 停车满这么多个定位点后才统计速度读数（之前是减速的滞后）
+
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+static double uniform()
+{
+  rngState = rngState * 6364136223846793005ULL + 1442695040888963407ULL;
+  return ((rngState >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+static double gaussian()
+{
+  return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+struct ErrSum
+{
+  double sumSq = 0, max = 0;
+  uint32_t n = 0;
+  void add(double e)
+  {
+    sumSq += e * e;
+    max = std::max(max, fabs(e));
+    n++;
+  }
+  double rms() const { return n ? sqrt(sumSq / n) : 0; }
+};
+
+int simRunFilterCheck()
+{
+  const std::string &path = simConfig.checkFilter;
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in)
+  {
+    fprintf(stderr, "[CHECK] cannot open %s\n", path.c_str());
+    return 2;
+  }
+  std::vector<GpsFix> truth;
+  std::vector<uint32_t> tows;
+  UbxDecoder ubx;
+  int c;
+  while ((c = fgetc(in)) != EOF)
+  {
+    if (ubx.feed((uint8_t)c) && ubx.fix().valid)
+    {
+      truth.push_back(ubx.fix());
+      tows.push_back(ubx.epochTow());
+    }
+  }
+  fclose(in);
+  if (truth.size() <= FILTER_WARMUP_FIXES)
+  {
+    fprintf(stderr, "[CHECK] %s: only %u valid fixes\n", path.c_str(), (unsigned)truth.size());
+    return 2;
+  }
+
+  ErrSum rawPos, filtPos, rawSpeed, filtSpeed;
+  double filtWorstSigma = 0;
+  double rawStopPeak = 0, filtStopPeak = 0;
+  std::vector<uint32_t> ns;
+  ns.reserve(truth.size() * FILTER_PASSES);
+  uint64_t allocs = 0;
+  const GpsFix &origin = truth[0];
+  for (uint32_t pass = 0; pass < FILTER_PASSES; pass++)
+  {
+    TrackFilter filter;
+    uint32_t stopped = 0;
+    for (size_t i = 0; i < truth.size(); i++)
+    {
+      const GpsFix &t = truth[i];
+      double hdop = (t.hdopX100 ? t.hdopX100 : 200) / 100.0;
+      // 真值在局部平面上加噪声
+      int32_t east, north;
+      geoToLocalCm(origin.latE7, origin.lngE7, t.latE7, t.lngE7, east, north);
+      GpsFix raw = t;
+      double sigma = TRACK_FILTER_UERE_CM * hdop;
+      geoFromLocalCm(origin.latE7, origin.lngE7, east + (int32_t)lround(gaussian() * sigma),
+                     north + (int32_t)lround(gaussian() * sigma), raw.latE7, raw.lngE7);
+      double course = t.courseCdeg * M_PI / 18000;
+      double sigmaV = TRACK_FILTER_VEL_CMPS * hdop;
+      double ve = t.speedCmps * sin(course) + gaussian() * sigmaV;
+      double vn = t.speedCmps * cos(course) + gaussian() * sigmaV;
+      raw.speedCmps = (uint32_t)lround(hypot(ve, vn));
+      double heading = atan2(ve, vn) * 18000 / M_PI;
+      raw.courseCdeg = (uint16_t)lround(heading < 0 ? heading + 36000 : heading) % 36000;
+
+      uint32_t nowMs = tows[i] - tows[0];
+      uint64_t a0 = simThreadAllocs();
+      auto t0 = std::chrono::steady_clock::now();
+      const GpsFix &out = filter.update(raw, nowMs);
+      auto t1 = std::chrono::steady_clock::now();
+      allocs += simThreadAllocs() - a0;
+      ns.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+      stopped = t.speedCmps == 0 ? stopped + 1 : 0;
+      if (i < FILTER_WARMUP_FIXES)
+        continue;
+
+      rawPos.add(geoEquirectCm(t.latE7, t.lngE7, raw.latE7, raw.lngE7));
+      uint32_t filtErr = geoEquirectCm(t.latE7, t.lngE7, out.latE7, out.lngE7);
+      filtPos.add(filtErr);
+      filtWorstSigma = std::max(filtWorstSigma, filtErr / sigma);
+      rawSpeed.add((double)raw.speedCmps - t.speedCmps);
+      filtSpeed.add((double)out.speedCmps - t.speedCmps);
+      if (stopped > FILTER_STOP_FIXES)
+      {
+        rawStopPeak = std::max(rawStopPeak, (double)raw.speedCmps);
+        filtStopPeak = std::max(filtStopPeak, (double)out.speedCmps);
+      }
+    }
+  }
+
+  std::sort(ns.begin(), ns.end());
+  uint32_t p50 = ns[ns.size() / 2], p99 = ns[ns.size() * 99 / 100], maxNs = ns.back();
+  // 主机纳秒折算为 C3 160 MHz 下的周期数
+  uint32_t p99Cycles = p99 * 160 / 1000;
+  fprintf(stderr, "[CHECK] %s: %u fixes x %u noise passes\n", path.c_str(), (unsigned)truth.size(), FILTER_PASSES);
+  fprintf(stderr, "%-10s %12s %12s %14s %14s\n", "", "pos rms m", "pos max m", "speed rms m/s", "stop peak m/s");
+  fprintf(stderr, "%-10s %12.2f %12.2f %14.2f %14.2f\n", "raw", rawPos.rms() / 100, rawPos.max / 100,
+          rawSpeed.rms() / 100, rawStopPeak / 100);
+  fprintf(stderr, "%-10s %12.2f %12.2f %14.2f %14.2f\n", "filtered", filtPos.rms() / 100, filtPos.max / 100,
+          filtSpeed.rms() / 100, filtStopPeak / 100);
+  fprintf(stderr, "[CHECK] worst filtered error %.2f x UERE x HDOP (limit %.1f)\n", filtWorstSigma,
+          FILTER_MAX_ERR_SIGMA);
+  fprintf(stderr, "[CHECK] update(): p50 %u ns, p99 %u ns (%u cycles at 160 MHz, budget %u), max %u ns; %.3f allocs/fix\n",
+          p50, p99, p99Cycles, TRACK_FILTER_BUDGET_CYCLES, maxNs, (double)allocs / ns.size());
+
+  int rc = 0;
+  if (filtPos.rms() > rawPos.rms() * 0.6)
+  {
+    fprintf(stderr, "[CHECK] FAIL filtered position rms %.2f m is not below 60%% of raw %.2f m\n",
+            filtPos.rms() / 100, rawPos.rms() / 100);
+    rc = 1;
+  }
+  if (filtWorstSigma > FILTER_MAX_ERR_SIGMA)
+  {
+    fprintf(stderr, "[CHECK] FAIL filtered position error reached %.2f x UERE x HDOP, limit %.1f\n", filtWorstSigma,
+            FILTER_MAX_ERR_SIGMA);
+    rc = 1;
+  }
+  if (filtSpeed.rms() > rawSpeed.rms())
+  {
+    fprintf(stderr, "[CHECK] FAIL filtered speed rms %.2f m/s above raw %.2f m/s\n", filtSpeed.rms() / 100,
+            rawSpeed.rms() / 100);
+    rc = 1;
+  }
+  if (rawStopPeak > 0 && filtStopPeak >= rawStopPeak)
+  {
+    fprintf(stderr, "[CHECK] FAIL stationary speed peak %.2f m/s not below raw %.2f m/s\n", filtStopPeak / 100,
+            rawStopPeak / 100);
+    rc = 1;
+  }
+  if (p99Cycles > TRACK_FILTER_BUDGET_CYCLES)
+  {
+    fprintf(stderr, "[CHECK] FAIL update() p99 %u cycles exceeds budget %u\n", p99Cycles,
+            TRACK_FILTER_BUDGET_CYCLES);
+    rc = 1;
+  }
+  if (allocs)
+  {
+    fprintf(stderr, "[CHECK] FAIL update() allocated %llu times\n", (unsigned long long)allocs);
+    rc = 1;
+  }
+  if (rc == 0)
+    fprintf(stderr, "[CHECK] ok\n");
+  return rc;
+}
@@ -0,0 +1,344 @@
+// 目录映射的 LittleFS
+#include <LittleFS.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include "sim.h"
+
+#define SIM_FS_BLOCK 4096
+
+fs::LittleFSFS LittleFS;
+
+namespace fs
+{
+
+struct FileImpl
+{
+  std::string vpath; // 固件看到的路径，如 /trip_1.bin
+  FILE *fp = nullptr;
+  bool dir = false;
+  std::vector<std::string> entries;
+  size_t next = 0;
+
+  ~FileImpl()
+  {
+    if (fp)
+      fclose(fp);
+  }
+};
+
+} // namespace fs
+
+std::string simFsPath(const char *path)
+{
+  std::string p = path ? path : "/";
+  if (p.empty() || p[0] != '/')
+    p.insert(0, 1, '/');
+  // 不允许跳出映射目录
+  if (p.find("/..") != std::string::npos)
+    p = "/";
+  while (p.size() > 1 && p.back() == '/')
+    p.pop_back();
+  return simConfig.fsRoot + (p == "/" ? "" : p);
+}
+
+static bool isDir(const std::string &local)
+{
+  struct stat st;
+  return stat(local.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void mkdirs(const std::string &dir)
+{
+  for (size_t i = 1; i <= dir.size(); i++)
+  {
+    if (i == dir.size() || dir[i] == '/')
+      ::mkdir(dir.substr(0, i).c_str(), 0755);
+  }
+}
+
+static uint64_t usedBlocks(const std::string &dir)
+{
+  uint64_t blocks = 1; // 目录本身
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    return blocks;
+  struct dirent *e;
+  while ((e = readdir(d)) != nullptr)
+  {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+      continue;
+    std::string p = dir + "/" + e->d_name;
+    struct stat st;
+    if (stat(p.c_str(), &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode))
+      blocks += usedBlocks(p);
+    else
+      blocks += (st.st_size + SIM_FS_BLOCK - 1) / SIM_FS_BLOCK + 1;
+  }
+  closedir(d);
+  return blocks;
+}
+
+static void removeTree(const std::string &dir)
+{
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    return;
+  struct dirent *e;
+  while ((e = readdir(d)) != nullptr)
+  {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+      continue;
+    std::string p = dir + "/" + e->d_name;
+    if (isDir(p))
+    {
+      removeTree(p);
+      ::rmdir(p.c_str());
+    }
+    else
+      unlink(p.c_str());
+  }
+  closedir(d);
+}
+
+// data/ 下比映射目录中新的文件视为一次 uploadfs
+void simFsSeed()
+{
+  DIR *d = opendir(simConfig.dataDir.c_str());
+  if (!d)
+    return;
+  struct dirent *e;
+  while ((e = readdir(d)) != nullptr)
+  {
+    std::string src = simConfig.dataDir + "/" + e->d_name;
+    std::string dst = simConfig.fsRoot + "/" + e->d_name;
+    struct stat ss, ds;
+    if (stat(src.c_str(), &ss) != 0 || !S_ISREG(ss.st_mode))
+      continue;
+    if (stat(dst.c_str(), &ds) == 0 && ds.st_mtime >= ss.st_mtime)
+      continue;
+    FILE *in = fopen(src.c_str(), "rb");
+    FILE *out = fopen(dst.c_str(), "wb");
+    char buf[4096];
+    size_t n;
+    while (in && out && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+      fwrite(buf, 1, n, out);
+    if (in)
+      fclose(in);
+    if (out)
+      fclose(out);
+  }
+  closedir(d);
+}
+
+namespace fs
+{
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+  if (!_p || !_p->fp)
+    return 0;
+  size_t n = fwrite(buf, 1, size, _p->fp);
+  simFsStats.bytesWritten += n;
+  simFsStats.writeCalls++;
+  return n;
+}
+
+int File::available()
+{
+  if (!_p || !_p->fp)
+    return 0;
+  return (int)(size() - position());
+}
+
+int File::read()
+{
+  uint8_t c;
+  return read(&c, 1) ? c : -1;
+}
+
+int File::peek()
+{
+  if (!_p || !_p->fp)
+    return -1;
+  int c = fgetc(_p->fp);
+  if (c != EOF)
+    ungetc(c, _p->fp);
+  return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+  if (!_p || !_p->fp)
+    return 0;
+  size_t n = fread(buf, 1, size, _p->fp);
+  simFsStats.bytesRead += n;
+  return n;
+}
+
+void File::flush()
+{
+  if (!_p || !_p->fp)
+    return;
+  fflush(_p->fp);
+  simFsStats.flushes++;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  if (!_p || !_p->fp)
+    return false;
+  static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  return fseek(_p->fp, (long)pos, whence[mode]) == 0;
+}
+
+size_t File::position() const
+{
+  if (!_p || !_p->fp)
+    return 0;
+  long pos = ftell(_p->fp);
+  return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t File::size() const
+{
+  if (!_p || !_p->fp)
+    return 0;
+  long pos = ftell(_p->fp);
+  fseek(_p->fp, 0, SEEK_END);
+  long end = ftell(_p->fp);
+  fseek(_p->fp, pos, SEEK_SET);
+  return end < 0 ? 0 : (size_t)end;
+}
+
+void File::close()
+{
+  if (_p && _p->fp)
+  {
+    fclose(_p->fp);
+    _p->fp = nullptr;
+  }
+  _p.reset();
+}
+
+File::operator bool() const { return _p && (_p->fp || _p->dir); }
+
+time_t File::getLastWrite()
+{
+  struct stat st;
+  if (!_p || stat(simFsPath(_p->vpath.c_str()).c_str(), &st) != 0)
+    return 0;
+  return st.st_mtime;
+}
+
+const char *File::path() const { return _p ? _p->vpath.c_str() : nullptr; }
+
+const char *File::name() const
+{
+  if (!_p)
+    return nullptr;
+  size_t slash = _p->vpath.rfind('/');
+  return _p->vpath.size() > 1 ? _p->vpath.c_str() + slash + 1 : _p->vpath.c_str();
+}
+
+bool File::isDirectory() const { return _p && _p->dir; }
+
+File File::openNextFile(const char *mode)
+{
+  if (!_p || !_p->dir || _p->next >= _p->entries.size())
+    return File();
+  std::string child = _p->vpath == "/" ? "/" + _p->entries[_p->next] : _p->vpath + "/" + _p->entries[_p->next];
+  _p->next++;
+  return LittleFS.open(child.c_str(), mode);
+}
+
+void File::rewindDirectory()
+{
+  if (_p)
+    _p->next = 0;
+}
+
+File FS::open(const char *path, const char *mode, const bool create)
+{
+  std::string local = simFsPath(path);
+  FileImplPtr p = std::make_shared<FileImpl>();
+  p->vpath = local.substr(simConfig.fsRoot.size());
+  if (p->vpath.empty())
+    p->vpath = "/";
+
+  if (isDir(local))
+  {
+    if (mode[0] != 'r')
+      return File();
+    DIR *d = opendir(local.c_str());
+    if (!d)
+      return File();
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr)
+    {
+      if (strcmp(e->d_name, ".") && strcmp(e->d_name, ".."))
+        p->entries.push_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(p->entries.begin(), p->entries.end());
+    p->dir = true;
+    return File(p);
+  }
+
+  if (mode[0] != 'r')
+  {
+    if (create)
+      mkdirs(local.substr(0, local.rfind('/')));
+    simFsStats.opensForWrite++;
+  }
+  std::string m = std::string(mode) + "b";
+  p->fp = fopen(local.c_str(), m.c_str());
+  if (!p->fp)
+    return File();
+  return File(p);
+}
+
+bool FS::exists(const char *path)
+{
+  struct stat st;
+  return stat(simFsPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path) { return unlink(simFsPath(path).c_str()) == 0; }
+
+bool FS::rename(const char *from, const char *to)
+{
+  return ::rename(simFsPath(from).c_str(), simFsPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) { return ::mkdir(simFsPath(path).c_str(), 0755) == 0 || isDir(simFsPath(path)); }
+
+bool FS::rmdir(const char *path) { return ::rmdir(simFsPath(path).c_str()) == 0; }
+
+bool LittleFSFS::begin(bool, const char *, uint8_t, const char *)
+{
+  mkdirs(simConfig.fsRoot);
+  if (!isDir(simConfig.fsRoot))
+    return false;
+  simFsSeed();
+  return true;
+}
+
+bool LittleFSFS::format()
+{
+  removeTree(simConfig.fsRoot);
+  return true;
+}
+
+size_t LittleFSFS::totalBytes() { return simConfig.fsSize; }
+
+size_t LittleFSFS::usedBytes()
+{
+  uint64_t used = usedBlocks(simConfig.fsRoot) * SIM_FS_BLOCK;
+  return used < simConfig.fsSize ? (size_t)used : simConfig.fsSize;
+}
+
+} // namespace fs
@@ -0,0 +1,251 @@
+// 定点大地测量基准（--bench-geo）
+//
+// 精度：在纬度 ±85° 内生成确定性的随机点对（方向随机，距离在各区间内按对数均匀分布），
+// 端点取整到 1e-7 度后，与 double 版半正矢公式（R = 6371008.8 m）比较 geoEquirectCm、
+// geoHaversineCm，与 double 版局部平面方位角比较 geoBearingCdeg，按距离区间和纬度带
+// 输出最大误差。任一区间超出 geo_fixed.h 中给出的误差上限时以退出码 1 失败。
+//
+// 速度：同一批点对分别调用定点版和 double 版，输出每次调用的纳秒数（x86 上另给出 TSC
+// 周期数）。主机有硬件浮点，double 版在这里很快；ESP32-C3 上 double 全部走软件模拟，
+// 设备上的实际开销以 /metrics 中 gps_fix 阶段的耗时为准。计时为主机时间，只适合前后对比。
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "geo_fixed.h"
+#include "sim.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GEO_BENCH_TSC 1
+#endif
+
+static uint64_t lcgState = 0x2545F4914F6CDD1DULL;
+static double rnd()
+{
+  lcgState = lcgState * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (lcgState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static const double EARTH_RADIUS_CM = 637100880.0;
+static const double RAD_PER_E7 = M_PI / 180e7;
+
+// 经度差取最短方向（1e-7 度）
+static double deltaLng(int32_t lng1, int32_t lng2)
+{
+  return remainder((double)lng2 - lng1, 3600000000.0);
+}
+
+static double haversineCm(int32_t lat1, int32_t lng1, int32_t lat2, int32_t lng2)
+{
+  double phi1 = lat1 * RAD_PER_E7, phi2 = lat2 * RAD_PER_E7;
+  double s1 = sin((lat2 - lat1) * RAD_PER_E7 / 2);
+  double s2 = sin(deltaLng(lng1, lng2) * RAD_PER_E7 / 2);
+  double a = s1 * s1 + cos(phi1) * cos(phi2) * s2 * s2;
+  return 2 * EARTH_RADIUS_CM * asin(sqrt(a < 1 ? a : 1));
+}
+
+// 与 geoEquirectCm 相同的近似（中间纬度），double 实现
+static double equirectCm(int32_t lat1, int32_t lng1, int32_t lat2, int32_t lng2)
+{
+  double dLat = (lat2 - lat1) * RAD_PER_E7;
+  double dLng = deltaLng(lng1, lng2) * RAD_PER_E7 * cos((lat1 + (lat2 - lat1) / 2.0) * RAD_PER_E7);
+  return EARTH_RADIUS_CM * sqrt(dLat * dLat + dLng * dLng);
+}
+
+static double bearingDeg(int32_t lat1, int32_t lng1, int32_t lat2, int32_t lng2)
+{
+  double dLat = (double)(lat2 - lat1);
+  double dLng = deltaLng(lng1, lng2) * cos((lat1 + (lat2 - lat1) / 2.0) * RAD_PER_E7);
+  double b = atan2(dLng, dLat) * 180 / M_PI;
+  return b < 0 ? b + 360 : b;
+}
+
+struct GeoPair
+{
+  int32_t lat1, lng1, lat2, lng2;
+  double refCm;
+};
+
+// 从点 1 出发沿方位角 brg 走 distM 米（球面），端点取整到 1e-7 度
+static GeoPair makePair(double latDeg, double lngDeg, double brg, double distM)
+{
+  double phi1 = latDeg * M_PI / 180, lam1 = lngDeg * M_PI / 180, delta = distM * 100 / EARTH_RADIUS_CM;
+  double phi2 = asin(sin(phi1) * cos(delta) + cos(phi1) * sin(delta) * cos(brg));
+  double lam2 = lam1 + atan2(sin(brg) * sin(delta) * cos(phi1), cos(delta) - sin(phi1) * sin(phi2));
+  lam2 = remainder(lam2, 2 * M_PI);
+  GeoPair p;
+  p.lat1 = (int32_t)lround(latDeg * 1e7);
+  p.lng1 = (int32_t)lround(lngDeg * 1e7);
+  p.lat2 = (int32_t)lround(phi2 * 180e7 / M_PI);
+  p.lng2 = (int32_t)lround(lam2 * 180e7 / M_PI);
+  if (p.lng2 > 1800000000 || p.lng2 < -1800000000)
+    p.lng2 = p.lng2 > 0 ? 1800000000 : -1800000000;
+  p.refCm = haversineCm(p.lat1, p.lng1, p.lat2, p.lng2);
+  return p;
+}
+
+struct GeoBand
+{
+  const char *name;
+  double minM, maxM;
+  double equirectLimitCm[2]; // 纬度 0-60° / 60-85°；0 表示不计算（距离超出近似的适用范围）
+  double haversineLimitCm;   // 0 表示按相对误差检查
+  double haversineLimitRel;
+};
+
+// 与 geo_fixed.h 的误差表一致
+static const GeoBand BANDS[] = {
+    {"1 m-1 km", 1, 1000, {1.0, 1.0}, 3.5, 0},
+    {"1-10 km", 1000, 10000, {5.5, 12.5}, 7.0, 0},
+    {"10-100 km", 10000, 100000, {350, 13500}, 80.0, 0},
+    {"0.1-19000 km", 100000, 19000000, {0, 0}, 0, 0.00007},
+};
+#define BAND_COUNT (sizeof(BANDS) / sizeof(BANDS[0]))
+#define PAIRS_PER_BAND 250000
+#define TIMED_PAIRS 100000
+
+struct ErrStat
+{
+  double maxErr = 0, sumErr = 0, maxLat = 0;
+  uint32_t n = 0;
+  void add(double err, int32_t latE7)
+  {
+    err = fabs(err);
+    sumErr += err;
+    n++;
+    if (err > maxErr)
+    {
+      maxErr = err;
+      maxLat = latE7 * 1e-7;
+    }
+  }
+};
+
+static volatile uint64_t sink;
+
+template <typename F> static double timeCalls(const std::vector<GeoPair> &pairs, F f, double &ticks)
+{
+  uint64_t acc = 0;
+  auto t0 = std::chrono::steady_clock::now();
+#ifdef GEO_BENCH_TSC
+  uint64_t c0 = __rdtsc();
+#endif
+  for (const GeoPair &p : pairs)
+    acc += (uint64_t)f(p);
+#ifdef GEO_BENCH_TSC
+  ticks = (double)(__rdtsc() - c0) / pairs.size();
+#else
+  ticks = 0;
+#endif
+  auto t1 = std::chrono::steady_clock::now();
+  sink = acc;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double)pairs.size();
+}
+
+int simRunGeoBench()
+{
+  int rc = 0;
+  fprintf(stderr, "[BENCH] accuracy vs double haversine, |lat| <= 85 deg, %u pairs per band\n", PAIRS_PER_BAND);
+  fprintf(stderr, "%-13s %-9s %12s %12s %10s %12s\n", "distance", "lat", "equirect cm", "haversine cm",
+          "max lat", "bearing deg");
+  for (size_t b = 0; b < BAND_COUNT; b++)
+  {
+    const GeoBand &band = BANDS[b];
+    // 纬度带：|lat| ≤ 60° 与 60°-85°，高纬度时经度差放大，查表误差和近似误差都更大
+    ErrStat equi[2], hav[2], brg[2];
+    double havRel = 0;
+    for (uint32_t i = 0; i < PAIRS_PER_BAND; i++)
+    {
+      double lat = (rnd() * 2 - 1) * 85;
+      double dist = band.minM * pow(band.maxM / band.minM, rnd());
+      GeoPair p = makePair(lat, (rnd() * 2 - 1) * 180, rnd() * 2 * M_PI, dist);
+      if (p.lat2 > 850000000 || p.lat2 < -850000000)
+        continue;
+      int hi = fabs(lat) > 60;
+      if (band.equirectLimitCm[hi] > 0)
+        equi[hi].add(geoEquirectCm(p.lat1, p.lng1, p.lat2, p.lng2) - p.refCm, p.lat1);
+      double h = geoHaversineCm(p.lat1, p.lng1, p.lat2, p.lng2) - p.refCm;
+      hav[hi].add(h, p.lat1);
+      if (p.refCm > 0)
+        havRel = fmax(havRel, fabs(h) / p.refCm);
+      if (p.refCm >= 1000 && band.maxM <= 100000)
+      {
+        double e = geoBearingCdeg(p.lat1, p.lng1, p.lat2, p.lng2) / 100.0 - bearingDeg(p.lat1, p.lng1, p.lat2, p.lng2);
+        e = remainder(e, 360);
+        brg[hi].add(e, p.lat1);
+      }
+    }
+    for (int hi = 0; hi < 2; hi++)
+    {
+      char equiText[16] = "-", brgText[16] = "-";
+      if (equi[hi].n)
+        snprintf(equiText, sizeof(equiText), "%.2f", equi[hi].maxErr);
+      if (brg[hi].n)
+        snprintf(brgText, sizeof(brgText), "%.4f", brg[hi].maxErr);
+      const ErrStat &worst = equi[hi].maxErr > hav[hi].maxErr ? equi[hi] : hav[hi];
+      fprintf(stderr, "%-13s %-9s %12s %12.2f %10.2f %12s\n", hi ? "" : band.name, hi ? "60-85" : "0-60", equiText,
+              hav[hi].maxErr, worst.maxLat, brgText);
+      if (band.equirectLimitCm[hi] > 0 && equi[hi].maxErr > band.equirectLimitCm[hi])
+      {
+        fprintf(stderr, "[BENCH] FAIL equirect %s: %.2f cm exceeds %.2f cm\n", band.name, equi[hi].maxErr,
+                band.equirectLimitCm[hi]);
+        rc = 1;
+      }
+      if (band.haversineLimitCm > 0 && hav[hi].maxErr > band.haversineLimitCm)
+      {
+        fprintf(stderr, "[BENCH] FAIL haversine %s: %.2f cm exceeds %.2f cm\n", band.name, hav[hi].maxErr,
+                band.haversineLimitCm);
+        rc = 1;
+      }
+      if (brg[hi].maxErr > 0.02)
+      {
+        fprintf(stderr, "[BENCH] FAIL bearing %s: %.4f deg exceeds 0.02 deg\n", band.name, brg[hi].maxErr);
+        rc = 1;
+      }
+    }
+    if (band.haversineLimitRel > 0)
+    {
+      fprintf(stderr, "%-13s %-9s %12s %11.4f%%\n", "", "relative", "", havRel * 100);
+      if (havRel > band.haversineLimitRel)
+      {
+        fprintf(stderr, "[BENCH] FAIL haversine %s: %.4f%% exceeds %.4f%%\n", band.name, havRel * 100,
+                band.haversineLimitRel * 100);
+        rc = 1;
+      }
+    }
+  }
+
+  // 速度：相邻定位点量级（≤ 1 km）的点对
+  std::vector<GeoPair> pairs;
+  pairs.reserve(TIMED_PAIRS);
+  for (uint32_t i = 0; i < TIMED_PAIRS; i++)
+    pairs.push_back(makePair((rnd() * 2 - 1) * 85, (rnd() * 2 - 1) * 180, rnd() * 2 * M_PI, 1 + rnd() * 999));
+  struct Row
+  {
+    const char *name;
+    double ns, ticks;
+  } rows[6];
+  rows[0].name = "geoEquirectCm";
+  rows[0].ns = timeCalls(
+      pairs, [](const GeoPair &p) { return geoEquirectCm(p.lat1, p.lng1, p.lat2, p.lng2); }, rows[0].ticks);
+  rows[1].name = "double equirect";
+  rows[1].ns = timeCalls(
+      pairs, [](const GeoPair &p) { return equirectCm(p.lat1, p.lng1, p.lat2, p.lng2); }, rows[1].ticks);
+  rows[2].name = "geoHaversineCm";
+  rows[2].ns = timeCalls(
+      pairs, [](const GeoPair &p) { return geoHaversineCm(p.lat1, p.lng1, p.lat2, p.lng2); }, rows[2].ticks);
+  rows[3].name = "double haversine";
+  rows[3].ns = timeCalls(
+      pairs, [](const GeoPair &p) { return haversineCm(p.lat1, p.lng1, p.lat2, p.lng2); }, rows[3].ticks);
+  rows[4].name = "geoBearingCdeg";
+  rows[4].ns = timeCalls(
+      pairs, [](const GeoPair &p) { return geoBearingCdeg(p.lat1, p.lng1, p.lat2, p.lng2); }, rows[4].ticks);
+  rows[5].name = "double bearing";
+  rows[5].ns = timeCalls(
+      pairs, [](const GeoPair &p) { return bearingDeg(p.lat1, p.lng1, p.lat2, p.lng2); }, rows[5].ticks);
+  fprintf(stderr, "[BENCH] %u calls each (host, hardware FPU)\n", TIMED_PAIRS);
+  fprintf(stderr, "%-17s %10s %12s\n", "", "ns/call", "tsc/call");
+  for (const Row &r : rows)
+    fprintf(stderr, "%-17s %10.1f %12.1f\n", r.name, r.ns, r.ticks);
+  return rc;
+}
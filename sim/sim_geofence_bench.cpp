@@ -0,0 +1,253 @@
+// 电子围栏基准（--bench-geofence）
+//
+// 在上海附近约 100 km 见方的范围内生成确定性的圆形/多边形区域（--bench-zones，默认 1000），
+// 另加几个覆盖大片范围、互相重叠的大区域，用固件的 Geofence 建立网格索引。
+// 定位点一半为随机游走（模拟行驶，经常进出区域），一半为范围内的均匀随机点。
+// 每个点分别计时：索引查询 update()，以及对全部区域逐个 contains() 的暴力对照。
+// 两者命中结果必须一致，单点代价不得超过 worstCaseWork()，update() 不得分配内存，
+// 否则以退出码 1 失败。计时为主机时间，只适合前后对比。
+// 之后另建一组大量重叠的大圆（300 个半径 20 km），检查索引条目数不超过 GEOFENCE_MAX_CELL_ENTRIES
+// 且放大格子后命中结果仍与暴力对照一致。
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "geofence.h"
+#include "sim.h"
+
+static uint32_t lcgState = 20240601;
+static uint32_t lcg(uint32_t range)
+{
+  lcgState = lcgState * 1664525u + 1013904223u;
+  return (lcgState >> 8) % range;
+}
+
+#define CENTER_LAT 312000000
+#define CENTER_LNG 1214000000
+#define AREA_HALF_E7 5000000 // ±0.5 度
+#define BENCH_FIXES 200000
+#define OVERLAP_ZONES 300
+#define OVERLAP_RADIUS_CM 2000000 // 20 km
+#define OVERLAP_FIXES 20000
+
+// 米 -> 纬度方向 1e-7 度；经度方向再除以 cos(纬度)
+static const double E7_PER_M = 1e7 / 111319.49;
+static const double COS_LAT = cos(31.2 * M_PI / 180);
+
+static bool addStar(Geofence &g, uint16_t id, const char *name, int32_t lat, int32_t lng, uint32_t minM, uint32_t maxM,
+                    uint16_t n)
+{
+  std::vector<int32_t> v(2 * n);
+  for (uint16_t i = 0; i < n; i++)
+  {
+    // 角度单调递增、半径随机：星形多边形，不自交但可以是凹的
+    double a = 2 * M_PI * (i + lcg(800) / 1000.0) / n;
+    double r = (minM + lcg(maxM - minM + 1)) * E7_PER_M;
+    v[2 * i] = lat + (int32_t)(r * sin(a));
+    v[2 * i + 1] = lng + (int32_t)(r * cos(a) / COS_LAT);
+  }
+  const char *err;
+  return g.addPolygon(id, name, v.data(), n, &err);
+}
+
+static void buildZones(Geofence &g, uint32_t count)
+{
+  char name[16];
+  uint16_t id = 1;
+  // 大区域：相互重叠，覆盖大量格子，整格在内的格子直接命中
+  const char *err;
+  g.addCircle(id++, "metro-a", CENTER_LAT, CENTER_LNG, 2000000, &err);
+  g.addCircle(id++, "metro-b", CENTER_LAT + 100000, CENTER_LNG - 150000, 1500000, &err);
+  addStar(g, id++, "district-c", CENTER_LAT - 150000, CENTER_LNG + 100000, 12000, 20000, 48);
+  addStar(g, id++, "district-d", CENTER_LAT + 200000, CENTER_LNG + 200000, 8000, 25000, 64);
+  while (g.zoneCount() < count)
+  {
+    int32_t lat = CENTER_LAT - AREA_HALF_E7 + (int32_t)lcg(2 * AREA_HALF_E7);
+    int32_t lng = CENTER_LNG - AREA_HALF_E7 + (int32_t)lcg(2 * AREA_HALF_E7);
+    snprintf(name, sizeof(name), "zone-%u", id);
+    if (lcg(2))
+      g.addCircle(id, name, lat, lng, (50 + lcg(1950)) * 100, &err);
+    else
+      addStar(g, id, name, lat, lng, 100 + lcg(400), 600 + lcg(2400), 4 + lcg(21));
+    id++;
+  }
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, uint32_t pct)
+{
+  if (v.empty())
+    return 0;
+  size_t k = v.size() * pct / 100;
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+// 圆心都在 ±0.1 度内，每个圆覆盖几乎全部范围：未设上限时条目数约为格子数 × 区域数
+static int runOverlapCheck()
+{
+  Geofence g;
+  const char *err;
+  char name[16];
+  for (uint16_t id = 1; id <= OVERLAP_ZONES; id++)
+  {
+    snprintf(name, sizeof(name), "wide-%u", id);
+    g.addCircle(id, name, CENTER_LAT - 1000000 + (int32_t)lcg(2000000), CENTER_LNG - 1000000 + (int32_t)lcg(2000000),
+                OVERLAP_RADIUS_CM, &err);
+  }
+  g.build();
+  fprintf(stderr, "[BENCH] overlap: %u circles of %u km, grid %ux%u%s, %lu entries (limit %u), %lu bytes, worst %lu\n",
+          g.zoneCount(), OVERLAP_RADIUS_CM / 100000, g.gridRows(), g.gridCols(), g.gridCoarsened() ? " (coarsened)" : "",
+          (unsigned long)g.cellEntries(), GEOFENCE_MAX_CELL_ENTRIES, (unsigned long)g.memoryBytes(),
+          (unsigned long)g.worstCaseWork());
+
+  uint32_t mismatches = 0, workMax = 0;
+  GeofenceEvent ev[8];
+  for (uint32_t i = 0; i < OVERLAP_FIXES; i++)
+  {
+    int32_t la = CENTER_LAT - 3500000 + (int32_t)lcg(7000000);
+    int32_t lo = CENTER_LNG - 3500000 + (int32_t)lcg(7000000);
+    g.update(la, lo, ev, 8);
+    workMax = std::max(workMax, g.lastWork());
+    for (uint16_t z = 0; z < g.zoneCount(); z++)
+      mismatches += g.hit(z) != g.contains(z, la, lo);
+  }
+  int rc = 0;
+  if (g.cellEntries() > GEOFENCE_MAX_CELL_ENTRIES)
+  {
+    fprintf(stderr, "[BENCH] FAIL overlap: %lu entries exceed limit %u\n", (unsigned long)g.cellEntries(),
+            GEOFENCE_MAX_CELL_ENTRIES);
+    rc = 1;
+  }
+  if (mismatches)
+  {
+    fprintf(stderr, "[BENCH] FAIL overlap: %lu index/brute-force mismatches\n", (unsigned long)mismatches);
+    rc = 1;
+  }
+  if (workMax > g.worstCaseWork())
+  {
+    fprintf(stderr, "[BENCH] FAIL overlap: work %lu exceeds bound %lu\n", (unsigned long)workMax,
+            (unsigned long)g.worstCaseWork());
+    rc = 1;
+  }
+  return rc;
+}
+
+int simRunGeofenceBench()
+{
+  Geofence g;
+  auto b0 = std::chrono::steady_clock::now();
+  buildZones(g, std::min<uint32_t>(simConfig.benchZones, GEOFENCE_MAX_ZONES));
+  g.build();
+  double buildMs =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - b0).count() / 1000.0;
+  uint16_t zones = g.zoneCount();
+  if (zones == 0)
+  {
+    fprintf(stderr, "[BENCH] no zones\n");
+    return 2;
+  }
+  fprintf(stderr, "[BENCH] %u zones, grid %ux%u, %lu entries, %lu bytes, build %.1f ms (host)\n", zones, g.gridRows(),
+          g.gridCols(), (unsigned long)g.cellEntries(), (unsigned long)g.memoryBytes(), buildMs);
+
+  // 定位点：一半随机游走（每步约 10 m），一半均匀随机（含范围外 10%）
+  std::vector<int32_t> fixes(2 * BENCH_FIXES);
+  int32_t lat = CENTER_LAT, lng = CENTER_LNG;
+  int32_t dLat = 90, dLng = 0;
+  for (uint32_t i = 0; i < BENCH_FIXES; i++)
+  {
+    if (i % 2 == 0)
+    {
+      if (lcg(50) == 0)
+      {
+        double a = lcg(360) * M_PI / 180;
+        dLat = (int32_t)(10 * E7_PER_M * sin(a));
+        dLng = (int32_t)(10 * E7_PER_M * cos(a) / COS_LAT);
+      }
+      lat += dLat;
+      lng += dLng;
+      if (abs(lat - CENTER_LAT) > AREA_HALF_E7 || abs(lng - CENTER_LNG) > AREA_HALF_E7)
+      {
+        dLat = -dLat;
+        dLng = -dLng;
+      }
+      fixes[2 * i] = lat;
+      fixes[2 * i + 1] = lng;
+    }
+    else
+    {
+      fixes[2 * i] = CENTER_LAT - AREA_HALF_E7 * 11 / 10 + (int32_t)lcg(AREA_HALF_E7 * 22 / 10);
+      fixes[2 * i + 1] = CENTER_LNG - AREA_HALF_E7 * 11 / 10 + (int32_t)lcg(AREA_HALF_E7 * 22 / 10);
+    }
+  }
+
+  std::vector<uint32_t> indexedNs, bruteNs;
+  indexedNs.reserve(BENCH_FIXES);
+  bruteNs.reserve(BENCH_FIXES);
+  uint64_t indexedTotal = 0, bruteTotal = 0, workTotal = 0, allocs = 0, hits = 0, events = 0;
+  uint32_t workMax = 0, mismatches = 0;
+  GeofenceEvent ev[8];
+  for (uint32_t i = 0; i < BENCH_FIXES; i++)
+  {
+    int32_t la = fixes[2 * i], lo = fixes[2 * i + 1];
+    uint64_t a0 = simThreadAllocs();
+    auto t0 = std::chrono::steady_clock::now();
+    events += g.update(la, lo, ev, 8);
+    auto t1 = std::chrono::steady_clock::now();
+    allocs += simThreadAllocs() - a0;
+    uint32_t n = 0;
+    for (uint16_t z = 0; z < zones; z++)
+      n += g.contains(z, la, lo);
+    auto t2 = std::chrono::steady_clock::now();
+    uint32_t ns1 = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    uint32_t ns2 = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    indexedNs.push_back(ns1);
+    bruteNs.push_back(ns2);
+    indexedTotal += ns1;
+    bruteTotal += ns2;
+    workTotal += g.lastWork();
+    workMax = std::max(workMax, g.lastWork());
+    hits += n;
+    // 不计时：逐个区域核对命中
+    for (uint16_t z = 0; z < zones; z++)
+    {
+      if (g.hit(z) != g.contains(z, la, lo) && mismatches++ < 5)
+        fprintf(stderr, "[BENCH] MISMATCH zone %u at %ld,%ld: index %d, brute %d\n", g.zoneId(z), (long)la, (long)lo,
+                g.hit(z), !g.hit(z));
+    }
+  }
+
+  uint32_t idxMax = *std::max_element(indexedNs.begin(), indexedNs.end());
+  uint32_t bruteMax = *std::max_element(bruteNs.begin(), bruteNs.end());
+  fprintf(stderr, "[BENCH] %u fixes, %.2f zones hit per fix, %llu enter/exit events\n", BENCH_FIXES,
+          (double)hits / BENCH_FIXES, (unsigned long long)events);
+  fprintf(stderr, "%-8s %10s %10s %10s\n", "", "ns/fix", "p99 ns", "max ns");
+  fprintf(stderr, "%-8s %10.0f %10u %10u\n", "indexed", (double)indexedTotal / BENCH_FIXES,
+          percentile(indexedNs, 99), idxMax);
+  fprintf(stderr, "%-8s %10.0f %10u %10u\n", "brute", (double)bruteTotal / BENCH_FIXES, percentile(bruteNs, 99),
+          bruteMax);
+  fprintf(stderr, "[BENCH] speedup %.1fx; work per fix avg %.1f, max %lu, bound %lu; %.3f allocs/fix\n",
+          (double)bruteTotal / indexedTotal, (double)workTotal / BENCH_FIXES, (unsigned long)workMax,
+          (unsigned long)g.worstCaseWork(), (double)allocs / BENCH_FIXES);
+
+  int rc = 0;
+  if (mismatches)
+  {
+    fprintf(stderr, "[BENCH] FAIL %lu index/brute-force mismatches\n", (unsigned long)mismatches);
+    rc = 1;
+  }
+  if (workMax > g.worstCaseWork())
+  {
+    fprintf(stderr, "[BENCH] FAIL work %lu exceeds bound %lu\n", (unsigned long)workMax,
+            (unsigned long)g.worstCaseWork());
+    rc = 1;
+  }
+  if (allocs)
+  {
+    fprintf(stderr, "[BENCH] FAIL update() allocated %llu times\n", (unsigned long long)allocs);
+    rc = 1;
+  }
+  if (runOverlapCheck())
+    rc = 1;
+  return rc;
+}
@@ -0,0 +1,251 @@
+// 主机模拟器入口：pio run -e native && .pio/build/native/program --replay sim/replay/sample.nmea
+//
+// 固件的 setup()/loop() 原样运行在主线程，GPS 串口由回放线程按波特率注入录制数据，
+// HTTP 任务是真实的本地 socket，LittleFS 映射到本地目录。结束时输出 loop 耗时分布、
+// 串口丢字节和闪存写入量，用于在不烧录的情况下比较改动前后的表现。
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Wire.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include "scheduler.h"
+#include "sim.h"
+
+void setup();
+void loop();
+
+// 固件里的串口计数（main.cpp）
+extern volatile uint32_t gpsRxOverflows;
+extern volatile uint32_t gpsDroppedBytes;
+extern uint64_t httpSleptUs;
+extern uint32_t httpWakeups;
+
+char **simArgv;
+
+// loop() 单次耗时直方图（主机微秒，不含末尾等待下一个作业的睡眠），1 us 一格，超出部分计入最后一格
+#define SIM_LOOP_HIST_US 100000
+static std::vector<uint32_t> loopHist(SIM_LOOP_HIST_US + 1);
+static uint64_t loopCount = 0;
+static uint64_t loopTotalUs = 0;
+static uint32_t loopMaxUs = 0;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: program [options]\n"
+          "  --replay FILE      GPS serial capture to replay (NMEA or UBX bytes)\n"
+          "  --baud N           replay baud rate (default: follow the firmware)\n"
+          "  --speedup X        run the simulated clock X times faster (default 1)\n"
+          "  --loop             restart the replay at end of file\n"
+          "  --no-timing        ignore capture timestamps, send back-to-back at the baud rate\n"
+          "  --duration SEC     stop after SEC simulated seconds (default: 2 s after replay ends)\n"
+          "  --fs DIR           directory backing LittleFS (default sim_fs)\n"
+          "  --data DIR         web assets copied into the filesystem (default data)\n"
+          "  --fs-size BYTES    reported LittleFS partition size (default 1441792)\n"
+          "  --port N           local port for the firmware's port-80 server (default 8080)\n"
+          "  --wifi ok|fail     whether the station connects (default ok)\n"
+          "  --wifi-drop SEC    drop the station link once at SEC simulated seconds\n"
+          "  --quiet            do not echo the firmware's Serial output\n"
+          "  --bench            run the NMEA ingestion benchmark instead of loop()\n"
+          "  --bench-corpus F   benchmark a captured NMEA file instead of the synthetic corpus\n"
+          "  --bench-sentences N  synthetic corpus size (default 200000)\n"
+          "  --bench-save F     write per-type results as a baseline\n"
+          "  --bench-baseline F fail (exit 1) on regressions against a saved baseline\n"
+          "  --bench-tolerance X  allowed slowdown per sentence type (default 0.25)\n"
+          "  --bench-geofence   run the geofence index benchmark against brute force\n"
+          "  --bench-zones N    zones generated for --bench-geofence (default 1000, max 1024)\n"
+          "  --bench-geo        check geo_fixed accuracy against double and time both\n"
+          "  --check-ubx F      decode a UBX capture and compare it with F.expect\n"
+          "  --check-filter F   replay a UBX capture with added noise through the track filter\n");
+}
+
+static bool parseArgs(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : ""; };
+    if (a == "--replay")
+      simConfig.replayPath = next();
+    else if (a == "--baud")
+      simConfig.baud = (uint32_t)atol(next());
+    else if (a == "--speedup")
+      simConfig.speedup = atof(next());
+    else if (a == "--loop")
+      simConfig.loopReplay = true;
+    else if (a == "--no-timing")
+      simConfig.replayTiming = false;
+    else if (a == "--duration")
+      simConfig.durationSec = atof(next());
+    else if (a == "--fs")
+      simConfig.fsRoot = next();
+    else if (a == "--data")
+      simConfig.dataDir = next();
+    else if (a == "--fs-size")
+      simConfig.fsSize = (uint32_t)atol(next());
+    else if (a == "--port")
+      simConfig.httpPort = (uint16_t)atoi(next());
+    else if (a == "--wifi")
+      simConfig.wifiOk = strcmp(next(), "fail") != 0;
+    else if (a == "--wifi-drop")
+      simConfig.wifiDropSec = atof(next());
+    else if (a == "--quiet")
+      simConfig.quiet = true;
+    else if (a == "--bench")
+      simConfig.bench = true;
+    else if (a == "--bench-corpus")
+      simConfig.benchCorpus = next();
+    else if (a == "--bench-sentences")
+      simConfig.benchSentences = (size_t)atol(next());
+    else if (a == "--bench-save")
+      simConfig.benchSave = next();
+    else if (a == "--bench-baseline")
+      simConfig.benchBaseline = next();
+    else if (a == "--bench-tolerance")
+      simConfig.benchTolerance = atof(next());
+    else if (a == "--bench-geofence")
+      simConfig.benchGeofence = true;
+    else if (a == "--bench-zones")
+      simConfig.benchZones = (uint32_t)atol(next());
+    else if (a == "--bench-geo")
+      simConfig.benchGeo = true;
+    else if (a == "--check-ubx")
+      simConfig.checkUbx = next();
+    else if (a == "--check-filter")
+      simConfig.checkFilter = next();
+    else
+      return false;
+  }
+  return simConfig.speedup > 0;
+}
+
+static uint32_t loopPercentile(double p)
+{
+  uint64_t target = (uint64_t)(loopCount * p);
+  uint64_t seen = 0;
+  for (size_t us = 0; us < loopHist.size(); us++)
+  {
+    seen += loopHist[us];
+    if (seen > target)
+      return (uint32_t)us;
+  }
+  return SIM_LOOP_HIST_US;
+}
+
+static void printSummary()
+{
+  double simSec = simMicros() / 1e6;
+  unsigned long long replayed = simUartStats.bytesReplayed;
+  unsigned long long uartDropped = simUartStats.bytesDropped;
+  fprintf(stderr, "\n[SIM] ---- summary ----\n");
+  fprintf(stderr, "sim time      %.1f s (speedup x%g)\n", simSec, simConfig.speedup);
+  fprintf(stderr, "gps uart      replayed=%llu B  driver dropped=%llu B in %u overflows  tx=%llu B\n", replayed,
+          uartDropped, (unsigned)simUartStats.overflows, (unsigned long long)simUartStats.bytesTx);
+  fprintf(stderr, "firmware      gpsRxOverflows=%lu  gpsDroppedBytes=%lu\n", (unsigned long)gpsRxOverflows,
+          (unsigned long)gpsDroppedBytes);
+  if (loopCount)
+  {
+    fprintf(stderr, "loop()        n=%llu  avg=%llu us  p50=%u us  p99=%u us  max=%u us (host time)\n",
+            (unsigned long long)loopCount, (unsigned long long)(loopTotalUs / loopCount), loopPercentile(0.5),
+            loopPercentile(0.99), loopMaxUs);
+  }
+  if (simSec > 0)
+  {
+    fprintf(stderr, "scheduler     wakeups=%lu (%.1f/s)  asleep %.1f%% of sim time\n", (unsigned long)scheduler.wakeups(),
+            scheduler.wakeups() / simSec, scheduler.sleptUs() / 1e4 / simSec);
+    fprintf(stderr, "http task     wakeups=%lu (%.1f/s)  asleep %.1f%% of sim time\n", (unsigned long)httpWakeups,
+            httpWakeups / simSec, httpSleptUs / 1e4 / simSec);
+    // 单核上两个任务都睡眠的时间至少是 1 - 两者忙碌时间之和；WiFi/lwIP/串口驱动等系统任务不在其中。
+    // 主机进程 CPU 占用另含回放和网络模拟线程，只作对照
+    double busy = 2 * simSec - (scheduler.sleptUs() + httpSleptUs) / 1e6;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double cpuSec = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    fprintf(stderr, "cpu           loop+http asleep >= %.1f%% of sim time; host process %.1f%% of one core\n",
+            busy < simSec ? 100 * (1 - busy / simSec) : 0.0, 100 * cpuSec * simConfig.speedup / simSec);
+  }
+  fprintf(stderr, "flash         written=%llu B in %llu writes, %llu flushes, %llu opens for write; used %u/%u B\n",
+          (unsigned long long)simFsStats.bytesWritten, (unsigned long long)simFsStats.writeCalls,
+          (unsigned long long)simFsStats.flushes, (unsigned long long)simFsStats.opensForWrite,
+          (unsigned)LittleFS.usedBytes(), (unsigned)LittleFS.totalBytes());
+  if (simSec > 0)
+    fprintf(stderr, "              %.1f B/s written per simulated second\n", simFsStats.bytesWritten / simSec);
+  fprintf(stderr, "http          requests=%llu  sent=%llu B\n", (unsigned long long)simHttpStats.requests,
+          (unsigned long long)simHttpStats.bytesSent);
+  fprintf(stderr, "i2c           %llu B\n", (unsigned long long)Wire.bytesWritten);
+}
+
+static bool finished()
+{
+  uint64_t now = simMicros();
+  if (stopRequested)
+    return true;
+  if (simConfig.durationSec > 0)
+    return now >= simConfig.durationSec * 1e6;
+  // 没有回放文件时一直运行，便于手动调试网页
+  return simUartStats.replayDone && now - simUartStats.replayDoneUs > 2000000;
+}
+
+int main(int argc, char **argv)
+{
+  simArgv = argv;
+  if (!parseArgs(argc, argv))
+  {
+    usage();
+    return 2;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, [](int) { stopRequested = 1; });
+  ESP.getFreeHeap(); // 记录堆基线
+
+  if (simConfig.benchGeofence)
+  {
+    // 围栏引擎不依赖固件其他部分，不调用 setup()
+    _exit(simRunGeofenceBench());
+  }
+  if (simConfig.benchGeo)
+    _exit(simRunGeoBench());
+  if (!simConfig.checkUbx.empty())
+    _exit(simRunUbxCheck());
+  if (!simConfig.checkFilter.empty())
+    _exit(simRunFilterCheck());
+
+  if (simConfig.bench)
+  {
+    // 基准只测解析路径：不回放、不连 WiFi、不回显串口
+    simConfig.replayPath.clear();
+    simConfig.wifiOk = false;
+    simConfig.quiet = true;
+    setup();
+    int rc = simRunBench();
+    printSummary();
+    _exit(rc);
+  }
+
+  setup();
+  while (!finished())
+  {
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t slept = scheduler.sleptUs();
+    loop();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    // 睡眠按模拟时间统计，换算回主机时间扣除
+    us -= (int64_t)((scheduler.sleptUs() - slept) / simConfig.speedup);
+    if (us < 0)
+      us = 0;
+    uint32_t v = us > SIM_LOOP_HIST_US ? SIM_LOOP_HIST_US : (uint32_t)us;
+    loopHist[v]++;
+    loopCount++;
+    loopTotalUs += us;
+    if ((uint32_t)us > loopMaxUs)
+      loopMaxUs = (uint32_t)us;
+  }
+  fflush(stdout);
+  printSummary();
+  // HTTP/回放线程仍在运行，跳过静态析构直接退出
+  _exit(0);
+}
@@ -0,0 +1,580 @@
+// WiFi、TCP 连接与 WebServer
+#include <WebServer.h>
+#include <WiFi.h>
+#include <arpa/inet.h>
+#include <lwip/sockets.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include "sim.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS：已在 main() 中忽略 SIGPIPE
+#endif
+
+#define SIM_HTTP_HEADER_MAX 8192
+#define SIM_HTTP_BODY_MAX 65536
+#define SIM_HTTP_TIMEOUT_MS 2000 // 主机时间
+#define SIM_WIFI_CONNECT_MS 1500 // 模拟时间：begin() 到 GOT_IP
+#define SIM_WIFI_OUTAGE_MS 20000 // 模拟时间：--wifi-drop 默认断网时长
+
+WiFiClass WiFi;
+
+// ---- WiFiClient ----
+
+struct WiFiClient::Handle
+{
+  int fd;
+  explicit Handle(int f) : fd(f) {}
+  ~Handle()
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+};
+
+WiFiClient::WiFiClient(int fd) : _h(std::make_shared<Handle>(fd)) {}
+
+int WiFiClient::fd() const { return _h ? _h->fd : -1; }
+
+uint8_t WiFiClient::connected()
+{
+  if (!_h)
+    return 0;
+  char c;
+  int n = recv(_h->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n > 0)
+    return 1;
+  if (n == 0)
+    return 0;
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+  if (!_h)
+    return 0;
+  size_t sent = 0;
+  while (sent < size)
+  {
+    int n = send(_h->fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n > 0)
+    {
+      sent += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      struct pollfd p = {_h->fd, POLLOUT, 0};
+      if (poll(&p, 1, SIM_HTTP_TIMEOUT_MS) > 0)
+        continue;
+    }
+    break;
+  }
+  simHttpStats.bytesSent += sent;
+  return sent;
+}
+
+int WiFiClient::available()
+{
+  int n = 0;
+  if (!_h || ioctl(_h->fd, FIONREAD, &n) < 0)
+    return 0;
+  return n;
+}
+
+int WiFiClient::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+  if (!_h)
+    return -1;
+  int n = recv(_h->fd, buf, size, MSG_DONTWAIT);
+  return n > 0 ? n : -1;
+}
+
+int WiFiClient::peek()
+{
+  uint8_t c;
+  if (!_h || recv(_h->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+    return -1;
+  return c;
+}
+
+bool WiFiClient::waitForData()
+{
+  if (!_h)
+    return false;
+  struct pollfd p = {_h->fd, POLLIN, 0};
+  poll(&p, 1, 10);
+  return true;
+}
+
+void WiFiClient::stop() { _h.reset(); }
+
+int WiFiClient::setNoDelay(bool nodelay)
+{
+  int flag = nodelay;
+  return _h ? setsockopt(_h->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) : -1;
+}
+
+IPAddress WiFiClient::remoteIP() const
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (!_h || getpeername(_h->fd, (struct sockaddr *)&addr, &len) != 0)
+    return IPAddress();
+  return IPAddress((uint32_t)addr.sin_addr.s_addr);
+}
+
+uint16_t WiFiClient::remotePort() const
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (!_h || getpeername(_h->fd, (struct sockaddr *)&addr, &len) != 0)
+    return 0;
+  return ntohs(addr.sin_port);
+}
+
+// ---- WebServer ----
+
+static const char *reasonPhrase(int code)
+{
+  switch (code)
+  {
+  case 200: return "OK";
+  case 204: return "No Content";
+  case 206: return "Partial Content";
+  case 301: return "Moved Permanently";
+  case 302: return "Found";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 403: return "Forbidden";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 413: return "Payload Too Large";
+  case 416: return "Range Not Satisfiable";
+  case 500: return "Internal Server Error";
+  case 503: return "Service Unavailable";
+  default: return "";
+  }
+}
+
+static String urlDecode(const String &s)
+{
+  String out;
+  out.reserve(s.length());
+  for (unsigned int i = 0; i < s.length(); i++)
+  {
+    char c = s[i];
+    if (c == '+')
+      c = ' ';
+    else if (c == '%' && i + 2 < s.length())
+    {
+      char hex[3] = {s[i + 1], s[i + 2], 0};
+      c = (char)strtol(hex, nullptr, 16);
+      i += 2;
+    }
+    out += c;
+  }
+  return out;
+}
+
+void WebServer::begin()
+{
+  close();
+  // 固件监听 80 端口，模拟器改到 --port，避免需要 root 权限
+  uint16_t port = _port == 80 ? simConfig.httpPort : _port;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0)
+  {
+    fprintf(stderr, "[SIM] HTTP listen on port %u failed: %s\n", port, strerror(errno));
+    if (fd >= 0)
+      ::close(fd);
+    return;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  _listenFd = fd;
+  fprintf(stderr, "[SIM] HTTP server on http://127.0.0.1:%u/\n", port);
+}
+
+void WebServer::close()
+{
+  if (_listenFd >= 0)
+    ::close(_listenFd);
+  _listenFd = -1;
+  _client = WiFiClient();
+}
+
+void WebServer::handleClient()
+{
+  int fd = _listenFd >= 0 ? accept(_listenFd, nullptr, nullptr) : -1;
+  if (fd < 0)
+  {
+    if (_nullDelay)
+      delay(1);
+    return;
+  }
+  struct timeval tv = {SIM_HTTP_TIMEOUT_MS / 1000, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  _client = WiFiClient(fd);
+  _responseHeaders = String();
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  _chunked = false;
+
+  if (parseRequest())
+  {
+    simHttpStats.requests++;
+    bool handled = false;
+    for (const Route &r : _routes)
+    {
+      if ((r.method == HTTP_ANY || r.method == _method) && r.uri == _uri)
+      {
+        r.fn();
+        handled = true;
+        break;
+      }
+    }
+    if (!handled)
+    {
+      if (_notFound)
+        _notFound();
+      else
+        send(404, "text/plain", String("Not found: ") + _uri);
+    }
+    finalizeResponse();
+  }
+  // 只释放服务器持有的引用；被 SSE 接管的连接保持打开
+  _client = WiFiClient();
+}
+
+bool WebServer::parseRequest()
+{
+  std::string raw;
+  size_t headerEnd;
+  char buf[1024];
+  while ((headerEnd = raw.find("\r\n\r\n")) == std::string::npos)
+  {
+    if (raw.size() > SIM_HTTP_HEADER_MAX)
+      return false;
+    int n = recv(_client.fd(), buf, sizeof(buf), 0);
+    if (n <= 0)
+      return false;
+    raw.append(buf, n);
+  }
+
+  size_t lineEnd = raw.find("\r\n");
+  std::string requestLine = raw.substr(0, lineEnd);
+  size_t sp1 = requestLine.find(' ');
+  size_t sp2 = requestLine.rfind(' ');
+  if (sp1 == std::string::npos || sp2 == sp1)
+    return false;
+  std::string method = requestLine.substr(0, sp1);
+  std::string url = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+  static const char *methods[] = {"", "GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"};
+  _method = HTTP_GET;
+  for (int i = 1; i < 8; i++)
+  {
+    if (method == methods[i])
+      _method = (HTTPMethod)i;
+  }
+
+  size_t q = url.find('?');
+  _uri = String(url.substr(0, q));
+  _args.clear();
+  if (q != std::string::npos)
+    parseArgs(String(url.substr(q + 1)));
+
+  _headers.clear();
+  for (const String &key : _collected)
+    _headers.push_back({key, String()});
+  _host = String();
+  size_t contentLength = 0;
+  String contentType;
+  size_t pos = lineEnd + 2;
+  while (pos < headerEnd)
+  {
+    size_t end = raw.find("\r\n", pos);
+    std::string line = raw.substr(pos, end - pos);
+    pos = end + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    String key(line.substr(0, colon));
+    String value(line.substr(colon + 1));
+    value.trim();
+    if (key.equalsIgnoreCase("Host"))
+      _host = value;
+    else if (key.equalsIgnoreCase("Content-Length"))
+      contentLength = (size_t)value.toInt();
+    else if (key.equalsIgnoreCase("Content-Type"))
+      contentType = value;
+    for (KeyValue &h : _headers)
+    {
+      if (h.key.equalsIgnoreCase(key))
+        h.value = value;
+    }
+  }
+
+  if (contentLength > SIM_HTTP_BODY_MAX)
+    return false;
+  std::string body = raw.substr(headerEnd + 4);
+  while (body.size() < contentLength)
+  {
+    int n = recv(_client.fd(), buf, sizeof(buf), 0);
+    if (n <= 0)
+      return false;
+    body.append(buf, n);
+  }
+  body.resize(contentLength);
+  if (!body.empty())
+  {
+    if (contentType.startsWith("application/x-www-form-urlencoded"))
+      parseArgs(String(body));
+    else
+      _args.push_back({String("plain"), String(body)});
+  }
+  return true;
+}
+
+void WebServer::parseArgs(const String &data)
+{
+  int start = 0;
+  while (start < (int)data.length())
+  {
+    int amp = data.indexOf('&', start);
+    if (amp < 0)
+      amp = data.length();
+    String pair = data.substring(start, amp);
+    int eq = pair.indexOf('=');
+    if (pair.length())
+    {
+      if (eq < 0)
+        _args.push_back({urlDecode(pair), String()});
+      else
+        _args.push_back({urlDecode(pair.substring(0, eq)), urlDecode(pair.substring(eq + 1))});
+    }
+    start = amp + 1;
+  }
+}
+
+String WebServer::arg(const String &name) const
+{
+  for (const KeyValue &a : _args)
+  {
+    if (a.key == name)
+      return a.value;
+  }
+  return String();
+}
+
+bool WebServer::hasArg(const String &name) const
+{
+  for (const KeyValue &a : _args)
+  {
+    if (a.key == name)
+      return true;
+  }
+  return false;
+}
+
+void WebServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+  _collected.clear();
+  for (size_t i = 0; i < headerKeysCount; i++)
+    _collected.push_back(String(headerKeys[i]));
+}
+
+String WebServer::header(const String &name) const
+{
+  for (const KeyValue &h : _headers)
+  {
+    if (h.key.equalsIgnoreCase(name))
+      return h.value;
+  }
+  return String();
+}
+
+bool WebServer::hasHeader(const String &name) const
+{
+  for (const KeyValue &h : _headers)
+  {
+    if (h.key.equalsIgnoreCase(name) && h.value.length())
+      return true;
+  }
+  return false;
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+  String line = name + ": " + value + "\r\n";
+  _responseHeaders = first ? line + _responseHeaders : _responseHeaders + line;
+}
+
+void WebServer::send(int code, const char *contentType, const char *content, size_t len)
+{
+  char status[64];
+  snprintf(status, sizeof(status), "HTTP/1.1 %d %s\r\n", code, reasonPhrase(code));
+  String h(status);
+  h += String("Content-Type: ") + (contentType ? contentType : "text/html") + "\r\n";
+  if (_contentLength == CONTENT_LENGTH_UNKNOWN)
+  {
+    h += "Transfer-Encoding: chunked\r\n";
+    _chunked = true;
+  }
+  else
+  {
+    size_t length = _contentLength == CONTENT_LENGTH_NOT_SET ? len : _contentLength;
+    h += String("Content-Length: ") + String((unsigned long)length) + "\r\n";
+  }
+  h += "Connection: close\r\n";
+  h += _responseHeaders;
+  h += "\r\n";
+  _responseHeaders = String();
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  writeRaw(h.c_str(), h.length());
+  if (len && _method != HTTP_HEAD)
+    sendContent(content, len);
+}
+
+void WebServer::send(int code, const char *contentType, const String &content)
+{
+  send(code, contentType, content.c_str(), content.length());
+}
+
+void WebServer::sendContent(const char *content, size_t len)
+{
+  if (!_chunked)
+  {
+    writeRaw(content, len);
+    return;
+  }
+  if (len == 0)
+  {
+    writeRaw("0\r\n\r\n", 5);
+    _chunked = false;
+    return;
+  }
+  char size[16];
+  int n = snprintf(size, sizeof(size), "%zx\r\n", len);
+  writeRaw(size, n);
+  writeRaw(content, len);
+  writeRaw("\r\n", 2);
+}
+
+void WebServer::finalizeResponse()
+{
+  if (_chunked)
+    sendContent("", 0);
+}
+
+size_t WebServer::writeRaw(const char *data, size_t len) { return _client.write((const uint8_t *)data, len); }
+
+// ---- WiFi ----
+
+static std::mutex wifiLock;
+static uint64_t wifiConnectAtUs = 0; // 0 表示没有待连接
+static uint64_t wifiOutageUntilUs = 0;
+static bool wifiDropDone = false;
+
+static void wifiEventThread()
+{
+  for (;;)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t now = simMicros();
+    bool connect = false, drop = false;
+    {
+      std::lock_guard<std::mutex> g(wifiLock);
+      if (wifiConnectAtUs && now >= wifiConnectAtUs && now >= wifiOutageUntilUs)
+      {
+        wifiConnectAtUs = 0;
+        connect = true;
+      }
+      if (!wifiDropDone && simConfig.wifiDropSec > 0 && now >= simConfig.wifiDropSec * 1e6 &&
+          WiFi.status() == WL_CONNECTED)
+      {
+        wifiDropDone = true;
+        wifiOutageUntilUs = now + (uint64_t)SIM_WIFI_OUTAGE_MS * 1000;
+        drop = true;
+      }
+    }
+    if (drop)
+    {
+      fprintf(stderr, "[SIM] WiFi dropped for %d s\n", SIM_WIFI_OUTAGE_MS / 1000);
+      WiFi.simSetStatus(WL_CONNECTION_LOST, ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 200); // BEACON_TIMEOUT
+    }
+    if (connect)
+      WiFi.simSetStatus(WL_CONNECTED, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  }
+}
+
+void simWifiSchedule()
+{
+  static std::once_flag started;
+  std::call_once(started, [] { std::thread(wifiEventThread).detach(); });
+  std::lock_guard<std::mutex> g(wifiLock);
+  wifiConnectAtUs = simConfig.wifiOk ? simMicros() + (uint64_t)SIM_WIFI_CONNECT_MS * 1000 : 0;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *)
+{
+  if (ssid)
+    _ssid = ssid;
+  _status = WL_DISCONNECTED;
+  simWifiSchedule();
+  return _status;
+}
+
+bool WiFiClass::disconnect(bool, bool)
+{
+  {
+    std::lock_guard<std::mutex> g(wifiLock);
+    wifiConnectAtUs = 0;
+  }
+  if (_status == WL_CONNECTED)
+    simSetStatus(WL_DISCONNECTED, ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 8); // ASSOC_LEAVE
+  return true;
+}
+
+bool WiFiClass::softAP(const char *, const char *, int, int, int) { return true; }
+
+bool WiFiClass::softAPConfig(IPAddress local, IPAddress, IPAddress)
+{
+  _apIp = local;
+  return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventCb cb, arduino_event_id_t event)
+{
+  return onEvent([cb](arduino_event_id_t e, arduino_event_info_t) { cb(e); }, event);
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb cb, arduino_event_id_t event)
+{
+  _handlers.push_back({cb, event});
+  return _handlers.size();
+}
+
+void WiFiClass::simSetStatus(wl_status_t s, arduino_event_id_t event, uint8_t reason)
+{
+  _status = s;
+  arduino_event_info_t info = {reason};
+  for (const Handler &h : _handlers)
+  {
+    if (h.event == ARDUINO_EVENT_MAX || h.event == event)
+      h.cb(event, info);
+  }
+}
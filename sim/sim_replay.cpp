@@ -0,0 +1,190 @@
+// GPS 串口回放
+//
+// 真实模块每个历元集中输出一批报文，批内按波特率连续发送，批间空闲。回放时先扫描
+// 录制文件，在每个新历元的第一条报文处记下时间（NMEA 的 hhmmss.ss 字段或 UBX NAV 的
+// iTOW），到点才放行该批；批内按当前波特率（8N1，每字节 10 位）逐毫秒注入。
+// --no-timing 时忽略时间标记，整份文件按波特率连续发送，用于压力测试。
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+#include "sim.h"
+
+struct EpochMark
+{
+  size_t offset; // 该历元第一条报文的起始字节
+  uint64_t tMs;  // 相对第一个历元的毫秒数
+};
+
+// NMEA 时间字段 hhmmss.ss -> 当天毫秒数；无时间返回 -1
+static int64_t nmeaTimeMs(const uint8_t *s, size_t len)
+{
+  // 只认带 UTC 时间且位于第 1 个字段的语句
+  static const char *types[] = {"GGA", "RMC", "ZDA", "GNS", "GBS"};
+  if (len < 7)
+    return -1;
+  bool known = false;
+  for (const char *t : types)
+    known |= memcmp(s + 3, t, 3) == 0;
+  if (!known || s[6] != ',')
+    return -1;
+  const uint8_t *f = s + 7;
+  size_t avail = len - 7;
+  if (avail < 6)
+    return -1;
+  for (int i = 0; i < 6; i++)
+  {
+    if (f[i] < '0' || f[i] > '9')
+      return -1;
+  }
+  int64_t ms = (((f[0] - '0') * 10 + (f[1] - '0')) * 3600 + ((f[2] - '0') * 10 + (f[3] - '0')) * 60 +
+                ((f[4] - '0') * 10 + (f[5] - '0'))) *
+               1000LL;
+  if (avail > 8 && f[6] == '.' && f[7] >= '0' && f[7] <= '9')
+  {
+    ms += (f[7] - '0') * 100;
+    if (f[8] >= '0' && f[8] <= '9')
+      ms += (f[8] - '0') * 10;
+  }
+  return ms;
+}
+
+static std::vector<EpochMark> scanEpochs(const std::vector<uint8_t> &data)
+{
+  std::vector<EpochMark> marks;
+  int64_t first = -1, last = -1, wrap = 0;
+  bool lastUbx = false;
+  auto mark = [&](size_t offset, int64_t t, bool ubx) {
+    if (ubx != lastUbx && !marks.empty())
+    {
+      // 模块从 NMEA 切到 UBX：当天时间与周内时间基准不同，接着上一批的时间继续
+      first = t - (int64_t)marks.back().tMs;
+      last = -1;
+      wrap = 0;
+    }
+    lastUbx = ubx;
+    if (t == last)
+      return;
+    if (last >= 0 && t < last && last - t > 43200000LL)
+      wrap += 86400000LL; // 跨零点
+    last = t;
+    if (first < 0)
+      first = t + wrap;
+    int64_t rel = t + wrap - first;
+    if (rel < 0 || (!marks.empty() && (uint64_t)rel < marks.back().tMs))
+      return; // 时间倒退（噪声），沿用上一批
+    marks.push_back({offset, (uint64_t)rel});
+  };
+
+  size_t i = 0;
+  while (i < data.size())
+  {
+    if (data[i] == '$')
+    {
+      size_t end = i;
+      while (end < data.size() && data[end] != '\n' && end - i < 100)
+        end++;
+      int64_t t = nmeaTimeMs(&data[i], end - i);
+      if (t >= 0)
+        mark(i, t, false);
+      i = end;
+    }
+    else if (data[i] == 0xB5 && i + 10 <= data.size() && data[i + 1] == 0x62 && data[i + 2] == 0x01)
+    {
+      // UBX NAV 类报文负载以 iTOW（ms）开头；只认校验和正确的帧，误同步的帧头不能跳过后续数据
+      uint16_t len = data[i + 4] | (data[i + 5] << 8);
+      size_t end = i + 6 + len;
+      uint8_t a = 0, b = 0;
+      for (size_t k = i + 2; k < end && end + 2 <= data.size(); k++)
+      {
+        a += data[k];
+        b += a;
+      }
+      if (end + 2 > data.size() || data[end] != a || data[end + 1] != b)
+      {
+        i++;
+        continue;
+      }
+      if (len >= 4)
+      {
+        uint32_t tow = data[i + 6] | (data[i + 7] << 8) | (data[i + 8] << 16) | ((uint32_t)data[i + 9] << 24);
+        mark(i, tow, true);
+      }
+      i = end + 2;
+    }
+    else
+      i++;
+  }
+  return marks;
+}
+
+static void replayThread(std::vector<uint8_t> data, HardwareSerial *port)
+{
+  std::vector<EpochMark> marks;
+  if (simConfig.replayTiming)
+    marks = scanEpochs(data);
+  fprintf(stderr, "[SIM] replaying %s: %zu bytes, %zu epochs%s\n", simConfig.replayPath.c_str(), data.size(),
+          marks.size(), marks.empty() ? " (paced by baud rate only)" : "");
+
+  for (;;)
+  {
+    uint64_t start = simMicros();
+    uint64_t last = start;
+    double budget = 0;
+    size_t pos = 0;
+    size_t nextMark = 0;
+    while (pos < data.size())
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      uint64_t now = simMicros();
+      unsigned long baud = simConfig.baud ? simConfig.baud : port->baudRate();
+      budget += (now - last) * (baud / 10.0) / 1e6;
+      last = now;
+
+      // 放行所有已到时间的历元；未到时间的历元之前的字节可以发送
+      uint64_t elapsedMs = (now - start) / 1000;
+      while (nextMark < marks.size() && marks[nextMark].tMs <= elapsedMs)
+        nextMark++;
+      size_t limit = nextMark < marks.size() ? marks[nextMark].offset : data.size();
+      if (pos >= limit)
+      {
+        budget = 0; // 线路空闲，不累积发送额度
+        continue;
+      }
+      size_t n = (size_t)budget;
+      if (n > limit - pos)
+        n = limit - pos;
+      if (!n)
+        continue;
+      budget -= n;
+      port->simInject(&data[pos], n);
+      pos += n;
+    }
+    if (!simConfig.loopReplay)
+      break;
+  }
+  simUartStats.replayDoneUs = simMicros();
+  simUartStats.replayDone = true;
+}
+
+void simReplayStart(HardwareSerial *port)
+{
+  static bool started = false;
+  if (started || simConfig.replayPath.empty())
+    return;
+  started = true;
+  std::vector<uint8_t> data;
+  FILE *f = fopen(simConfig.replayPath.c_str(), "rb");
+  if (f)
+  {
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      data.insert(data.end(), buf, buf + n);
+    fclose(f);
+  }
+  else
+  {
+    fprintf(stderr, "[SIM] cannot open replay file %s\n", simConfig.replayPath.c_str());
+  }
+  std::thread(replayThread, std::move(data), port).detach();
+}
@@ -0,0 +1,129 @@
+// UBX 解码检查（--check-ubx 文件）
+//
+// 把录制的 UBX 原始字节逐个喂给固件的 UbxDecoder，与同名 .expect 文件比较：
+//   frames_ok / checksum_errors / acks / naks  解码器计数
+//   sats                                       最后一次 NAV-SVINFO 后卫星视图中的卫星数
+//   epoch iTOW valid latE7 lngE7 altCm speedCmps  按顺序列出每个应输出的历元
+// 样例数据 sim/replay/sample.ubx 由 nmea_to_ubx.py 生成，含校验和错误、噪声、
+// 重复和乱序报文。任何一项不符时以退出码 1 失败。
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "sim.h"
+#include "ubx.h"
+
+struct UbxEpoch
+{
+  uint32_t tow;
+  int valid;
+  long latE7, lngE7, altCm, speedCmps;
+};
+
+static bool sameEpoch(const UbxEpoch &a, const UbxEpoch &b)
+{
+  return a.tow == b.tow && a.valid == b.valid && a.latE7 == b.latE7 && a.lngE7 == b.lngE7 && a.altCm == b.altCm &&
+         a.speedCmps == b.speedCmps;
+}
+
+static void printEpoch(const char *tag, size_t n, const UbxEpoch &e)
+{
+  fprintf(stderr, "[CHECK]   %s #%u: tow %lu valid %d lat %ld lng %ld alt %ld speed %ld\n", tag, (unsigned)n,
+          (unsigned long)e.tow, e.valid, e.latE7, e.lngE7, e.altCm, e.speedCmps);
+}
+
+int simRunUbxCheck()
+{
+  const std::string &path = simConfig.checkUbx;
+  FILE *in = fopen(path.c_str(), "rb");
+  std::string expectPath = path + ".expect";
+  FILE *ex = fopen(expectPath.c_str(), "r");
+  if (!in || !ex)
+  {
+    fprintf(stderr, "[CHECK] cannot open %s\n", in ? expectPath.c_str() : path.c_str());
+    if (in)
+      fclose(in);
+    if (ex)
+      fclose(ex);
+    return 2;
+  }
+
+  long want[5] = {-1, -1, -1, -1, -1};
+  static const char *keys[5] = {"frames_ok", "checksum_errors", "acks", "naks", "sats"};
+  std::vector<UbxEpoch> expected;
+  char line[160];
+  while (fgets(line, sizeof(line), ex))
+  {
+    char key[32];
+    UbxEpoch e;
+    unsigned long tow;
+    long value;
+    if (line[0] == '#' || line[0] == '\n')
+      continue;
+    if (sscanf(line, "epoch %lu %d %ld %ld %ld %ld", &tow, &e.valid, &e.latE7, &e.lngE7, &e.altCm, &e.speedCmps) == 6)
+    {
+      e.tow = (uint32_t)tow;
+      expected.push_back(e);
+      continue;
+    }
+    if (sscanf(line, "%31s %ld", key, &value) == 2)
+    {
+      for (int k = 0; k < 5; k++)
+        if (strcmp(key, keys[k]) == 0)
+          want[k] = value;
+    }
+  }
+  fclose(ex);
+
+  UbxDecoder ubx;
+  SatView sky;
+  ubx.setSatView(&sky);
+  std::vector<UbxEpoch> got;
+  size_t bytes = 0;
+  int c;
+  while ((c = fgetc(in)) != EOF)
+  {
+    bytes++;
+    if (!ubx.feed((uint8_t)c))
+      continue;
+    const GpsFix &f = ubx.fix();
+    got.push_back({ubx.epochTow(), f.valid ? 1 : 0, (long)f.latE7, (long)f.lngE7, (long)f.altCm, (long)f.speedCmps});
+  }
+  fclose(in);
+
+  long have[5] = {(long)ubx.framesOk(), (long)ubx.checksumErrors(), (long)ubx.acks(), (long)ubx.naks(),
+                  (long)sky.count()};
+  fprintf(stderr, "[CHECK] %s: %u bytes, %u epochs (expected %u)\n", path.c_str(), (unsigned)bytes,
+          (unsigned)got.size(), (unsigned)expected.size());
+
+  int rc = 0;
+  for (int k = 0; k < 5; k++)
+  {
+    bool ok = want[k] < 0 || want[k] == have[k];
+    fprintf(stderr, "[CHECK] %-16s %6ld  expected %6ld  %s\n", keys[k], have[k], want[k], ok ? "ok" : "FAIL");
+    if (!ok)
+      rc = 1;
+  }
+
+  size_t n = got.size() < expected.size() ? got.size() : expected.size();
+  uint32_t mismatches = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (sameEpoch(got[i], expected[i]))
+      continue;
+    if (mismatches++ < 3)
+    {
+      printEpoch("got     ", i, got[i]);
+      printEpoch("expected", i, expected[i]);
+    }
+  }
+  if (mismatches || got.size() != expected.size())
+  {
+    fprintf(stderr, "[CHECK] FAIL %lu epochs differ, %u decoded vs %u expected\n", (unsigned long)mismatches,
+            (unsigned)got.size(), (unsigned)expected.size());
+    rc = 1;
+  }
+  if (rc == 0)
+    fprintf(stderr, "[CHECK] ok\n");
+  return rc;
+}
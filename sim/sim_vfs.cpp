@@ -0,0 +1,30 @@
+// 固件经由 VFS 挂载点直接调用的 POSIX 文件接口（Arduino FS 未提供的部分，如截断）。
+// /littlefs/... 映射到模拟 LittleFS 目录，其余路径照常交给系统。
+// 可执行文件中的同名定义优先于 libc（ELF 符号抢占），只在 glibc 上启用。
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "sim.h"
+
+#define SIM_VFS_ROOT "/littlefs"
+
+static std::string localPath(const char *path)
+{
+  size_t n = strlen(SIM_VFS_ROOT);
+  if (strncmp(path, SIM_VFS_ROOT, n) == 0 && (path[n] == '/' || path[n] == '\0'))
+    return simFsPath(path + n);
+  return path;
+}
+
+#ifdef __GLIBC__
+extern "C" int truncate(const char *path, off_t length) noexcept
+{
+  int fd = open(localPath(path).c_str(), O_WRONLY);
+  if (fd < 0)
+    return -1;
+  int rc = ftruncate(fd, length);
+  close(fd);
+  return rc;
+}
+#endif
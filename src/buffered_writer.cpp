@@ -0,0 +1,88 @@
+#include "buffered_writer.h"
+#include <stdarg.h>
+
+uint32_t BufferedFileWriter::_totalBytes = 0;
+
+bool BufferedFileWriter::open(FS &fs, const String &path, const char *mode)
+{
+  close();
+  _file = fs.open(path, mode);
+  if (!_file)
+    return false;
+  _path = path;
+  _open = true;
+  _len = 0;
+  _lastFlush = millis();
+  _records = 0;
+  _flushes = 0;
+  _bytes = 0;
+  return true;
+}
+
+void BufferedFileWriter::close()
+{
+  if (!_open)
+    return;
+  flush();
+  _file.close();
+  _open = false;
+}
+
+bool BufferedFileWriter::write(const uint8_t *data, size_t len)
+{
+  if (!_open)
+    return false;
+  if (_len + len > sizeof(_buf) && !flush())
+    return false;
+  if (len > sizeof(_buf))
+  {
+    // 超过缓冲区的记录直接写入
+    if (_file.write(data, len) != len)
+      return false;
+    _bytes += len;
+    _totalBytes += len;
+    _records++;
+    return flush();
+  }
+  memcpy(_buf + _len, data, len);
+  _len += len;
+  _records++;
+  return true;
+}
+
+bool BufferedFileWriter::printf(const char *fmt, ...)
+{
+  char line[160];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (n < 0)
+    return false;
+  if ((size_t)n >= sizeof(line))
+    n = sizeof(line) - 1;
+  return write((const uint8_t *)line, n);
+}
+
+void BufferedFileWriter::flushIfDue(uint32_t nowMs)
+{
+  if (_open && _len > 0 && nowMs - _lastFlush >= _flushIntervalMs)
+    flush();
+}
+
+bool BufferedFileWriter::flush()
+{
+  if (!_open)
+    return false;
+  _lastFlush = millis();
+  if (_len == 0)
+    return true;
+  size_t written = _file.write(_buf, _len);
+  _file.flush(); // 提交 LittleFS 元数据，掉电后数据可见
+  _bytes += written;
+  _totalBytes += written;
+  _flushes++;
+  bool ok = written == _len;
+  _len = 0;
+  return ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+// 常开文件句柄 + RAM 缓冲的追加写入器。
+// 每条记录先进缓冲区，满（或到时间阈值、或关闭）时才整块写入并 flush，
+// 把 LittleFS 的元数据提交次数从“每条记录一次”降到“每次刷新一次”。
+#include <Arduino.h>
+#include <FS.h>
+
+#ifndef BUFFERED_WRITER_SIZE
+#define BUFFERED_WRITER_SIZE 1024
+#endif
+
+class BufferedFileWriter
+{
+public:
+  explicit BufferedFileWriter(uint32_t flushIntervalMs) : _flushIntervalMs(flushIntervalMs) {}
+
+  bool open(FS &fs, const String &path, const char *mode);
+  void close();
+  bool isOpen() const { return _open; }
+  const String &path() const { return _path; }
+
+  // 追加一条记录（整条写入缓冲区，不会被刷新拆开）
+  bool write(const uint8_t *data, size_t len);
+  bool printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  // 缓冲区非空且距上次刷新超过阈值时写入 flash，在 loop() 中定期调用
+  void flushIfDue(uint32_t nowMs);
+  bool flush();
+
+  // 统计：写入放大 = 原方案每条记录一次 open/close 提交，现方案每次刷新一次
+  uint32_t records() const { return _records; }
+  uint32_t flushes() const { return _flushes; }
+  uint32_t bytesWritten() const { return _bytes; }
+  // 所有写入器自启动以来写入 flash 的总字节数，不随 open() 清零
+  static uint32_t totalBytesWritten() { return _totalBytes; }
+
+private:
+  File _file;
+  String _path;
+  bool _open = false;
+  uint8_t _buf[BUFFERED_WRITER_SIZE];
+  size_t _len = 0;
+  uint32_t _flushIntervalMs;
+  uint32_t _lastFlush = 0;
+  uint32_t _records = 0;
+  uint32_t _flushes = 0;
+  uint32_t _bytes = 0;
+  static uint32_t _totalBytes;
+};
@@ -0,0 +1,30 @@
+#include "display_fields.h"
+#include <stdarg.h>
+
+bool drawField(Adafruit_GFX &gfx, DisplayField &f, const char *text, uint16_t color, uint16_t bg, uint8_t size)
+{
+  if (f.drawn && f.color == color && f.size == size && strncmp(f.text, text, sizeof(f.text)) == 0)
+    return false;
+  strncpy(f.text, text, sizeof(f.text) - 1);
+  f.text[sizeof(f.text) - 1] = '\0';
+  f.color = color;
+  f.size = size;
+  f.drawn = true;
+  gfx.fillRect(f.x, f.y, f.w, f.h, bg);
+  gfx.setTextWrap(false);
+  gfx.setTextSize(size);
+  gfx.setTextColor(color);
+  gfx.setCursor(f.x, f.y + f.textDy);
+  gfx.print(f.text);
+  return true;
+}
+
+bool drawFieldf(Adafruit_GFX &gfx, DisplayField &f, uint16_t color, uint16_t bg, uint8_t size, const char *fmt, ...)
+{
+  char buf[DISPLAY_FIELD_TEXT];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  return drawField(gfx, f, buf, color, bg, size);
+}
@@ -0,0 +1,26 @@
+#pragma once
+// 屏幕字段缓存：记录每个字段上次绘制的文本/颜色/字号，只有变化时才擦除该区域并重绘。
+#include <Adafruit_GFX.h>
+
+#define DISPLAY_FIELD_TEXT 24
+
+struct DisplayField
+{
+  int16_t x, y, w, h; // 字段占用的矩形，重绘前整体擦除
+  int16_t textDy;     // 文本相对矩形顶部的纵向偏移
+  char text[DISPLAY_FIELD_TEXT];
+  uint16_t color;
+  uint8_t size;
+  bool drawn;
+};
+
+#define DISPLAY_FIELD(x, y, w, h) {(x), (y), (w), (h), 0, "", 0, 1, false}
+#define DISPLAY_FIELD_DY(x, y, w, h, dy) {(x), (y), (w), (h), (dy), "", 0, 1, false}
+
+// 内容有变化时擦除并重绘，返回是否重绘
+bool drawField(Adafruit_GFX &gfx, DisplayField &f, const char *text, uint16_t color, uint16_t bg, uint8_t size = 1);
+// printf 风格，格式化到字段缓冲区长度
+bool drawFieldf(Adafruit_GFX &gfx, DisplayField &f, uint16_t color, uint16_t bg, uint8_t size, const char *fmt, ...)
+    __attribute__((format(printf, 6, 7)));
+// 下次必定重绘（屏幕被整屏清除之后调用）
+inline void invalidateField(DisplayField &f) { f.drawn = false; }
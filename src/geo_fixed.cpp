@@ -0,0 +1,287 @@
+#include "geo_fixed.h"
+#include "trip_format.h"
+
+// sin(i·90°/256) × 2^30，i = 0..256
+static const int32_t SIN_TABLE[257] = {
+    0, 6588356, 13176464, 19764076, 26350943, 32936819, 39521455, 46104602,
+    52686014, 59265442, 65842639, 72417357, 78989349, 85558366, 92124163, 98686491,
+    105245103, 111799753, 118350194, 124896179, 131437462, 137973796, 144504935, 151030634,
+    157550647, 164064728, 170572633, 177074115, 183568930, 190056834, 196537583, 203010932,
+    209476638, 215934457, 222384147, 228825464, 235258165, 241682010, 248096755, 254502159,
+    260897982, 267283981, 273659918, 280025552, 286380643, 292724951, 299058239, 305380268,
+    311690799, 317989595, 324276419, 330551034, 336813204, 343062693, 349299266, 355522689,
+    361732726, 367929144, 374111709, 380280190, 386434353, 392573967, 398698801, 404808624,
+    410903207, 416982319, 423045732, 429093217, 435124548, 441139496, 447137835, 453119340,
+    459083786, 465030947, 470960600, 476872522, 482766489, 488642281, 494499676, 500338453,
+    506158392, 511959275, 517740883, 523502998, 529245404, 534967884, 540670223, 546352205,
+    552013618, 557654248, 563273883, 568872310, 574449320, 580004702, 585538248, 591049748,
+    596538995, 602005783, 607449906, 612871159, 618269338, 623644239, 628995660, 634323400,
+    639627258, 644907034, 650162530, 655393548, 660599890, 665781362, 670937767, 676068911,
+    681174602, 686254647, 691308855, 696337036, 701339000, 706314559, 711263525, 716185713,
+    721080937, 725949013, 730789757, 735602987, 740388522, 745146182, 749875788, 754577161,
+    759250125, 763894504, 768510122, 773096806, 777654384, 782182683, 786681534, 791150767,
+    795590213, 799999706, 804379079, 808728167, 813046808, 817334838, 821592095, 825818421,
+    830013654, 834177638, 838310216, 842411232, 846480531, 850517961, 854523370, 858496606,
+    862437520, 866345964, 870221790, 874064853, 877875009, 881652112, 885396022, 889106597,
+    892783698, 896427186, 900036924, 903612776, 907154608, 910662286, 914135678, 917574653,
+    920979082, 924348837, 927683790, 930983817, 934248793, 937478595, 940673101, 943832191,
+    946955747, 950043650, 953095785, 956112036, 959092290, 962036435, 964944360, 967815955,
+    970651112, 973449725, 976211688, 978936898, 981625251, 984276646, 986890984, 989468165,
+    992008094, 994510675, 996975812, 999403415, 1001793390, 1004145648, 1006460100, 1008736660,
+    1010975242, 1013175761, 1015338134, 1017462281, 1019548121, 1021595575, 1023604567, 1025575020,
+    1027506862, 1029400018, 1031254418, 1033069992, 1034846671, 1036584389, 1038283080, 1039942680,
+    1041563127, 1043144360, 1044686319, 1046188946, 1047652185, 1049075980, 1050460278, 1051805027,
+    1053110176, 1054375676, 1055601479, 1056787540, 1057933813, 1059040255, 1060106826, 1061133483,
+    1062120190, 1063066909, 1063973603, 1064840240, 1065666786, 1066453210, 1067199483, 1067905576,
+    1068571464, 1069197120, 1069782521, 1070327646, 1070832474, 1071296985, 1071721163, 1072104991,
+    1072448455, 1072751542, 1073014240, 1073236540, 1073418433, 1073559913, 1073660973, 1073721611,
+    1073741824,
+};
+
+// atan(i/256) 的二进制角，i = 0..256
+static const int32_t ATAN_TABLE[257] = {
+    0, 2670163, 5340245, 8010164, 10679838, 13349187, 16018129, 18686582,
+    21354465, 24021698, 26688200, 29353889, 32018685, 34682507, 37345276, 40006910,
+    42667331, 45326458, 47984212, 50640513, 53295284, 55948444, 58599915, 61249621,
+    63897482, 66543421, 69187361, 71829226, 74468939, 77106424, 79741605, 82374407,
+    85004756, 87632577, 90257796, 92880340, 95500135, 98117110, 100731191, 103342309,
+    105950391, 108555367, 111157167, 113755721, 116350962, 118942819, 121531227, 124116117,
+    126697423, 129275078, 131849018, 134419178, 136985493, 139547900, 142106335, 144660738,
+    147211045, 149757197, 152299132, 154836791, 157370116, 159899047, 162423527, 164943499,
+    167458907, 169969696, 172475810, 174977196, 177473799, 179965568, 182452450, 184934394,
+    187411349, 189883266, 192350096, 194811789, 197268300, 199719579, 202165583, 204606264,
+    207041579, 209471483, 211895933, 214314887, 216728303, 219136141, 221538359, 223934919,
+    226325781, 228710908, 231090262, 233463808, 235831508, 238193329, 240549235, 242899194,
+    245243172, 247581137, 249913059, 252238905, 254558647, 256872255, 259179700, 261480955,
+    263775993, 266064788, 268347313, 270623543, 272893455, 275157025, 277414230, 279665048,
+    281909457, 284147437, 286378966, 288604026, 290822599, 293034664, 295240206, 297439207,
+    299631651, 301817523, 303996806, 306169488, 308335554, 310494991, 312647786, 314793928,
+    316933406, 319066208, 321192324, 323311746, 325424463, 327530468, 329629752, 331722309,
+    333808132, 335887214, 337959550, 340025134, 342083962, 344136031, 346181336, 348219874,
+    350251643, 352276640, 354294865, 356306316, 358310992, 360308894, 362300021, 364284375,
+    366261957, 368232767, 370196809, 372154086, 374104599, 376048352, 377985350, 379915596,
+    381839095, 383755852, 385665872, 387569162, 389465727, 391355574, 393238710, 395115141,
+    396984877, 398847924, 400704291, 402553986, 404397019, 406233399, 408063135, 409886237,
+    411702716, 413512582, 415315845, 417112518, 418902610, 420686135, 422463104, 424233528,
+    425997422, 427754796, 429505665, 431250041, 432987938, 434719370, 436444350, 438162893,
+    439875013, 441580724, 443280042, 444972981, 446659557, 448339785, 450013680, 451681259,
+    453342536, 454997530, 456646255, 458288728, 459924966, 461554985, 463178803, 464796437,
+    466407904, 468013221, 469612406, 471205476, 472792449, 474373344, 475948178, 477516969,
+    479079736, 480636498, 482187271, 483732076, 485270931, 486803855, 488330866, 489851983,
+    491367227, 492876615, 494380167, 495877903, 497369841, 498856002, 500336404, 501811068,
+    503280012, 504743258, 506200824, 507652730, 509098996, 510539643, 511974689, 513404156,
+    514828063, 516246430, 517659277, 519066625, 520468494, 521864904, 523255875, 524641427,
+    526021581, 527396357, 528765775, 530129856, 531488619, 532842087, 534190278, 535533213,
+    536870912,
+};
+
+#define QUARTER 0x40000000u // 90° 的二进制角
+#define SEG_SHIFT 22        // 每个表格区间 2^22 BAM
+
+// 每个二进制角对应的地面弧长（厘米）× 2^32：2π × 6371008.8 m / 2^32
+static const uint64_t CM_PER_BAM_Q32 = 4003022888ULL;
+// 每 1e-7 度对应的地面弧长（厘米）× 2^24
+static const uint64_t CM_PER_E7_Q24 = 18655439ULL;
+#define E7_FULL_TURN 3600000000LL
+
+int32_t geoE7ToBam(int32_t e7)
+{
+  // 2^32 / 3.6e9 × 2^31，乘积 < 2^63；四舍五入
+  return (int32_t)(((int64_t)e7 * 2562047788LL + (1LL << 30)) >> 31);
+}
+
+int32_t geoSin(uint32_t bam)
+{
+  uint32_t quadrant = bam >> 30;
+  uint32_t q = bam & (QUARTER - 1);
+  if (quadrant & 1)
+    q = QUARTER - q;
+  uint32_t idx = q >> SEG_SHIFT;
+  int32_t v;
+  if (idx >= 256)
+    v = SIN_TABLE[256];
+  else
+  {
+    int64_t frac = q & ((1u << SEG_SHIFT) - 1);
+    v = SIN_TABLE[idx] + (int32_t)(((SIN_TABLE[idx + 1] - SIN_TABLE[idx]) * frac + (1 << (SEG_SHIFT - 1))) >> SEG_SHIFT);
+  }
+  return quadrant & 2 ? -v : v;
+}
+
+// Q30 正数 x（≤ 1.0）的反正弦，单位为 1/4 BAM：在正弦表中二分查找后反向插值
+static uint64_t asinQuarterBam(uint32_t x)
+{
+  if (x >= (uint32_t)SIN_TABLE[256])
+    return (uint64_t)QUARTER << 2;
+  int lo = 0, hi = 256; // SIN_TABLE[lo] ≤ x < SIN_TABLE[hi]
+  while (hi - lo > 1)
+  {
+    int mid = (lo + hi) / 2;
+    if ((uint32_t)SIN_TABLE[mid] <= x)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  uint64_t seg = (uint64_t)(SIN_TABLE[hi] - SIN_TABLE[lo]);
+  uint64_t frac = (((uint64_t)(x - SIN_TABLE[lo]) << (SEG_SHIFT + 2)) + seg / 2) / seg;
+  return ((uint64_t)lo << (SEG_SHIFT + 2)) + frac;
+}
+
+uint64_t geoIsqrt64(uint64_t v)
+{
+  uint64_t r = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > v)
+    bit >>= 2;
+  while (bit)
+  {
+    if (v >= r + bit)
+    {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    }
+    else
+    {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+int32_t geoRawToE7(uint16_t deg, uint32_t billionths, bool negative)
+{
+  int32_t v = (int32_t)deg * 10000000L + (int32_t)((billionths + 50) / 100);
+  return negative ? -v : v;
+}
+
+// 局部平面上的东向/北向分量，单位 1e-7 度 × 2^6；经度差取最短方向，跨越 ±180° 也正确
+#define LOCAL_SHIFT 6
+static void localDelta(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7, int64_t &dx, int64_t &dy)
+{
+  int64_t dLat = (int64_t)lat2E7 - lat1E7;
+  int64_t dLng = (int64_t)lng2E7 - lng1E7;
+  if (dLng > E7_FULL_TURN / 2)
+    dLng -= E7_FULL_TURN;
+  else if (dLng < -E7_FULL_TURN / 2)
+    dLng += E7_FULL_TURN;
+  int32_t meanLat = geoE7ToBam(lat1E7 + (int32_t)(dLat / 2));
+  dy = dLat << LOCAL_SHIFT;
+  dx = (dLng * geoCos((uint32_t)meanLat) + (1LL << (29 - LOCAL_SHIFT))) >> (30 - LOCAL_SHIFT);
+}
+
+uint32_t geoEquirectCm(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7)
+{
+  int64_t dx, dy;
+  localDelta(lat1E7, lng1E7, lat2E7, lng2E7, dx, dy);
+  uint64_t ax = dx < 0 ? -dx : dx;
+  uint64_t ay = dy < 0 ? -dy : dy;
+  uint64_t d;
+  if (ax < (1ULL << 31) && ay < (1ULL << 31))
+  {
+    // 约 200 km 以内保留 6 位小数位，避免截断误差随相邻点累加
+    uint64_t sq = ax * ax + ay * ay;
+    d = geoIsqrt64(sq);
+    if (sq - d * d > d)
+      d++; // 四舍五入
+  }
+  else
+  {
+    ax >>= LOCAL_SHIFT;
+    ay >>= LOCAL_SHIFT;
+    d = geoIsqrt64(ax * ax + ay * ay) << LOCAL_SHIFT;
+  }
+  return (uint32_t)((d * CM_PER_E7_Q24 + (1ULL << (23 + LOCAL_SHIFT))) >> (24 + LOCAL_SHIFT));
+}
+
+uint32_t geoHaversineCm(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7)
+{
+  // 半角直接由 1e-7 度差值换算（一次取整），避免两端各自取整的误差
+  int64_t dLat = (int64_t)lat2E7 - lat1E7;
+  int64_t dLng = (int64_t)lng2E7 - lng1E7;
+  if (dLng > E7_FULL_TURN / 2)
+    dLng -= E7_FULL_TURN;
+  else if (dLng < -E7_FULL_TURN / 2)
+    dLng += E7_FULL_TURN;
+  // 乘积 < 2^63：|dLat|、|dLng| ≤ 1.8e9
+  int64_t s1 = geoSin((uint32_t)(int32_t)((dLat * 2562047788LL + (1LL << 31)) >> 32));
+  int64_t s2 = geoSin((uint32_t)(int32_t)((dLng * 2562047788LL + (1LL << 31)) >> 32));
+  int64_t u = (s2 * geoCos((uint32_t)geoE7ToBam(lat1E7)) + (1LL << 29)) >> 30;
+  int64_t v = (s2 * geoCos((uint32_t)geoE7ToBam(lat2E7)) + (1LL << 29)) >> 30;
+  // a = sin²(Δφ/2) + cosφ1·cosφ2·sin²(Δλ/2)，Q60
+  uint64_t a = (uint64_t)(s1 * s1) + (uint64_t)(u * v);
+  uint64_t root = geoIsqrt64(a); // Q30
+  if (a - root * root > root)
+    root++; // 四舍五入
+  if (root > QUARTER)
+    root = QUARTER;
+  // d = 2R·asin(√a)；半角为 1/4 BAM，乘 2 后正好是 CM_PER_BAM 的一半
+  uint64_t halfAngle = asinQuarterBam((uint32_t)root);
+  return (uint32_t)((halfAngle * (CM_PER_BAM_Q32 >> 1) + (1ULL << 31)) >> 32);
+}
+
+// atan(t)，t 为 Q30 且 0 ≤ t ≤ 1.0，结果为 BAM
+static uint32_t atanBam(uint64_t t)
+{
+  uint32_t idx = (uint32_t)(t >> SEG_SHIFT);
+  if (idx >= 256)
+    return (uint32_t)ATAN_TABLE[256];
+  int64_t frac = (int64_t)(t & ((1u << SEG_SHIFT) - 1));
+  return (uint32_t)(ATAN_TABLE[idx] + (((int64_t)(ATAN_TABLE[idx + 1] - ATAN_TABLE[idx]) * frac) >> SEG_SHIFT));
+}
+
+uint16_t geoBearingCdeg(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7)
+{
+  int64_t dx, dy;
+  localDelta(lat1E7, lng1E7, lat2E7, lng2E7, dx, dy);
+  dx >>= LOCAL_SHIFT - 2; // 保留 2 位小数位即可，(a << 30) 不会溢出
+  dy >>= LOCAL_SHIFT - 2;
+  if (dx == 0 && dy == 0)
+    return 0;
+  uint64_t ax = dx < 0 ? -dx : dx;
+  uint64_t ay = dy < 0 ? -dy : dy;
+  // 与正北方向的夹角（0..90°）
+  uint32_t angle = ax <= ay ? atanBam((ax << 30) / ay) : QUARTER - atanBam((ay << 30) / ax);
+  uint32_t bam;
+  if (dy >= 0)
+    bam = dx >= 0 ? angle : 0u - angle;
+  else
+    bam = dx >= 0 ? 2 * QUARTER - angle : 2 * QUARTER + angle;
+  return (uint16_t)(((uint64_t)bam * 36000 + (1ULL << 31)) >> 32) % 36000;
+}
+
+void geoToLocalCm(int32_t refLatE7, int32_t refLngE7, int32_t latE7, int32_t lngE7, int32_t &eastCm, int32_t &northCm)
+{
+  int64_t dx, dy;
+  localDelta(refLatE7, refLngE7, latE7, lngE7, dx, dy);
+  const int shift = 24 + LOCAL_SHIFT;
+  eastCm = (int32_t)((dx * (int64_t)CM_PER_E7_Q24 + (1LL << (shift - 1))) >> shift);
+  northCm = (int32_t)((dy * (int64_t)CM_PER_E7_Q24 + (1LL << (shift - 1))) >> shift);
+}
+
+void geoFromLocalCm(int32_t refLatE7, int32_t refLngE7, int32_t eastCm, int32_t northCm, int32_t &latE7, int32_t &lngE7)
+{
+  int64_t dLat = (((int64_t)northCm << 24) + (int64_t)(CM_PER_E7_Q24 / 2)) / (int64_t)CM_PER_E7_Q24;
+  latE7 = refLatE7 + (int32_t)dLat;
+  int64_t c = geoCos((uint32_t)geoE7ToBam(refLatE7 + (int32_t)(dLat / 2)));
+  if (c < (1 << 16))
+    c = 1 << 16; // 极点附近经度无意义，避免除以 0
+  int64_t dLng = ((((int64_t)eastCm << 24) / (int64_t)CM_PER_E7_Q24) << 30) / c;
+  int64_t lng = refLngE7 + dLng;
+  if (lng > E7_FULL_TURN / 2)
+    lng -= E7_FULL_TURN;
+  else if (lng < -E7_FULL_TURN / 2)
+    lng += E7_FULL_TURN;
+  lngE7 = (int32_t)lng;
+}
+
+size_t geoFormatE7(char *buf, size_t size, int32_t e7, uint8_t decimals)
+{
+  static const int32_t pow10[] = {10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+  if (decimals > 7)
+    decimals = 7;
+  int32_t div = pow10[decimals];
+  int32_t half = div / 2;
+  int32_t v = div == 1 ? e7 : (e7 >= 0 ? (e7 + half) / div : (e7 - half) / div);
+  return formatFixed(buf, size, v, decimals);
+}
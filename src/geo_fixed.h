@@ -0,0 +1,40 @@
+#pragma once
+// 定点数大地测量：ESP32-C3 没有浮点单元，double 运算全部走软件模拟。
+// 这里的距离、方位和格式化只用整数运算，输入为 1e-7 度整数坐标（GpsFix 的单位）。
+//
+// 内部角度用二进制角（BAM，整圈 = 2^32），正弦/反正切查 257 项四分之一周期表并线性插值，
+// 开方用整数平方根，所有移位均四舍五入，相邻点累加时没有系统偏差。
+// 与 double 版半正矢公式对比（随机点对，纬度 ±85°）的最大误差，由 --bench-geo 测得并检查：
+//   geoEquirectCm   ≤ 1 km：1 cm；10 km：5 cm（纬度 60° 以上 12 cm）；
+//                   100 km：3.3 m（纬度 85° 时 131 m）。10 km 以上主要是近似本身的误差
+//   geoHaversineCm  ≤ 1 km：3.5 cm（半角按二进制角取整，约 0.9 cm 一级）；10 km：7 cm；
+//                   100 km：0.8 m；更远 0.007%
+//   geoBearingCdeg  两点相距 ≥ 10 m 时 0.02°
+// 相邻定位点之间的距离用 geoEquirectCm：误差最小，只有一次查表和一次整数开方。
+#include <stddef.h>
+#include <stdint.h>
+
+// 1e-7 度 -> 二进制角
+int32_t geoE7ToBam(int32_t e7);
+// 正弦/余弦，结果为 Q30（1.0 = 2^30）
+int32_t geoSin(uint32_t bam);
+inline int32_t geoCos(uint32_t bam) { return geoSin(bam + 0x40000000u); }
+
+// TinyGPSPlus RawDegrees（度 + 十亿分之一度）-> 1e-7 度，四舍五入
+int32_t geoRawToE7(uint16_t deg, uint32_t billionths, bool negative);
+
+// 两点距离（厘米）。等距矩形近似适合相邻定位点之间的短距离；半正矢公式适合任意距离
+uint32_t geoEquirectCm(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7);
+uint32_t geoHaversineCm(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7);
+// 从点 1 指向点 2 的方位角（局部平面近似，正北为 0，顺时针），单位 0.01 度，0..35999
+uint16_t geoBearingCdeg(int32_t lat1E7, int32_t lng1E7, int32_t lat2E7, int32_t lng2E7);
+
+// 以参考点为原点的局部东/北平面坐标（厘米，等距矩形近似，适合 ±200 km 内）及其逆变换
+void geoToLocalCm(int32_t refLatE7, int32_t refLngE7, int32_t latE7, int32_t lngE7, int32_t &eastCm, int32_t &northCm);
+void geoFromLocalCm(int32_t refLatE7, int32_t refLngE7, int32_t eastCm, int32_t northCm, int32_t &latE7, int32_t &lngE7);
+
+// 64 位整数平方根（向下取整）
+uint64_t geoIsqrt64(uint64_t v);
+
+// 1e-7 度格式化为 decimals 位小数（四舍五入，decimals ≤ 7），返回长度
+size_t geoFormatE7(char *buf, size_t size, int32_t e7, uint8_t decimals);
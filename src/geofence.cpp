@@ -0,0 +1,701 @@
+#include "geofence.h"
+#include <string.h>
+#include "geo_fixed.h"
+
+// 1 度纬度约 11131949 厘米
+#define GEOFENCE_CM_PER_DEG 11131949LL
+
+static inline int64_t clamp64(int64_t v, int64_t lo, int64_t hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// 平方前截断到 ±2^31，两项之和仍在 uint64 范围内；截断后的距离远大于任何半径，不影响判断
+static inline uint64_t sq(int64_t v)
+{
+  v = clamp64(v, -2147483647LL, 2147483647LL);
+  return (uint64_t)(v * v);
+}
+
+// 纬度余弦（Q15），至少为 1
+static uint16_t cosQ15(int32_t latE7)
+{
+  int32_t c = (geoCos((uint32_t)geoE7ToBam(latE7)) + (1 << 14)) >> 15;
+  return c < 1 ? 1 : (uint16_t)c;
+}
+
+// ---- 文本解析 ----
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static inline void skipSpaces(const char *&p)
+{
+  while (*p == ' ' || *p == '\t')
+    p++;
+}
+
+// 十进制数换算为 decimals 位定点整数（四舍五入），例如 ("31.2304", 7) -> 312304000
+static bool parseFixed(const char *&p, uint8_t decimals, int64_t &out)
+{
+  skipSpaces(p);
+  bool neg = *p == '-';
+  if (*p == '-' || *p == '+')
+    p++;
+  if (!isDigit(*p) && !(*p == '.' && isDigit(p[1])))
+    return false;
+  int64_t v = 0;
+  while (isDigit(*p))
+  {
+    if (v > 100000000000LL)
+      return false;
+    v = v * 10 + (*p++ - '0');
+  }
+  uint8_t frac = 0;
+  bool roundUp = false;
+  if (*p == '.')
+  {
+    p++;
+    while (isDigit(*p))
+    {
+      if (frac < decimals)
+      {
+        v = v * 10 + (*p - '0');
+        frac++;
+      }
+      else if (frac == decimals)
+      {
+        roundUp = *p >= '5';
+        frac++; // 之后的位不再看
+      }
+      p++;
+    }
+  }
+  for (uint8_t i = frac; i < decimals; i++)
+    v *= 10;
+  if (roundUp)
+    v++;
+  out = neg ? -v : v;
+  skipSpaces(p);
+  return true;
+}
+
+static bool expectComma(const char *&p)
+{
+  skipSpaces(p);
+  if (*p != ',')
+    return false;
+  p++;
+  return true;
+}
+
+static bool atLineEnd(const char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    p++;
+  return *p == '\0';
+}
+
+// 读到下一个逗号为止的字段，去掉首尾空白
+static size_t readToken(const char *&p, char *out, size_t size)
+{
+  skipSpaces(p);
+  const char *start = p;
+  while (*p && *p != ',' && *p != '\r' && *p != '\n')
+    p++;
+  const char *end = p;
+  while (end > start && (end[-1] == ' ' || end[-1] == '\t'))
+    end--;
+  size_t n = end - start;
+  if (n >= size)
+    return size; // 调用方按过长处理
+  memcpy(out, start, n);
+  out[n] = '\0';
+  return n;
+}
+
+static bool parseLatLng(const char *&p, int32_t &lat, int32_t &lng)
+{
+  int64_t a, b;
+  if (!parseFixed(p, 7, a) || !expectComma(p) || !parseFixed(p, 7, b))
+    return false;
+  if (a < -900000000LL || a > 900000000LL || b < -1800000000LL || b > 1800000000LL)
+    return false;
+  lat = (int32_t)a;
+  lng = (int32_t)b;
+  return true;
+}
+
+bool Geofence::addLine(const char *line, const char **err)
+{
+  const char *p = line;
+  skipSpaces(p);
+  if (*p == '#' || atLineEnd(p))
+    return true;
+
+  int64_t id;
+  if (!parseFixed(p, 0, id) || id < 0 || id > 0xFFFF || !expectComma(p))
+  {
+    *err = "bad id";
+    return false;
+  }
+  char name[GEOFENCE_NAME_MAX + 1];
+  size_t nameLen = readToken(p, name, sizeof(name));
+  if (nameLen == 0 || nameLen >= sizeof(name) || !expectComma(p))
+  {
+    *err = "bad name";
+    return false;
+  }
+  char type[8];
+  size_t typeLen = readToken(p, type, sizeof(type));
+  if (typeLen >= sizeof(type) || !expectComma(p))
+  {
+    *err = "bad type";
+    return false;
+  }
+
+  if (strcmp(type, "circle") == 0)
+  {
+    int32_t lat, lng;
+    int64_t radiusCm;
+    if (!parseLatLng(p, lat, lng) || !expectComma(p) || !parseFixed(p, 2, radiusCm) || !atLineEnd(p) ||
+        radiusCm <= 0)
+    {
+      *err = "bad circle";
+      return false;
+    }
+    return addCircle((uint16_t)id, name, lat, lng, (uint32_t)clamp64(radiusCm, 1, 0xFFFFFFFFLL), err);
+  }
+  if (strcmp(type, "poly") == 0)
+  {
+    // 顶点直接追加到 _verts 末尾，出错时回退
+    uint32_t first = (uint32_t)_verts.size();
+    for (;;)
+    {
+      int32_t lat, lng;
+      if (!parseLatLng(p, lat, lng))
+      {
+        _verts.resize(first);
+        *err = "bad vertex";
+        return false;
+      }
+      if (_verts.size() >= GEOFENCE_MAX_VERTICES)
+      {
+        _verts.resize(first);
+        *err = "too many vertices";
+        return false;
+      }
+      _verts.push_back({lat, lng});
+      if (atLineEnd(p))
+        break;
+      if (!expectComma(p))
+      {
+        _verts.resize(first);
+        *err = "bad vertex";
+        return false;
+      }
+    }
+    return finishPolygon((uint16_t)id, name, first, err);
+  }
+  *err = "unknown type";
+  return false;
+}
+
+// ---- 添加区域 ----
+
+bool Geofence::addZone(uint16_t id, const char *name, const char **err)
+{
+  if (_zones.size() >= GEOFENCE_MAX_ZONES)
+  {
+    *err = "too many zones";
+    return false;
+  }
+  for (const Zone &z : _zones)
+  {
+    if (z.id == id)
+    {
+      *err = "duplicate id";
+      return false;
+    }
+  }
+  // 名称原样写入 JSON，排除引号、反斜杠和控制字符
+  size_t len = strlen(name);
+  for (size_t i = 0; i < len; i++)
+  {
+    if (name[i] == '"' || name[i] == '\\' || (uint8_t)name[i] < 0x20)
+    {
+      *err = "bad name";
+      return false;
+    }
+  }
+  if (len == 0 || len > GEOFENCE_NAME_MAX || _names.size() + len + 1 > 0xFFFF)
+  {
+    *err = "bad name";
+    return false;
+  }
+  Zone z = {};
+  z.id = id;
+  z.nameOff = (uint16_t)_names.size();
+  _names.insert(_names.end(), name, name + len + 1);
+  _zones.push_back(z);
+  return true;
+}
+
+bool Geofence::addCircle(uint16_t id, const char *name, int32_t latE7, int32_t lngE7, uint32_t radiusCm,
+                         const char **err)
+{
+  if (_verts.size() >= GEOFENCE_MAX_VERTICES)
+  {
+    *err = "too many vertices";
+    return false;
+  }
+  int64_t radiusE7 = (int64_t)radiusCm * 10000000LL / GEOFENCE_CM_PER_DEG;
+  if (radiusE7 < 1)
+    radiusE7 = 1;
+  uint16_t c = cosQ15(latE7);
+  int64_t dLng = radiusE7 * 32768 / c;
+  if (2 * radiusE7 > GEOFENCE_MAX_SPAN_E7 || 2 * dLng > GEOFENCE_MAX_SPAN_E7 ||
+      (int64_t)latE7 - radiusE7 < -900000000LL || (int64_t)latE7 + radiusE7 > 900000000LL ||
+      (int64_t)lngE7 - dLng < -1800000000LL || (int64_t)lngE7 + dLng > 1800000000LL)
+  {
+    *err = "zone too large";
+    return false;
+  }
+  if (!addZone(id, name, err))
+    return false;
+  Zone &z = _zones.back();
+  z.first = (uint32_t)_verts.size();
+  z.count = 0;
+  z.cosQ15 = c;
+  z.radiusE7 = (uint32_t)radiusE7;
+  z.minLat = (int32_t)(latE7 - radiusE7);
+  z.maxLat = (int32_t)(latE7 + radiusE7);
+  z.minLng = (int32_t)(lngE7 - dLng);
+  z.maxLng = (int32_t)(lngE7 + dLng);
+  _verts.push_back({latE7, lngE7});
+  return true;
+}
+
+bool Geofence::addPolygon(uint16_t id, const char *name, const int32_t *latLngE7, uint16_t n, const char **err)
+{
+  if (_verts.size() + n > GEOFENCE_MAX_VERTICES)
+  {
+    *err = "too many vertices";
+    return false;
+  }
+  uint32_t first = (uint32_t)_verts.size();
+  for (uint16_t i = 0; i < n; i++)
+    _verts.push_back({latLngE7[2 * i], latLngE7[2 * i + 1]});
+  return finishPolygon(id, name, first, err);
+}
+
+bool Geofence::finishPolygon(uint16_t id, const char *name, uint32_t first, const char **err)
+{
+  // 末顶点与首顶点相同（显式闭合）时去掉
+  if (_verts.size() - first >= 2 && _verts.back().lat == _verts[first].lat && _verts.back().lng == _verts[first].lng)
+    _verts.pop_back();
+  uint32_t n = (uint32_t)_verts.size() - first;
+  if (n < 3 || n > 0xFFFF)
+  {
+    _verts.resize(first);
+    *err = "polygon needs 3+ vertices";
+    return false;
+  }
+  int32_t minLat = _verts[first].lat, maxLat = minLat;
+  int32_t minLng = _verts[first].lng, maxLng = minLng;
+  for (uint32_t i = first + 1; i < first + n; i++)
+  {
+    const Vertex &v = _verts[i];
+    minLat = v.lat < minLat ? v.lat : minLat;
+    maxLat = v.lat > maxLat ? v.lat : maxLat;
+    minLng = v.lng < minLng ? v.lng : minLng;
+    maxLng = v.lng > maxLng ? v.lng : maxLng;
+  }
+  if ((int64_t)maxLat - minLat > GEOFENCE_MAX_SPAN_E7 || (int64_t)maxLng - minLng > GEOFENCE_MAX_SPAN_E7)
+  {
+    _verts.resize(first);
+    *err = "zone too large";
+    return false;
+  }
+  if (!addZone(id, name, err))
+  {
+    _verts.resize(first);
+    return false;
+  }
+  Zone &z = _zones.back();
+  z.first = first;
+  z.count = (uint16_t)n;
+  z.minLat = minLat;
+  z.maxLat = maxLat;
+  z.minLng = minLng;
+  z.maxLng = maxLng;
+  return true;
+}
+
+void Geofence::clear()
+{
+  _zones.clear();
+  _verts.clear();
+  _names.clear();
+  _cellStart.clear();
+  _cellZones.clear();
+  _cur.clear();
+  _inside.clear();
+  _pending.clear();
+  _confirm.clear();
+  _rows = _cols = 0;
+  _worstWork = _lastWork = 0;
+  _coarsened = false;
+}
+
+// ---- 几何判断 ----
+
+// 射线法：向东的射线与各边的交点数为奇数则在内。差值用 64 位，叉乘不会溢出（区域边长有上限）
+bool Geofence::polygonContains(const Zone &z, int32_t lat, int32_t lng) const
+{
+  const Vertex *v = &_verts[z.first];
+  bool in = false;
+  for (uint16_t i = 0, j = z.count - 1; i < z.count; j = i++)
+  {
+    const Vertex &a = v[i];
+    const Vertex &b = v[j];
+    if ((a.lat > lat) != (b.lat > lat))
+    {
+      // 交点经度 a.lng + (b.lng - a.lng) * (lat - a.lat) / (b.lat - a.lat) 大于 lng 时计入
+      int64_t lhs = ((int64_t)lng - a.lng) * ((int64_t)b.lat - a.lat);
+      int64_t rhs = ((int64_t)b.lng - a.lng) * ((int64_t)lat - a.lat);
+      if (b.lat > a.lat ? lhs < rhs : lhs > rhs)
+        in = !in;
+    }
+  }
+  return in;
+}
+
+bool Geofence::contains(uint16_t zone, int32_t latE7, int32_t lngE7) const
+{
+  const Zone &z = _zones[zone];
+  if (latE7 < z.minLat || latE7 > z.maxLat || lngE7 < z.minLng || lngE7 > z.maxLng)
+    return false;
+  if (z.count)
+    return polygonContains(z, latE7, lngE7);
+  const Vertex &c = _verts[z.first];
+  int64_t dx = ((int64_t)lngE7 - c.lng) * z.cosQ15 >> 15;
+  int64_t dy = (int64_t)latE7 - c.lat;
+  return sq(dx) + sq(dy) <= (uint64_t)z.radiusE7 * z.radiusE7;
+}
+
+// 格子的闭矩形，右/上边与相邻格子重合：相邻格子的并集是连通的闭区域，
+// 区域边界若不碰到其中任何一格，这些格子内的点在区域内外的状态必然相同
+void Geofence::cellRect(uint16_t row, uint16_t col, int64_t &x0, int64_t &y0, int64_t &x1, int64_t &y1) const
+{
+  x0 = (int64_t)_minLng + (int64_t)col * _cellLng;
+  y0 = (int64_t)_minLat + (int64_t)row * _cellLat;
+  x1 = x0 + _cellLng;
+  y1 = y0 + _cellLat;
+}
+
+Geofence::CellClass Geofence::classifyCircle(const Zone &z, int64_t x0, int64_t y0, int64_t x1, int64_t y1) const
+{
+  const Vertex &c = _verts[z.first];
+  uint64_t r2 = (uint64_t)z.radiusE7 * z.radiusE7;
+  auto dist2 = [&](int64_t x, int64_t y) { return sq((x - c.lng) * z.cosQ15 >> 15) + sq(y - c.lat); };
+  // 格子中离圆心最近的点在圆外：整格在圆外；最远的角在圆内：整格在圆内
+  if (dist2(clamp64(c.lng, x0, x1), clamp64(c.lat, y0, y1)) > r2)
+    return OUTSIDE;
+  int64_t fx = c.lng - x0 > x1 - c.lng ? x0 : x1;
+  int64_t fy = c.lat - y0 > y1 - c.lat ? y0 : y1;
+  return dist2(fx, fy) <= r2 ? FULL : PARTIAL;
+}
+
+// 线段与闭矩形是否相交：外包矩形重叠，且矩形四角不全在线段所在直线的同一侧
+static bool segmentTouchesRect(int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t x0, int64_t y0, int64_t x1,
+                               int64_t y1)
+{
+  if ((ax > bx ? ax : bx) < x0 || (ax < bx ? ax : bx) > x1 || (ay > by ? ay : by) < y0 || (ay < by ? ay : by) > y1)
+    return false;
+  int64_t dx = bx - ax, dy = by - ay;
+  auto side = [&](int64_t x, int64_t y) {
+    int64_t c = dx * (y - ay) - dy * (x - ax);
+    return (c > 0) - (c < 0);
+  };
+  int s = side(x0, y0) + side(x1, y0) + side(x0, y1) + side(x1, y1);
+  return s != 4 && s != -4;
+}
+
+// 多边形覆盖的格子范围内：被边穿过的格子为 PARTIAL；其余格子按行分成连续段，
+// 每段内状态相同，只测段首格子的中心点
+void Geofence::classifyPolygon(const Zone &z, uint16_t r0, uint16_t c0, uint16_t r1, uint16_t c1,
+                               std::vector<uint8_t> &cls) const
+{
+  uint16_t w = c1 - c0 + 1;
+  uint16_t h = r1 - r0 + 1;
+  cls.assign((size_t)w * h, OUTSIDE);
+  const Vertex *v = &_verts[z.first];
+  for (uint16_t i = 0, j = z.count - 1; i < z.count; j = i++)
+  {
+    const Vertex &a = v[i];
+    const Vertex &b = v[j];
+    uint16_t er0 = (uint16_t)(((int64_t)(a.lat < b.lat ? a.lat : b.lat) - _minLat) / _cellLat);
+    uint16_t er1 = (uint16_t)(((int64_t)(a.lat > b.lat ? a.lat : b.lat) - _minLat) / _cellLat);
+    uint16_t ec0 = (uint16_t)(((int64_t)(a.lng < b.lng ? a.lng : b.lng) - _minLng) / _cellLng);
+    uint16_t ec1 = (uint16_t)(((int64_t)(a.lng > b.lng ? a.lng : b.lng) - _minLng) / _cellLng);
+    // 顶点恰在格线上时也可能碰到左/下方的格子
+    er0 = er0 > r0 ? er0 - 1 : r0;
+    ec0 = ec0 > c0 ? ec0 - 1 : c0;
+    for (uint16_t r = er0; r <= er1 && r <= r1; r++)
+    {
+      for (uint16_t c = ec0; c <= ec1 && c <= c1; c++)
+      {
+        uint8_t &k = cls[(size_t)(r - r0) * w + (c - c0)];
+        if (k == PARTIAL)
+          continue;
+        int64_t x0, y0, x1, y1;
+        cellRect(r, c, x0, y0, x1, y1);
+        if (segmentTouchesRect(a.lng, a.lat, b.lng, b.lat, x0, y0, x1, y1))
+          k = PARTIAL;
+      }
+    }
+  }
+  for (uint16_t r = 0; r < h; r++)
+  {
+    uint8_t *row = &cls[(size_t)r * w];
+    uint16_t c = 0;
+    while (c < w)
+    {
+      if (row[c] == PARTIAL)
+      {
+        c++;
+        continue;
+      }
+      uint16_t start = c;
+      while (c < w && row[c] != PARTIAL)
+        c++;
+      int64_t x0, y0, x1, y1;
+      cellRect(r0 + r, c0 + start, x0, y0, x1, y1);
+      bool in = polygonContains(z, (int32_t)((y0 + y1) / 2), (int32_t)((x0 + x1) / 2));
+      for (uint16_t k = start; k < c; k++)
+        row[k] = in ? FULL : OUTSIDE;
+    }
+  }
+}
+
+// ---- 网格索引 ----
+
+// 网格为 1 格时条目数等于区域数，放大格子总能满足上限
+static_assert(GEOFENCE_MAX_CELL_ENTRIES >= GEOFENCE_MAX_ZONES, "GEOFENCE_MAX_CELL_ENTRIES below GEOFENCE_MAX_ZONES");
+
+// 格子按实际距离取正方形，纬度方向边长不小于 cell，总数不超过 GEOFENCE_GRID_CELLS
+void Geofence::layoutGrid(int64_t cell, int64_t spanLat, int64_t spanLng, uint16_t cosLat)
+{
+  int64_t rows, cols, cellLng;
+  for (;;)
+  {
+    cellLng = clamp64(cell * 32768 / cosLat, 1, spanLng);
+    rows = (spanLat + cell - 1) / cell;
+    cols = (spanLng + cellLng - 1) / cellLng;
+    if (rows * cols <= GEOFENCE_GRID_CELLS)
+      break;
+    cell += cell / 8 + 1;
+  }
+  _cellLat = (uint32_t)cell;
+  _cellLng = (uint32_t)cellLng;
+  _rows = (uint16_t)rows;
+  _cols = (uint16_t)cols;
+}
+
+// 按区域顺序对每个与区域相交的格子调用 emit(格子下标, 条目)，条目为区域下标，整格在内时带 CELL_FULL
+template <typename F>
+void Geofence::scanCells(std::vector<uint8_t> &cls, F emit) const
+{
+  for (uint16_t i = 0; i < _zones.size(); i++)
+  {
+    const Zone &z = _zones[i];
+    uint16_t r0 = (uint16_t)(((int64_t)z.minLat - _minLat) / _cellLat);
+    uint16_t r1 = (uint16_t)(((int64_t)z.maxLat - _minLat) / _cellLat);
+    uint16_t c0 = (uint16_t)(((int64_t)z.minLng - _minLng) / _cellLng);
+    uint16_t c1 = (uint16_t)(((int64_t)z.maxLng - _minLng) / _cellLng);
+    uint16_t w = c1 - c0 + 1;
+    if (z.count)
+      classifyPolygon(z, r0, c0, r1, c1, cls);
+    for (uint16_t r = r0; r <= r1; r++)
+    {
+      for (uint16_t col = c0; col <= c1; col++)
+      {
+        uint8_t k;
+        if (z.count)
+          k = cls[(size_t)(r - r0) * w + (col - c0)];
+        else
+        {
+          int64_t x0, y0, x1, y1;
+          cellRect(r, col, x0, y0, x1, y1);
+          k = classifyCircle(z, x0, y0, x1, y1);
+        }
+        if (k != OUTSIDE)
+          emit((uint32_t)r * _cols + col, (uint16_t)(i | (k == FULL ? CELL_FULL : 0)));
+      }
+    }
+  }
+}
+
+void Geofence::build()
+{
+  size_t zones = _zones.size();
+  size_t words = (zones + 31) / 32;
+  _cur.assign(words, 0);
+  _inside.assign(words, 0);
+  _pending.assign(words, 0);
+  _confirm.assign(zones, 0);
+  _cellStart.clear();
+  _cellZones.clear();
+  _rows = _cols = 0;
+  _worstWork = 0;
+  _coarsened = false;
+  _zones.shrink_to_fit();
+  _verts.shrink_to_fit();
+  _names.shrink_to_fit();
+  if (zones == 0)
+    return;
+
+  int32_t minLat = _zones[0].minLat, maxLat = _zones[0].maxLat;
+  int32_t minLng = _zones[0].minLng, maxLng = _zones[0].maxLng;
+  for (const Zone &z : _zones)
+  {
+    minLat = z.minLat < minLat ? z.minLat : minLat;
+    maxLat = z.maxLat > maxLat ? z.maxLat : maxLat;
+    minLng = z.minLng < minLng ? z.minLng : minLng;
+    maxLng = z.maxLng > maxLng ? z.maxLng : maxLng;
+  }
+  _minLat = minLat;
+  _minLng = minLng;
+
+  // 格子数约为区域数的 4 倍，不超过 GEOFENCE_GRID_CELLS
+  int64_t spanLat = (int64_t)maxLat - minLat + 1;
+  int64_t spanLng = (int64_t)maxLng - minLng + 1;
+  uint16_t c = cosQ15((int32_t)(((int64_t)minLat + maxLat) / 2));
+  int64_t spanLngScaled = spanLng * c >> 15;
+  if (spanLngScaled < 1)
+    spanLngScaled = 1;
+  uint64_t target = zones * 4;
+  target = target < 64 ? 64 : (target > GEOFENCE_GRID_CELLS ? GEOFENCE_GRID_CELLS : target);
+  int64_t cell = (int64_t)geoIsqrt64((uint64_t)(spanLat * spanLngScaled) / target);
+  if (cell < 1)
+    cell = 1;
+
+  // 第一遍只按格子计数；条目总数超出上限时格子边长加倍后重数，确定后才分配条目数组
+  std::vector<uint8_t> cls;
+  size_t cells;
+  uint32_t entries;
+  for (;;)
+  {
+    layoutGrid(cell, spanLat, spanLng, c);
+    cells = (size_t)_rows * _cols;
+    _cellStart.assign(cells + 1, 0);
+    entries = 0;
+    scanCells(cls, [&](uint32_t i, uint16_t) {
+      _cellStart[i + 1]++;
+      entries++;
+    });
+    if (entries <= GEOFENCE_MAX_CELL_ENTRIES || cells == 1)
+      break;
+    _coarsened = true;
+    // 边长达到整个范围时只剩 1 格
+    int64_t span = spanLat > spanLng ? spanLat : spanLng;
+    cell = cell * 2 < span ? cell * 2 : span;
+  }
+  _cellStart.shrink_to_fit(); // 放大前的计数数组更大
+
+  // 计数累加为各格起始位置；第二遍按区域顺序填入，填完后 _cellStart[i] 指向下一格的起始，整体右移一位复原
+  for (size_t i = 0; i < cells; i++)
+    _cellStart[i + 1] += _cellStart[i];
+  _cellZones.resize(entries);
+  scanCells(cls, [&](uint32_t i, uint16_t e) { _cellZones[_cellStart[i]++] = e; });
+  memmove(&_cellStart[1], &_cellStart[0], cells * sizeof(uint32_t));
+  _cellStart[0] = 0;
+
+  for (size_t i = 0; i < cells; i++)
+  {
+    uint32_t work = 0;
+    for (uint32_t k = _cellStart[i]; k < _cellStart[i + 1]; k++)
+    {
+      uint16_t e = _cellZones[k];
+      const Zone &z = _zones[e & ~CELL_FULL];
+      work += 1 + ((e & CELL_FULL) ? 0 : (z.count ? z.count : 1));
+    }
+    _worstWork = work > _worstWork ? work : _worstWork;
+  }
+}
+
+uint8_t Geofence::update(int32_t latE7, int32_t lngE7, GeofenceEvent *events, uint8_t maxEvents)
+{
+  size_t words = _cur.size();
+  memset(_cur.data(), 0, words * sizeof(uint32_t));
+  _lastWork = 0;
+  if (_rows > 0 && latE7 >= _minLat && lngE7 >= _minLng)
+  {
+    uint32_t r = (uint32_t)((int64_t)latE7 - _minLat) / _cellLat;
+    uint32_t c = (uint32_t)((int64_t)lngE7 - _minLng) / _cellLng;
+    if (r < _rows && c < _cols)
+    {
+      uint32_t cell = r * _cols + c;
+      for (uint32_t k = _cellStart[cell]; k < _cellStart[cell + 1]; k++)
+      {
+        uint16_t e = _cellZones[k];
+        uint16_t i = e & ~CELL_FULL;
+        bool in = true;
+        if (!(e & CELL_FULL))
+        {
+          _lastWork += _zones[i].count ? _zones[i].count : 1;
+          in = contains(i, latE7, lngE7);
+        }
+        _lastWork++;
+        if (in)
+          _cur[i >> 5] |= 1u << (i & 31);
+      }
+    }
+  }
+
+  // 与已确认状态不同的区域累计连续次数，中途恢复原状态则清零
+  uint8_t n = 0;
+  for (size_t w = 0; w < words; w++)
+  {
+    uint32_t diff = _cur[w] ^ _inside[w];
+    uint32_t settled = _pending[w] & ~diff;
+    while (settled)
+    {
+      _confirm[w * 32 + __builtin_ctz(settled)] = 0;
+      settled &= settled - 1;
+    }
+    _pending[w] &= diff;
+    while (diff)
+    {
+      uint8_t b = __builtin_ctz(diff);
+      uint32_t bit = 1u << b;
+      diff &= diff - 1;
+      uint16_t i = (uint16_t)(w * 32 + b);
+      if (_confirm[i] < 0xFF)
+        _confirm[i]++;
+      if (_confirm[i] >= GEOFENCE_CONFIRM_FIXES && n < maxEvents)
+      {
+        _inside[w] ^= bit;
+        _pending[w] &= ~bit;
+        _confirm[i] = 0;
+        events[n].zone = i;
+        events[n].enter = (_inside[w] & bit) != 0;
+        n++;
+      }
+      else
+        _pending[w] |= bit;
+    }
+  }
+  return n;
+}
+
+uint16_t Geofence::insideCount() const
+{
+  uint16_t n = 0;
+  for (uint32_t w : _inside)
+    n += __builtin_popcount(w);
+  return n;
+}
+
+size_t Geofence::memoryBytes() const
+{
+  return _zones.capacity() * sizeof(Zone) + _verts.capacity() * sizeof(Vertex) + _names.capacity() +
+         _cellStart.capacity() * sizeof(uint32_t) + _cellZones.capacity() * sizeof(uint16_t) +
+         (_cur.capacity() + _inside.capacity() + _pending.capacity()) * sizeof(uint32_t) + _confirm.capacity();
+}
@@ -0,0 +1,137 @@
+#pragma once
+// 电子围栏：圆形和多边形区域（仓库、限速区等），开机从 LittleFS 读取定义。
+// 载入时在全部区域的外包矩形上建立均匀网格，每个格子记下与之相交的区域，并预先判定
+// “整个格子都在区域内”的情况。每个定位点只查所在的一个格子：整格在内的区域直接命中，
+// 只有边界穿过该格的区域才做点在圆/多边形内的测试。单点最坏代价（worstCaseWork()）在载入时算出，
+// 取决于最拥挤的一格：区域互不重叠时与区域总数无关，大区域层层重叠时随重叠层数增长，最多为全部区域。
+// 索引条目总数不超过 GEOFENCE_MAX_CELL_ENTRIES，超出时放大格子重建；update() 不分配内存。
+// 坐标为 1e-7 度整数，只用整数运算。多边形的边在经纬度平面上取直线，区域不能跨 180° 经线。
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#ifndef GEOFENCE_MAX_ZONES
+#define GEOFENCE_MAX_ZONES 1024
+#endif
+// 全部多边形顶点合计（每个 8 字节）
+#ifndef GEOFENCE_MAX_VERTICES
+#define GEOFENCE_MAX_VERTICES 8192
+#endif
+// 网格格子数上限（每格 4 字节索引）
+#ifndef GEOFENCE_GRID_CELLS
+#define GEOFENCE_GRID_CELLS 4096
+#endif
+// 网格索引条目总数上限（每条 2 字节）。条目数约为各区域覆盖的格子数之和，
+// 大区域相互重叠时可达格子数 × 区域数；建立前先计数，超出时放大格子直到不超过此值
+#ifndef GEOFENCE_MAX_CELL_ENTRIES
+#define GEOFENCE_MAX_CELL_ENTRIES 16384
+#endif
+// 进出状态须连续保持这么多次定位才确认，边界附近的抖动不会来回触发
+#ifndef GEOFENCE_CONFIRM_FIXES
+#define GEOFENCE_CONFIRM_FIXES 2
+#endif
+#define GEOFENCE_NAME_MAX 31
+// 单个区域的外包矩形边长上限（1e-7 度，约 1100 km），保证整数运算不溢出
+#define GEOFENCE_MAX_SPAN_E7 100000000
+
+struct GeofenceEvent
+{
+  uint16_t zone; // 区域下标，用 zoneId()/zoneName() 取编号和名称
+  bool enter;
+};
+
+class Geofence
+{
+public:
+  void clear();
+  // 按一行文本添加区域（格式见 README）：
+  //   编号,名称,circle,纬度,经度,半径米
+  //   编号,名称,poly,纬度1,经度1,纬度2,经度2,...
+  // 空行和 # 开头的注释行忽略并返回 true；出错返回 false，err 为原因
+  bool addLine(const char *line, const char **err);
+  bool addCircle(uint16_t id, const char *name, int32_t latE7, int32_t lngE7, uint32_t radiusCm, const char **err);
+  // latLngE7 依次为各顶点的纬度、经度，首尾自动闭合
+  bool addPolygon(uint16_t id, const char *name, const int32_t *latLngE7, uint16_t n, const char **err);
+  // 建立网格索引，之后才能 update()
+  void build();
+
+  // 输入新位置，返回本次确认的进出事件数（最多 maxEvents 个，其余留到下一次）
+  uint8_t update(int32_t latE7, int32_t lngE7, GeofenceEvent *events, uint8_t maxEvents);
+  // 点是否在区域内（不经过索引，用于对照）
+  bool contains(uint16_t zone, int32_t latE7, int32_t lngE7) const;
+  // 最近一次 update() 时点是否落在该区域内（未经确认的原始结果）
+  bool hit(uint16_t zone) const { return _cur[zone >> 5] & (1u << (zone & 31)); }
+
+  uint16_t zoneCount() const { return (uint16_t)_zones.size(); }
+  uint16_t zoneId(uint16_t zone) const { return _zones[zone].id; }
+  const char *zoneName(uint16_t zone) const { return &_names[_zones[zone].nameOff]; }
+  // 已确认在区域内
+  bool inside(uint16_t zone) const { return _inside[zone >> 5] & (1u << (zone & 31)); }
+  uint16_t insideCount() const;
+
+  uint16_t gridRows() const { return _rows; }
+  uint16_t gridCols() const { return _cols; }
+  uint32_t cellEntries() const { return (uint32_t)_cellZones.size(); }
+  // 条目数超出 GEOFENCE_MAX_CELL_ENTRIES，网格已放大
+  bool gridCoarsened() const { return _coarsened; }
+  // 单点代价上限：所在格子的候选区域数加上需要逐边测试的边数（圆计 1）
+  uint32_t worstCaseWork() const { return _worstWork; }
+  // 最近一次 update() 的实际代价，同上口径
+  uint32_t lastWork() const { return _lastWork; }
+  size_t memoryBytes() const;
+
+private:
+  struct Vertex
+  {
+    int32_t lat;
+    int32_t lng;
+  };
+  struct Zone
+  {
+    uint16_t id;
+    uint16_t nameOff;  // _names 中的偏移
+    uint32_t first;    // 多边形首顶点 / 圆心在 _verts 中的下标
+    uint16_t count;    // 多边形顶点数，0 表示圆
+    uint16_t cosQ15;   // 圆：圆心纬度的余弦（Q15），经度差乘以它换算为纬度方向的长度
+    uint32_t radiusE7; // 圆：半径（纬度方向 1e-7 度）
+    int32_t minLat, minLng, maxLat, maxLng;
+  };
+  enum CellClass : uint8_t
+  {
+    OUTSIDE,
+    PARTIAL,
+    FULL
+  };
+  // _cellZones 的最高位：整格在区域内
+  static const uint16_t CELL_FULL = 0x8000;
+
+  bool addZone(uint16_t id, const char *name, const char **err);
+  bool finishPolygon(uint16_t id, const char *name, uint32_t first, const char **err);
+  bool polygonContains(const Zone &z, int32_t lat, int32_t lng) const;
+  CellClass classifyCircle(const Zone &z, int64_t x0, int64_t y0, int64_t x1, int64_t y1) const;
+  void classifyPolygon(const Zone &z, uint16_t r0, uint16_t c0, uint16_t r1, uint16_t c1, std::vector<uint8_t> &cls) const;
+  void cellRect(uint16_t row, uint16_t col, int64_t &x0, int64_t &y0, int64_t &x1, int64_t &y1) const;
+  void layoutGrid(int64_t cell, int64_t spanLat, int64_t spanLng, uint16_t cosLat);
+  template <typename F>
+  void scanCells(std::vector<uint8_t> &cls, F emit) const;
+
+  std::vector<Zone> _zones;
+  std::vector<Vertex> _verts;
+  std::vector<char> _names;
+
+  // 网格：格子 (r, c) 的候选区域为 _cellZones[_cellStart[i] .. _cellStart[i+1])，i = r * _cols + c
+  int32_t _minLat = 0, _minLng = 0;
+  uint32_t _cellLat = 1, _cellLng = 1; // 格子边长（1e-7 度）
+  uint16_t _rows = 0, _cols = 0;
+  std::vector<uint32_t> _cellStart;
+  std::vector<uint16_t> _cellZones;
+  uint32_t _worstWork = 0;
+  uint32_t _lastWork = 0;
+  bool _coarsened = false;
+
+  // 每个区域一位：本次命中、已确认在内、状态变化待确认
+  std::vector<uint32_t> _cur;
+  std::vector<uint32_t> _inside;
+  std::vector<uint32_t> _pending;
+  std::vector<uint8_t> _confirm; // 待确认的连续次数
+};
@@ -0,0 +1,23 @@
+#pragma once
+// 与协议无关的定位快照：NMEA（TinyGPSPlus）和 UBX 解码器都填充此结构，
+// 网页、屏幕和文件写入只读取它。坐标为 1e-7 度整数，与 UBX 原始单位一致。
+#include <stdint.h>
+
+struct GpsFix
+{
+  int32_t latE7 = 0;      // 纬度，1e-7 度
+  int32_t lngE7 = 0;      // 经度，1e-7 度
+  int32_t altCm = 0;      // 海拔（平均海平面），厘米
+  uint32_t speedCmps = 0; // 地速，厘米/秒
+  uint16_t courseCdeg = 0; // 航向（正北为 0，顺时针），0.01 度
+  uint8_t satellites = 0;
+  uint16_t hdopX100 = 0; // 水平精度因子 ×100，0 表示未知
+  bool valid = false;
+
+  double lat() const { return latE7 * 1e-7; }
+  double lng() const { return lngE7 * 1e-7; }
+  double altMeters() const { return altCm * 0.01; }
+  double speedKmph() const { return speedCmps * 0.036; }
+  // 整数版本，供格式化使用（ESP32-C3 没有浮点单元）
+  uint32_t speedKmphX100() const { return (speedCmps * 36UL + 5) / 10; }
+};
@@ -0,0 +1,65 @@
+#pragma once
+// 单生产者/单消费者（SPSC）无锁环形缓冲区
+// 生产者：UART 事件任务（onReceive 回调）；消费者：loop() 中的 NMEA/UBX 解析。
+// 只依赖标准库，可直接在主机上编译，用于按线速回放 NMEA 数据做测试。
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+template <size_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+  // 可写入的字节数（仅生产者调用）
+  size_t freeSpace() const
+  {
+    return N - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+  }
+
+  // 可读取的字节数（仅消费者调用）
+  size_t available() const
+  {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+  }
+
+  // 写入最多 len 字节，返回实际写入数；缓冲区满时多余字节由调用方计为丢弃
+  size_t push(const uint8_t *data, size_t len)
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t room = N - (head - _tail.load(std::memory_order_acquire));
+    if (len > room)
+      len = room;
+    size_t idx = head & (N - 1);
+    size_t first = len < N - idx ? len : N - idx;
+    memcpy(_buf + idx, data, first);
+    memcpy(_buf, data + first, len - first);
+    _head.store(head + len, std::memory_order_release);
+    return len;
+  }
+
+  // 读出最多 maxLen 字节，返回实际读出数
+  size_t pop(uint8_t *out, size_t maxLen)
+  {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t len = _head.load(std::memory_order_acquire) - tail;
+    if (len > maxLen)
+      len = maxLen;
+    size_t idx = tail & (N - 1);
+    size_t first = len < N - idx ? len : N - idx;
+    memcpy(out, _buf + idx, first);
+    memcpy(out + first, _buf, len - first);
+    _tail.store(tail + len, std::memory_order_release);
+    return len;
+  }
+
+  static constexpr size_t capacity() { return N; }
+
+private:
+  uint8_t _buf[N];
+  // 读写索引单调递增，取模由掩码完成；两个索引各自只有一个写者
+  std::atomic<size_t> _head{0};
+  std::atomic<size_t> _tail{0};
+};
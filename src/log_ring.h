@@ -0,0 +1,76 @@
+#pragma once
+// 定长日志环：静态分配 LOG_RING_ENTRIES 行，每行带单调递增序号，
+// 追加时只做一次截断拷贝，不产生堆分配。/log?since=N 按序号增量读取。
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef LOG_RING_ENTRIES
+#define LOG_RING_ENTRIES 64
+#endif
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX 120
+#endif
+
+static_assert(LOG_LINE_MAX <= 256, "LOG_LINE_MAX must fit the uint8_t length field");
+
+class LogRing
+{
+public:
+  // 追加一行（超长截断），返回该行序号
+  uint32_t append(const char *msg, size_t len)
+  {
+    if (len > LOG_LINE_MAX - 1)
+      len = LOG_LINE_MAX - 1;
+    Entry &e = _entries[_next % LOG_RING_ENTRIES];
+    memcpy(e.text, msg, len);
+    e.text[len] = '\0';
+    e.len = (uint8_t)len;
+    return _next++;
+  }
+
+  // 下一行将使用的序号；客户端保存它作为下次请求的 since
+  uint32_t nextSeq() const { return _next; }
+  // 环中仍保留的最早序号
+  uint32_t oldestSeq() const { return _next > LOG_RING_ENTRIES ? _next - LOG_RING_ENTRIES : 0; }
+
+  // 依次访问序号 >= since 的行：fn(seq, text, len)
+  template <typename F>
+  void forEachSince(uint32_t since, F fn) const
+  {
+    uint32_t seq = since < oldestSeq() ? oldestSeq() : since;
+    for (; seq < _next; seq++)
+    {
+      const Entry &e = _entries[seq % LOG_RING_ENTRIES];
+      fn(seq, e.text, (size_t)e.len);
+    }
+  }
+
+  // 把 [seq, end) 范围内的行（每行以 \n 结尾）拷入 out，直到放不下为止；
+  // seq 前移到下一未拷贝的行，返回写入字节数。已被覆盖的行自动跳过。
+  size_t copySince(uint32_t &seq, uint32_t end, char *out, size_t size) const
+  {
+    if (seq < oldestSeq())
+      seq = oldestSeq();
+    size_t used = 0;
+    for (; seq < end && seq < _next; seq++)
+    {
+      const Entry &e = _entries[seq % LOG_RING_ENTRIES];
+      if (used + e.len + 1 > size)
+        break;
+      memcpy(out + used, e.text, e.len);
+      used += e.len;
+      out[used++] = '\n';
+    }
+    return used;
+  }
+
+private:
+  struct Entry
+  {
+    char text[LOG_LINE_MAX];
+    uint8_t len;
+  };
+  Entry _entries[LOG_RING_ENTRIES];
+  uint32_t _next = 0;
+};
@@ -0,0 +1,68 @@
+#include "loop_metrics.h"
+
+LoopMetrics loopMetrics;
+
+static const uint32_t BOUND_US[STAGE_BUCKETS] = {5,     10,    25,    50,     100,    250,    500,    1000,
+                                                 2500,  5000,  10000, 25000,  50000,  100000, 250000, 1000000};
+static const char *const BOUND_LABEL[STAGE_BUCKETS] = {"5e-06",  "1e-05",  "2.5e-05", "5e-05", "0.0001", "0.00025",
+                                                       "0.0005", "0.001",  "0.0025",  "0.005", "0.01",   "0.025",
+                                                       "0.05",   "0.1",    "0.25",    "1"};
+
+static const char *const STAGE_NAME[(uint8_t)Stage::Count] = {
+    "loop",      "gps_drain", "gps_parse", "gps_fix",   "pos_log", "filter",
+    "trip_write", "geofence", "housekeep", "wifi",    "display", "http"};
+
+void StageHistogram::record(uint32_t cycles, const uint32_t *bounds)
+{
+  uint8_t i = 0;
+  while (i < STAGE_BUCKETS && cycles > bounds[i])
+    i++;
+  _buckets[i]++;
+  _sumCycles += cycles;
+  if (cycles > _maxCycles)
+    _maxCycles = cycles;
+}
+
+uint32_t StageHistogram::count() const
+{
+  uint32_t n = 0;
+  for (uint8_t i = 0; i <= STAGE_BUCKETS; i++)
+    n += _buckets[i];
+  return n;
+}
+
+uint32_t StageHistogram::quantileCycles(uint8_t percent, const uint32_t *bounds) const
+{
+  uint32_t total = count();
+  if (total == 0)
+    return 0;
+  // 第一个累计数达到 total * percent% 的桶
+  uint32_t target = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < STAGE_BUCKETS; i++)
+  {
+    seen += _buckets[i];
+    if (seen >= target)
+      return bounds[i] < _maxCycles ? bounds[i] : _maxCycles;
+  }
+  return _maxCycles;
+}
+
+void LoopMetrics::begin()
+{
+  _cyclesPerUs = ESP.getCpuFreqMHz();
+  for (uint8_t i = 0; i < STAGE_BUCKETS; i++)
+    _boundCycles[i] = BOUND_US[i] * _cyclesPerUs;
+
+  // 用一个临时直方图测一次 StageTimer 的开销，/metrics 据此估算统计本身占 loop 的比例
+  StageHistogram probe;
+  const uint32_t rounds = 32;
+  uint32_t start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < rounds; i++)
+    probe.record(ESP.getCycleCount() - start, _boundCycles);
+  _recordCycles = (ESP.getCycleCount() - start) / rounds;
+}
+
+const char *LoopMetrics::stageName(Stage s) { return STAGE_NAME[(uint8_t)s]; }
+
+const char *LoopMetrics::boundLabel(uint8_t i) { return BOUND_LABEL[i]; }
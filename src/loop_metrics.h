@@ -0,0 +1,86 @@
+#pragma once
+// 主循环分段耗时统计：每个分段一个固定分桶直方图，用 CPU 周期计数器计时。
+// 记录一次只需读两次周期计数器、从低到高找桶（多数样本落在前几个桶）和几次加法，
+// 不加锁：每个分段只有一个写入任务，/metrics 读取时容忍个别计数不同步。
+#include <Arduino.h>
+
+// 分段可以嵌套：GpsDrain 包含 GpsParse/GpsFix，GpsFix 包含 PosLog/Filter/TripWrite/Geofence，
+// Loop 包含除 Http 以外的全部分段
+enum class Stage : uint8_t
+{
+  Loop,      // 一次 loop()，不含末尾的睡眠
+  GpsDrain,  // drainGps()，只统计取到数据的调用
+  GpsParse,  // 其中的解码部分：gps.encode()/ubx.feed()、串口回显、日志行拼接
+  GpsFix,    // onGpsFix()
+  PosLog,    // writePositionToFS()
+  Filter,    // trackFilter.update()
+  TripWrite, // writeTripData()
+  Geofence,  // checkGeofence()
+  Housekeep, // 补时间戳行、定时刷新 flash、SSE 推送
+  Wifi,      // wifiStep()
+  Display,   // 屏幕刷新
+  Http,      // 单个 HTTP 请求的处理（HTTP 任务）
+  Count
+};
+
+// 桶上界（微秒），另有一个溢出桶
+#define STAGE_BUCKETS 16
+
+class StageHistogram
+{
+public:
+  void record(uint32_t cycles, const uint32_t *bounds);
+
+  uint32_t bucket(uint8_t i) const { return _buckets[i]; } // i == STAGE_BUCKETS 为溢出桶
+  uint32_t count() const;
+  uint64_t sumCycles() const { return _sumCycles; }
+  uint32_t maxCycles() const { return _maxCycles; }
+  // 分位数所在桶的上界（周期），不超过最大值；无样本返回 0
+  uint32_t quantileCycles(uint8_t percent, const uint32_t *bounds) const;
+
+private:
+  uint32_t _buckets[STAGE_BUCKETS + 1] = {};
+  uint64_t _sumCycles = 0;
+  uint32_t _maxCycles = 0;
+};
+
+class LoopMetrics
+{
+public:
+  // 按 CPU 频率换算桶上界，并测量一次记录本身的开销
+  void begin();
+  void record(Stage s, uint32_t cycles) { _stages[(uint8_t)s].record(cycles, _boundCycles); }
+
+  const StageHistogram &stage(Stage s) const { return _stages[(uint8_t)s]; }
+  uint32_t quantileCycles(Stage s, uint8_t percent) const
+  {
+    return _stages[(uint8_t)s].quantileCycles(percent, _boundCycles);
+  }
+  uint32_t cyclesPerUs() const { return _cyclesPerUs; }
+  uint32_t recordCycles() const { return _recordCycles; }
+
+  static const char *stageName(Stage s);
+  static const char *boundLabel(uint8_t i); // Prometheus le 标签（秒）
+
+private:
+  StageHistogram _stages[(uint8_t)Stage::Count];
+  uint32_t _boundCycles[STAGE_BUCKETS] = {};
+  uint32_t _cyclesPerUs = 1;
+  uint32_t _recordCycles = 0;
+};
+
+extern LoopMetrics loopMetrics;
+
+// 作用域计时：构造时读周期计数器，析构时记入对应分段
+class StageTimer
+{
+public:
+  explicit StageTimer(Stage s) : _stage(s), _start(ESP.getCycleCount()) {}
+  ~StageTimer() { loopMetrics.record(_stage, ESP.getCycleCount() - _start); }
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+  Stage _stage;
+  uint32_t _start;
+};
@@ -7,6 +7,30 @@
 #include <LittleFS.h>
 #include <DNSServer.h>
 #include <ESPmDNS.h>
+#include "gps_ring.h"
+#include "gps_fix.h"
+#include "buffered_writer.h"
+#include "segment_log.h"
+#include "trip_format.h"
+#include "trip_stats.h"
+#include "trip_index.h"
+#include "geo_fixed.h"
+#include "track_filter.h"
+#include "track_simplify.h"
+#include "log_ring.h"
+#include "sse_hub.h"
+#include "display_fields.h"
+#include "loop_metrics.h"
+#include "scheduler.h"
+#include "sat_view.h"
+#include "geofence.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <unistd.h>
+#ifdef GPS_USE_UBX
+#include "ubx.h"
+#endif
 #ifdef USE_OLED_SCREEN
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
@@ -27,6 +51,20 @@ Adafruit_ST7735 tft(TFT_CS, TFT_DC, TFT_RST);
 // 定义 GPS 模块的 RX 和 TX 引脚（硬件串口）
 #define RX_PIN 0
 #define TX_PIN 1
+#ifndef GPS_BAUD
+#define GPS_BAUD 9600
+#endif
+// UBX 模式（-D GPS_USE_UBX）：开机后把模块切到更高波特率和导航频率，只输出二进制导航报文
+#ifndef GPS_UBX_BAUD
+#define GPS_UBX_BAUD 115200
+#endif
+#ifndef GPS_UBX_RATE_MS
+#define GPS_UBX_RATE_MS 200 // 5 Hz
+#endif
+// UART 驱动层接收缓冲区，需大于一次 HTTP 请求/屏幕刷新期间到达的数据量
+#ifndef GPS_UART_RX_BUFFER
+#define GPS_UART_RX_BUFFER 2048
+#endif
 
 // 创建 SoftwareSerial 和 TinyGPSPlus 对象
 // SoftwareSerial gpsSerial(RX_PIN, TX_PIN);
@@ -34,7 +72,39 @@ Adafruit_ST7735 tft(TFT_CS, TFT_DC, TFT_RST);
 HardwareSerial gpsSerial(1); // 使用硬件串口1
 
 TinyGPSPlus gps;
+#ifdef GPS_USE_UBX
+UbxDecoder ubx;
+#endif
+GpsFix gpsFix; // 当前定位，NMEA/UBX 两种模式共用
+SatView satView; // 可见卫星与 DOP：NMEA 模式解析 GSV/GSA，UBX 模式由 NAV-SVINFO/NAV-DOP 填充
+unsigned long lastSkyUpdateTime = 0;
+// 电子围栏：开机从 /geofence.txt 载入，之后只读；进出事件保存在最近事件环中
+#define GEOFENCE_PATH "/geofence.txt"
+#define GEOFENCE_LINE_MAX 1536    // 一行最长（多边形约 170 个顶点）
+#define GEOFENCE_EVENTS_PER_FIX 8 // 单个定位点最多确认的事件数，其余顺延到下一个点
+#define GEOFENCE_RECENT_EVENTS 16
+struct GeofenceRecent
+{
+  unsigned long ms;
+  uint16_t zone;
+  bool enter;
+};
+Geofence geofence;
+GeofenceRecent geofenceRecent[GEOFENCE_RECENT_EVENTS];
+uint32_t geofenceEventCount = 0; // 事件总数，也是状态 JSON 的 geo.seq
+// 平滑滤波（-D GPS_FILTER=0 关闭）：屏幕、网页和码表统计读取 gpsView，
+// 日志和码表文件仍记录原始 gpsFix。有效性以 gpsFix.valid 为准。
+#ifndef GPS_FILTER
+#define GPS_FILTER 1
+#endif
+TrackFilter trackFilter;
+GpsFix gpsView;
+// UART 事件任务写入、loop() 读出的 GPS 原始字节环形缓冲区
+SpscRing<4096> gpsRing;
+volatile uint32_t gpsRxOverflows = 0;  // UART FIFO/驱动缓冲区溢出次数
+volatile uint32_t gpsDroppedBytes = 0; // 环形缓冲区已满而丢弃的字节数
 WebServer server(80);
+SseHub sseHub; // /events 推送通道
 DNSServer dnsServer; // 用于Captive Portal
 
 #ifdef USE_OLED_SCREEN
@@ -44,14 +114,53 @@ DNSServer dnsServer; // 用于Captive Portal
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 #endif
 
-String logBuffer = "";
-String lineBuffer = "";
+LogRing logRing;        // 网页串口日志，定长环形存储
+char nmeaLine[100];     // 正在接收的 NMEA 语句（标准最长 82 字符）
+size_t nmeaLineLen = 0;
 
 // 码表相关变量
 bool tripActive = false;
 unsigned long tripStartTime = 0;
 unsigned long tripEndTime = 0;
 String tripFileName = "";
+unsigned long lastTripRowTime = 0; // 最近一次写入码表行的时间
+
+// GPS 位置日志分段循环存储：单段大小、总保留量（字节）和保留小时数（0 为不按时间淘汰）
+#ifndef GPSLOG_SEGMENT_BYTES
+#define GPSLOG_SEGMENT_BYTES 32768
+#endif
+#ifndef GPSLOG_MAX_BYTES
+#define GPSLOG_MAX_BYTES 262144
+#endif
+#ifndef GPSLOG_RETENTION_HOURS
+#define GPSLOG_RETENTION_HOURS 0
+#endif
+
+// 码表与位置日志保持文件常开，按大小/时间阈值批量刷新到 flash
+BufferedFileWriter tripWriter(5000);
+SegmentLog posLog("/gpslog", GPSLOG_SEGMENT_BYTES, GPSLOG_MAX_BYTES, GPSLOG_RETENTION_HOURS, 10000);
+TripEncoder tripEncoder;
+TripStats tripStats; // 当前码表的里程/时间/速度/爬升统计，每个定位点 O(1) 更新
+
+// 码表断电恢复：进行中的码表每隔 TRIP_CHECKPOINT_MS 刷新一次并写检查点，
+// 开机时据此续写同一文件（只需校验检查点之后的部分）
+#ifndef TRIP_CHECKPOINT_MS
+#define TRIP_CHECKPOINT_MS 30000
+#endif
+// 超过这么久没有新定位时补一条只有时间戳的码表行
+#define TRIP_GAP_MS 1000
+#define TRIP_CHECKPOINT_PATH "/state/trip.ckp"
+#define TRIP_CHECKPOINT_TMP "/state/trip.tmp"
+// LittleFS.begin() 默认的 VFS 挂载点，POSIX 接口需要带上它
+#define LITTLEFS_VFS_ROOT "/littlefs"
+uint32_t tripFileBase = 0; // 续写时文件的原有长度；加上 tripWriter.bytesWritten() 即已刷新的长度
+TripIndex tripIndex; // 下载列表用的码表文件索引，受 stateMutex 保护
+
+// 主循环作业（scheduler.h）：码表写入、定位和 WiFi 事件会提前或重新排期
+int8_t tripGapJob = -1;
+int8_t checkpointJob = -1;
+int8_t pushJob = -1;
+int8_t wifiJob = -1;
 
 // WiFi 配置相关变量
 #ifdef wifi_ssid
@@ -69,22 +178,69 @@ unsigned long wifiLostTime = 0;
 bool apModeActive = false;
 bool configModeActive = false;                   // 配置模式标志
 bool wifiRetrying = false;                       // WiFi重连状态标志
-unsigned long lastWifiRetryTime = 0;             // 上次尝试重连WiFi的时间
 const unsigned long WIFI_RETRY_INTERVAL = 60000; // 每60秒尝试重连一次WiFi
+const unsigned long WIFI_CONNECT_TIMEOUT = 30000; // 开机连接、掉线后切换AP的时限
+const unsigned long WIFI_RETRY_TIMEOUT = 15000;   // AP模式下单次重连的时限
+
+// WiFi 连接状态机：事件回调只置标志，由 loop() 中的 wifiStep() 推进，任何状态都不阻塞
+enum class WifiState : uint8_t
+{
+  Connecting, // 开机后首次连接
+  Connected,
+  Lost,       // STA 掉线，等待驱动自动重连
+  ApFallback, // 数据AP模式，定期发起重连
+  ApRetrying, // AP+STA，重连进行中
+  Config      // 配置门户
+};
+WifiState wifiState = WifiState::Connecting;
+unsigned long wifiStateSince = 0;
+volatile bool wifiGotIpEvent = false;
+volatile bool wifiDisconnectEvent = false;
 
 // GPS数据超时检测变量
 unsigned long lastGpsUpdateTime = 0;
 const unsigned long GPS_TIMEOUT_MS = 10000; // 10秒超时
 
-void addLog(const String &msg) {
-  logBuffer += msg + "<br>";
-  // 限制日志长度，避免内存溢出
-  if (logBuffer.length() > 3000) {
-    logBuffer = logBuffer.substring(logBuffer.length() - 3000);
+// HTTP 服务在独立任务中运行；它与 loop() 共享的状态（定位、码表、日志、推送）
+// 由这把递归互斥量保护。持锁区间只做内存操作，网络发送一律在锁外进行。
+SemaphoreHandle_t stateMutex = nullptr;
+TaskHandle_t httpTaskHandle = nullptr;
+
+// HTTP 任务的轮询间隔：处理过请求后的一段时间内（页面的后续资源、定时刷新成批到来）每 1 ms 查一次新连接，
+// 其余时间放慢到 HTTP_IDLE_POLL_MS，无人访问时每秒只醒 50 次；代价是空闲后第一个连接最多晚 20 ms 被接受
+#define HTTP_IDLE_POLL_MS 20
+#define HTTP_ACTIVE_WINDOW_MS 2000
+volatile unsigned long httpLastRequestMs = 0;
+uint64_t httpSleptUs = 0; // 只由 HTTP 任务写入
+uint32_t httpWakeups = 0;
+
+class StateLock
+{
+public:
+  StateLock()
+  {
+    if (stateMutex)
+      xSemaphoreTakeRecursive(stateMutex, portMAX_DELAY);
+  }
+  ~StateLock()
+  {
+    if (stateMutex)
+      xSemaphoreGiveRecursive(stateMutex);
   }
+};
+
+void addLog(const char *msg)
+{
+  StateLock lock;
+  logRing.append(msg, strlen(msg)); // 定长环形存储，不产生堆分配
   Serial.println(msg);
 }
 
+void addLog(const String &msg)
+{
+  addLog(msg.c_str());
+}
+
 void saveWifiConfig()
 {
   File f = LittleFS.open("/wifi.txt", "w");
@@ -96,6 +252,23 @@ void saveWifiConfig()
   }
 }
 
+// 定位的文本形式，全部为整数格式化，不经过软件浮点
+struct FixText
+{
+  char lat[16];
+  char lng[16];
+  char alt[16]; // 米，2 位小数
+  char spd[16]; // km/h，2 位小数
+};
+
+void formatFixText(const GpsFix &fix, FixText &t, uint8_t coordDecimals = 6)
+{
+  geoFormatE7(t.lat, sizeof(t.lat), fix.latE7, coordDecimals);
+  geoFormatE7(t.lng, sizeof(t.lng), fix.lngE7, coordDecimals);
+  formatFixed(t.alt, sizeof(t.alt), fix.altCm, 2);
+  formatFixed(t.spd, sizeof(t.spd), (int32_t)fix.speedKmphX100(), 2);
+}
+
 String gpsDataInnerHtml()
 {
   String html = "<div class='gps-data'>";
@@ -105,12 +278,14 @@ String gpsDataInnerHtml()
   unsigned long currentTime = millis();
   bool gpsTimeout = (lastGpsUpdateTime > 0) && (currentTime - lastGpsUpdateTime > GPS_TIMEOUT_MS);
 
-  if (gps.location.isValid() && !gpsTimeout)
+  if (gpsFix.valid && !gpsTimeout)
   {
-    html += "<p>纬度: <b>" + String(gps.location.lat(), 6) + "</b></p>";
-    html += "<p>经度: <b>" + String(gps.location.lng(), 6) + "</b></p>";
-    html += "<p>海拔: <b>" + String(gps.altitude.meters()) + " m</b></p>";
-    html += "<p>速度: <b>" + String(gps.speed.kmph()) + " km/h</b></p>";
+    FixText t;
+    formatFixText(gpsView, t);
+    html += "<p>纬度: <b>" + String(t.lat) + "</b></p>";
+    html += "<p>经度: <b>" + String(t.lng) + "</b></p>";
+    html += "<p>海拔: <b>" + String(t.alt) + " m</b></p>";
+    html += "<p>速度: <b>" + String(t.spd) + " km/h</b></p>";
     // 显示最后更新时间
     unsigned long timeSinceUpdate = currentTime - lastGpsUpdateTime;
     html += "<p style='color:#666;'>最后更新: <b>" + String(timeSinceUpdate / 1000) + " 秒前</b></p>";
@@ -125,431 +300,2093 @@ String gpsDataInnerHtml()
   {
     html += "<p style='color:#c00;'>等待 GPS 定位数据...</p>";
   }
+  if (tripActive)
+  {
+    unsigned long movingSecs = tripStats.movingMs() / 1000;
+    char dist[16], avg[16], top[16];
+    formatFixed(dist, sizeof(dist), (int32_t)((tripStats.distanceCm() + 500) / 1000), 2);
+    formatFixed(avg, sizeof(avg), (int32_t)((tripStats.avgSpeedCmps() * 36UL + 50) / 100), 1);
+    formatFixed(top, sizeof(top), (int32_t)((tripStats.maxSpeedCmps() * 36UL + 50) / 100), 1);
+    html += "<p>里程: <b>" + String(dist) + " km</b>, 运动时间: <b>" +
+            String(movingSecs / 60) + ":" + (movingSecs % 60 < 10 ? "0" : "") + String(movingSecs % 60) + "</b></p>";
+    html += "<p>平均/最高: <b>" + String(avg) + " / " + String(top) + " km/h</b>, 爬升/下降: <b>" +
+            String(tripStats.ascentCm() / 100) + " / " + String(tripStats.descentCm() / 100) + " m</b></p>";
+  }
+  if (gpsRxOverflows > 0 || gpsDroppedBytes > 0)
+  {
+    html += "<p style='color:#ff6600;'>串口溢出: <b>" + String(gpsRxOverflows) +
+            "</b> 次, 丢弃: <b>" + String(gpsDroppedBytes) + "</b> 字节</p>";
+  }
   html += "</div>";
-  html += "<div class='log-title'>串口日志</div>";
-  html += "<div class='log-box'>" + logBuffer + "</div>";
   return html;
 }
 
-void handleRoot() {
-  File f = LittleFS.open("/index.html", "r");
-  if (f)
-  {
-    String html = f.readString();
-    server.send(200, "text/html", html);
-    f.close();
-  }
-  else
+// FNV-1a，用作 ETag
+uint32_t fnv1a(const char *data, size_t len, uint32_t h = 2166136261u)
+{
+  for (size_t i = 0; i < len; i++)
   {
-    server.send(500, "text/plain", "index.html not found in LittleFS");
+    h = (h ^ (uint8_t)data[i]) * 16777619u;
   }
+  return h;
 }
 
-void handleStyle()
+// 静态资源 ETag：首次请求时对文件内容计算一次并缓存（资源只随 uploadfs 更新，之后会重启）
+const char *assetEtag(File &f, const String &path)
 {
-  File f = LittleFS.open("/style.css", "r");
-  if (f)
+  struct Entry
   {
-    String css = f.readString();
-    server.send(200, "text/css", css);
-    f.close();
+    String path;
+    char etag[12];
+  };
+  static Entry cache[8];
+  static size_t used = 0;
+  for (size_t i = 0; i < used; i++)
+  {
+    if (cache[i].path == path)
+    {
+      return cache[i].etag;
+    }
   }
-  else
+  uint32_t h = fnv1a(nullptr, 0);
+  uint8_t buf[256];
+  size_t n;
+  while ((n = f.read(buf, sizeof(buf))) > 0)
   {
-    server.send(404, "text/plain", "style.css not found");
+    h = fnv1a((const char *)buf, n, h);
   }
+  f.seek(0);
+  Entry &e = cache[used < 8 ? used++ : 7];
+  e.path = path;
+  snprintf(e.etag, sizeof(e.etag), "\"%08lx\"", (unsigned long)h);
+  return e.etag;
 }
 
-void handleScript()
+// 分块流式发送 LittleFS 中的网页资源；客户端接受 gzip 且存在 .gz 时发送压缩版本
+void serveAsset(const char *path, const char *contentType, const char *cacheControl)
 {
-  File f = LittleFS.open("/script.js", "r");
-  if (f)
+  String gzPath = String(path) + ".gz";
+  bool gzip = server.header("Accept-Encoding").indexOf("gzip") >= 0 && LittleFS.exists(gzPath);
+  String fsPath = gzip ? gzPath : String(path);
+  File f = LittleFS.open(fsPath, "r");
+  if (!f)
   {
-    String js = f.readString();
-    server.send(200, "application/javascript", js);
-    f.close();
+    server.send(404, "text/plain", String(path + 1) + " not found in LittleFS");
+    return;
+  }
+  const char *etag = assetEtag(f, fsPath);
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", cacheControl);
+  server.sendHeader("Vary", "Accept-Encoding");
+  if (server.header("If-None-Match") == etag)
+  {
+    server.send(304);
   }
   else
   {
-    server.send(404, "text/plain", "script.js not found");
+    // 文件名以 .gz 结尾时 streamFile 会自动加 Content-Encoding: gzip
+    server.streamFile(f, contentType);
   }
+  f.close();
+}
+
+// 页面每次重新验证（304 很便宜）；样式/脚本缓存一天，到期后凭 ETag 重新验证
+void handleRoot()
+{
+  serveAsset("/index.html", "text/html", "no-cache");
+}
+
+void handleStyle()
+{
+  serveAsset("/style.css", "text/css", "public, max-age=86400");
+}
+
+void handleScript()
+{
+  serveAsset("/script.js", "application/javascript", "public, max-age=86400");
 }
 
 void handleData()
 {
-  server.send(200, "text/html", gpsDataInnerHtml());
+  String html;
+  {
+    StateLock lock;
+    html = gpsDataInnerHtml();
+  }
+  server.send(200, "text/html", html);
 }
 
-void handleStartTrip()
+const char *wifiModeName()
 {
-  addLog("[DEBUG] handleStartTrip() called");
-  if (!tripActive)
+  if (apModeActive)
+    return "ap";
+  if (configModeActive)
+    return "config";
+  if (WiFi.status() == WL_CONNECTED)
+    return "sta";
+  return wifiLostTime > 0 ? "lost" : "connecting";
+}
+
+// 状态JSON缓冲区大小（SSE 帧另加事件名等约 24 字节，见 SSE_FRAME_MAX）
+#define STATE_JSON_MAX 768
+
+// 码表统计JSON：里程/海拔单位米，速度 km/h，时间单位秒
+size_t buildTripStatsJson(char *buf, size_t size)
+{
+  char dist[16], maxSpd[16], avgSpd[16], asc[16], desc[16];
+  formatFixed(dist, sizeof(dist), (int32_t)tripStats.distanceCm(), 2);
+  formatFixed(maxSpd, sizeof(maxSpd), (int32_t)((tripStats.maxSpeedCmps() * 36UL + 5) / 10), 2);
+  formatFixed(avgSpd, sizeof(avgSpd), (int32_t)((tripStats.avgSpeedCmps() * 36UL + 5) / 10), 2);
+  formatFixed(asc, sizeof(asc), (int32_t)tripStats.ascentCm(), 2);
+  formatFixed(desc, sizeof(desc), (int32_t)tripStats.descentCm(), 2);
+  int n = snprintf(buf, size,
+                   "{\"dist\":%s,\"moving\":%lu,\"stopped\":%lu,\"max\":%s,\"avg\":%s,\"asc\":%s,\"desc\":%s}",
+                   dist, (unsigned long)(tripStats.movingMs() / 1000), (unsigned long)(tripStats.stoppedMs() / 1000),
+                   maxSpd, avgSpd, asc, desc);
+  return n < 0 ? 0 : ((size_t)n < size ? n : size - 1);
+}
+
+// 把当前状态写成紧凑JSON，返回长度；只用栈上/静态缓冲区
+size_t buildStateJson(char *buf, size_t size)
+{
+  unsigned long now = millis();
+  bool gpsTimeout = (lastGpsUpdateTime > 0) && (now - lastGpsUpdateTime > GPS_TIMEOUT_MS);
+  unsigned long age = lastGpsUpdateTime > 0 ? (now - lastGpsUpdateTime) / 1000 : 0;
+  FixText t;
+  formatFixText(gpsView, t, 7);
+  IPAddress ip = apModeActive || configModeActive ? WiFi.softAPIP() : WiFi.localIP();
+  unsigned long tripSecs = tripActive ? (now - tripStartTime) / 1000 : 0;
+  char stats[160];
+  buildTripStatsJson(stats, sizeof(stats));
+  int n = snprintf(buf, size,
+                   "{\"valid\":%s,\"timeout\":%s,\"age\":%lu,"
+                   "\"fix\":{\"lat\":%s,\"lng\":%s,\"alt\":%s,\"spd\":%s,\"sats\":%u,\"hdop\":%u},"
+                   "\"trip\":{\"active\":%s,\"file\":\"%s\",\"secs\":%lu,\"stats\":%s},"
+                   "\"wifi\":{\"mode\":\"%s\",\"ip\":\"%u.%u.%u.%u\",\"retrying\":%s},"
+                   "\"uart\":{\"ovf\":%lu,\"drop\":%lu},"
+                   "\"geo\":{\"zones\":%u,\"inside\":%u,\"seq\":%lu}}",
+                   gpsFix.valid ? "true" : "false", gpsTimeout ? "true" : "false", age,
+                   t.lat, t.lng, t.alt, t.spd, gpsView.satellites, gpsView.hdopX100,
+                   tripActive ? "true" : "false", tripActive ? tripFileName.c_str() : "", tripSecs, stats,
+                   wifiModeName(), ip[0], ip[1], ip[2], ip[3], wifiRetrying ? "true" : "false",
+                   (unsigned long)gpsRxOverflows, (unsigned long)gpsDroppedBytes,
+                   geofence.zoneCount(), geofence.insideCount(), (unsigned long)geofenceEventCount);
+  return n < 0 ? 0 : ((size_t)n < size ? n : size - 1);
+}
+
+// 紧凑状态JSON；内容未变时按 If-None-Match 返回 304，不发正文
+void handleApiState()
+{
+  static char json[STATE_JSON_MAX];
+  size_t len;
   {
-    tripActive = true;
-    tripStartTime = millis();
-    time_t now = time(nullptr);
-    struct tm *tm_info = localtime(&now);
-    char buf[32];
-    strftime(buf, sizeof(buf), "/trip_%Y%m%d_%H%M%S.csv", tm_info);
-    tripFileName = String(buf);
-    File f = LittleFS.open(tripFileName, "w");
-    if (f)
-    {
-      // 写入标准码表CSV表头
-      f.println("timestamp,latitude,longitude,altitude,speed_kmph");
-      f.close();
-      addLog("[TRIP] Trip started: " + tripFileName);
-    }
-    else
-    {
-      addLog("[ERROR] Failed to create trip file");
-    }
-    server.send(200, "text/plain", "Trip started");
+    StateLock lock;
+    len = buildStateJson(json, sizeof(json));
   }
-  else
+  char etag[12];
+  snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)fnv1a(json, len));
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match") == etag)
   {
-    addLog("[DEBUG] handleStartTrip() called but tripActive already true");
-    server.send(200, "text/plain", "Trip already started");
+    server.send(304);
+    return;
   }
+  server.setContentLength(len);
+  server.send(200, "application/json", "");
+  server.sendContent(json, len);
 }
 
-void handleStopTrip()
+// 卫星视图JSON：sats 每项为 [PRN, 系统, 仰角, 方位角, 信噪比, 是否参与定位]，
+// 仰角/方位角未知时为 -1；DOP 为 0 表示未知
+#define SKY_JSON_MAX (160 + SAT_VIEW_MAX * 32)
+
+size_t buildSkyJson(char *buf, size_t size)
 {
-  if (tripActive)
+  const SatDop &dop = satView.dop();
+  char pdop[12], hdop[12], vdop[12];
+  formatFixed(pdop, sizeof(pdop), dop.pdopX100, 2);
+  formatFixed(hdop, sizeof(hdop), dop.hdopX100, 2);
+  formatFixed(vdop, sizeof(vdop), dop.vdopX100, 2);
+  unsigned long age = lastSkyUpdateTime > 0 ? (millis() - lastSkyUpdateTime) / 1000 : 0;
+  int n = snprintf(buf, size, "{\"age\":%lu,\"fix\":%u,\"pdop\":%s,\"hdop\":%s,\"vdop\":%s,\"used\":%u,\"sats\":[", age,
+                   dop.fixType, pdop, hdop, vdop, satView.usedCount());
+  for (uint8_t i = 0; i < satView.count() && n > 0 && (size_t)n < size; i++)
   {
-    tripActive = false;
-    tripEndTime = millis();
-    addLog("[TRIP] Trip ended: " + tripFileName);
-    server.send(200, "text/plain", "Trip stopped");
+    const SatInfo &sat = satView.at(i);
+    n += snprintf(buf + n, size - n, "%s[%u,\"%s\",%d,%d,%u,%u]", i ? "," : "", sat.prn, satSystemName(sat.system),
+                  sat.elevDeg, sat.azDeg == 0xFFFF ? -1 : sat.azDeg, sat.snr, sat.used ? 1 : 0);
   }
-  else
+  if (n > 0 && (size_t)n < size)
   {
-    server.send(200, "text/plain", "Trip not active");
+    n += snprintf(buf + n, size - n, "]}");
   }
+  return n < 0 ? 0 : ((size_t)n < size ? n : size - 1);
 }
 
-void writePositionToFS(double lat, double lng, double alt, double speed)
+// 天空图数据，同 /api/state 一样按内容生成 ETag
+void handleApiSky()
 {
-  File f = LittleFS.open("/gpslog.txt", "a");
-  if (f)
+  static char json[SKY_JSON_MAX];
+  size_t len;
   {
-    f.printf("%f,%f,%f,%f,%lu\n", lat, lng, alt, speed, millis());
-    f.close();
+    StateLock lock;
+    len = buildSkyJson(json, sizeof(json));
   }
-  else
+  char etag[12];
+  snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)fnv1a(json, len));
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match") == etag)
   {
-    addLog("[ERROR] Failed to open gpslog.txt for append");
+    server.send(304);
+    return;
   }
+  server.setContentLength(len);
+  server.send(200, "application/json", "");
+  server.sendContent(json, len);
 }
 
-void writeTripData(double lat, double lng, double alt, double speed)
+// 增量日志：返回序号 >= since 的行（每行一条），X-Log-Next 为下次请求的 since
+void handleLog()
 {
-  if (tripActive && tripFileName.length() > 0)
+  uint32_t seq = server.hasArg("since") ? strtoul(server.arg("since").c_str(), nullptr, 10) : 0;
+  uint32_t end;
+  {
+    StateLock lock;
+    end = logRing.nextSeq();
+  }
+  server.sendHeader("X-Log-Next", String(end));
+  server.sendHeader("Cache-Control", "no-store");
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; charset=utf-8", "");
+
+  // 分块：持锁拷贝一块，释放锁后再发送，避免慢客户端拖住 loop()
+  char out[512];
+  size_t outLen;
+  do
   {
-    File f = LittleFS.open(tripFileName, "a");
-    if (f)
     {
-      if (gps.location.isValid())
-      {
-        f.printf("%lu,%.6f,%.6f,%.2f,%.2f\n", millis(), lat, lng, alt, speed);
-        addLog("[TRIP] Data written to " + tripFileName + ": " +
-               String(lat, 6) + ", " + String(lng, 6) + ", " +
-               String(alt, 2) + " m, " + String(speed, 2) + " km/h");
-      }
-      else
-      {
-        f.printf("%lu,,,,\n", millis()); // 只写时间，其他为空
-        addLog("[TRIP] Invalid GPS data, only timestamp written to " + tripFileName);
-      }
-      f.close();
+      StateLock lock;
+      outLen = logRing.copySince(seq, end, out, sizeof(out));
     }
-  }
+    if (outLen > 0)
+    {
+      server.sendContent(out, outLen);
+    }
+  } while (outLen > 0);
+  server.sendContent(""); // 结束分块传输
 }
 
-void handleWifiConfig()
+// 广播当前状态；新定位、码表开始/结束、WiFi/超时状态变化时调用
+void publishState()
 {
-  String html = "<html><head><meta charset='utf-8'><title>WiFi配置</title>";
-  html += R"(
-  <style>
-    body { font-family: 'Segoe UI', Arial, sans-serif; background: #f4f6fa; }
-    .container { max-width: 400px; margin: 40px auto; background: #fff; border-radius: 10px; box-shadow: 0 2px 8px #0001; padding: 24px; }
-    h2 { color: #2a5d9f; }
-    label { display:block; margin: 12px 0 4px 0; }
-    input { width: 100%; padding: 8px; border-radius: 5px; border: 1px solid #bbb; margin-bottom: 12px; }
-    button { background: #2a5d9f; color: #fff; border: none; border-radius: 5px; padding: 10px 22px; font-size: 1em; cursor: pointer; width: 100%; }
-    button:hover { background: #17406b; }
-    .msg { color: #c00; margin: 10px 0; }
-  </style>
-  )";
-  html += "</head><body><div class='container'>";
-  html += "<h2>WiFi 配置</h2>";
-  html += "<form method='POST' action='/wifi_save'>";
-  html += "<label>WiFi名称(SSID)</label><input name='ssid' required>";
-  html += "<label>WiFi密码</label><input name='pass' type='password'>";
-  html += "<button type='submit'>保存并连接</button>";
-  html += "</form>";
-  html += "</div></body></html>";
-  server.send(200, "text/html", html);
+  if (sseHub.clientCount() == 0)
+  {
+    return;
+  }
+  static char json[STATE_JSON_MAX];
+  size_t len = buildStateJson(json, sizeof(json));
+  sseHub.publish("state", json, len);
+  scheduler.schedule(pushJob, 0);
 }
 
-void handleWifiSave()
+// 定位之外的状态（WiFi模式、GPS超时、码表）变化时推送一次
+void publishStateIfChanged()
 {
-#ifdef wifi_ssid
-  // 宏模式下不允许网页配置WiFi
-  server.send(403, "text/plain", "WiFi is hardcoded in firmware");
-#else
-  if (server.hasArg("ssid"))
-    wifiSsid = server.arg("ssid");
-  if (server.hasArg("pass"))
-    wifiPass = server.arg("pass");
-  wifiConfigured = true;
-  saveWifiConfig(); // 保存WiFi配置到LittleFS
-  String html = "<html><meta charset='utf-8'><body><h2>WiFi配置已保存，正在重启...</h2></body></html>";
-  server.send(200, "text/html", html);
-  delay(1000);
-  ESP.restart();
-#endif
+  static const char *lastMode = nullptr;
+  static uint8_t lastFlags = 0xFF;
+  bool gpsTimeout = (lastGpsUpdateTime > 0) && (millis() - lastGpsUpdateTime > GPS_TIMEOUT_MS);
+  const char *mode = wifiModeName();
+  uint8_t flags = (gpsTimeout ? 1 : 0) | (tripActive ? 2 : 0) | (wifiRetrying ? 4 : 0);
+  if (mode != lastMode || flags != lastFlags)
+  {
+    lastMode = mode;
+    lastFlags = flags;
+    publishState();
+  }
 }
 
-void tryLoadWifiConfig()
+// SSE：接管当前连接，之后由 sseHub 在 loop() 中推送
+void handleEvents()
 {
-#ifndef wifi_ssid
-  File f = LittleFS.open("/wifi.txt", "r");
-  if (f)
+  bool attached;
   {
-    wifiSsid = f.readStringUntil('\n');
-    wifiSsid.trim();
-    wifiPass = f.readStringUntil('\n');
-    wifiPass.trim();
-    wifiConfigured = wifiSsid.length() > 0;
-    f.close();
+    StateLock lock;
+    attached = sseHub.attach(server.client());
   }
-#endif
+  if (!attached)
+  {
+    server.send(503, "text/plain", "Too many event clients");
+    return;
+  }
+  // 只释放 WebServer 持有的引用，socket 由 sseHub 继续持有
+  server.client().stop();
 }
 
-
-#ifdef USE_OLED_SCREEN
-void updateOled()
+// 分块响应的输出缓冲（/metrics、/downloads、/geofence）：逐行追加，放不下时先发出当前块再重新格式化；
+// 单次输出超过整个缓冲时用临时堆内存整段发出，不截断
+struct ChunkedOut
 {
-  display.clearDisplay();
-  display.setTextColor(SSD1306_WHITE);
-  display.setTextSize(1);
-  display.setCursor(0, 0); // 显示WiFi状态
-  if (apModeActive)
+  char buf[1024];
+  size_t len = 0;
+
+  void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
   {
-    if (wifiRetrying)
+    va_list args, again;
+    va_start(args, fmt);
+    va_copy(again, args);
+    int n = vsnprintf(buf + len, sizeof(buf) - len, fmt, args);
+    va_end(args);
+    if (n >= 0 && (size_t)n >= sizeof(buf) - len)
     {
-      display.println("AP: Reconnecting...");
+      if (len > 0)
+      {
+        server.sendContent(buf, len);
+        len = 0;
+      }
+      if ((size_t)n < sizeof(buf))
+        vsnprintf(buf, sizeof(buf), fmt, again);
+      else
+      {
+        char *big = (char *)malloc((size_t)n + 1);
+        if (big)
+        {
+          vsnprintf(big, (size_t)n + 1, fmt, again);
+          server.sendContent(big, (size_t)n);
+          free(big);
+        }
+        else
+          addLog("[ERROR] Out of memory for chunked response line");
+        n = 0;
+      }
     }
-    else
+    va_end(again);
+    if (n > 0)
+      len += (size_t)n;
+  }
+};
+
+// 电子围栏状态：当前所在区域和最近的进出事件（age 为距今秒数，新的在前）。
+// 区域定义开机后不再变化，名称可在锁外读取；进出状态持锁拷贝
+void handleGeofence()
+{
+  static uint16_t inside[GEOFENCE_MAX_ZONES];
+  GeofenceRecent recent[GEOFENCE_RECENT_EVENTS];
+  uint16_t insideCount = 0;
+  uint8_t recentCount;
+  uint32_t total;
+  unsigned long now = millis();
+  {
+    StateLock lock;
+    for (uint16_t i = 0; i < geofence.zoneCount(); i++)
     {
-      display.println("AP: GPS-AP-Data");
+      if (geofence.inside(i))
+        inside[insideCount++] = i;
     }
-    display.println("Visit: 192.168.4.1");
+    total = geofenceEventCount;
+    recentCount = total < GEOFENCE_RECENT_EVENTS ? total : GEOFENCE_RECENT_EVENTS;
+    for (uint8_t i = 0; i < recentCount; i++)
+      recent[i] = geofenceRecent[(total - 1 - i) % GEOFENCE_RECENT_EVENTS];
   }
-  else if (configModeActive)
+
+  static ChunkedOut out;
+  out.len = 0;
+  server.sendHeader("Cache-Control", "no-store");
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  out.printf("{\"zones\":%u,\"grid\":[%u,%u],\"entries\":%lu,\"worst\":%lu,\"bytes\":%lu,\"seq\":%lu,\"inside\":[",
+             geofence.zoneCount(), geofence.gridRows(), geofence.gridCols(), (unsigned long)geofence.cellEntries(),
+             (unsigned long)geofence.worstCaseWork(), (unsigned long)geofence.memoryBytes(), (unsigned long)total);
+  for (uint16_t i = 0; i < insideCount; i++)
   {
-    display.println("Config Mode");
-    display.println("Visit: 192.168.4.1");
+    out.printf("%s{\"id\":%u,\"name\":\"%s\"}", i ? "," : "", geofence.zoneId(inside[i]),
+               geofence.zoneName(inside[i]));
   }
-  else if (WiFi.status() == WL_CONNECTED)
+  out.printf("],\"events\":[");
+  for (uint8_t i = 0; i < recentCount; i++)
   {
-    display.printf("WiFi: %s\n", WiFi.localIP().toString().c_str());
-    display.println("Visit: esp32gps.local");
+    const GeofenceRecent &e = recent[i];
+    out.printf("%s{\"age\":%lu,\"id\":%u,\"name\":\"%s\",\"enter\":%s}", i ? "," : "", (now - e.ms) / 1000,
+               geofence.zoneId(e.zone), geofence.zoneName(e.zone), e.enter ? "true" : "false");
   }
-  else
+  out.printf("]}");
+  server.sendContent(out.buf, out.len);
+  server.sendContent(""); // 结束分块传输
+}
+
+// 百万分之一为单位的整数 -> "整数.六位小数"，用于秒和比例，不经过浮点
+static void formatMicros(char *buf, size_t size, uint64_t micros)
+{
+  snprintf(buf, size, "%lu.%06lu", (unsigned long)(micros / 1000000), (unsigned long)(micros % 1000000));
+}
+
+// Prometheus 文本格式（0.0.4）：各分段耗时直方图、分位数和解析/串口/闪存/堆计数
+void handleMetrics()
+{
+  static ChunkedOut out;
+  out.len = 0;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; version=0.0.4", "");
+
+  const uint8_t stages = (uint8_t)Stage::Count;
+  const uint32_t cpu = loopMetrics.cyclesPerUs();
+  char v[24];
+
+  out.printf("# HELP gps_stage_seconds Time spent per main loop stage (stages nest, http runs in its own task)\n"
+             "# TYPE gps_stage_seconds histogram\n");
+  for (uint8_t s = 0; s < stages; s++)
   {
-    if (wifiLostTime > 0)
+    const char *name = LoopMetrics::stageName((Stage)s);
+    const StageHistogram &h = loopMetrics.stage((Stage)s);
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < STAGE_BUCKETS; i++)
     {
-      unsigned long disconnectTime = (millis() - wifiLostTime) / 1000;
-      display.printf("WiFi lost: %lus\n", disconnectTime);
-    }
-    else
-    {
-      display.println("WiFi: Connecting...");
+      cumulative += h.bucket(i);
+      out.printf("gps_stage_seconds_bucket{stage=\"%s\",le=\"%s\"} %lu\n", name, LoopMetrics::boundLabel(i),
+                 (unsigned long)cumulative);
     }
+    cumulative += h.bucket(STAGE_BUCKETS);
+    formatMicros(v, sizeof(v), h.sumCycles() / cpu);
+    out.printf("gps_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n"
+               "gps_stage_seconds_sum{stage=\"%s\"} %s\n"
+               "gps_stage_seconds_count{stage=\"%s\"} %lu\n",
+               name, (unsigned long)cumulative, name, v, name, (unsigned long)cumulative);
   }
 
-  // 检查GPS数据是否超时
-  unsigned long currentTime = millis();
-  bool gpsTimeout = (lastGpsUpdateTime > 0) && (currentTime - lastGpsUpdateTime > GPS_TIMEOUT_MS);
-  if (gps.location.isValid() && !gpsTimeout)
+  out.printf("# HELP gps_stage_quantile_seconds Upper bound of the histogram bucket holding the quantile\n"
+             "# TYPE gps_stage_quantile_seconds gauge\n");
+  for (uint8_t s = 0; s < stages; s++)
   {
-    // 第一行：简化的经纬度显示
-    display.setTextSize(1);
-    display.printf("%.4f,%.4f\n", gps.location.lat(), gps.location.lng());
-
-    // 第二行：高度
-    display.printf("Alt: %.0fm\n", gps.altitude.meters());
+    const char *name = LoopMetrics::stageName((Stage)s);
+    formatMicros(v, sizeof(v), loopMetrics.quantileCycles((Stage)s, 50) / cpu);
+    out.printf("gps_stage_quantile_seconds{stage=\"%s\",quantile=\"0.5\"} %s\n", name, v);
+    formatMicros(v, sizeof(v), loopMetrics.quantileCycles((Stage)s, 99) / cpu);
+    out.printf("gps_stage_quantile_seconds{stage=\"%s\",quantile=\"0.99\"} %s\n", name, v);
+  }
 
-    // 第三、四行：大字体显示速度
-    display.setTextSize(2);
-    display.setCursor(0, 32);
-    display.printf("%.1f", gps.speed.kmph());
+  out.printf("# HELP gps_stage_max_seconds Longest single run since boot\n"
+             "# TYPE gps_stage_max_seconds gauge\n");
+  uint64_t records = 0;
+  for (uint8_t s = 0; s < stages; s++)
+  {
+    const StageHistogram &h = loopMetrics.stage((Stage)s);
+    if ((Stage)s != Stage::Http)
+      records += h.count();
+    formatMicros(v, sizeof(v), h.maxCycles() / cpu);
+    out.printf("gps_stage_max_seconds{stage=\"%s\"} %s\n", LoopMetrics::stageName((Stage)s), v);
+  }
 
-    // 在速度数字右侧显示单位（小字体）
-    display.setTextSize(1);
-    display.setCursor(80, 40);
-    display.println("km/h");
+  // 统计本身的开销：记录次数 x 单次记录周期 / 开机以来的总周期
+  uint64_t elapsedCycles = (uint64_t)millis() * 1000 * cpu;
+  formatMicros(v, sizeof(v), elapsedCycles ? records * loopMetrics.recordCycles() * 1000000 / elapsedCycles : 0);
+  out.printf("# HELP gps_metrics_overhead_ratio Estimated share of CPU time spent recording these metrics\n"
+             "# TYPE gps_metrics_overhead_ratio gauge\n"
+             "gps_metrics_overhead_ratio %s\n",
+             v);
+
+  // 调度器：各作业的运行次数、迟到（开始时间 - 截止时间）和超期，主循环睡眠时间。
+  // 统计由主循环写入，这里不加锁读取，个别数值可能差一次运行
+  out.printf("# HELP gps_job_runs_total Scheduled main loop job runs\n"
+             "# TYPE gps_job_runs_total counter\n");
+  for (uint8_t j = 0; j < scheduler.jobCount(); j++)
+  {
+    out.printf("gps_job_runs_total{job=\"%s\"} %lu\n", scheduler.jobName(j),
+               (unsigned long)scheduler.jobStats(j).runs);
   }
-  else if (gpsTimeout)
+  out.printf("# HELP gps_job_lateness_seconds Start time minus deadline (jitter)\n"
+             "# TYPE gps_job_lateness_seconds summary\n");
+  for (uint8_t j = 0; j < scheduler.jobCount(); j++)
   {
-    unsigned long timeSinceUpdate = currentTime - lastGpsUpdateTime;
-    display.printf("GPS TIMEOUT!\n");
-    display.printf("No update: %lus\n", timeSinceUpdate / 1000);
-    display.println("Check connection");
+    const JobStats &st = scheduler.jobStats(j);
+    formatMicros(v, sizeof(v), st.lateSumUs);
+    out.printf("gps_job_lateness_seconds_sum{job=\"%s\"} %s\n"
+               "gps_job_lateness_seconds_count{job=\"%s\"} %lu\n",
+               scheduler.jobName(j), v, scheduler.jobName(j), (unsigned long)st.runs);
   }
-  else
+  out.printf("# TYPE gps_job_lateness_max_seconds gauge\n");
+  for (uint8_t j = 0; j < scheduler.jobCount(); j++)
   {
-    display.println("wait for signal");
+    formatMicros(v, sizeof(v), scheduler.jobStats(j).lateMaxUs);
+    out.printf("gps_job_lateness_max_seconds{job=\"%s\"} %s\n", scheduler.jobName(j), v);
   }
-
-  if (tripActive)
+  out.printf("# TYPE gps_job_run_max_seconds gauge\n");
+  for (uint8_t j = 0; j < scheduler.jobCount(); j++)
   {
-    display.setTextSize(1);
-    display.setCursor(0, 56);
-    display.print("Trip: ON");
+    formatMicros(v, sizeof(v), scheduler.jobStats(j).runMaxUs);
+    out.printf("gps_job_run_max_seconds{job=\"%s\"} %s\n", scheduler.jobName(j), v);
   }
-  else
+  out.printf("# HELP gps_job_overruns_total Periods skipped because the job started a full period late\n"
+             "# TYPE gps_job_overruns_total counter\n");
+  for (uint8_t j = 0; j < scheduler.jobCount(); j++)
   {
-    display.setTextSize(1);
-    display.setCursor(0, 56);
-    display.print("Trip: OFF");
+    out.printf("gps_job_overruns_total{job=\"%s\"} %lu\n", scheduler.jobName(j),
+               (unsigned long)scheduler.jobStats(j).overruns);
   }
-  display.display();
-}
+  formatMicros(v, sizeof(v), scheduler.sleptUs());
+  out.printf("# HELP gps_loop_sleep_seconds_total Time the main loop spent blocked waiting for a deadline or I/O\n"
+             "# TYPE gps_loop_sleep_seconds_total counter\ngps_loop_sleep_seconds_total %s\n",
+             v);
+  out.printf("# TYPE gps_loop_wakeups_total counter\ngps_loop_wakeups_total %lu\n", (unsigned long)scheduler.wakeups());
+  formatMicros(v, sizeof(v), httpSleptUs);
+  out.printf("# HELP gps_http_sleep_seconds_total Time the HTTP task spent blocked between handleClient() polls\n"
+             "# TYPE gps_http_sleep_seconds_total counter\ngps_http_sleep_seconds_total %s\n",
+             v);
+  out.printf("# TYPE gps_http_wakeups_total counter\ngps_http_wakeups_total %lu\n", (unsigned long)httpWakeups);
+
+#ifdef GPS_USE_UBX
+  out.printf("# TYPE gps_ubx_frames_total counter\ngps_ubx_frames_total %lu\n", (unsigned long)ubx.framesOk());
+  out.printf("# TYPE gps_ubx_checksum_errors_total counter\ngps_ubx_checksum_errors_total %lu\n",
+             (unsigned long)ubx.checksumErrors());
+#else
+  out.printf("# TYPE gps_nmea_chars_total counter\ngps_nmea_chars_total %lu\n", (unsigned long)gps.charsProcessed());
+  out.printf("# TYPE gps_nmea_checksum_passed_total counter\ngps_nmea_checksum_passed_total %lu\n",
+             (unsigned long)gps.passedChecksum());
+  out.printf("# TYPE gps_nmea_checksum_failed_total counter\ngps_nmea_checksum_failed_total %lu\n",
+             (unsigned long)gps.failedChecksum());
 #endif
-#ifdef USE_ST7735_SCREEN
-void updateSt7735()
-{
-  tft.fillScreen(ST77XX_BLACK);
-  tft.setTextColor(ST77XX_WHITE);
-  tft.setTextSize(1);
-  tft.setCursor(0, 0);
-
-  // 显示WiFi状态
-  if (apModeActive)
+  out.printf("# TYPE gps_sats_in_view gauge\ngps_sats_in_view %u\n"
+             "# TYPE gps_sats_used gauge\ngps_sats_used %u\n",
+             satView.count(), satView.usedCount());
+  out.printf("# TYPE gps_geofence_zones gauge\ngps_geofence_zones %u\n", geofence.zoneCount());
+  out.printf("# TYPE gps_geofence_inside gauge\ngps_geofence_inside %u\n", geofence.insideCount());
+  out.printf("# TYPE gps_geofence_events_total counter\ngps_geofence_events_total %lu\n",
+             (unsigned long)geofenceEventCount);
+  out.printf("# HELP gps_geofence_worst_case_work Upper bound of zone/edge tests for one fix\n"
+             "# TYPE gps_geofence_worst_case_work gauge\ngps_geofence_worst_case_work %lu\n",
+             (unsigned long)geofence.worstCaseWork());
+  out.printf("# TYPE gps_uart_overflows_total counter\ngps_uart_overflows_total %lu\n"
+             "# TYPE gps_uart_dropped_bytes_total counter\ngps_uart_dropped_bytes_total %lu\n"
+             "# TYPE gps_flash_written_bytes_total counter\ngps_flash_written_bytes_total %lu\n",
+             (unsigned long)gpsRxOverflows, (unsigned long)gpsDroppedBytes,
+             (unsigned long)BufferedFileWriter::totalBytesWritten());
+  out.printf("# TYPE gps_heap_free_bytes gauge\ngps_heap_free_bytes %lu\n"
+             "# TYPE gps_heap_min_free_bytes gauge\ngps_heap_min_free_bytes %lu\n",
+             (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap());
+  uint8_t sseClients;
+  uint32_t sseDropped, logBytes, logSegments, logRecycled;
   {
-    tft.setTextColor(ST77XX_YELLOW);
-    tft.println("AP: GPS-AP-Data");
-    tft.setTextColor(ST77XX_WHITE);
+    StateLock lock;
+    sseClients = sseHub.clientCount();
+    sseDropped = sseHub.droppedFrames();
+    logBytes = posLog.totalBytes();
+    logSegments = posLog.segmentCount();
+    logRecycled = posLog.recycled();
   }
-  else if (WiFi.status() == WL_CONNECTED)
+  out.printf("# TYPE gps_log_bytes gauge\ngps_log_bytes %lu\n"
+             "# TYPE gps_log_segments gauge\ngps_log_segments %lu\n"
+             "# TYPE gps_log_recycled_segments_total counter\ngps_log_recycled_segments_total %lu\n",
+             (unsigned long)logBytes, (unsigned long)logSegments, (unsigned long)logRecycled);
+  out.printf("# TYPE gps_sse_clients gauge\ngps_sse_clients %u\n"
+             "# TYPE gps_sse_dropped_frames_total counter\ngps_sse_dropped_frames_total %lu\n"
+             "# TYPE gps_uptime_seconds gauge\ngps_uptime_seconds %lu\n",
+             sseClients, (unsigned long)sseDropped, (unsigned long)(millis() / 1000));
+  server.sendContent(out.buf, out.len);
+  server.sendContent(""); // 结束分块传输
+}
+
+// 刷新码表文件并写检查点（调用方持有 StateLock）。先写临时文件再改名，
+// LittleFS 的改名是原子的，任何时刻掉电都只会留下旧的或新的完整检查点
+void writeTripCheckpoint()
+{
+  scheduler.schedule(checkpointJob, TRIP_CHECKPOINT_MS);
+  if (!tripWriter.flush())
   {
-    tft.setTextColor(ST77XX_GREEN);
-    tft.printf("WiFi: %s\n", WiFi.localIP().toString().c_str());
-    tft.setTextColor(ST77XX_WHITE);
+    return;
   }
-  else
+  TripCheckpoint ck;
+  strncpy(ck.fileName, tripFileName.c_str(), TRIP_CHECKPOINT_NAME_MAX);
+  ck.flushedBytes = tripFileBase + tripWriter.bytesWritten();
+  ck.lastTMs = lastTripRowTime - tripStartTime;
+  ck.stats = tripStats.totals();
+  uint8_t rec[TRIP_CHECKPOINT_SIZE];
+  tripCheckpointEncode(ck, rec);
+  File f = LittleFS.open(TRIP_CHECKPOINT_TMP, "w");
+  bool ok = f && f.write(rec, sizeof(rec)) == sizeof(rec);
+  f.close();
+  if (!ok || !LittleFS.rename(TRIP_CHECKPOINT_TMP, TRIP_CHECKPOINT_PATH))
   {
-    tft.setTextColor(ST77XX_RED);
-    if (wifiLostTime > 0)
-    {
-      unsigned long disconnectTime = (millis() - wifiLostTime) / 1000;
-      tft.printf("WiFi 断开: %lus\n", disconnectTime);
-    }
+    addLog("[ERROR] Failed to write trip checkpoint");
+    return;
+  }
+  // 检查点之后的第一个点写关键帧：恢复时尾部可以独立解码并补入统计
+  tripEncoder.reset();
+}
+
+// 开始码表，返回给客户端的提示（调用方持有 StateLock）
+const char *startTrip()
+{
+  addLog("[DEBUG] handleStartTrip() called");
+  if (!tripActive)
+  {
+    tripActive = true;
+    tripStartTime = millis();
+    time_t now = time(nullptr);
+    struct tm *tm_info = localtime(&now);
+    char buf[32];
+    strftime(buf, sizeof(buf), "/trip_%Y%m%d_%H%M%S.bin", tm_info);
+    tripFileName = String(buf);
+    if (tripWriter.open(LittleFS, tripFileName, "w"))
+    {
+      // 写入二进制文件头，立即刷新以便文件列表中可见；下载时再转换为CSV/GPX
+      TripHeader header;
+      header.startEpoch = (uint32_t)now;
+      header.startMillis = tripStartTime;
+      uint8_t hdr[TRIP_HEADER_SIZE];
+      tripWriter.write(hdr, tripWriteHeader(header, hdr));
+      tripWriter.flush();
+      tripEncoder.reset();
+      tripStats.reset();
+      lastTripRowTime = millis();
+      scheduler.schedule(tripGapJob, TRIP_GAP_MS + 1);
+      tripFileBase = 0;
+      writeTripCheckpoint();
+      TripIndexEntry e;
+      strncpy(e.name, tripFileName.c_str(), TRIP_INDEX_NAME_MAX);
+      e.size = TRIP_HEADER_SIZE;
+      e.startEpoch = header.startEpoch;
+      e.active = true;
+      tripIndex.put(e);
+      addLog("[TRIP] Trip started: " + tripFileName);
+    }
     else
     {
-      tft.println("WiFi: 连接中...");
+      addLog("[ERROR] Failed to create trip file");
+    }
+    return "Trip started";
+  }
+  else
+  {
+    addLog("[DEBUG] handleStartTrip() called but tripActive already true");
+    return "Trip already started";
+  }
+}
+
+// 码表结束时把统计写成与 .bin 同名的 .json，下载列表中可直接查看
+void writeTripSummary()
+{
+  char stats[160];
+  size_t len = buildTripStatsJson(stats, sizeof(stats));
+  String path = tripFileName.substring(0, tripFileName.length() - 4) + ".json";
+  File f = LittleFS.open(path, "w");
+  if (!f)
+  {
+    addLog("[ERROR] Failed to write trip summary " + path);
+    return;
+  }
+  f.write((const uint8_t *)stats, len);
+  f.close();
+  addLog("[TRIP] Summary: " + String(stats));
+}
+
+const char *stopTrip()
+{
+  if (tripActive)
+  {
+    tripActive = false;
+    tripEndTime = millis();
+    tripWriter.close();
+    scheduler.cancel(tripGapJob);
+    scheduler.cancel(checkpointJob);
+    LittleFS.remove(TRIP_CHECKPOINT_PATH);
+    writeTripSummary();
+    if (TripIndexEntry *e = tripIndex.find(tripFileName))
+    {
+      e->size = tripFileBase + tripWriter.bytesWritten();
+      e->durationS = (lastTripRowTime - tripStartTime) / 1000;
+      e->active = false;
+      e->summary = true;
+      tripIndex.touch();
+    }
+    // 原方案每行一次 open/append/close，现在每次刷新才提交一次
+    addLog("[TRIP] Trip ended: " + tripFileName + " (" + String(tripWriter.records()) +
+           " rows, " + String(tripWriter.bytesWritten()) + " bytes, " +
+           String(tripWriter.flushes()) + " flushes, saved " +
+           String(tripWriter.records() - tripWriter.flushes()) + " commits)");
+    publishState();
+    return "Trip stopped";
+  }
+  else
+  {
+    return "Trip not active";
+  }
+}
+
+void handleStartTrip()
+{
+  const char *reply;
+  {
+    StateLock lock;
+    reply = startTrip();
+  }
+  server.send(200, "text/plain", reply);
+}
+
+void handleStopTrip()
+{
+  const char *reply;
+  {
+    StateLock lock;
+    reply = stopTrip();
+  }
+  server.send(200, "text/plain", reply);
+}
+
+void writePositionToFS(const GpsFix &fix)
+{
+  StageTimer timer(Stage::PosLog);
+  // 段打开失败时 SegmentLog::write() 只重试打开当前段，不重新扫描目录；错误每分钟最多记一次
+  static unsigned long lastErrorLog = 0;
+  FixText t;
+  formatFixText(fix, t);
+  if (!posLog.printf("%s,%s,%s,%s,%lu\n", t.lat, t.lng, t.alt, t.spd, millis()) &&
+      (lastErrorLog == 0 || millis() - lastErrorLog >= 60000))
+  {
+    lastErrorLog = millis();
+    addLog("[ERROR] Failed to append to gpslog segment");
+  }
+}
+
+// 追加一个码表点，gpsFix 无效时只记录时间戳
+void appendTripPoint(const GpsFix &fix, bool valid)
+{
+  TripPoint p;
+  p.tMs = lastTripRowTime - tripStartTime;
+  p.valid = valid;
+  if (valid)
+  {
+    // 1e-7 度四舍五入到微度
+    p.latE6 = (fix.latE7 + (fix.latE7 >= 0 ? 5 : -5)) / 10;
+    p.lngE6 = (fix.lngE7 + (fix.lngE7 >= 0 ? 5 : -5)) / 10;
+    p.altCm = fix.altCm;
+    p.speedCmps = fix.speedCmps > 0xFFFF ? 0xFFFF : fix.speedCmps;
+  }
+  uint8_t rec[TRIP_MAX_RECORD];
+  tripWriter.write(rec, tripEncoder.encode(p, rec));
+}
+
+void writeTripData(const GpsFix &fix)
+{
+  if (tripActive && tripWriter.isOpen())
+  {
+    StageTimer timer(Stage::TripWrite);
+    lastTripRowTime = millis();
+    scheduler.schedule(tripGapJob, TRIP_GAP_MS + 1);
+    appendTripPoint(fix, true);
+    FixText t;
+    formatFixText(fix, t);
+    addLog("[TRIP] Data written to " + tripFileName + ": " + t.lat + ", " + t.lng + ", " + t.alt + " m, " +
+           t.spd + " km/h");
+  }
+}
+
+// 超过1秒没有新定位时只写时间戳，其他为空，保持每秒至少一行
+void writeTripGap()
+{
+  if (tripActive && tripWriter.isOpen())
+  {
+    lastTripRowTime = millis();
+    scheduler.schedule(tripGapJob, TRIP_GAP_MS + 1);
+    appendTripPoint(gpsFix, false);
+    tripStats.addGap();
+    addLog("[TRIP] No GPS fix, only timestamp written to " + tripFileName);
+  }
+}
+
+// Arduino FS 没有截断接口，经由 VFS 挂载点调用 POSIX truncate()
+bool truncateLittleFsFile(const String &path, uint32_t len)
+{
+  return truncate((LITTLEFS_VFS_ROOT + path).c_str(), len) == 0;
+}
+
+// 把检查点之后 [from, to) 范围内的记录补入码表统计，返回补入的定位点数。
+// 记录中是原始定位（微度），运行时统计用的是滤波后的位置，补入部分的里程可能略有差别。
+// 旧文件的检查点后不一定紧跟关键帧，第一个关键帧之前的增量无法解码，只能略过
+uint32_t replayTripTail(const String &fn, uint32_t from, uint32_t to)
+{
+  File f = LittleFS.open(fn, "r");
+  if (!f || !f.seek(from))
+  {
+    f.close();
+    return 0;
+  }
+  TripDecoder decoder;
+  uint8_t slots[32 * TRIP_SLOT_SIZE];
+  uint32_t pos = from, replayed = 0;
+  while (pos < to)
+  {
+    size_t want = to - pos < sizeof(slots) ? to - pos : sizeof(slots);
+    size_t n = f.read(slots, want);
+    if (n < TRIP_SLOT_SIZE)
+      break;
+    for (size_t off = 0; off + TRIP_SLOT_SIZE <= n; off += TRIP_SLOT_SIZE)
+    {
+      TripPoint p;
+      if (decoder.decodeSlot(slots + off, p) != 1)
+        continue;
+      if (!p.valid)
+      {
+        tripStats.addGap();
+        continue;
+      }
+      GpsFix fix;
+      fix.latE7 = p.latE6 * 10;
+      fix.lngE7 = p.lngE6 * 10;
+      fix.altCm = p.altCm;
+      fix.speedCmps = p.speedCmps;
+      fix.valid = true;
+      tripStats.addFix(fix, p.tMs);
+      replayed++;
+    }
+    pos += n;
+  }
+  f.close();
+  return replayed;
+}
+
+// 开机时恢复未结束的码表：校验检查点之后写入的尾部，截掉不完整的记录后续写同一文件，
+// 尾部的定位点补入统计。检查点之前的内容不再读取，恢复耗时只与一个检查点间隔的数据量有关
+void resumeTrip()
+{
+  File ckf = LittleFS.open(TRIP_CHECKPOINT_PATH, "r");
+  if (!ckf)
+  {
+    return;
+  }
+  uint8_t rec[TRIP_CHECKPOINT_SIZE];
+  size_t n = ckf.read(rec, sizeof(rec));
+  ckf.close();
+  TripCheckpoint ck;
+  if (n != sizeof(rec) || !tripCheckpointDecode(rec, ck))
+  {
+    addLog("[WARN] Trip checkpoint corrupt, not resuming");
+    LittleFS.remove(TRIP_CHECKPOINT_PATH);
+    return;
+  }
+  String fn = ck.fileName;
+  File f = LittleFS.open(fn, "r");
+  uint8_t hdr[TRIP_HEADER_SIZE];
+  TripHeader header;
+  if (!f || f.read(hdr, sizeof(hdr)) != sizeof(hdr) || !tripReadHeader(hdr, header))
+  {
+    addLog("[WARN] Trip file " + fn + " missing or invalid, not resuming");
+    f.close();
+    LittleFS.remove(TRIP_CHECKPOINT_PATH);
+    return;
+  }
+  uint32_t size = f.size();
+  uint32_t start = ck.flushedBytes;
+  if (start < TRIP_HEADER_SIZE || start > size)
+  {
+    // 文件比检查点记录的还短：无法确定记录边界，退回到槽位边界续写
+    start = TRIP_HEADER_SIZE + (size - TRIP_HEADER_SIZE) / TRIP_SLOT_SIZE * TRIP_SLOT_SIZE;
+    addLog("[WARN] Trip file shorter than checkpoint: " + String(size) + " < " + String(ck.flushedBytes));
+  }
+  TripTailScanner tail(start, ck.lastTMs);
+  f.seek(start);
+  uint8_t slots[32 * TRIP_SLOT_SIZE];
+  bool intact = true;
+  while (intact && (n = f.read(slots, sizeof(slots))) >= TRIP_SLOT_SIZE)
+  {
+    for (size_t off = 0; intact && off + TRIP_SLOT_SIZE <= n; off += TRIP_SLOT_SIZE)
+    {
+      intact = tail.feedSlot(slots + off);
+    }
+  }
+  f.close();
+
+  if (tail.validEnd() < size)
+  {
+    if (!truncateLittleFsFile(fn, tail.validEnd()))
+    {
+      addLog("[ERROR] Failed to truncate torn tail of " + fn + ", not resuming");
+      LittleFS.remove(TRIP_CHECKPOINT_PATH);
+      return;
+    }
+    addLog("[WARN] Trip tail truncated: " + String(size) + " -> " + String(tail.validEnd()) + " bytes");
+  }
+  if (!tripWriter.open(LittleFS, fn, "a"))
+  {
+    addLog("[ERROR] Failed to reopen trip file " + fn);
+    return;
+  }
+  tripActive = true;
+  tripFileName = fn;
+  tripFileBase = tail.validEnd();
+  // 没有 RTC，断电时长无从得知：时间轴从最后一条记录接着走，并写一条无定位记录标出中断，
+  // 下一个定位点会写关键帧
+  tripStartTime = millis() - tail.lastTMs();
+  tripEncoder.reset();
+  tripStats.restore(ck.stats);
+  uint32_t replayed = replayTripTail(fn, start, tail.validEnd());
+  writeTripGap();
+  writeTripCheckpoint();
+  addLog("[TRIP] Trip resumed: " + fn + " (" + String(tail.validEnd()) + " bytes, checked " +
+         String(tail.validEnd() - start) + " bytes after checkpoint, " + String(replayed) + " points added to stats)");
+}
+
+// UART 事件任务回调：一次搬走驱动缓冲区内所有待读字节，放入环形缓冲区
+void onGpsUartReceive()
+{
+  uint8_t buf[128];
+  size_t n;
+  while ((n = gpsSerial.available()) > 0)
+  {
+    if (n > sizeof(buf))
+    {
+      n = sizeof(buf);
+    }
+    n = gpsSerial.read(buf, n);
+    size_t pushed = gpsRing.push(buf, n);
+    if (pushed < n)
+    {
+      gpsDroppedBytes += n - pushed;
+    }
+  }
+  scheduler.wake();
+}
+
+void onGpsUartError(hardwareSerial_error_t err)
+{
+  if (err == UART_FIFO_OVF_ERROR || err == UART_BUFFER_FULL_ERROR)
+  {
+    gpsRxOverflows++;
+  }
+}
+
+// 开机载入电子围栏定义，逐行解析，出错的行跳过并记录日志
+void loadGeofence()
+{
+  File f = LittleFS.open(GEOFENCE_PATH, "r");
+  if (!f)
+  {
+    return;
+  }
+  unsigned long start = millis();
+  static char line[GEOFENCE_LINE_MAX];
+  uint8_t chunk[256];
+  size_t len = 0, n;
+  bool tooLong = false;
+  uint16_t lineNo = 0, errors = 0;
+  auto endLine = [&]() {
+    line[len] = '\0';
+    lineNo++;
+    const char *err = "line too long";
+    if (tooLong || !geofence.addLine(line, &err))
+    {
+      if (++errors <= 5)
+      {
+        addLog("[GEOFENCE] " GEOFENCE_PATH " line " + String(lineNo) + ": " + err);
+      }
+    }
+    len = 0;
+    tooLong = false;
+  };
+  geofence.clear();
+  while ((n = f.read(chunk, sizeof(chunk))) > 0)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      if (chunk[i] == '\n')
+        endLine();
+      else if (len < sizeof(line) - 1)
+        line[len++] = (char)chunk[i];
+      else
+        tooLong = true;
+    }
+  }
+  if (len > 0)
+  {
+    endLine();
+  }
+  f.close();
+  geofence.build();
+  char msg[160];
+  snprintf(msg, sizeof(msg), "[GEOFENCE] %u zones (%u bad lines), grid %ux%u, %lu entries, worst %lu, %lu bytes, %lu ms",
+           geofence.zoneCount(), errors, geofence.gridRows(), geofence.gridCols(),
+           (unsigned long)geofence.cellEntries(), (unsigned long)geofence.worstCaseWork(),
+           (unsigned long)geofence.memoryBytes(), millis() - start);
+  addLog(msg);
+  if (geofence.gridCoarsened())
+  {
+    // 大区域重叠过多，按默认格子大小建索引会超出内存上限；查询仍然正确，只是每点代价更高
+    addLog("[GEOFENCE] Zones overlap heavily, grid coarsened to stay within " +
+           String(GEOFENCE_MAX_CELL_ENTRIES) + " cell entries");
+  }
+}
+
+// 用平滑后的位置判断进出区域；确认的事件记入最近事件、日志，码表进行中时写入码表
+void checkGeofence()
+{
+  if (geofence.zoneCount() == 0)
+  {
+    return;
+  }
+  StageTimer timer(Stage::Geofence);
+  GeofenceEvent events[GEOFENCE_EVENTS_PER_FIX];
+  uint8_t n = geofence.update(gpsView.latE7, gpsView.lngE7, events, GEOFENCE_EVENTS_PER_FIX);
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < n; i++)
+  {
+    const GeofenceEvent &e = events[i];
+    geofenceRecent[geofenceEventCount % GEOFENCE_RECENT_EVENTS] = {now, e.zone, e.enter};
+    geofenceEventCount++;
+    char msg[80];
+    snprintf(msg, sizeof(msg), "[GEOFENCE] %s zone %u (%s)", e.enter ? "Enter" : "Exit", geofence.zoneId(e.zone),
+             geofence.zoneName(e.zone));
+    addLog(msg);
+    if (tripActive && tripWriter.isOpen())
+    {
+      TripZoneEvent ze;
+      ze.tMs = now - tripStartTime;
+      ze.zoneId = geofence.zoneId(e.zone);
+      ze.enter = e.enter;
+      uint8_t rec[TRIP_SLOT_SIZE];
+      tripWriter.write(rec, TripEncoder::encodeZoneEvent(ze, rec));
+    }
+  }
+}
+
+// 新定位到达：记录日志并写入LittleFS
+void onGpsFix()
+{
+  StageTimer timer(Stage::GpsFix);
+  lastGpsUpdateTime = millis(); // 记录GPS数据更新时间
+  FixText t;
+  formatFixText(gpsFix, t);
+#define FIX_LOG_FORMAT "Latitude= %s Longitude= %s Altitude= %s Speed= %s"
+  // 4 个 %s 各替换为最长的 FixText 字段（不含结尾 0），不会截断
+  char logMsg[sizeof(FIX_LOG_FORMAT) - 8 + sizeof(FixText) - 4];
+  snprintf(logMsg, sizeof(logMsg), FIX_LOG_FORMAT, t.lat, t.lng, t.alt, t.spd);
+  addLog(logMsg); // addLog 同时输出到串口
+  // 写入LittleFS
+  writePositionToFS(gpsFix);
+#if GPS_FILTER
+  {
+    StageTimer filterTimer(Stage::Filter);
+    gpsView = trackFilter.update(gpsFix, lastGpsUpdateTime);
+  }
+#else
+  gpsView = gpsFix;
+#endif
+  if (tripActive)
+  {
+    tripStats.addFix(gpsView, lastGpsUpdateTime);
+  }
+  writeTripData(gpsFix);
+  checkGeofence();
+  publishState();
+}
+
+#ifdef GPS_USE_UBX
+// UBX 模式：完整导航历元到达时更新定位
+void processGpsByte(uint8_t b)
+{
+  uint32_t skyUpdates = satView.updates();
+  bool epoch = ubx.feed(b);
+  if (satView.updates() != skyUpdates)
+  {
+    lastSkyUpdateTime = millis();
+  }
+  if (epoch)
+  {
+    gpsFix = ubx.fix();
+    if (gpsFix.valid)
+    {
+      onGpsFix();
+    }
+  }
+}
+#else
+// 把 TinyGPSPlus 的原始定位换算为 GpsFix（整数运算，不经过 double）
+void updateFixFromNmea()
+{
+  const RawDegrees &rlat = gps.location.rawLat();
+  const RawDegrees &rlng = gps.location.rawLng();
+  gpsFix.latE7 = geoRawToE7(rlat.deg, rlat.billionths, rlat.negative);
+  gpsFix.lngE7 = geoRawToE7(rlng.deg, rlng.billionths, rlng.negative);
+  gpsFix.altCm = gps.altitude.value();
+  // speed.value() 单位为 0.01 节；1 节 = 51.4444 厘米/秒
+  gpsFix.speedCmps = (uint32_t)(((int64_t)gps.speed.value() * 514444 + 500000) / 1000000);
+  gpsFix.courseCdeg = (uint16_t)(gps.course.value() % 36000); // 0.01 度
+  gpsFix.satellites = gps.satellites.value();
+  gpsFix.hdopX100 = gps.hdop.value();
+  gpsFix.valid = gps.location.isValid();
+}
+
+// NMEA 模式：解码、拼接日志行，定位更新时写入LittleFS
+void processGpsByte(uint8_t b)
+{
+  char c = (char)b;
+  bool sentenceDone = gps.encode(c); // 解码接收到的 GPS 数据
+  if (satView.feed(c))
+  {
+    lastSkyUpdateTime = millis();
+  }
+
+  if (c == '\n')
+  {
+    nmeaLine[nmeaLineLen] = '\0';
+    addLog(nmeaLine);
+    nmeaLineLen = 0;
+  }
+  else if (c != '\r' && nmeaLineLen < sizeof(nmeaLine) - 1)
+  {
+    nmeaLine[nmeaLineLen++] = c;
+  }
+  // 只有完整语句解析完成后定位才可能更新
+  if (sentenceDone && gps.location.isUpdated())
+  {
+    updateFixFromNmea();
+    onGpsFix();
+  }
+}
+#endif
+
+// 每次唤醒时取空环形缓冲区，避免积压
+void drainGps()
+{
+  StateLock lock;
+  uint32_t start = ESP.getCycleCount();
+  uint64_t fixCyclesBefore = loopMetrics.stage(Stage::GpsFix).sumCycles();
+  bool drained = false;
+  uint8_t chunk[128];
+  size_t n;
+  while ((n = gpsRing.pop(chunk, sizeof(chunk))) > 0)
+  {
+    drained = true;
+#ifndef GPS_USE_UBX
+    Serial.write(chunk, n); // 打印所有GPS原始数据，便于调试
+#endif
+    for (size_t i = 0; i < n; i++)
+    {
+      processGpsByte(chunk[i]);
+    }
+  }
+  // 逐字节计时开销太大：解码耗时 = 整体耗时 - 期间 onGpsFix() 的耗时
+  if (drained)
+  {
+    uint32_t total = ESP.getCycleCount() - start;
+    uint32_t fixCycles = (uint32_t)(loopMetrics.stage(Stage::GpsFix).sumCycles() - fixCyclesBefore);
+    loopMetrics.record(Stage::GpsDrain, total);
+    loopMetrics.record(Stage::GpsParse, total > fixCycles ? total - fixCycles : 0);
+  }
+}
+
+#ifdef GPS_USE_UBX
+void sendUbx(const uint8_t *frame, size_t len)
+{
+  gpsSerial.write(frame, len);
+  gpsSerial.flush(); // 等待发送完成，再切换波特率或发下一条
+}
+
+// 通过 CFG-PRT/CFG-RATE/CFG-MSG 配置 NEO-6M（只写 RAM，模块断电后恢复出厂）
+void configureGpsUbx()
+{
+  uint8_t frame[UBX_MAX_FRAME];
+  size_t len = ubxBuildCfgPrt(frame, GPS_UBX_BAUD);
+  // ESP 单独复位时模块可能已是目标波特率，新旧两种波特率各发一次
+  sendUbx(frame, len);
+  delay(100);
+  gpsSerial.updateBaudRate(GPS_UBX_BAUD);
+  sendUbx(frame, len);
+  delay(100);
+
+  len = ubxBuildCfgRate(frame, GPS_UBX_RATE_MS);
+  sendUbx(frame, len);
+
+  static const uint8_t navMsgs[] = {UBX_NAV_POSLLH, UBX_NAV_VELNED, UBX_NAV_SOL};
+  for (uint8_t id : navMsgs)
+  {
+    len = ubxBuildCfgMsg(frame, UBX_CLASS_NAV, id, 1);
+    sendUbx(frame, len);
+  }
+  // 卫星视图约每秒一次即可：每 N 个导航解输出一次
+  uint8_t skyRate = GPS_UBX_RATE_MS < 1000 ? 1000 / GPS_UBX_RATE_MS : 1;
+  static const uint8_t skyMsgs[] = {UBX_NAV_SVINFO, UBX_NAV_DOP};
+  for (uint8_t id : skyMsgs)
+  {
+    len = ubxBuildCfgMsg(frame, UBX_CLASS_NAV, id, skyRate);
+    sendUbx(frame, len);
+  }
+  Serial.printf("[INFO] GPS UBX mode: baud=%d, rate=%dms\n", GPS_UBX_BAUD, GPS_UBX_RATE_MS);
+  addLog("[INFO] GPS switched to UBX NAV-POSLLH/VELNED/SOL/SVINFO/DOP");
+}
+#endif
+
+void handleWifiConfig()
+{
+  String html = "<html><head><meta charset='utf-8'><title>WiFi配置</title>";
+  html += R"(
+  <style>
+    body { font-family: 'Segoe UI', Arial, sans-serif; background: #f4f6fa; }
+    .container { max-width: 400px; margin: 40px auto; background: #fff; border-radius: 10px; box-shadow: 0 2px 8px #0001; padding: 24px; }
+    h2 { color: #2a5d9f; }
+    label { display:block; margin: 12px 0 4px 0; }
+    input { width: 100%; padding: 8px; border-radius: 5px; border: 1px solid #bbb; margin-bottom: 12px; }
+    button { background: #2a5d9f; color: #fff; border: none; border-radius: 5px; padding: 10px 22px; font-size: 1em; cursor: pointer; width: 100%; }
+    button:hover { background: #17406b; }
+    .msg { color: #c00; margin: 10px 0; }
+  </style>
+  )";
+  html += "</head><body><div class='container'>";
+  html += "<h2>WiFi 配置</h2>";
+  html += "<form method='POST' action='/wifi_save'>";
+  html += "<label>WiFi名称(SSID)</label><input name='ssid' required>";
+  html += "<label>WiFi密码</label><input name='pass' type='password'>";
+  html += "<button type='submit'>保存并连接</button>";
+  html += "</form>";
+  html += "</div></body></html>";
+  server.send(200, "text/html", html);
+}
+
+void handleWifiSave()
+{
+#ifdef wifi_ssid
+  // 宏模式下不允许网页配置WiFi
+  server.send(403, "text/plain", "WiFi is hardcoded in firmware");
+#else
+  if (server.hasArg("ssid"))
+    wifiSsid = server.arg("ssid");
+  if (server.hasArg("pass"))
+    wifiPass = server.arg("pass");
+  wifiConfigured = true;
+  saveWifiConfig(); // 保存WiFi配置到LittleFS
+  String html = "<html><meta charset='utf-8'><body><h2>WiFi配置已保存，正在重启...</h2></body></html>";
+  server.send(200, "text/html", html);
+  delay(1000);
+  ESP.restart();
+#endif
+}
+
+void tryLoadWifiConfig()
+{
+#ifndef wifi_ssid
+  File f = LittleFS.open("/wifi.txt", "r");
+  if (f)
+  {
+    wifiSsid = f.readStringUntil('\n');
+    wifiSsid.trim();
+    wifiPass = f.readStringUntil('\n');
+    wifiPass.trim();
+    wifiConfigured = wifiSsid.length() > 0;
+    f.close();
+  }
+#endif
+}
+
+
+// 屏幕按字段增量刷新：只有内容变化的字段才擦除重绘，耗时记录在下面两个变量
+unsigned long displayRenderUs = 0;    // 最近一次刷新耗时（微秒）
+unsigned long displayRenderMaxUs = 0; // 自上次调试日志以来的最大刷新耗时
+
+#ifdef USE_OLED_SCREEN
+// 每次 I2C 传输的数据字节数（不含 0x40 控制字节），需小于 Wire 缓冲区
+#ifndef OLED_I2C_CHUNK
+#define OLED_I2C_CHUNK 31
+#endif
+#define OLED_I2C_ADDR 0x3C
+
+DisplayField oledWifi1 = DISPLAY_FIELD(0, 0, SCREEN_WIDTH, 8);
+DisplayField oledWifi2 = DISPLAY_FIELD(0, 8, SCREEN_WIDTH, 8);
+DisplayField oledGps1 = DISPLAY_FIELD(0, 16, SCREEN_WIDTH, 8);
+DisplayField oledGps2 = DISPLAY_FIELD(0, 24, SCREEN_WIDTH, 8);
+DisplayField oledSpeed = DISPLAY_FIELD(0, 32, 80, 16);
+DisplayField oledUnit = DISPLAY_FIELD_DY(80, 32, SCREEN_WIDTH - 80, 16, 8);
+DisplayField oledStats = DISPLAY_FIELD(0, 48, SCREEN_WIDTH, 8);
+DisplayField oledTrip = DISPLAY_FIELD(0, 56, SCREEN_WIDTH, 8);
+DisplayField *const oledFields[] = {&oledWifi1, &oledWifi2, &oledGps1, &oledGps2, &oledSpeed, &oledUnit, &oledStats, &oledTrip};
+bool oledNeedsClear = true; // 屏幕被其他画面整屏覆盖过，下次需全部重绘
+
+// 字段有变化时把它覆盖的 8 像素高页标记为脏
+static void oledField(uint8_t &dirtyPages, DisplayField &f, uint8_t size, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+static void oledField(uint8_t &dirtyPages, DisplayField &f, uint8_t size, const char *fmt, ...)
+{
+  char buf[DISPLAY_FIELD_TEXT];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (drawField(display, f, buf, SSD1306_WHITE, SSD1306_BLACK, size))
+  {
+    for (int p = f.y / 8; p <= (f.y + f.h - 1) / 8; p++)
+      dirtyPages |= 1 << p;
+  }
+}
+
+// 只把脏页从帧缓冲区发送到屏幕；相邻脏页合并为一次地址窗口
+static void oledPushPages(uint8_t dirtyPages)
+{
+  const uint8_t *buffer = display.getBuffer();
+  int page = 0;
+  while (page < SCREEN_HEIGHT / 8)
+  {
+    if (!(dirtyPages & (1 << page)))
+    {
+      page++;
+      continue;
+    }
+    int last = page;
+    while (last + 1 < SCREEN_HEIGHT / 8 && (dirtyPages & (1 << (last + 1))))
+      last++;
+
+    display.ssd1306_command(SSD1306_PAGEADDR);
+    display.ssd1306_command(page);
+    display.ssd1306_command(last);
+    display.ssd1306_command(SSD1306_COLUMNADDR);
+    display.ssd1306_command(0);
+    display.ssd1306_command(SCREEN_WIDTH - 1);
+
+    const uint8_t *p = buffer + page * SCREEN_WIDTH;
+    size_t remaining = (size_t)(last - page + 1) * SCREEN_WIDTH;
+    while (remaining > 0)
+    {
+      size_t n = remaining < OLED_I2C_CHUNK ? remaining : OLED_I2C_CHUNK;
+      Wire.beginTransmission(OLED_I2C_ADDR);
+      Wire.write((uint8_t)0x40); // Co=0, D/C#=1：后续均为显示数据
+      Wire.write(p, n);
+      Wire.endTransmission();
+      p += n;
+      remaining -= n;
     }
-    tft.setTextColor(ST77XX_WHITE);
+    page = last + 1;
+  }
+}
+
+void updateOled()
+{
+  uint8_t dirtyPages = 0;
+  if (oledNeedsClear)
+  {
+    display.clearDisplay();
+    for (DisplayField *f : oledFields)
+      invalidateField(*f);
+    oledNeedsClear = false;
+    dirtyPages = 0xFF;
+  }
+
+  // 显示WiFi状态
+  if (apModeActive)
+  {
+    oledField(dirtyPages, oledWifi1, 1, "%s", wifiRetrying ? "AP: Reconnecting..." : "AP: GPS-AP-Data");
+    oledField(dirtyPages, oledWifi2, 1, "Visit: 192.168.4.1");
+  }
+  else if (configModeActive)
+  {
+    oledField(dirtyPages, oledWifi1, 1, "Config Mode");
+    oledField(dirtyPages, oledWifi2, 1, "Visit: 192.168.4.1");
+  }
+  else if (WiFi.status() == WL_CONNECTED)
+  {
+    IPAddress ip = WiFi.localIP();
+    oledField(dirtyPages, oledWifi1, 1, "WiFi: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    oledField(dirtyPages, oledWifi2, 1, "Visit: esp32gps.local");
+  }
+  else
+  {
+    if (wifiLostTime > 0)
+      oledField(dirtyPages, oledWifi1, 1, "WiFi lost: %lus", (millis() - wifiLostTime) / 1000);
+    else
+      oledField(dirtyPages, oledWifi1, 1, "WiFi: Connecting...");
+    oledField(dirtyPages, oledWifi2, 1, "%s", "");
   }
 
   // 检查GPS数据是否超时
   unsigned long currentTime = millis();
   bool gpsTimeout = (lastGpsUpdateTime > 0) && (currentTime - lastGpsUpdateTime > GPS_TIMEOUT_MS);
+  if (gpsFix.valid && !gpsTimeout)
+  {
+    // 简化的经纬度、高度，大字体速度和右侧小字单位
+    char lat[16], lng[16], spd[16];
+    geoFormatE7(lat, sizeof(lat), gpsView.latE7, 4);
+    geoFormatE7(lng, sizeof(lng), gpsView.lngE7, 4);
+    formatFixed(spd, sizeof(spd), (int32_t)((gpsView.speedKmphX100() + 5) / 10), 1);
+    int32_t altM = (gpsView.altCm + (gpsView.altCm >= 0 ? 50 : -50)) / 100;
+    oledField(dirtyPages, oledGps1, 1, "%s,%s", lat, lng);
+    oledField(dirtyPages, oledGps2, 1, "Alt: %ldm", (long)altM);
+    oledField(dirtyPages, oledSpeed, 2, "%s", spd);
+    oledField(dirtyPages, oledUnit, 1, "km/h");
+  }
+  else if (gpsTimeout)
+  {
+    oledField(dirtyPages, oledGps1, 1, "GPS TIMEOUT!");
+    oledField(dirtyPages, oledGps2, 1, "No update: %lus", (currentTime - lastGpsUpdateTime) / 1000);
+    oledField(dirtyPages, oledSpeed, 1, "Check conn.");
+    oledField(dirtyPages, oledUnit, 1, "%s", "");
+  }
+  else
+  {
+    oledField(dirtyPages, oledGps1, 1, "wait for signal");
+    oledField(dirtyPages, oledGps2, 1, "%s", "");
+    oledField(dirtyPages, oledSpeed, 1, "%s", "");
+    oledField(dirtyPages, oledUnit, 1, "%s", "");
+  }
+
+  // 码表进行中：里程和运动时间
+  if (tripActive)
+  {
+    uint32_t dist = tripStats.distanceCm() / 1000; // 10 米
+    uint32_t secs = tripStats.movingMs() / 1000;
+    oledField(dirtyPages, oledStats, 1, "%lu.%02lukm %lu:%02lu:%02lu", (unsigned long)(dist / 100),
+              (unsigned long)(dist % 100), (unsigned long)(secs / 3600), (unsigned long)(secs / 60 % 60),
+              (unsigned long)(secs % 60));
+  }
+  else
+  {
+    oledField(dirtyPages, oledStats, 1, "%s", "");
+  }
+  oledField(dirtyPages, oledTrip, 1, "%s", tripActive ? "Trip: ON" : "Trip: OFF");
+
+  // 内容未变化时不占用 I2C 总线
+  if (dirtyPages)
+    oledPushPages(dirtyPages);
+}
+#endif
+#ifdef USE_ST7735_SCREEN
+DisplayField tftWifi = DISPLAY_FIELD(0, 0, 160, 8);
+DisplayField tftLines[5] = {DISPLAY_FIELD(0, 8, 160, 8), DISPLAY_FIELD(0, 16, 160, 8), DISPLAY_FIELD(0, 24, 160, 8),
+                            DISPLAY_FIELD(0, 32, 160, 8), DISPLAY_FIELD(0, 40, 160, 8)};
+DisplayField tftTrip = DISPLAY_FIELD(0, 48, 160, 8);
+DisplayField tftStats[3] = {DISPLAY_FIELD(0, 56, 160, 8), DISPLAY_FIELD(0, 64, 160, 8), DISPLAY_FIELD(0, 72, 160, 8)};
+
+// 只重绘变化的字段：每个字段先用背景色填充自身矩形再写字，不再整屏清除
+void updateSt7735()
+{
+  static bool cleared = false;
+  if (!cleared)
+  {
+    tft.fillScreen(ST77XX_BLACK);
+    cleared = true;
+  }
+  // 显示WiFi状态
+  if (apModeActive)
+  {
+    drawField(tft, tftWifi, "AP: GPS-AP-Data", ST77XX_YELLOW, ST77XX_BLACK);
+  }
+  else if (WiFi.status() == WL_CONNECTED)
+  {
+    IPAddress ip = WiFi.localIP();
+    drawFieldf(tft, tftWifi, ST77XX_GREEN, ST77XX_BLACK, 1, "WiFi: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  }
+  else if (wifiLostTime > 0)
+  {
+    drawFieldf(tft, tftWifi, ST77XX_RED, ST77XX_BLACK, 1, "WiFi 断开: %lus", (millis() - wifiLostTime) / 1000);
+  }
+  else
+  {
+    drawField(tft, tftWifi, "WiFi: 连接中...", ST77XX_RED, ST77XX_BLACK);
+  }
 
-  if (gps.location.isValid() && !gpsTimeout)
+  // 检查GPS数据是否超时
+  unsigned long currentTime = millis();
+  bool gpsTimeout = (lastGpsUpdateTime > 0) && (currentTime - lastGpsUpdateTime > GPS_TIMEOUT_MS);
+  int used = 0;
+  if (gpsFix.valid && !gpsTimeout)
   {
-    tft.printf("Lat: %.6f\n", gps.location.lat());
-    tft.printf("Lng: %.6f\n", gps.location.lng());
-    tft.printf("Alt: %.1f m\n", gps.altitude.meters());
-    tft.printf("Spd: %.1f km/h\n", gps.speed.kmph());
+    FixText t;
+    formatFixText(gpsView, t);
+    drawFieldf(tft, tftLines[used++], ST77XX_WHITE, ST77XX_BLACK, 1, "Lat: %s", t.lat);
+    drawFieldf(tft, tftLines[used++], ST77XX_WHITE, ST77XX_BLACK, 1, "Lng: %s", t.lng);
+    drawFieldf(tft, tftLines[used++], ST77XX_WHITE, ST77XX_BLACK, 1, "Alt: %s m", t.alt);
+    drawFieldf(tft, tftLines[used++], ST77XX_WHITE, ST77XX_BLACK, 1, "Spd: %s km/h", t.spd);
     // 显示最后更新时间
-    unsigned long timeSinceUpdate = currentTime - lastGpsUpdateTime;
-    tft.printf("更新: %lu秒前\n", timeSinceUpdate / 1000);
+    drawFieldf(tft, tftLines[used++], ST77XX_WHITE, ST77XX_BLACK, 1, "更新: %lu秒前",
+               (currentTime - lastGpsUpdateTime) / 1000);
   }
   else if (gpsTimeout)
   {
-    unsigned long timeSinceUpdate = currentTime - lastGpsUpdateTime;
-    tft.setTextColor(ST77XX_RED);
-    tft.printf("GPS超时!\n");
-    tft.printf("未更新: %lu秒\n", timeSinceUpdate / 1000);
-    tft.setTextColor(ST77XX_WHITE);
-    tft.println("检查连接...");
+    drawField(tft, tftLines[used++], "GPS超时!", ST77XX_RED, ST77XX_BLACK);
+    drawFieldf(tft, tftLines[used++], ST77XX_RED, ST77XX_BLACK, 1, "未更新: %lu秒",
+               (currentTime - lastGpsUpdateTime) / 1000);
+    drawField(tft, tftLines[used++], "检查连接...", ST77XX_WHITE, ST77XX_BLACK);
   }
   else
   {
-    tft.println("等待定位...");
+    drawField(tft, tftLines[used++], "等待定位...", ST77XX_WHITE, ST77XX_BLACK);
   }
+  for (; used < 5; used++)
+    drawField(tft, tftLines[used], "", ST77XX_WHITE, ST77XX_BLACK);
 
+  drawField(tft, tftTrip, tripActive ? "码表: 进行中" : "码表: 未开始", ST77XX_WHITE, ST77XX_BLACK);
   if (tripActive)
   {
-    tft.setCursor(0, 48);
-    tft.print("码表: 进行中");
+    uint32_t dist = tripStats.distanceCm() / 1000; // 10 米
+    uint32_t secs = tripStats.movingMs() / 1000;
+    uint32_t avg = (tripStats.avgSpeedCmps() * 36UL + 50) / 100; // 0.1 km/h
+    uint32_t top = (tripStats.maxSpeedCmps() * 36UL + 50) / 100;
+    drawFieldf(tft, tftStats[0], ST77XX_CYAN, ST77XX_BLACK, 1, "Dist: %lu.%02lu km  %lu:%02lu:%02lu",
+               (unsigned long)(dist / 100), (unsigned long)(dist % 100), (unsigned long)(secs / 3600),
+               (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60));
+    drawFieldf(tft, tftStats[1], ST77XX_CYAN, ST77XX_BLACK, 1, "Avg/Max: %lu.%lu/%lu.%lu km/h",
+               (unsigned long)(avg / 10), (unsigned long)(avg % 10), (unsigned long)(top / 10), (unsigned long)(top % 10));
+    drawFieldf(tft, tftStats[2], ST77XX_CYAN, ST77XX_BLACK, 1, "Climb: +%lu/-%lu m",
+               (unsigned long)(tripStats.ascentCm() / 100), (unsigned long)(tripStats.descentCm() / 100));
+  }
+  else
+  {
+    for (DisplayField &f : tftStats)
+      drawField(tft, f, "", ST77XX_WHITE, ST77XX_BLACK);
+  }
+}
+#endif
+
+#define DOWNLOADS_PER_PAGE 20
+#define DOWNLOADS_PER_PAGE_MAX 50
+
+// 码表文件列表（JSON，分页）：?page=0&per=20。读内存中的索引，每页耗时与码表总数无关。
+// ETag 由索引版本号、位置日志大小和正在记录的码表的当前大小、时长算出，都未变化时返回 304
+void handleDownloads()
+{
+  long page = server.hasArg("page") ? server.arg("page").toInt() : 0;
+  long per = server.hasArg("per") ? server.arg("per").toInt() : DOWNLOADS_PER_PAGE;
+  if (page < 0)
+    page = 0;
+  if (per < 1 || per > DOWNLOADS_PER_PAGE_MAX)
+    per = DOWNLOADS_PER_PAGE;
+
+  // 持锁只复制本页条目，发送时不占用 stateMutex
+  static TripIndexEntry rows[DOWNLOADS_PER_PAGE_MAX];
+  size_t count = 0, total;
+  uint32_t version, logBytes, live = 2166136261u;
+  {
+    StateLock lock;
+    version = tripIndex.version();
+    total = tripIndex.size();
+    logBytes = posLog.totalBytes();
+    for (size_t i = (size_t)page * per; i < total && count < (size_t)per; i++)
+    {
+      rows[count] = tripIndex.at(i);
+      // 正在记录的码表大小和时长取当前值。索引版本号不随之变化，这两项另外计入 ETag
+      if (rows[count].active && tripActive && tripFileName == rows[count].name)
+      {
+        rows[count].size = tripFileBase + tripWriter.bytesWritten();
+        rows[count].durationS = (lastTripRowTime - tripStartTime) / 1000;
+        live = fnv1a((const char *)&rows[count].size, sizeof(rows[count].size), live);
+        live = fnv1a((const char *)&rows[count].durationS, sizeof(rows[count].durationS), live);
+      }
+      count++;
+    }
+  }
+
+  live = fnv1a((const char *)&logBytes, sizeof(logBytes), live);
+  char etag[20];
+  snprintf(etag, sizeof(etag), "\"%08lx%08lx\"", (unsigned long)version, (unsigned long)live);
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match") == etag)
+  {
+    server.send(304);
+    return;
+  }
+
+  static ChunkedOut out;
+  out.len = 0;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  out.printf("{\"version\":\"%08lx\",\"total\":%u,\"page\":%ld,\"per\":%ld,\"gpslog\":%lu,\"trips\":[",
+             (unsigned long)version, (unsigned)total, page, per, (unsigned long)logBytes);
+  for (size_t i = 0; i < count; i++)
+  {
+    const TripIndexEntry &e = rows[i];
+    out.printf("%s{\"file\":\"%s\",\"size\":%lu,\"start\":%lu,\"secs\":%lu,\"active\":%s,\"summary\":%s}",
+               i ? "," : "", e.name, (unsigned long)e.size, (unsigned long)e.startEpoch,
+               (unsigned long)e.durationS, e.active ? "true" : "false", e.summary ? "true" : "false");
+  }
+  out.printf("]}");
+  server.sendContent(out.buf, out.len);
+  server.sendContent(""); // 结束分块传输
+}
+
+// 删除已结束的码表及其统计文件：/delete?file=/trip_xxx.bin
+void handleDeleteTrip()
+{
+  String fn = server.arg("file");
+  if (!fn.startsWith("/"))
+  {
+    fn = "/" + fn;
+  }
+  if (!fn.startsWith("/trip_") || (!fn.endsWith(".bin") && !fn.endsWith(".csv")) || fn.indexOf("..") >= 0)
+  {
+    server.send(400, "text/plain", "Not a trip file");
+    return;
+  }
+  int code = 200;
+  const char *reply = "Deleted";
+  {
+    StateLock lock;
+    if (tripActive && fn == tripFileName)
+    {
+      code = 409;
+      reply = "Trip is active";
+    }
+    else if (!LittleFS.remove(fn))
+    {
+      code = 404;
+      reply = "File not found";
+      // 文件已不存在时索引也不应再列出
+      tripIndex.remove(fn);
+    }
+    else
+    {
+      LittleFS.remove(fn.substring(0, fn.length() - 4) + ".json");
+      tripIndex.remove(fn);
+      addLog("[TRIP] Deleted " + fn);
+    }
+  }
+  server.send(code, "text/plain", reply);
+}
+
+// 下载输出缓冲：只把 [start, end] 范围内的字节发给客户端，之前的只计数（断点续传时跳过
+// 已下载的部分）。send 为 false 时只统计总长度
+struct RangeSink
+{
+  char buf[1024];
+  size_t len;
+  uint32_t pos;
+  uint32_t start;
+  uint32_t end;
+  bool send;
+
+  void reset(uint32_t from, uint32_t to, bool sending)
+  {
+    len = 0;
+    pos = 0;
+    start = from;
+    end = to;
+    send = sending;
+  }
+  // 已越过范围末尾，后面的内容不必再生成
+  bool done() const { return send && pos > end; }
+  void put(const char *data, size_t n)
+  {
+    uint32_t from = pos;
+    pos += n;
+    if (!send || pos <= start || from > end)
+    {
+      return;
+    }
+    size_t skip = from < start ? start - from : 0;
+    size_t take = (pos - 1 > end ? end + 1 : pos) - from - skip;
+    data += skip;
+    while (take > 0)
+    {
+      size_t chunk = take < sizeof(buf) - len ? take : sizeof(buf) - len;
+      memcpy(buf + len, data, chunk);
+      len += chunk;
+      data += chunk;
+      take -= chunk;
+      if (len == sizeof(buf))
+      {
+        server.sendContent(buf, len);
+        len = 0;
+      }
+    }
+  }
+  void flush()
+  {
+    if (len > 0)
+    {
+      server.sendContent(buf, len);
+    }
+    len = 0;
+  }
+};
+
+// 把二进制码表边读边转换为导出格式，使用固定大小的读写缓冲区，不生成临时文件。
+// 只读到 dataEnd（请求开始时的文件长度），正在记录的码表计数和发送两次的内容也一致
+void streamTripExport(File &f, uint32_t dataEnd, TripExporter &ex, RangeSink &sink)
+{
+  static char line[TRIP_EXPORT_MAX_CHUNK];
+  static uint8_t slots[32 * TRIP_SLOT_SIZE];
+  sink.put(line, ex.header(line, sizeof(line)));
+  for (uint8_t pass = 0; pass < ex.passes() && !sink.done(); pass++)
+  {
+    sink.put(line, ex.beginPass(pass, line, sizeof(line)));
+    f.seek(TRIP_HEADER_SIZE);
+    uint32_t left = dataEnd > TRIP_HEADER_SIZE ? (dataEnd - TRIP_HEADER_SIZE) / TRIP_SLOT_SIZE * TRIP_SLOT_SIZE : 0;
+    TripDecoder decoder;
+    size_t n;
+    while (left > 0 && !sink.done() && (n = f.read(slots, left < sizeof(slots) ? left : sizeof(slots))) >= TRIP_SLOT_SIZE)
+    {
+      left -= n;
+      for (size_t off = 0; off + TRIP_SLOT_SIZE <= n; off += TRIP_SLOT_SIZE)
+      {
+        TripPoint p;
+        int r = decoder.decodeSlot(slots + off, p);
+        if (r == 1)
+        {
+          sink.put(line, ex.point(p, line, sizeof(line)));
+        }
+        else if (r == 2)
+        {
+          sink.put(line, ex.zoneEvent(decoder.zoneEvent(), line, sizeof(line)));
+        }
+      }
+    }
+  }
+  if (!sink.done())
+  {
+    sink.put(line, ex.footer(line, sizeof(line)));
+  }
+}
+
+// 单段 Range：bytes=a-b、bytes=a-、bytes=-n。返回 1 有效；0 忽略（多段或格式不对，发送完整内容）；
+// -1 超出范围（416）
+static int parseByteRange(const String &h, uint32_t total, uint32_t &start, uint32_t &end)
+{
+  if (!h.startsWith("bytes=") || h.indexOf(',') >= 0)
+  {
+    return 0;
+  }
+  int dash = h.indexOf('-', 6);
+  if (dash < 0)
+  {
+    return 0;
+  }
+  const char *a = h.c_str() + 6;
+  const char *b = h.c_str() + dash + 1;
+  char *stop;
+  if (a == h.c_str() + dash)
+  {
+    // 后缀形式：最后 n 个字节
+    unsigned long n = strtoul(b, &stop, 10);
+    if (stop == b || *stop)
+    {
+      return 0;
+    }
+    if (n == 0 || total == 0)
+    {
+      return -1;
+    }
+    start = n >= total ? 0 : total - n;
+    end = total - 1;
+    return 1;
+  }
+  unsigned long first = strtoul(a, &stop, 10);
+  if (stop != h.c_str() + dash)
+  {
+    return 0;
+  }
+  unsigned long last = total - 1;
+  if (*b)
+  {
+    last = strtoul(b, &stop, 10);
+    if (*stop || last < first)
+    {
+      return 0;
+    }
+  }
+  if (first >= total)
+  {
+    return -1;
+  }
+  start = first;
+  end = last < total ? last : total - 1;
+  return 1;
+}
+
+// 下载文件。.bin 码表按 format=csv（默认）/gpx/geojson/kml 边读边转换，其余文件原样发送。
+// 支持单段 Range（206）续传：ETag 由文件长度、修改时间和格式组成，If-Range 不符时发送完整内容。
+// 转换后的长度要完整生成一遍才能知道：完整下载直接用分块编码边转换边发送，顺带记下长度；
+// 只有带 Range 且长度未知时才先只计数生成一遍。长度按文件和格式缓存最近 DOWNLOAD_LENGTH_CACHE 个
+#define DOWNLOAD_LENGTH_CACHE 8
+
+struct ExportLength
+{
+  uint32_t key; // 文件名和 ETag 的 FNV-1a，0 为空
+  uint32_t length;
+};
+static ExportLength exportLengths[DOWNLOAD_LENGTH_CACHE];
+static uint8_t exportLengthNext = 0;
+
+static bool findExportLength(uint32_t key, uint32_t &length)
+{
+  for (const ExportLength &e : exportLengths)
+  {
+    if (e.key == key)
+    {
+      length = e.length;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void storeExportLength(uint32_t key, uint32_t length)
+{
+  uint32_t known;
+  if (findExportLength(key, known))
+    return;
+  exportLengths[exportLengthNext] = {key, length};
+  exportLengthNext = (exportLengthNext + 1) % DOWNLOAD_LENGTH_CACHE;
+}
+
+void handleDownloadFile()
+{
+  if (!server.hasArg("file"))
+  {
+    server.send(400, "text/plain", "Missing file param");
+    return;
+  }
+  String fn = server.arg("file");
+  // 兼容前端传递的文件名没有前导斜杠的情况
+  if (!fn.startsWith("/"))
+  {
+    fn = "/" + fn;
+  }
+  TripExportFormat fmt;
+  if (!tripExportParse(server.arg("format").c_str(), fmt))
+  {
+    server.send(400, "text/plain", "Unknown format");
+    return;
+  }
+  // 正在记录的码表先把缓冲区写入 flash，保证下载内容完整
+  {
+    StateLock lock;
+    if (tripWriter.isOpen() && fn == tripWriter.path())
+    {
+      tripWriter.flush();
+    }
+  }
+  File f = LittleFS.open(fn, "r");
+  if (!f)
+  {
+    server.send(404, "text/plain", "File not found");
+    return;
+  }
+  bool bin = fn.endsWith(".bin");
+  uint32_t size = f.size();
+  char etag[40];
+  snprintf(etag, sizeof(etag), "\"%lx-%lx-%u\"", (unsigned long)size, (unsigned long)f.getLastWrite(),
+           bin ? (unsigned)fmt : 0u);
+
+  int slash = fn.lastIndexOf('/');
+  String base = fn.substring(slash + 1, fn.length() - 4);
+  TripHeader header;
+  if (bin)
+  {
+    uint8_t hdr[TRIP_HEADER_SIZE];
+    if (f.read(hdr, sizeof(hdr)) != sizeof(hdr) || !tripReadHeader(hdr, header))
+    {
+      f.close();
+      server.send(500, "text/plain", "Bad trip file header");
+      return;
+    }
+  }
+  TripExporter ex(fmt, header, base.c_str());
+  static RangeSink sink;
+  uint32_t total = size;
+  bool ranged = server.hasHeader("Range") && (!server.hasHeader("If-Range") || server.header("If-Range") == etag);
+  uint32_t lengthKey = 0;
+  if (bin)
+  {
+    lengthKey = fnv1a(etag, strlen(etag), fnv1a(fn.c_str(), fn.length()));
+    lengthKey = lengthKey ? lengthKey : 1;
+    if (!findExportLength(lengthKey, total))
+    {
+      if (!ranged)
+      {
+        // 完整下载：不预先计数，分块发送，结束后记下长度供续传使用
+        server.sendHeader("ETag", etag);
+        server.sendHeader("Content-Disposition",
+                          "attachment; filename=\"" + base + tripExportExt(fmt) + "\"");
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send(200, tripExportMime(fmt), "");
+        sink.reset(0, UINT32_MAX, true);
+        streamTripExport(f, size, ex, sink);
+        sink.flush();
+        server.sendContent(""); // 结束分块传输
+        f.close();
+        storeExportLength(lengthKey, sink.pos);
+        return;
+      }
+      sink.reset(0, 0, false);
+      streamTripExport(f, size, ex, sink);
+      total = sink.pos;
+      storeExportLength(lengthKey, total);
+    }
+  }
+
+  int code = 200;
+  uint32_t start = 0, end = total - 1;
+  if (ranged)
+  {
+    int r = parseByteRange(server.header("Range"), total, start, end);
+    if (r < 0)
+    {
+      f.close();
+      server.sendHeader("Content-Range", "bytes */" + String(total));
+      server.send(416, "text/plain", "Range not satisfiable");
+      return;
+    }
+    if (r > 0)
+    {
+      char range[48];
+      snprintf(range, sizeof(range), "bytes %lu-%lu/%lu", (unsigned long)start, (unsigned long)end,
+               (unsigned long)total);
+      server.sendHeader("Content-Range", range);
+      code = 206;
+    }
+  }
+  server.sendHeader("Accept-Ranges", "bytes");
+  server.sendHeader("ETag", etag);
+  if (bin)
+  {
+    server.sendHeader("Content-Disposition",
+                      "attachment; filename=\"" + base + tripExportExt(fmt) + "\"");
+  }
+  server.setContentLength(total > 0 ? end - start + 1 : 0);
+  server.send(code, bin ? tripExportMime(fmt) : (fn.endsWith(".json") ? "application/json" : "text/csv"), "");
+  if (total > 0)
+  {
+    sink.reset(start, end, true);
+    if (bin)
+    {
+      streamTripExport(f, size, ex, sink);
+    }
+    else
+    {
+      // 原样发送：从范围起点开始读
+      static uint8_t raw[512];
+      f.seek(start);
+      sink.pos = start;
+      size_t n;
+      while (!sink.done() && (n = f.read(raw, sizeof(raw))) > 0)
+      {
+        sink.put((const char *)raw, n);
+      }
+    }
+    sink.flush();
+  }
+  f.close();
+}
+
+#define TRIP_PREVIEW_POINTS 500      // 默认点数上限
+#define TRIP_PREVIEW_MAX_POINTS 1000  // 顶点数组大小
+#define TRIP_PREVIEW_TOLERANCE_CM 500 // 默认容差 5 m
+
+// 地图预览：/trip/preview?file=/trip_xxx.bin&tolerance=5&max=500（容差单位米）。
+// 顺序读一遍码表，流式抽稀后只返回形状上必要的顶点 [[纬度,经度],...]；
+// 点数超过上限时自动放宽容差，实际容差在 tolerance 字段中返回
+void handleTripPreview()
+{
+  uint32_t startUs = micros();
+  String fn = server.arg("file");
+  if (!fn.startsWith("/"))
+  {
+    fn = "/" + fn;
+  }
+  if (!fn.endsWith(".bin"))
+  {
+    server.send(400, "text/plain", "Not a trip file");
+    return;
+  }
+  uint32_t tolCm = TRIP_PREVIEW_TOLERANCE_CM;
+  if (server.hasArg("tolerance"))
+  {
+    float m = server.arg("tolerance").toFloat();
+    tolCm = m < 0.5f ? 50 : (m > 10000.0f ? 1000000 : (uint32_t)(m * 100));
+  }
+  long budget = server.hasArg("max") ? server.arg("max").toInt() : TRIP_PREVIEW_POINTS;
+  if (budget < 3 || budget > TRIP_PREVIEW_MAX_POINTS)
+  {
+    budget = budget < 3 ? 3 : TRIP_PREVIEW_MAX_POINTS;
+  }
+  {
+    StateLock lock;
+    if (tripWriter.isOpen() && fn == tripWriter.path())
+    {
+      tripWriter.flush();
+    }
+  }
+  File f = LittleFS.open(fn, "r");
+  if (!f)
+  {
+    server.send(404, "text/plain", "File not found");
+    return;
   }
-  else
+  uint8_t hdr[TRIP_HEADER_SIZE];
+  TripHeader header;
+  if (f.read(hdr, sizeof(hdr)) != sizeof(hdr) || !tripReadHeader(hdr, header))
   {
-    tft.setCursor(0, 48);
-    tft.print("码表: 未开始");
+    f.close();
+    server.send(500, "text/plain", "Bad trip file header");
+    return;
   }
-}
-#endif
 
-void handleDownloads()
-{
-  String html = "<div class='download-list'>";
-  std::vector<String> files;
-  File root = LittleFS.open("/", "r");
-  if (root)
+  static TrackSimplifier::Vertex vertices[TRIP_PREVIEW_MAX_POINTS];
+  static uint8_t slots[32 * TRIP_SLOT_SIZE];
+  TrackSimplifier simplifier(vertices, budget, tolCm);
+  TripDecoder decoder;
+  size_t n;
+  while ((n = f.read(slots, sizeof(slots))) >= TRIP_SLOT_SIZE)
   {
-    File file = root.openNextFile();
-    while (file)
+    for (size_t off = 0; off + TRIP_SLOT_SIZE <= n; off += TRIP_SLOT_SIZE)
     {
-      String name = file.name();
-      if (!file.isDirectory())
+      TripPoint p;
+      if (decoder.decodeSlot(slots + off, p) == 1 && p.valid)
       {
-        files.push_back(name);
+        simplifier.add(p.latE6 * 10, p.lngE6 * 10);
       }
-      file = root.openNextFile();
     }
-    root.close();
-  }
-  // 按文件名倒序排列（最新在前）
-  std::sort(files.begin(), files.end(), std::greater<String>());
-  for (const auto &name : files)
-  {
-    html += "<a href=\"/download?file=" + name + "\" download>" + name.substring(1) + "</a><br>";
   }
-  if (files.empty())
+  f.close();
+  simplifier.finish();
+
+  static ChunkedOut out;
+  out.len = 0;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  char tol[16];
+  formatFixed(tol, sizeof(tol), (int32_t)simplifier.toleranceCm(), 2);
+  out.printf("{\"file\":\"%s\",\"tolerance\":%s,\"total\":%lu,\"points\":%u,\"ms\":%lu,\"coords\":[",
+             fn.c_str(), tol, (unsigned long)simplifier.inputPoints(), (unsigned)simplifier.size(),
+             (unsigned long)((micros() - startUs) / 1000));
+  for (size_t i = 0; i < simplifier.size(); i++)
   {
-    html += "<div class='no-data'>暂无码表数据</div>";
+    int32_t lat, lng;
+    simplifier.vertex(i, lat, lng);
+    char la[16], lo[16];
+    geoFormatE7(la, sizeof(la), lat, 5);
+    geoFormatE7(lo, sizeof(lo), lng, 5);
+    out.printf("%s[%s,%s]", i ? "," : "", la, lo);
   }
-  html += "</div>";
-  server.send(200, "text/html", html);
+  out.printf("]}");
+  server.sendContent(out.buf, out.len);
+  server.sendContent(""); // 结束分块传输
 }
 
-void handleDownloadFile()
+// 按时间顺序拼接位置日志的各段；当前段先把缓冲区写入 flash
+void handleGpsLog()
 {
-  if (!server.hasArg("file"))
+  uint32_t first, last;
   {
-    server.send(400, "text/plain", "Missing file param");
-    return;
-  }
-  String fn = server.arg("file");
-  // 兼容前端传递的文件名没有前导斜杠的情况
-  if (!fn.startsWith("/"))
-  {
-    fn = "/" + fn;
+    StateLock lock;
+    posLog.flush();
+    first = posLog.firstSeq();
+    last = posLog.lastSeq();
   }
-  File f = LittleFS.open(fn, "r");
-  if (!f)
+  server.sendHeader("Content-Disposition", "attachment; filename=\"gpslog.txt\"");
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/csv", "");
+  static uint8_t buf[1024];
+  for (uint32_t seq = first; seq <= last; seq++)
   {
-    server.send(404, "text/plain", "File not found");
-    return;
+    // 下载期间被淘汰的段直接跳过
+    File f = LittleFS.open(posLog.segmentPath(seq), "r");
+    if (!f)
+    {
+      continue;
+    }
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0)
+    {
+      server.sendContent((const char *)buf, n);
+    }
+    f.close();
   }
-  server.streamFile(f, "text/csv");
-  f.close();
+  server.sendContent(""); // 结束分块传输
 }
 
 void listLittleFSFiles()
@@ -576,24 +2413,158 @@ void listLittleFSFiles()
 void tryLoadWifiConfig();
 void handleWifiConfig();
 void handleWifiSave();
-void writePositionToFS(double lat, double lng, double alt, double speed);
-void writeTripData(double lat, double lng, double alt, double speed);
+void writePositionToFS(const GpsFix &fix);
+void writeTripData(const GpsFix &fix);
 void handleStartTrip();
 void handleStopTrip();
 void handleDownloads();
+void handleDeleteTrip();
 void handleDownloadFile();
 void enterApMode();
+void registerJobs();
+void enterConfigMode();
+void setWifiState(WifiState state);
+void wifiBeginSta();
+void onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t);
+
+// 注册路由，处理耗时计入 http 分段
+void onTimedRoute(const char *uri, HTTPMethod method, void (*handler)())
+{
+  server.on(uri, method, [handler]()
+            {
+              StageTimer timer(Stage::Http);
+              httpLastRequestMs = millis();
+              handler();
+            });
+}
+
+// 注册数据页面路由；AP 数据模式下不提供码表开始/结束
+void registerDataRoutes(bool tripControl)
+{
+  // WebServer 默认不保存请求头，需显式声明要读取的头
+  static const char *headerKeys[] = {"If-None-Match", "Accept-Encoding", "Range", "If-Range"};
+  server.collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
+  onTimedRoute("/", HTTP_GET, handleRoot);
+  onTimedRoute("/index.html", HTTP_GET, handleRoot);
+  onTimedRoute("/style.css", HTTP_GET, handleStyle);
+  onTimedRoute("/script.js", HTTP_GET, handleScript);
+  onTimedRoute("/data", HTTP_ANY, handleData);
+  onTimedRoute("/api/state", HTTP_GET, handleApiState);
+  onTimedRoute("/api/sky", HTTP_GET, handleApiSky);
+  onTimedRoute("/geofence", HTTP_GET, handleGeofence);
+  onTimedRoute("/log", HTTP_GET, handleLog);
+  onTimedRoute("/events", HTTP_GET, handleEvents);
+  onTimedRoute("/metrics", HTTP_GET, handleMetrics);
+  if (tripControl)
+  {
+    onTimedRoute("/start", HTTP_POST, handleStartTrip);
+    onTimedRoute("/start", HTTP_GET, handleStartTrip);
+    onTimedRoute("/stop", HTTP_POST, handleStopTrip);
+    onTimedRoute("/stop", HTTP_GET, handleStopTrip);
+    onTimedRoute("/delete", HTTP_POST, handleDeleteTrip);
+  }
+  onTimedRoute("/downloads", HTTP_ANY, handleDownloads);
+  onTimedRoute("/download", HTTP_ANY, handleDownloadFile);
+  onTimedRoute("/gpslog", HTTP_GET, handleGpsLog);
+  onTimedRoute("/trip/preview", HTTP_GET, handleTripPreview);
+}
+
+// 在 HTTP 任务内重建路由并重启服务，避免与 handleClient() 并发修改
+volatile int8_t httpRestartRequest = -1; // -1 无请求；0 AP数据路由；1 完整路由
+
+void applyHttpRestart(bool tripControl)
+{
+  server.close();
+  server.stop();
+  delay(100);
+  registerDataRoutes(tripControl);
+  server.begin();
+}
+
+void restartHttpServer(bool tripControl)
+{
+  if (httpTaskHandle == nullptr)
+  {
+    applyHttpRestart(tripControl);
+  }
+  else
+  {
+    httpRestartRequest = tripControl ? 1 : 0;
+    xTaskNotifyGive(httpTaskHandle); // 不等下一次轮询
+  }
+}
+
+// HTTP 任务：慢客户端、大文件下载只阻塞本任务，loop() 中的 GPS 处理不受影响
+void httpTask(void *)
+{
+  server.enableDelay(false); // 无连接时不在 handleClient() 内 delay(1)，由下面按活跃程度阻塞
+  for (;;)
+  {
+    int8_t restart = httpRestartRequest;
+    if (restart >= 0)
+    {
+      httpRestartRequest = -1;
+      applyHttpRestart(restart == 1);
+    }
+    server.handleClient();
+    if (configModeActive)
+    {
+      dnsServer.processNextRequest(); // 处理DNS请求，用于Captive Portal
+    }
+    uint32_t waitMs = millis() - httpLastRequestMs < HTTP_ACTIVE_WINDOW_MS ? 1 : HTTP_IDLE_POLL_MS;
+    uint32_t start = micros();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+    httpSleptUs += micros() - start;
+    httpWakeups++;
+  }
+}
+
+void startHttpTask()
+{
+  if (httpTaskHandle == nullptr)
+  {
+    xTaskCreate(httpTask, "http", 8192, nullptr, 1, &httpTaskHandle);
+  }
+}
 
 void setup() {
+  stateMutex = xSemaphoreCreateRecursiveMutex();
+  loopMetrics.begin();
+  scheduler.begin(); // setup() 与 loop() 在同一任务中运行
   Serial.begin(115200);
   Serial.println("Booting...");
-  gpsSerial.begin(9600, SERIAL_8N1, RX_PIN, TX_PIN);
-  Serial.printf("[INFO] GPS UART1 started: RX=%d, TX=%d, baud=9600\n", RX_PIN, TX_PIN);
+  // 由 UART 事件任务负责搬运数据，loop() 被 HTTP/屏幕阻塞时也不会丢字节
+  gpsSerial.setRxBufferSize(GPS_UART_RX_BUFFER);
+  gpsSerial.begin(GPS_BAUD, SERIAL_8N1, RX_PIN, TX_PIN);
+  gpsSerial.onReceiveError(onGpsUartError);
+  gpsSerial.onReceive(onGpsUartReceive);
+  Serial.printf("[INFO] GPS UART1 started: RX=%d, TX=%d, baud=%d\n", RX_PIN, TX_PIN, GPS_BAUD);
+#ifdef GPS_USE_UBX
+  ubx.setSatView(&satView);
+  configureGpsUbx();
+#endif
   if (!LittleFS.begin())
   {
     Serial.println("LittleFS mount failed");
     addLog("[ERROR] LittleFS mount failed");
   }
+  else
+  {
+    if (!posLog.begin(LittleFS, "/gpslog.txt"))
+    {
+      addLog("[ERROR] Failed to open gpslog segment for append");
+    }
+    LittleFS.mkdir("/state");
+    resumeTrip();
+    tripIndex.build(LittleFS);
+    if (TripIndexEntry *e = tripActive ? tripIndex.find(tripFileName) : nullptr)
+    {
+      e->active = true;
+      tripIndex.touch();
+    }
+    addLog("[INFO] Trip index: " + String(tripIndex.size()) + " files");
+    loadGeofence();
+  }
   tryLoadWifiConfig();
 
 #ifdef USE_OLED_SCREEN
@@ -618,15 +2589,12 @@ void setup() {
   delay(1000);
 #endif
 
-  // 智能WiFi连接逻辑：预配置模式也支持超时进入AP
-  bool wifiConnected = false;
-  unsigned long wifiConnectStart = millis();
-  const unsigned long WIFI_CONNECT_TIMEOUT = 30000; // 30秒超时
+  registerJobs();
 
-#ifdef wifi_ssid
-  WiFi.begin(wifiSsid, wifiPass);
-  Serial.printf("[INFO] Trying to connect to predefined WiFi: %s\n", wifiSsid);
-#else
+  // 智能WiFi连接逻辑：预配置模式也支持超时进入AP。
+  // 这里只发起连接，结果由 loop() 中的 wifiStep() 处理，GPS 接收不受影响
+  WiFi.onEvent(onWifiEvent);
+#ifndef wifi_ssid
   if (!wifiConfigured)
   {
     // 无配置，直接进入AP配置模式，跳过WiFi连接
@@ -634,113 +2602,17 @@ void setup() {
     enterConfigMode();
     return; // 退出setup函数，不继续WiFi连接流程
   }
-  WiFi.begin(wifiSsid.c_str(), wifiPass.c_str());
-  Serial.printf("[INFO] Trying to connect to saved WiFi: %s\n", wifiSsid.c_str());
-#endif
-  // 等待WiFi连接，但有超时限制
-  while (WiFi.status() != WL_CONNECTED && (millis() - wifiConnectStart < WIFI_CONNECT_TIMEOUT))
-  {
-    // 在等待WiFi连接时处理GPS数据
-    while (gpsSerial.available() > 0)
-    {
-      if (gps.encode(gpsSerial.read()))
-      {
-        lastGpsUpdateTime = millis();
-      }
-    }
-
-    delay(500); // 减少延迟，提高响应速度
-    Serial.println("Connecting to WiFi...");
-
-    // 在连接过程中显示GPS数据和连接状态
-#ifdef USE_OLED_SCREEN
-    display.clearDisplay();
-    display.setTextColor(SSD1306_WHITE);
-    display.setTextSize(1);
-    display.setCursor(0, 0);
-    display.println("Connecting WiFi...");
-    display.printf("Time: %lu s\n", (millis() - wifiConnectStart) / 1000);
-#ifdef wifi_ssid
-    display.printf("SSID: %s\n", wifiSsid);
-#else
-    display.printf("SSID: %s\n", wifiSsid.c_str());
-#endif
-
-    // 显示GPS状态
-    if (gps.location.isValid())
-    {
-      display.printf("GPS: %.6f,%.6f\n", gps.location.lat(), gps.location.lng());
-    }
-    else
-    {
-      display.println("GPS: Searching...");
-    }
-
-    if (gps.speed.isValid())
-    {
-      display.printf("Speed: %.1f km/h\n", gps.speed.kmph());
-    }
-
-    display.display();
-#endif
-  }
-
-  if (WiFi.status() == WL_CONNECTED)
-  {
-    wifiConnected = true;
-    Serial.println("[INFO] Connected to WiFi successfully");
-    Serial.printf("[INFO] IP address: %s\n", WiFi.localIP().toString().c_str());
-    addLog("[INFO] WiFi connected: " + WiFi.localIP().toString());
-
-    // --- mDNS ---
-    if (MDNS.begin("esp32gps"))
-    {
-      Serial.println("mDNS responder started: http://esp32gps.local/");
-      addLog("[INFO] mDNS started: http://esp32gps.local/");
-    }
-    else
-    {
-      Serial.println("Error setting up mDNS responder!");
-      addLog("[ERROR] mDNS failed");
-    }
-  }
-  else
-  {
-    Serial.println("[WARN] WiFi connection timeout, entering AP mode");
-    wifiConnected = false;
-#ifdef wifi_ssid
-    // 预配置模式下，WiFi连接失败后进入数据AP模式
-    enterApMode();
-#else
-    // 无配置时，进入配置AP模式
-    enterConfigMode();
 #endif
-  }
-  // 只有在WiFi连接成功后才尝试时间同步
-  if (wifiConnected)
-  {
-    configTime(8 * 3600, 0, "ntp.aliyun.com", "ntp1.aliyun.com", "pool.ntp.org");
-  }
-
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/index.html", HTTP_GET, handleRoot);
-  server.on("/style.css", HTTP_GET, handleStyle);
-  server.on("/script.js", HTTP_GET, handleScript);
-  server.on("/data", handleData);
-  server.on("/start", HTTP_POST, handleStartTrip);
-  server.on("/start", HTTP_GET, handleStartTrip); // 新增这一行
-  server.on("/stop", HTTP_POST, handleStopTrip);
-  server.on("/stop", HTTP_GET, handleStopTrip); // 新增这一行
-  server.on("/downloads", handleDownloads);
-  server.on("/download", handleDownloadFile);
-  server.begin();
-  Serial.println("HTTP server started");
+  wifiBeginSta();
+  setWifiState(WifiState::Connecting);
+  Serial.printf("[INFO] Trying to connect to WiFi: %s\n", String(wifiSsid).c_str());
   listLittleFSFiles(); // 启动后串口输出所有文件列表
 }
 
 void enterConfigMode()
 {
   configModeActive = true;
+  setWifiState(WifiState::Config);
   Serial.println("[CONFIG MODE] Starting AP for WiFi configuration");
   addLog("[CONFIG MODE] Starting AP for WiFi configuration");
 
@@ -754,6 +2626,7 @@ void enterConfigMode()
   display.println("ESP32-GPS-Config");
   display.println("192.168.4.1");
   display.display();
+  oledNeedsClear = true;
 #endif
   WiFi.mode(WIFI_AP);
   WiFi.softAP("ESP32-GPS-Config");
@@ -788,6 +2661,7 @@ void enterConfigMode()
     server.send(302, "text/plain", ""); });
 
   server.begin();
+  startHttpTask();
 
   Serial.println("[CONFIG MODE] AP started: SSID=ESP32-GPS-Config, IP=192.168.4.1");
   Serial.println("[CONFIG MODE] Captive Portal active - all requests redirect to WiFi config");
@@ -800,202 +2674,298 @@ void enterApMode()
   if (apModeActive)
     return;
   apModeActive = true;
+  setWifiState(WifiState::ApFallback);
   WiFi.disconnect();
   WiFi.mode(WIFI_AP);
   WiFi.softAP("GPS-AP-Data");
   IPAddress apIP(192, 168, 4, 1);
   WiFi.softAPConfig(apIP, apIP, IPAddress(255, 255, 255, 0));
-  server.close();
-  server.stop();
-  delay(100);
-  // 重新设置路由并启动server
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/index.html", HTTP_GET, handleRoot);
-  server.on("/style.css", HTTP_GET, handleStyle);
-  server.on("/script.js", HTTP_GET, handleScript);
-  server.on("/data", handleData);
-  server.on("/downloads", handleDownloads);
-  server.on("/download", handleDownloadFile);
-  server.begin();
+  // 重新设置路由并启动server（开机即超时的情况下 HTTP 任务尚未启动）
+  restartHttpServer(false);
+  startHttpTask();
   Serial.println("[AP MODE] Started AP for data access: SSID=GPS-AP-Data");
   addLog("[AP MODE] Started AP for data access: SSID=GPS-AP-Data");
 }
 
-void loop()
-{ // 每10秒输出一次调试日志，减少日志频率
-  static unsigned long lastDebug = 0;
-  if (millis() - lastDebug > 10000)
+// WiFi 事件任务中调用：只记录事件，状态切换留给 loop()
+void onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t)
+{
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+    wifiGotIpEvent = true;
+  else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
+    wifiDisconnectEvent = true;
+  else
+    return;
+  scheduler.schedule(wifiJob, 0);
+}
+
+void setWifiState(WifiState state)
+{
+  wifiState = state;
+  wifiStateSince = millis();
+}
+
+void wifiBeginSta()
+{
+#ifdef wifi_ssid
+  WiFi.begin(wifiSsid, wifiPass);
+#else
+  WiFi.begin(wifiSsid.c_str(), wifiPass.c_str());
+#endif
+}
+
+// 取得IP后的收尾工作：mDNS 与时间同步
+void onWifiConnected()
+{
+  Serial.printf("[INFO] IP address: %s\n", WiFi.localIP().toString().c_str());
+  addLog("[INFO] WiFi connected: " + WiFi.localIP().toString());
+  MDNS.end();
+  if (MDNS.begin("esp32gps"))
   {
-    addLog("[DEBUG] loop running, waiting for GPS data...");
-    lastDebug = millis();
+    Serial.println("mDNS responder started: http://esp32gps.local/");
+    addLog("[INFO] mDNS started: http://esp32gps.local/");
   }
+  else
+  {
+    Serial.println("Error setting up mDNS responder!");
+    addLog("[ERROR] mDNS failed");
+  }
+  configTime(8 * 3600, 0, "ntp.aliyun.com", "ntp1.aliyun.com", "pool.ntp.org");
+}
 
-  // 检查是否有来自 GPS 模块的数据
-  if (gpsSerial.available() > 0) {
-    char c = gpsSerial.read();
-    Serial.write(c); // 打印所有GPS原始数据，便于调试
-    gps.encode(c);  // 解码接收到的 GPS 数据
-
-    if (c == '\n')
+// 推进一次WiFi状态机，只做状态判断和异步调用，立即返回
+void wifiStep()
+{
+  bool gotIp = wifiGotIpEvent;
+  bool disconnected = wifiDisconnectEvent;
+  wifiGotIpEvent = false;
+  wifiDisconnectEvent = false;
+  bool connected = gotIp || WiFi.status() == WL_CONNECTED;
+  unsigned long elapsed = millis() - wifiStateSince;
+
+  switch (wifiState)
+  {
+  case WifiState::Connecting:
+    if (connected)
     {
-      addLog(lineBuffer);
-      lineBuffer = "";
+      Serial.println("[INFO] Connected to WiFi successfully");
+      onWifiConnected();
+      restartHttpServer(true);
+      startHttpTask();
+      Serial.println("HTTP server started");
+      setWifiState(WifiState::Connected);
     }
-    else if (c != '\r')
+    else if (elapsed > WIFI_CONNECT_TIMEOUT)
     {
-      lineBuffer += c;
-    } // 如果 GPS 数据更新了，打印相关信息
-    if (gps.location.isUpdated()) {
-      lastGpsUpdateTime = millis(); // 记录GPS数据更新时间
-      String logMsg = "Latitude= " + String(gps.location.lat(), 6) +
-                      " Longitude= " + String(gps.location.lng(), 6) +
-                      " Altitude= " + String(gps.altitude.meters()) +
-                      " Speed= " + String(gps.speed.kmph());
-      Serial.println(logMsg);
-      addLog(logMsg);
-      // 写入LittleFS
-      writePositionToFS(gps.location.lat(), gps.location.lng(), gps.altitude.meters(), gps.speed.kmph());
-      writeTripData(gps.location.lat(), gps.location.lng(), gps.altitude.meters(), gps.speed.kmph());
+      Serial.println("[WARN] WiFi connection timeout, entering AP mode");
+#ifdef wifi_ssid
+      // 预配置模式下，WiFi连接失败后进入数据AP模式
+      enterApMode();
+#else
+      // 已保存的配置连不上时，进入配置AP模式
+      enterConfigMode();
+#endif
     }
-  }
+    break;
 
-  static unsigned long lastTripWrite = 0;
-  if (tripActive)
-  {
-    if (millis() - lastTripWrite > 1000)
-    {
-      lastTripWrite = millis();
-      double lat = gps.location.isValid() ? gps.location.lat() : 0.0;
-      double lng = gps.location.isValid() ? gps.location.lng() : 0.0;
-      double alt = gps.location.isValid() ? gps.altitude.meters() : 0.0;
-      double spd = gps.location.isValid() ? gps.speed.kmph() : 0.0;
-      writeTripData(lat, lng, alt, spd);
-    }
-  }
-  // WiFi掉线检测与AP切换
-  if (!apModeActive)
-  {
-    if (WiFi.status() != WL_CONNECTED)
+  case WifiState::Connected:
+    if (disconnected || !connected)
     {
-      if (wifiLostTime == 0)
-      {
-        wifiLostTime = millis();
-        Serial.println("[WARN] WiFi connection lost, starting timer...");
-        addLog("[WARN] WiFi connection lost");
-      }
-      else if (millis() - wifiLostTime > 30000)
-      { // 30秒无网
-        Serial.println("[WARN] WiFi disconnected for 30s, entering AP mode");
-        enterApMode();
-      }
+      wifiLostTime = millis();
+      Serial.println("[WARN] WiFi connection lost, starting timer...");
+      addLog("[WARN] WiFi connection lost");
+      setWifiState(WifiState::Lost);
     }
-    else
+    break;
+
+  case WifiState::Lost:
+    if (connected)
     {
-      // WiFi重新连接成功
-      if (wifiLostTime > 0)
-      {
-        Serial.println("[INFO] WiFi reconnected successfully");
-        addLog("[INFO] WiFi reconnected: " + WiFi.localIP().toString());
-      }
+      // 驱动自动重连成功
+      Serial.println("[INFO] WiFi reconnected successfully");
+      addLog("[INFO] WiFi reconnected: " + WiFi.localIP().toString());
       wifiLostTime = 0;
+      setWifiState(WifiState::Connected);
     }
-  }
-  else
-  {
+    else if (elapsed > WIFI_CONNECT_TIMEOUT)
+    { // 30秒无网
+      Serial.println("[WARN] WiFi disconnected for 30s, entering AP mode");
+      enterApMode();
+    }
+    break;
+
+  case WifiState::ApFallback:
     // 在AP模式下，定期尝试重连原WiFi网络
-    if (millis() - lastWifiRetryTime > WIFI_RETRY_INTERVAL)
+    if (elapsed > WIFI_RETRY_INTERVAL)
     {
-      lastWifiRetryTime = millis();
-      wifiRetrying = true; // 设置重连状态标志
+      wifiRetrying = true;
       Serial.println("[INFO] Attempting to reconnect to WiFi from AP mode...");
       addLog("[INFO] Attempting WiFi reconnection...");
-      // 临时切换到Station+AP模式尝试连接
+      // 临时切换到Station+AP模式，AP 上的客户端不受影响
       WiFi.mode(WIFI_AP_STA);
-      WiFi.begin(wifi_ssid, wifi_password);
+      wifiBeginSta();
+      setWifiState(WifiState::ApRetrying);
+    }
+    break;
 
-      // 等待连接最多15秒
-      unsigned long connectStart = millis();
-      while (WiFi.status() != WL_CONNECTED && millis() - connectStart < 15000)
-      {
-        delay(500);
-        Serial.print(".");
+  case WifiState::ApRetrying:
+    if (connected)
+    {
+      Serial.println("[INFO] WiFi reconnected successfully, exiting AP mode");
+      addLog("[INFO] WiFi recovered: " + WiFi.localIP().toString());
+      // 成功连接，退出AP模式，恢复完整路由
+      wifiRetrying = false;
+      apModeActive = false;
+      wifiLostTime = 0;
+      WiFi.mode(WIFI_STA);
+      restartHttpServer(true);
+      onWifiConnected();
+      setWifiState(WifiState::Connected);
+    }
+    else if (elapsed > WIFI_RETRY_TIMEOUT)
+    {
+      Serial.println("[INFO] WiFi reconnection failed, staying in AP mode");
+      addLog("[INFO] WiFi reconnection failed");
+      // 连接失败，切换回纯AP模式
+      wifiRetrying = false;
+      WiFi.mode(WIFI_AP);
+      setWifiState(WifiState::ApFallback);
+    }
+    break;
 
-        // 在等待期间继续处理GPS数据
-        if (gpsSerial.available() > 0)
-        {
-          char c = gpsSerial.read();
-          gps.encode(c);
-        }
-      }
+  case WifiState::Config:
+    break; // 配置保存后设备重启
+  }
+}
 
-      wifiRetrying = false; // 清除重连状态标志
+// 主循环作业。码表补行和检查点是单次作业，每写一行/一次检查点后重新排期
+void jobDebugLog()
+{
+  // 每10秒输出一次调试日志，减少日志频率
+  addLog("[DEBUG] loop running, waiting for GPS data...");
+  if (gpsRxOverflows > 0 || gpsDroppedBytes > 0)
+  {
+    addLog("[WARN] GPS UART overflows=" + String(gpsRxOverflows) +
+           " dropped=" + String(gpsDroppedBytes));
+  }
+#ifdef GPS_USE_UBX
+  if (ubx.checksumErrors() > 0 || ubx.naks() > 0)
+  {
+    addLog("[WARN] UBX checksum errors=" + String(ubx.checksumErrors()) +
+           " NAK=" + String(ubx.naks()));
+  }
+#endif
+#if defined(USE_OLED_SCREEN) || defined(USE_ST7735_SCREEN)
+  addLog("[DEBUG] display render last=" + String(displayRenderUs) + "us max=" + String(displayRenderMaxUs) + "us");
+  displayRenderMaxUs = 0;
+#endif
+}
 
-      if (WiFi.status() == WL_CONNECTED)
-      {
-        Serial.println();
-        Serial.println("[INFO] WiFi reconnected successfully, exiting AP mode");
-        addLog("[INFO] WiFi recovered: " + WiFi.localIP().toString());
-
-        // 成功连接，退出AP模式
-        apModeActive = false;
-        wifiLostTime = 0;
-        WiFi.mode(WIFI_STA); // 切换回纯Station模式
-
-        // 重启server和mDNS服务
-        server.close();
-        server.stop();
-        delay(100);
-
-        // 重新设置路由
-        server.on("/", HTTP_GET, handleRoot);
-        server.on("/index.html", HTTP_GET, handleRoot);
-        server.on("/style.css", HTTP_GET, handleStyle);
-        server.on("/script.js", HTTP_GET, handleScript);
-        server.on("/data", handleData);
-        server.on("/start", HTTP_POST, handleStartTrip);
-        server.on("/start", HTTP_GET, handleStartTrip);
-        server.on("/stop", HTTP_POST, handleStopTrip);
-        server.on("/stop", HTTP_GET, handleStopTrip);
-        server.on("/downloads", handleDownloads);
-        server.on("/download", handleDownloadFile);
-        server.begin();
-
-        // 重启mDNS服务
-        MDNS.end();
-        if (MDNS.begin("esp32gps"))
-        {
-          Serial.println("[INFO] mDNS restarted after WiFi recovery");
-          addLog("[INFO] mDNS restarted");
-        }
-      }
-      else
-      {
-        Serial.println();
-        Serial.println("[INFO] WiFi reconnection failed, staying in AP mode");
-        addLog("[INFO] WiFi reconnection failed");
+void jobTripGap()
+{
+  StateLock lock;
+  StageTimer timer(Stage::Housekeep);
+  if (!tripActive)
+  {
+    return;
+  }
+  // 定位行由 onGpsFix() 写入；这里只补无定位期间的时间戳行，避免重复
+  unsigned long idle = millis() - lastTripRowTime;
+  if (idle > TRIP_GAP_MS)
+  {
+    writeTripGap();
+  }
+  else
+  {
+    scheduler.schedule(tripGapJob, TRIP_GAP_MS + 1 - idle);
+  }
+}
 
-        // 连接失败，切换回纯AP模式
-        WiFi.mode(WIFI_AP);
-      }
-    }
+void jobCheckpoint()
+{
+  StateLock lock;
+  StageTimer timer(Stage::Housekeep);
+  if (tripActive)
+  {
+    writeTripCheckpoint();
   }
+}
 
-  // 屏幕更新限制频率，避免过于频繁
-  static unsigned long lastScreenUpdate = 0;
-  if (millis() - lastScreenUpdate > 100) // 每100ms更新一次屏幕
+void jobFlush()
+{
+  StateLock lock;
+  StageTimer timer(Stage::Housekeep);
+  tripWriter.flushIfDue(millis());
+  posLog.flushIfDue(millis());
+}
+
+// 推送通道：状态变化时广播，并推进慢客户端未发完的帧
+void jobPush()
+{
+  StateLock lock;
+  StageTimer timer(Stage::Housekeep);
+  publishStateIfChanged();
+  sseHub.pump();
+  if (sseHub.backlogged())
   {
-    lastScreenUpdate = millis();
+    scheduler.schedule(pushJob, 10);
+  }
+}
+
+// WiFi连接、掉线检测与AP切换
+void jobWifi()
+{
+  StageTimer timer(Stage::Wifi);
+  wifiStep();
+}
+
+#if defined(USE_OLED_SCREEN) || defined(USE_ST7735_SCREEN)
+void jobDisplay()
+{
+  StageTimer timer(Stage::Display);
+  unsigned long renderStart = micros();
 #ifdef USE_OLED_SCREEN
-    updateOled();
+  updateOled();
 #endif
 #ifdef USE_ST7735_SCREEN
-    updateSt7735();
+  updateSt7735();
 #endif
-  }
-  server.handleClient();
-  if (configModeActive)
+  displayRenderUs = micros() - renderStart;
+  if (displayRenderUs > displayRenderMaxUs)
+    displayRenderMaxUs = displayRenderUs;
+}
+#endif
+
+// 没有作业到期时的最长睡眠（兜底，周期作业通常更早到期）
+#define LOOP_MAX_SLEEP_MS 1000
+
+void registerJobs()
+{
+  scheduler.every("debug_log", 10000, jobDebugLog, 10000);
+  scheduler.every("flush", 1000, jobFlush);
+  pushJob = scheduler.every("push", 250, jobPush);
+  wifiJob = scheduler.every("wifi", 100, jobWifi);
+#if defined(USE_OLED_SCREEN) || defined(USE_ST7735_SCREEN)
+  scheduler.every("display", 100, jobDisplay); // 屏幕更新限制频率，避免过于频繁
+#endif
+  tripGapJob = scheduler.once("trip_gap", jobTripGap);
+  checkpointJob = scheduler.once("checkpoint", jobCheckpoint);
+  // setup() 中续写的码表
+  if (tripActive)
   {
-    dnsServer.processNextRequest(); // 处理DNS请求，用于Captive Portal
+    scheduler.schedule(tripGapJob, TRIP_GAP_MS + 1);
+    scheduler.schedule(checkpointJob, TRIP_CHECKPOINT_MS);
   }
-  delay(1); // 减少延迟，提高响应速度
+}
+
+void loop()
+{
+  uint32_t loopStart = ESP.getCycleCount();
+  // 处理 UART 事件任务已接收的全部 GPS 数据
+  drainGps();
+  uint32_t waitMs = scheduler.dispatch(LOOP_MAX_SLEEP_MS);
+  loopMetrics.record(Stage::Loop, ESP.getCycleCount() - loopStart);
+  // HTTP 请求和 Captive Portal DNS 在独立任务中处理；这里睡到下一个作业的截止时间，
+  // 串口收到数据或 WiFi 事件时提前唤醒
+  scheduler.sleep(waitMs);
 }
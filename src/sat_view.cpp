@@ -0,0 +1,398 @@
+#include "sat_view.h"
+#include <string.h>
+
+const char *satSystemName(SatSystem s)
+{
+  switch (s)
+  {
+  case SatSystem::Gps:
+    return "GPS";
+  case SatSystem::Sbas:
+    return "SBAS";
+  case SatSystem::Glonass:
+    return "GLONASS";
+  case SatSystem::Galileo:
+    return "Galileo";
+  case SatSystem::Beidou:
+    return "BeiDou";
+  case SatSystem::Qzss:
+    return "QZSS";
+  default:
+    return "?";
+  }
+}
+
+// 发送方序号：1 GP，2 GL，3 GA，4 GB，5 BD，6 GQ，7 GN；0 为其他
+static uint8_t talkerSource(const char *a)
+{
+  static const char talkers[][3] = {"GP", "GL", "GA", "GB", "BD", "GQ", "GN"};
+  for (uint8_t i = 0; i < sizeof(talkers) / sizeof(talkers[0]); i++)
+  {
+    if (a[0] == talkers[i][0] && a[1] == talkers[i][1])
+      return i + 1;
+  }
+  return 0;
+}
+
+// 按 NMEA 编号段区分 GP/GN 语句里的系统
+static SatSystem systemByPrn(uint8_t prn)
+{
+  if (prn >= 1 && prn <= 32)
+    return SatSystem::Gps;
+  if (prn >= 33 && prn <= 64)
+    return SatSystem::Sbas;
+  if (prn >= 65 && prn <= 96)
+    return SatSystem::Glonass;
+  if (prn >= 193 && prn <= 202)
+    return SatSystem::Qzss;
+  return SatSystem::Unknown;
+}
+
+// systemId 为 NMEA 4.10 GSA 的系统编号（1 GPS，2 GLONASS，3 Galileo，4 BeiDou，5 QZSS），0 表示没有
+static SatSystem satSystemOf(uint8_t source, uint8_t prn, uint8_t systemId)
+{
+  switch (source)
+  {
+  case 2:
+    return SatSystem::Glonass;
+  case 3:
+    return SatSystem::Galileo;
+  case 4:
+  case 5:
+    return SatSystem::Beidou;
+  case 6:
+    return SatSystem::Qzss;
+  case 7:
+    switch (systemId)
+    {
+    case 2:
+      return SatSystem::Glonass;
+    case 3:
+      return SatSystem::Galileo;
+    case 4:
+      return SatSystem::Beidou;
+    case 5:
+      return SatSystem::Qzss;
+    }
+    return systemByPrn(prn);
+  default:
+    return systemByPrn(prn);
+  }
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+bool SatView::parse(char c)
+{
+  if (c == '$')
+  {
+    startSentence();
+    return false;
+  }
+  switch (_state)
+  {
+  case IDLE:
+  case SKIP:
+    return false;
+  case ADDRESS:
+    if (c != ',')
+    {
+      _sum ^= c;
+      if (_addrLen < sizeof(_addr))
+        _addr[_addrLen++] = c;
+      else
+        _state = SKIP;
+      return false;
+    }
+    _sum ^= c;
+    _kind = NONE;
+    if (_addrLen == 5 && _addr[2] == 'G' && _addr[3] == 'S')
+    {
+      if (_addr[4] == 'V')
+        _kind = GSV;
+      else if (_addr[4] == 'A')
+        _kind = GSA;
+    }
+    // 两条 GSA 之间出现其他语句，说明已是下一个历元
+    if (_kind != GSA)
+      _lastWasGsa = false;
+    if (_kind == NONE)
+    {
+      _state = SKIP;
+      return false;
+    }
+    _source = talkerSource(_addr);
+    _field = 1;
+    _state = FIELD;
+    return false;
+  case FIELD:
+    if (c == '*')
+    {
+      endField();
+      _state = CK_HI;
+      return false;
+    }
+    _sum ^= c;
+    if (c == ',')
+    {
+      endField();
+      if (_field < 255)
+        _field++;
+    }
+    else if (c >= '0' && c <= '9')
+    {
+      _empty = false;
+      if (!_dot)
+      {
+        if (_int < 100000)
+          _int = _int * 10 + (c - '0');
+      }
+      else if (_fracDigits < 2)
+      {
+        _frac = _frac * 10 + (c - '0');
+        _fracDigits++;
+      }
+    }
+    else if (c == '.' && !_dot)
+      _dot = true;
+    else if (c == '\r' || c == '\n')
+      _state = IDLE; // 没有校验和的语句不采用
+    else
+      _bad = true;
+    return false;
+  case CK_HI:
+  {
+    int v = hexValue(c);
+    if (v < 0)
+    {
+      _state = IDLE;
+      return false;
+    }
+    _rxSum = v << 4;
+    _state = CK_LO;
+    return false;
+  }
+  case CK_LO:
+  {
+    _state = IDLE;
+    int v = hexValue(c);
+    if (v < 0 || (_rxSum | v) != _sum)
+    {
+      _checksumErrors++;
+      return false;
+    }
+    _sentences++;
+    return commitSentence();
+  }
+  }
+  return false;
+}
+
+void SatView::startSentence()
+{
+  _state = ADDRESS;
+  _kind = NONE;
+  _addrLen = 0;
+  _sum = 0;
+  _field = 0;
+  _int = _frac = _fracDigits = 0;
+  _dot = _bad = false;
+  _empty = true;
+  _gsvTotal = _gsvNum = _gsvInView = 0;
+  for (SatInfo &s : _msg)
+    s = SatInfo();
+  _gsaPrnCount = 0;
+  _gsaSystemId = 0;
+  _gsaDop = SatDop();
+}
+
+// 字段结束：按语句类型和字段序号写入暂存区，然后清空字段状态
+void SatView::endField()
+{
+  // 含非法字符的字段按空字段处理
+  bool empty = _empty || _bad;
+  uint32_t v = _int;
+  uint16_t x100 = (uint16_t)((v > 600 ? 600 : v) * 100 + (_fracDigits == 1 ? _frac * 10 : _frac));
+  uint8_t f = _field;
+  _int = _frac = _fracDigits = 0;
+  _dot = _bad = false;
+  _empty = true;
+
+  if (_kind == GSV)
+  {
+    if (f == 1)
+      _gsvTotal = empty ? 0 : (uint8_t)(v > 9 ? 0 : v);
+    else if (f == 2)
+      _gsvNum = empty ? 0 : (uint8_t)(v > 9 ? 0 : v);
+    else if (f == 3)
+      _gsvInView = empty ? 0 : (uint8_t)(v > 255 ? 255 : v);
+    else if (f >= 4 && f < 4 + 4 * GSV_PER_MSG)
+    {
+      SatInfo &s = _msg[(f - 4) / 4];
+      switch ((f - 4) % 4)
+      {
+      case 0:
+        s.prn = (empty || v > 255) ? 0 : v;
+        break;
+      case 1:
+        s.elevDeg = (empty || v > 90) ? (int8_t)-1 : (int8_t)v;
+        break;
+      case 2:
+        s.azDeg = (empty || v > 359) ? 0xFFFF : (uint16_t)v;
+        break;
+      case 3:
+        s.snr = (empty || v > 99) ? 0 : v;
+        break;
+      }
+    }
+  }
+  else if (_kind == GSA)
+  {
+    if (empty)
+      return;
+    if (f == 2)
+      _gsaDop.fixType = v <= 3 ? v : 0;
+    else if (f >= 3 && f < 3 + GSA_MAX_PRN)
+    {
+      if (v > 0 && v <= 255)
+        _gsaPrn[_gsaPrnCount++] = v;
+    }
+    else if (f == 15)
+      _gsaDop.pdopX100 = x100;
+    else if (f == 16)
+      _gsaDop.hdopX100 = x100;
+    else if (f == 17)
+      _gsaDop.vdopX100 = x100;
+    else if (f == 18)
+      _gsaSystemId = v <= 15 ? v : 0;
+  }
+}
+
+bool SatView::commitSentence()
+{
+  if (_kind == GSV)
+    return commitGsv();
+  if (_kind == GSA)
+    return commitGsa();
+  return false;
+}
+
+// 一组 GSV 的各条语句依次到达，全部收齐才替换同一来源的卫星；中途缺一条则整组丢弃
+bool SatView::commitGsv()
+{
+  if (_gsvTotal == 0 || _gsvNum == 0 || _gsvNum > _gsvTotal)
+    return false;
+  if (_gsvNum == 1)
+  {
+    beginCycle(_source);
+    _nextTotal = _gsvTotal;
+    _nextExpect = 1;
+  }
+  if (_nextExpect != _gsvNum || _nextSource != _source || _nextTotal != _gsvTotal)
+  {
+    _nextExpect = 0;
+    return false;
+  }
+  // 本条实际包含的卫星数；多出的字段（NMEA 4.10 的信号编号）忽略
+  uint16_t before = (uint16_t)GSV_PER_MSG * (_gsvNum - 1);
+  uint8_t n = _gsvInView > before ? _gsvInView - before : 0;
+  if (n > GSV_PER_MSG)
+    n = GSV_PER_MSG;
+  for (uint8_t i = 0; i < n; i++)
+  {
+    SatInfo &s = _msg[i];
+    if (s.prn == 0)
+      continue;
+    s.system = satSystemOf(_source, s.prn, 0);
+    s.used = isUsed(s.system, s.prn);
+    add(s);
+  }
+  if (_gsvNum < _gsvTotal)
+  {
+    _nextExpect++;
+    return false;
+  }
+  _nextExpect = 0;
+  commitCycle();
+  return true;
+}
+
+bool SatView::commitGsa()
+{
+  // 多系统接收机每个历元按系统各发一条 GSA，连续到达的几条合并
+  if (!_lastWasGsa)
+    memset(_usedMap, 0, sizeof(_usedMap));
+  _lastWasGsa = true;
+  for (uint8_t i = 0; i < _gsaPrnCount; i++)
+  {
+    uint8_t prn = _gsaPrn[i];
+    SatSystem sys = satSystemOf(_source, prn, _gsaSystemId);
+    _usedMap[(uint8_t)sys][prn >> 3] |= 1 << (prn & 7);
+  }
+  setDop(_gsaDop);
+  markUsed();
+  return true;
+}
+
+void SatView::markUsed()
+{
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if (_sats[i].source != SAT_SOURCE_UBX)
+      _sats[i].used = isUsed(_sats[i].system, _sats[i].prn);
+  }
+}
+
+void SatView::beginCycle(uint8_t source)
+{
+  _nextCount = 0;
+  _nextSource = source;
+}
+
+void SatView::add(const SatInfo &s)
+{
+  if (_nextCount >= SAT_VIEW_MAX)
+    return;
+  _next[_nextCount] = s;
+  _next[_nextCount].source = _nextSource;
+  _nextCount++;
+}
+
+void SatView::commitCycle()
+{
+  // 先去掉同一来源的旧卫星（保持其余来源的顺序），再追加新的一组
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if (_sats[i].source != _nextSource)
+      _sats[kept++] = _sats[i];
+  }
+  for (uint8_t i = 0; i < _nextCount && kept < SAT_VIEW_MAX; i++)
+    _sats[kept++] = _next[i];
+  _count = kept;
+  _nextCount = 0;
+  _updates++;
+}
+
+void SatView::setDop(const SatDop &dop)
+{
+  _dop = dop;
+  _updates++;
+}
+
+uint8_t SatView::usedCount() const
+{
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < _count; i++)
+    n += _sats[i].used;
+  return n;
+}
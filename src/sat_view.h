@@ -0,0 +1,145 @@
+#pragma once
+// 卫星视图：可见卫星表（PRN、仰角、方位角、信噪比、是否参与定位）和 PDOP/HDOP/VDOP。
+// NMEA 模式下逐字节解析 GSV/GSA（不经过 TinyGPSPlus），UBX 模式由 NAV-SVINFO/NAV-DOP 填充。
+// 所有表都是定长数组，不分配内存；每字节只做一次状态判断，其他语句在地址字段后即被跳过，
+// 一条语句的提交代价以 SAT_VIEW_MAX 为上限。只依赖标准库，可在主机上回放验证。
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SAT_VIEW_MAX
+#define SAT_VIEW_MAX 32
+#endif
+// UBX NAV-SVINFO 的来源编号；NMEA 来源为发送方（GP/GL/GA/GB/BD/GQ/GN）的序号 1..7
+#define SAT_SOURCE_UBX 8
+
+enum class SatSystem : uint8_t
+{
+  Gps,
+  Sbas,
+  Glonass,
+  Galileo,
+  Beidou,
+  Qzss,
+  Unknown,
+  Count
+};
+
+const char *satSystemName(SatSystem s);
+
+struct SatInfo
+{
+  uint8_t prn = 0;       // NMEA 编号（SBAS 为 33..64，GLONASS 为 65..96）
+  SatSystem system = SatSystem::Unknown;
+  int8_t elevDeg = -1;   // -1 表示未知（尚未解出星历）
+  uint16_t azDeg = 0xFFFF; // 0xFFFF 表示未知
+  uint8_t snr = 0;       // dB-Hz，0 表示未跟踪
+  bool used = false;     // 参与定位解算
+  uint8_t source = 0;    // 来源语句的发送方（GP/GL/GN...），同一来源整组替换
+};
+
+struct SatDop
+{
+  uint16_t pdopX100 = 0; // 0 表示未知
+  uint16_t hdopX100 = 0;
+  uint16_t vdopX100 = 0;
+  uint8_t fixType = 0; // GSA 定位模式：1 无定位，2 二维，3 三维；0 未知
+};
+
+class SatView
+{
+public:
+  // NMEA：逐字节输入；返回 true 表示刚提交了一组 GSV 或一条 GSA（校验通过）。
+  // 跳过的语句在内联的快速路径上返回，不进入解析函数
+  bool feed(char c)
+  {
+    if (c != '$' && (_state == IDLE || _state == SKIP))
+      return false;
+    return parse(c);
+  }
+
+  // 整组来源（UBX NAV-SVINFO）：begin 之后逐颗 add，commit 时替换同一来源的全部卫星
+  void beginCycle(uint8_t source);
+  void add(const SatInfo &s);
+  void commitCycle();
+  void setDop(const SatDop &dop);
+
+  uint8_t count() const { return _count; }
+  const SatInfo &at(uint8_t i) const { return _sats[i]; }
+  const SatDop &dop() const { return _dop; }
+  uint8_t usedCount() const;
+  // 每次提交加一，可用于判断内容是否变化
+  uint32_t updates() const { return _updates; }
+  uint32_t sentences() const { return _sentences; }
+  uint32_t checksumErrors() const { return _checksumErrors; }
+
+private:
+  enum State : uint8_t
+  {
+    IDLE,     // 等待 '$'
+    ADDRESS,  // 发送方 + 语句类型，如 GPGSV
+    FIELD,    // 数据字段
+    CK_HI,    // '*' 之后两位十六进制校验和
+    CK_LO,
+    SKIP      // 不关心的语句，等待下一个 '$'
+  };
+  enum Kind : uint8_t
+  {
+    NONE,
+    GSV,
+    GSA
+  };
+  static const uint8_t GSV_PER_MSG = 4;
+  static const uint8_t GSA_MAX_PRN = 12;
+
+  bool parse(char c);
+  void startSentence();
+  void endField();
+  bool commitSentence();
+  bool commitGsv();
+  bool commitGsa();
+  void markUsed();
+  bool isUsed(SatSystem sys, uint8_t prn) const { return _usedMap[(uint8_t)sys][prn >> 3] & (1 << (prn & 7)); }
+
+  // 当前语句
+  State _state = IDLE;
+  Kind _kind = NONE;
+  char _addr[5];
+  uint8_t _addrLen = 0;
+  uint8_t _source = 0;
+  uint8_t _sum = 0;
+  uint8_t _rxSum = 0;
+  uint8_t _field = 0;
+  // 当前字段：整数部分、最多两位小数（DOP 按 ×100 取整），以及是否为空
+  uint32_t _int = 0;
+  uint8_t _frac = 0;
+  uint8_t _fracDigits = 0;
+  bool _dot = false;
+  bool _empty = true;
+  bool _bad = false; // 字段中出现非数字字符
+
+  // 已校验之前只写入暂存区
+  uint8_t _gsvTotal = 0, _gsvNum = 0, _gsvInView = 0;
+  SatInfo _msg[GSV_PER_MSG];
+  uint8_t _gsaPrn[GSA_MAX_PRN];
+  uint8_t _gsaPrnCount = 0;
+  uint8_t _gsaSystemId = 0; // NMEA 4.10 GSA 末尾的系统编号，0 表示没有
+  SatDop _gsaDop;
+
+  // 正在拼接的一组 GSV（多条语句）
+  SatInfo _next[SAT_VIEW_MAX];
+  uint8_t _nextCount = 0;
+  uint8_t _nextSource = 0;
+  uint8_t _nextExpect = 0; // 下一条应到达的语句序号，0 表示没有进行中的一组
+  uint8_t _nextTotal = 0;
+
+  // 已发布的视图
+  SatInfo _sats[SAT_VIEW_MAX];
+  uint8_t _count = 0;
+  SatDop _dop;
+  uint8_t _usedMap[(uint8_t)SatSystem::Count][32] = {}; // 按系统和 PRN（0..255）标记参与定位的卫星
+  bool _lastWasGsa = false;   // 连续的 GSA（多系统各一条）属于同一历元
+
+  uint32_t _updates = 0;
+  uint32_t _sentences = 0;
+  uint32_t _checksumErrors = 0;
+};
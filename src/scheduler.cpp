@@ -0,0 +1,180 @@
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+// 截止时间比较：按有符号差值，micros() 回绕后仍然正确
+static inline bool reached(uint32_t now, uint32_t deadline) { return (int32_t)(now - deadline) >= 0; }
+
+void Scheduler::begin()
+{
+  _lock = xSemaphoreCreateMutex();
+  _owner = xTaskGetCurrentTaskHandle();
+  for (int8_t &s : _slots)
+    s = -1;
+  _lastTick = micros() >> SCHED_TICK_SHIFT;
+}
+
+int8_t Scheduler::add(const char *name, uint32_t periodUs, JobFn fn)
+{
+  if (_count >= SCHED_MAX_JOBS)
+    return -1;
+  Job &j = _jobs[_count];
+  j.name = name;
+  j.fn = fn;
+  j.periodUs = periodUs;
+  return _count++;
+}
+
+int8_t Scheduler::every(const char *name, uint32_t periodMs, JobFn fn, uint32_t firstDelayMs)
+{
+  int8_t job = add(name, periodMs * 1000, fn);
+  if (job >= 0)
+    schedule(job, firstDelayMs);
+  return job;
+}
+
+int8_t Scheduler::once(const char *name, JobFn fn) { return add(name, 0, fn); }
+
+void Scheduler::link(int8_t job)
+{
+  uint8_t slot = slotOf(_jobs[job].deadline);
+  _jobs[job].next = _slots[slot];
+  _slots[slot] = job;
+  _jobs[job].armed = true;
+}
+
+void Scheduler::unlink(int8_t job)
+{
+  if (!_jobs[job].armed)
+    return;
+  int8_t *p = &_slots[slotOf(_jobs[job].deadline)];
+  while (*p >= 0 && *p != job)
+    p = &_jobs[*p].next;
+  if (*p == job)
+    *p = _jobs[job].next;
+  _jobs[job].armed = false;
+}
+
+void Scheduler::schedule(int8_t job, uint32_t delayMs)
+{
+  if (job < 0 || job >= _count)
+    return;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  unlink(job);
+  _jobs[job].deadline = micros() + delayMs * 1000;
+  link(job);
+  xSemaphoreGive(_lock);
+  // 其他任务排期的作业可能早于主循环当前的睡眠截止时间
+  if (xTaskGetCurrentTaskHandle() != _owner)
+    wake();
+}
+
+void Scheduler::cancel(int8_t job)
+{
+  if (job < 0 || job >= _count)
+    return;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  unlink(job);
+  xSemaphoreGive(_lock);
+}
+
+void Scheduler::wake()
+{
+  if (_owner)
+    xTaskNotifyGive(_owner);
+}
+
+uint32_t Scheduler::dispatch(uint32_t maxWaitMs)
+{
+  // 取出经过的槽中已到期的作业，解锁后再运行：作业里可以再排期，其他任务也不必等作业运行完
+  int8_t due[SCHED_MAX_JOBS];
+  uint8_t dueCount = 0;
+  uint32_t now = micros();
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  uint32_t tick = now >> SCHED_TICK_SHIFT;
+  uint32_t span = tick - _lastTick + 1;
+  if (span > SCHED_WHEEL_SLOTS)
+    span = SCHED_WHEEL_SLOTS;
+  for (uint32_t t = tick - span + 1; t != tick + 1; t++)
+  {
+    int8_t *p = &_slots[t & (SCHED_WHEEL_SLOTS - 1)];
+    while (*p >= 0)
+    {
+      Job &j = _jobs[*p];
+      if (reached(now, j.deadline))
+      {
+        due[dueCount++] = *p;
+        j.armed = false;
+        *p = j.next;
+      }
+      else
+      {
+        p = &j.next;
+      }
+    }
+  }
+  // 当前 tick 的槽下次还要再扫一遍：同一 tick 内稍后到期的作业
+  _lastTick = tick;
+  xSemaphoreGive(_lock);
+
+  for (uint8_t i = 0; i < dueCount; i++)
+  {
+    int8_t job = due[i];
+    Job &j = _jobs[job];
+    uint32_t start = micros();
+    uint32_t late = start - j.deadline;
+    if (j.periodUs > 0)
+    {
+      // 下一次按相位推进；错过的整周期跳过
+      uint32_t missed = late / j.periodUs;
+      j.stats.overruns += missed;
+      xSemaphoreTake(_lock, portMAX_DELAY);
+      // 运行期间被其他任务重新排期的以新的截止时间为准
+      if (!j.armed)
+      {
+        j.deadline += (missed + 1) * j.periodUs;
+        link(job);
+      }
+      xSemaphoreGive(_lock);
+    }
+    j.fn();
+    uint32_t ran = micros() - start;
+    j.stats.runs++;
+    j.stats.lateSumUs += late;
+    if (late > j.stats.lateMaxUs)
+      j.stats.lateMaxUs = late;
+    if (ran > j.stats.runMaxUs)
+      j.stats.runMaxUs = ran;
+  }
+
+  // 下一个截止时间：作业数很少，直接遍历已排期的作业
+  now = micros();
+  uint32_t waitUs = maxWaitMs * 1000;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    if (!_jobs[i].armed)
+      continue;
+    if (reached(now, _jobs[i].deadline))
+    {
+      waitUs = 0;
+      break;
+    }
+    if (_jobs[i].deadline - now < waitUs)
+      waitUs = _jobs[i].deadline - now;
+  }
+  xSemaphoreGive(_lock);
+  // 向上取整到毫秒，醒来时作业已到期
+  return (waitUs + 999) / 1000;
+}
+
+void Scheduler::sleep(uint32_t ms)
+{
+  uint32_t start = micros();
+  if (ms > 0)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+  else
+    ulTaskNotifyTake(pdTRUE, 0); // 清掉已处理过的通知
+  _sleptUs += micros() - start;
+  _wakeups++;
+}
@@ -0,0 +1,88 @@
+#pragma once
+// 协作式定时调度：各子系统登记周期作业和单次作业，loop() 每次醒来先处理 I/O，再运行到期作业，
+// 然后阻塞在任务通知上直到下一个截止时间（或串口、WiFi 事件提前唤醒），空闲时不再空转。
+//
+// 作业按截止时间挂在时间轮上：64 个槽、每槽约 1 ms（1024 us），截止时间的低位决定槽位，
+// 超过一圈的作业留在槽内等轮到的那一圈。醒来时只扫描上次以来经过的槽（至多一圈）。
+// 周期作业的下一次截止时间按「上次截止时间 + 周期」推进，不随执行延迟漂移；
+// 错过整周期时跳过并计为超期。每个作业统计运行次数、迟到（实际开始 - 截止时间）和运行耗时。
+//
+// 登记作业只在 setup() 中进行；schedule()/cancel() 可在任意任务中调用（内部加锁并唤醒主循环），
+// 作业本身总在主循环中运行。时间基准为 micros()，单次延迟不超过 35 分钟。
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#define SCHED_MAX_JOBS 12
+#define SCHED_WHEEL_SLOTS 64 // 2 的幂
+#define SCHED_TICK_SHIFT 10  // 每槽 2^10 us
+
+typedef void (*JobFn)();
+
+struct JobStats
+{
+  uint32_t runs = 0;
+  uint32_t overruns = 0;  // 周期作业错过的周期数
+  uint64_t lateSumUs = 0; // 迟到合计，除以 runs 为平均抖动
+  uint32_t lateMaxUs = 0;
+  uint32_t runMaxUs = 0;
+};
+
+class Scheduler
+{
+public:
+  // 在将要运行作业的任务（主循环）中调用
+  void begin();
+
+  // 周期作业，首次在 firstDelayMs 后运行；返回作业编号，满了返回 -1
+  int8_t every(const char *name, uint32_t periodMs, JobFn fn, uint32_t firstDelayMs = 0);
+  // 单次作业：登记时不排期，由 schedule() 设定（或重设）截止时间，运行后需要再次 schedule()
+  int8_t once(const char *name, JobFn fn);
+
+  // 在 delayMs 后运行（已排期的改为新的截止时间）；周期作业从这里重新计相位
+  void schedule(int8_t job, uint32_t delayMs);
+  void cancel(int8_t job);
+  // 唤醒主循环（串口、WiFi 事件回调中调用）
+  void wake();
+
+  // 运行全部到期作业，返回距下一个截止时间的毫秒数（不超过 maxWaitMs）
+  uint32_t dispatch(uint32_t maxWaitMs);
+  // 阻塞至多 ms 毫秒，被 wake() 或 schedule() 提前唤醒；记录睡眠时间
+  void sleep(uint32_t ms);
+
+  uint8_t jobCount() const { return _count; }
+  const char *jobName(uint8_t job) const { return _jobs[job].name; }
+  uint32_t jobPeriodMs(uint8_t job) const { return _jobs[job].periodUs / 1000; }
+  const JobStats &jobStats(uint8_t job) const { return _jobs[job].stats; }
+  uint64_t sleptUs() const { return _sleptUs; }
+  uint32_t wakeups() const { return _wakeups; }
+
+private:
+  struct Job
+  {
+    const char *name = "";
+    JobFn fn = nullptr;
+    uint32_t periodUs = 0; // 0 为单次作业
+    uint32_t deadline = 0; // micros()
+    bool armed = false;
+    int8_t next = -1; // 同槽链表
+    JobStats stats;
+  };
+
+  int8_t add(const char *name, uint32_t periodUs, JobFn fn);
+  void link(int8_t job);
+  void unlink(int8_t job);
+  static uint8_t slotOf(uint32_t us) { return (us >> SCHED_TICK_SHIFT) & (SCHED_WHEEL_SLOTS - 1); }
+
+  Job _jobs[SCHED_MAX_JOBS];
+  uint8_t _count = 0;
+  int8_t _slots[SCHED_WHEEL_SLOTS];
+  uint32_t _lastTick = 0; // 上次扫描到的 tick（micros() >> SCHED_TICK_SHIFT）
+  SemaphoreHandle_t _lock = nullptr;
+  TaskHandle_t _owner = nullptr;
+  uint64_t _sleptUs = 0;
+  uint32_t _wakeups = 0;
+};
+
+extern Scheduler scheduler;
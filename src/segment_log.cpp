@@ -0,0 +1,180 @@
+#include "segment_log.h"
+#include <stdarg.h>
+#include <time.h>
+
+// 早于此时间（2020-09）视为系统时间尚未通过 NTP 同步
+#define SEGMENT_TIME_VALID 1600000000
+
+// 段文件名为 8 位序号 + ".txt"；name() 在不同核心版本下可能带目录前缀
+static bool parseSegmentName(const char *name, uint32_t &seq)
+{
+  const char *slash = strrchr(name, '/');
+  if (slash)
+    name = slash + 1;
+  if (strlen(name) != 12 || strcmp(name + 8, ".txt") != 0)
+    return false;
+  seq = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    if (name[i] < '0' || name[i] > '9')
+      return false;
+    seq = seq * 10 + (name[i] - '0');
+  }
+  return true;
+}
+
+String SegmentLog::segmentPath(uint32_t seq) const
+{
+  char name[16];
+  snprintf(name, sizeof(name), "/%08lu.txt", (unsigned long)seq);
+  return _dir + name;
+}
+
+bool SegmentLog::begin(FS &fs, const char *legacyPath)
+{
+  _fs = &fs;
+  _writer.close();
+  _first = _last = _count = 0;
+  _segBytes = _totalBytes = 0;
+
+  fs.mkdir(_dir.c_str());
+  File dir = fs.open(_dir, "r");
+  if (dir && dir.isDirectory())
+  {
+    File f = dir.openNextFile();
+    while (f)
+    {
+      uint32_t seq;
+      if (!f.isDirectory() && parseSegmentName(f.name(), seq))
+      {
+        if (_count == 0 || seq < _first)
+          _first = seq;
+        if (_count == 0 || seq > _last)
+        {
+          _last = seq;
+          _segBytes = f.size();
+        }
+        _count++;
+        _totalBytes += f.size();
+      }
+      f = dir.openNextFile();
+    }
+  }
+  dir.close();
+
+  if (_count == 0 && legacyPath && fs.exists(legacyPath))
+  {
+    File legacy = fs.open(legacyPath, "r");
+    uint32_t size = legacy.size();
+    legacy.close();
+    if (fs.rename(legacyPath, segmentPath(0)))
+    {
+      _count = 1;
+      _segBytes = _totalBytes = size;
+    }
+  }
+  if (_count == 0)
+    _count = 1; // 第 0 段在下面打开时创建
+
+  if (_segBytes >= _segmentBytes)
+    rotate();
+  else
+  {
+    prune();
+    openSegment(_last, "a");
+  }
+  return isOpen();
+}
+
+bool SegmentLog::openSegment(uint32_t seq, const char *mode)
+{
+  return _writer.open(*_fs, segmentPath(seq), mode);
+}
+
+bool SegmentLog::write(const uint8_t *data, size_t len)
+{
+  if (!_fs)
+    return false;
+  if (_segBytes > 0 && _segBytes + len > _segmentBytes)
+    rotate();
+  // 换段时创建失败（例如闪存已满）则在下一条记录时重试
+  if (!_writer.isOpen() && !openSegment(_last, "a"))
+    return false;
+  if (!_writer.write(data, len))
+    return false;
+  _segBytes += len;
+  _totalBytes += len;
+  return true;
+}
+
+bool SegmentLog::printf(const char *fmt, ...)
+{
+  char line[160];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (n < 0)
+    return false;
+  if ((size_t)n >= sizeof(line))
+    n = sizeof(line) - 1;
+  return write((const uint8_t *)line, n);
+}
+
+// 关闭当前段并开始下一段；先淘汰旧段再创建，闪存将满时也能腾出空间
+void SegmentLog::rotate()
+{
+  _writer.close();
+  _last++;
+  _count++;
+  _segBytes = 0;
+  prune();
+  openSegment(_last, "w");
+}
+
+// 当前段（_last）之外的段按两条规则淘汰：已关闭的段加上一整个当前段超过总量上限，
+// 或最后写入时间早于保留时长。只在启动和换段时检查，平时追加不扫描目录
+void SegmentLog::prune()
+{
+  while (_count > 1 && _totalBytes - _segBytes + _segmentBytes > _maxBytes)
+  {
+    if (!removeOldest())
+      return;
+  }
+  if (_retentionHours == 0)
+    return;
+  time_t now = time(nullptr);
+  if (now < SEGMENT_TIME_VALID)
+    return;
+  while (_count > 1)
+  {
+    File f = _fs->open(segmentPath(_first), "r");
+    time_t written = f ? f.getLastWrite() : 0;
+    f.close();
+    // 写入时时间尚未同步的段无法判断新旧，保留
+    if (written < SEGMENT_TIME_VALID || now - written < (time_t)_retentionHours * 3600)
+      return;
+    if (!removeOldest())
+      return;
+  }
+}
+
+bool SegmentLog::removeOldest()
+{
+  // 跳过被手动删除的段
+  while (_first < _last && !_fs->exists(segmentPath(_first)))
+    _first++;
+  if (_first >= _last)
+    return false;
+  String path = segmentPath(_first);
+  File f = _fs->open(path, "r");
+  uint32_t size = f ? f.size() : 0;
+  f.close();
+  if (!_fs->remove(path))
+    return false;
+  _totalBytes = _totalBytes > size ? _totalBytes - size : 0;
+  _count--;
+  _first++;
+  _recycled++;
+  return true;
+}
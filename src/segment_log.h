@@ -0,0 +1,58 @@
+#pragma once
+// 分段循环日志：记录写入目录下按序号命名的段文件（/gpslog/00000042.txt），
+// 当前段写满后换下一段，总量或时间超出保留上限时删除最旧的段。
+// 每次追加只涉及当前段（文件大小有上限），代价与设备运行了多久无关；
+// 序号即时间顺序，下载时按序号依次拼接。
+#include <Arduino.h>
+#include <FS.h>
+#include "buffered_writer.h"
+
+class SegmentLog
+{
+public:
+  // retentionHours 为 0 时只按总字节数保留；按时间保留需要系统时间已同步
+  SegmentLog(const char *dir, uint32_t segmentBytes, uint32_t maxBytes, uint32_t retentionHours,
+             uint32_t flushIntervalMs)
+      : _dir(dir), _segmentBytes(segmentBytes), _maxBytes(maxBytes), _retentionHours(retentionHours),
+        _writer(flushIntervalMs)
+  {
+  }
+
+  // 扫描已有段并打开最新一段继续追加。目录中还没有段且 legacyPath 存在时，
+  // 把旧的单文件日志改名为第 0 段，随后按保留策略淘汰
+  bool begin(FS &fs, const char *legacyPath = nullptr);
+  bool isOpen() const { return _writer.isOpen(); }
+
+  // 追加一条记录；记录不会跨段
+  bool write(const uint8_t *data, size_t len);
+  bool printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  void flushIfDue(uint32_t nowMs) { _writer.flushIfDue(nowMs); }
+  bool flush() { return _writer.flush(); }
+
+  // 现存段的序号范围 [firstSeq, lastSeq]，由旧到新
+  uint32_t firstSeq() const { return _first; }
+  uint32_t lastSeq() const { return _last; }
+  uint32_t segmentCount() const { return _count; }
+  String segmentPath(uint32_t seq) const;
+  uint32_t totalBytes() const { return _totalBytes; }
+  uint32_t recycled() const { return _recycled; }
+
+private:
+  bool openSegment(uint32_t seq, const char *mode);
+  void rotate();
+  void prune();
+  bool removeOldest();
+
+  FS *_fs = nullptr;
+  String _dir;
+  uint32_t _segmentBytes;
+  uint32_t _maxBytes;
+  uint32_t _retentionHours;
+  BufferedFileWriter _writer;
+  uint32_t _first = 0;
+  uint32_t _last = 0;
+  uint32_t _count = 0;
+  uint32_t _segBytes = 0;   // 当前段已写入（含缓冲区中未刷新的部分）
+  uint32_t _totalBytes = 0; // 所有段合计
+  uint32_t _recycled = 0;   // 已淘汰的段数
+};
@@ -0,0 +1,116 @@
+#include "sse_hub.h"
+#include <lwip/sockets.h>
+
+#define SSE_PING_INTERVAL_MS 15000
+
+bool SseHub::attach(WiFiClient &client)
+{
+  for (Client &c : _clients)
+  {
+    if (c.active)
+      continue;
+    c.conn = client;
+    c.active = true;
+    c.seq = _frameLen ? _frameSeq - 1 : _frameSeq; // 握手后立即补发最新一帧
+    c.len = 0;
+    c.off = 0;
+    c.conn.setNoDelay(true);
+    static const char header[] = "HTTP/1.1 200 OK\r\n"
+                                 "Content-Type: text/event-stream\r\n"
+                                 "Cache-Control: no-cache\r\n"
+                                 "Connection: keep-alive\r\n\r\n"
+                                 "retry: 3000\n\n";
+    memcpy(c.buf, header, sizeof(header) - 1);
+    c.len = sizeof(header) - 1;
+    pump();
+    return true;
+  }
+  return false;
+}
+
+void SseHub::publish(const char *event, const char *data, size_t len)
+{
+  int n = snprintf(_frame, sizeof(_frame), "event: %s\ndata: %.*s\n\n", event, (int)len, data);
+  if (n <= 0 || (size_t)n >= sizeof(_frame))
+    return; // 帧过长，丢弃
+  _frameLen = n;
+  _frameSeq++;
+  pump();
+}
+
+void SseHub::pump()
+{
+  bool ping = millis() - _lastPing > SSE_PING_INTERVAL_MS;
+  if (ping)
+    _lastPing = millis();
+
+  for (Client &c : _clients)
+  {
+    if (!c.active)
+      continue;
+    // 没有未发完的数据时，装入最新帧；中间错过的帧直接跳过
+    if (c.off >= c.len)
+    {
+      c.len = c.off = 0;
+      if (c.seq != _frameSeq)
+      {
+        if (_frameSeq - c.seq > 1)
+          _dropped += _frameSeq - c.seq - 1;
+        c.seq = _frameSeq;
+        memcpy(c.buf, _frame, _frameLen);
+        c.len = _frameLen;
+      }
+      else if (ping)
+      {
+        memcpy(c.buf, ": ping\n\n", 8);
+        c.len = 8;
+      }
+      else
+      {
+        continue;
+      }
+    }
+    int n = sendNow(c, c.buf + c.off, c.len - c.off);
+    if (n < 0)
+      drop(c);
+    else
+      c.off += n;
+  }
+}
+
+int SseHub::sendNow(Client &c, const char *data, size_t len)
+{
+  int fd = c.conn.fd();
+  if (fd < 0)
+    return -1;
+  int n = send(fd, data, len, MSG_DONTWAIT);
+  if (n >= 0)
+    return n;
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+void SseHub::drop(Client &c)
+{
+  c.conn.stop();
+  c.conn = WiFiClient();
+  c.active = false;
+  c.len = c.off = 0;
+}
+
+uint8_t SseHub::clientCount() const
+{
+  uint8_t n = 0;
+  for (const Client &c : _clients)
+    n += c.active ? 1 : 0;
+  return n;
+}
+
+bool SseHub::backlogged() const
+{
+  for (const Client &c : _clients)
+  {
+    if (c.active && c.off < c.len)
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+// Server-Sent Events 推送：持有若干已完成握手的连接，向所有客户端广播最新一帧。
+// 发送使用非阻塞 socket；客户端发送缓冲区满时保留未发完的帧，
+// 期间产生的新帧只保留最新一份（旧帧丢弃并计数），慢客户端不会拖住 loop()。
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#ifndef SSE_MAX_CLIENTS
+#define SSE_MAX_CLIENTS 4
+#endif
+#ifndef SSE_FRAME_MAX
+#define SSE_FRAME_MAX 896
+#endif
+
+class SseHub
+{
+public:
+  // 接管一个 HTTP 连接并写入事件流响应头；满员返回 false
+  bool attach(WiFiClient &client);
+  // 广播一帧：event 为事件名，data 为单行数据（JSON）
+  void publish(const char *event, const char *data, size_t len);
+  // 推进各客户端的发送，在主循环中调用；定期发送保活注释以发现断开的连接
+  void pump();
+
+  uint8_t clientCount() const;
+  // 有客户端的帧还没发完（发送缓冲区满），需要尽快再 pump()
+  bool backlogged() const;
+  uint32_t droppedFrames() const { return _dropped; }
+
+private:
+  struct Client
+  {
+    WiFiClient conn;
+    bool active = false;
+    uint32_t seq = 0;   // 已开始发送的帧序号
+    uint16_t len = 0;   // 正在发送的帧长度
+    uint16_t off = 0;   // 已发送字节数
+    char buf[SSE_FRAME_MAX];
+  };
+
+  // 非阻塞写；返回写入字节数，-1 表示连接已失效
+  int sendNow(Client &c, const char *data, size_t len);
+  void drop(Client &c);
+
+  Client _clients[SSE_MAX_CLIENTS];
+  char _frame[SSE_FRAME_MAX]; // 最新一帧
+  uint16_t _frameLen = 0;
+  uint32_t _frameSeq = 0;
+  uint32_t _dropped = 0;
+  unsigned long _lastPing = 0;
+};
@@ -0,0 +1,140 @@
+#include "track_filter.h"
+#include "geo_fixed.h"
+
+#define FRAC 8 // 状态的小数位
+#define P_MAX 3000000000LL  // 协方差上限（厘米²），保证 p00² 等乘积不溢出 int64
+#define JUMP_CM 1000000     // 新息超过 10 km 视为重新定位，直接重新初始化
+#define REANCHOR_CM 5000000   // 离原点 50 km 后平移原点，保持平面近似精度
+
+#define V_MAX ((int64_t)TRACK_FILTER_MAX_SPEED_CMPS * 2 << FRAC) // 速度状态上限
+
+// 溢出余量：协方差两两相乘最大 P_MAX² = 9.0e18，只比 INT64_MAX（9.22e18）小 2.4%，
+// 调大 P_MAX 之前先看这里。协方差乘新息：位置新息不超过 JUMP_CM 加一步预测的位移，
+// 速度新息不超过观测上限加速度状态上限
+static_assert(P_MAX <= INT64_MAX / P_MAX, "P_MAX squared must fit in int64");
+static_assert(((int64_t)JUMP_CM << FRAC) + V_MAX * TRACK_FILTER_MAX_DT_MS / 1000 <= INT64_MAX / P_MAX,
+              "covariance times position innovation must fit in int64");
+static_assert(((int64_t)TRACK_FILTER_MAX_SPEED_CMPS << FRAC) + V_MAX <= INT64_MAX / P_MAX,
+              "covariance times velocity innovation must fit in int64");
+
+static inline int64_t clampP(int64_t p) { return p > P_MAX ? P_MAX : (p < -P_MAX ? -P_MAX : p); }
+static inline int64_t clampV(int64_t v) { return v > V_MAX ? V_MAX : (v < -V_MAX ? -V_MAX : v); }
+
+void TrackFilter::Axis::init(int32_t posCm, int64_t r)
+{
+  x = (int64_t)posCm << FRAC;
+  v = 0;
+  p00 = r;
+  p01 = 0;
+  // 初始速度未知：按 10 m/s 的标准差，随后的速度观测会立即收敛
+  p11 = 1000LL * 1000;
+}
+
+void TrackFilter::Axis::predict(uint32_t dtMs)
+{
+  int64_t dt = dtMs;
+  const int64_t q = (int64_t)TRACK_FILTER_ACCEL_CMPS2 * TRACK_FILTER_ACCEL_CMPS2;
+  x += v * dt / 1000;
+  // P = F P Fᵀ + Q，F = [1 dt; 0 1]，Q 为白噪声加速度模型
+  p00 = clampP(p00 + 2 * p01 * dt / 1000 + p11 * dt * dt / 1000000 + q * dt * dt * dt / 3000000000LL);
+  p01 = clampP(p01 + p11 * dt / 1000 + q * dt * dt / 2000000);
+  p11 = clampP(p11 + q * dt / 1000);
+}
+
+void TrackFilter::Axis::correct(int32_t posCm, int64_t r)
+{
+  int64_t s = p00 + r;
+  int64_t y = ((int64_t)posCm << FRAC) - x; // 新息，厘米 × 2^8
+  // K = [p00, p01] / s
+  x += p00 * y / s;
+  v = clampV(v + p01 * y / s);
+  int64_t n00 = p00 - p00 * p00 / s;
+  int64_t n01 = p01 - p00 * p01 / s;
+  int64_t n11 = p11 - p01 * p01 / s;
+  p00 = n00 > 1 ? n00 : 1;
+  p01 = n01;
+  p11 = n11 > 1 ? n11 : 1;
+}
+
+void TrackFilter::Axis::correctVelocity(int32_t velCmps, int64_t r)
+{
+  int64_t s = p11 + r;
+  int64_t y = ((int64_t)velCmps << FRAC) - v;
+  // K = [p01, p11] / s
+  x += p01 * y / s;
+  v = clampV(v + p11 * y / s);
+  int64_t n00 = p00 - p01 * p01 / s;
+  int64_t n01 = p01 - p01 * p11 / s;
+  int64_t n11 = p11 - p11 * p11 / s;
+  p00 = n00 > 1 ? n00 : 1;
+  p01 = n01;
+  p11 = n11 > 1 ? n11 : 1;
+}
+
+void TrackFilter::start(const GpsFix &raw, int64_t r, int32_t velE, int32_t velN)
+{
+  _refLatE7 = raw.latE7;
+  _refLngE7 = raw.lngE7;
+  _east.init(0, r);
+  _north.init(0, r);
+  _east.v = (int64_t)velE << FRAC;
+  _north.v = (int64_t)velN << FRAC;
+  _ready = true;
+}
+
+const GpsFix &TrackFilter::update(const GpsFix &raw, uint32_t nowMs)
+{
+  _out = raw;
+  // HDOP 未知时按 2.0 处理
+  int64_t hdop = raw.hdopX100 ? raw.hdopX100 : 200;
+  int64_t sigma = (int64_t)TRACK_FILTER_UERE_CM * hdop / 100;
+  int64_t r = sigma * sigma;
+  int64_t sigmaV = (int64_t)TRACK_FILTER_VEL_CMPS * hdop / 100;
+  int64_t rv = sigmaV * sigmaV;
+  // 地速按航向分解为东/北分量；航向 0.01 度 -> 二进制角
+  uint32_t course = (uint32_t)(((uint64_t)raw.courseCdeg << 32) / 36000);
+  int64_t speed = raw.speedCmps < TRACK_FILTER_MAX_SPEED_CMPS ? raw.speedCmps : TRACK_FILTER_MAX_SPEED_CMPS;
+  int32_t velE = (int32_t)((speed * geoSin(course)) >> 30);
+  int32_t velN = (int32_t)((speed * geoCos(course)) >> 30);
+
+  uint32_t dt = nowMs - _lastMs;
+  _lastMs = nowMs;
+  if (!_ready || dt > TRACK_FILTER_MAX_DT_MS)
+  {
+    start(raw, r, velE, velN);
+    return _out;
+  }
+
+  int32_t eastCm, northCm;
+  geoToLocalCm(_refLatE7, _refLngE7, raw.latE7, raw.lngE7, eastCm, northCm);
+  int64_t de = eastCm - (_east.x >> FRAC);
+  int64_t dn = northCm - (_north.x >> FRAC);
+  if (de > JUMP_CM || de < -JUMP_CM || dn > JUMP_CM || dn < -JUMP_CM)
+  {
+    start(raw, r, velE, velN);
+    return _out;
+  }
+  _east.predict(dt);
+  _north.predict(dt);
+  _east.correct(eastCm, r);
+  _north.correct(northCm, r);
+  _east.correctVelocity(velE, rv);
+  _north.correctVelocity(velN, rv);
+
+  int32_t e = (int32_t)(_east.x >> FRAC);
+  int32_t n = (int32_t)(_north.x >> FRAC);
+  geoFromLocalCm(_refLatE7, _refLngE7, e, n, _out.latE7, _out.lngE7);
+  int64_t ve = _east.v >> FRAC;
+  int64_t vn = _north.v >> FRAC;
+  _out.speedCmps = (uint32_t)geoIsqrt64((uint64_t)(ve * ve + vn * vn));
+
+  // 远离原点后以当前估计为新原点，状态相应平移
+  if (e > REANCHOR_CM || e < -REANCHOR_CM || n > REANCHOR_CM || n < -REANCHOR_CM)
+  {
+    _refLatE7 = _out.latE7;
+    _refLngE7 = _out.lngE7;
+    _east.x -= (int64_t)e << FRAC;
+    _north.x -= (int64_t)n << FRAC;
+  }
+  return _out;
+}
@@ -0,0 +1,64 @@
+#pragma once
+// 定位平滑：二维匀速模型卡尔曼滤波，东/北两个方向各一个独立的 [位置, 速度] 滤波器。
+// 每个定位点依次用位置和接收机多普勒速度（地速 + 航向分解为东/北分量）做两次观测更新；
+// 观测噪声随 HDOP 变化（σ = UERE × HDOP），加速度过程噪声固定。
+// 状态为定长整数（厘米、厘米/秒，协方差 int64），每个定位点只做常数次乘除，无堆分配，
+// 只依赖标准库，可在主机上用录制轨迹回放验证。
+//
+// 输出的位置和速度用于屏幕、网页和码表统计；原始定位照常写入日志和码表文件。
+#include <stdint.h>
+#include "gps_fix.h"
+
+#ifndef TRACK_FILTER_UERE_CM
+#define TRACK_FILTER_UERE_CM 300 // HDOP = 1 时的水平定位误差（NEO-6M 约 2.5~3 m）
+#endif
+#ifndef TRACK_FILTER_VEL_CMPS
+#define TRACK_FILTER_VEL_CMPS 50 // HDOP = 1 时的速度误差（厘米/秒）
+#endif
+#ifndef TRACK_FILTER_ACCEL_CMPS2
+#define TRACK_FILTER_ACCEL_CMPS2 50 // 过程噪声：加速度标准差（厘米/秒²）
+#endif
+#ifndef TRACK_FILTER_MAX_DT_MS
+#define TRACK_FILTER_MAX_DT_MS 5000 // 两点间隔更长时重新初始化
+#endif
+#ifndef TRACK_FILTER_MAX_SPEED_CMPS
+#define TRACK_FILTER_MAX_SPEED_CMPS 50000 // 地速观测上限（NEO-6M 动态上限 500 m/s），更大的值按上限处理
+#endif
+// 每次 update() 的周期预算（C3 160 MHz 下 100 µs）：/metrics 的 filter 分段在设备上给出实测值，
+// 模拟器 --check-filter 在主机上检查同一上限
+#define TRACK_FILTER_BUDGET_CYCLES 16000
+
+class TrackFilter
+{
+public:
+  void reset() { _ready = false; }
+  // 输入一个有效定位；返回滤波后的定位（坐标、速度被替换，其余字段照搬）
+  const GpsFix &update(const GpsFix &raw, uint32_t nowMs);
+  const GpsFix &fix() const { return _out; }
+  bool ready() const { return _ready; }
+
+private:
+  struct Axis
+  {
+    int64_t x;   // 位置，厘米 × 2^8
+    int64_t v;   // 速度，厘米/秒 × 2^8
+    int64_t p00; // 协方差，厘米²
+    int64_t p01; // 厘米²/秒
+    int64_t p11; // 厘米²/秒²
+
+    void init(int32_t posCm, int64_t r);
+    void predict(uint32_t dtMs);
+    void correct(int32_t posCm, int64_t r);
+    void correctVelocity(int32_t velCmps, int64_t r);
+  };
+
+  void start(const GpsFix &raw, int64_t r, int32_t velE, int32_t velN);
+
+  bool _ready = false;
+  uint32_t _lastMs = 0;
+  int32_t _refLatE7 = 0; // 局部平面原点，远离后平移
+  int32_t _refLngE7 = 0;
+  Axis _east;
+  Axis _north;
+  GpsFix _out;
+};
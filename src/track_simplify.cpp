@@ -0,0 +1,116 @@
+#include "track_simplify.h"
+#include "geo_fixed.h"
+
+// 点 p 到线段 ab 的距离是否超过 tol（厘米）。叉积除以线段长度即垂距，
+// 比较 |叉积| 与 tol × 长度，避免平方溢出 int64
+static bool beyond(const TrackSimplifier::Vertex &a, const TrackSimplifier::Vertex &b, uint64_t len,
+                   const TrackSimplifier::Vertex &p, uint32_t tol)
+{
+  int64_t vx = (int64_t)b.eastCm - a.eastCm, vy = (int64_t)b.northCm - a.northCm;
+  int64_t wx = (int64_t)p.eastCm - a.eastCm, wy = (int64_t)p.northCm - a.northCm;
+  int64_t dot = wx * vx + wy * vy;
+  uint64_t tol2 = (uint64_t)tol * tol;
+  // 投影落在线段两端之外时取到端点的距离
+  if (len == 0 || dot <= 0)
+    return (uint64_t)(wx * wx + wy * wy) > tol2;
+  if ((uint64_t)dot >= len * len)
+  {
+    int64_t ux = (int64_t)p.eastCm - b.eastCm, uy = (int64_t)p.northCm - b.northCm;
+    return (uint64_t)(ux * ux + uy * uy) > tol2;
+  }
+  int64_t cross = wx * vy - wy * vx;
+  return (uint64_t)(cross < 0 ? -cross : cross) > (uint64_t)tol * len;
+}
+
+static uint64_t segmentLength(const TrackSimplifier::Vertex &a, const TrackSimplifier::Vertex &b)
+{
+  int64_t dx = (int64_t)b.eastCm - a.eastCm, dy = (int64_t)b.northCm - a.northCm;
+  return geoIsqrt64((uint64_t)(dx * dx + dy * dy));
+}
+
+TrackSimplifier::TrackSimplifier(Vertex *out, size_t capacity, uint32_t toleranceCm)
+    : _out(out), _capacity(capacity), _tol(toleranceCm > 0 ? toleranceCm : 1)
+{
+}
+
+void TrackSimplifier::add(int32_t latE7, int32_t lngE7)
+{
+  if (_inputs++ == 0)
+  {
+    _refLatE7 = latE7;
+    _refLngE7 = lngE7;
+    push(Vertex{0, 0});
+    return;
+  }
+  Vertex p;
+  geoToLocalCm(_refLatE7, _refLngE7, latE7, lngE7, p.eastCm, p.northCm);
+  if (_winLen > 0)
+  {
+    bool cut = _winLen == TRACK_SIMPLIFY_WINDOW;
+    const Vertex &anchor = _out[_count - 1];
+    uint64_t len = segmentLength(anchor, p);
+    for (uint8_t i = 0; !cut && i < _winLen; i++)
+      cut = beyond(anchor, p, len, _win[i], _tol);
+    if (cut)
+    {
+      push(_win[_winLen - 1]);
+      _winLen = 0;
+    }
+  }
+  _win[_winLen++] = p;
+}
+
+void TrackSimplifier::finish()
+{
+  if (_winLen > 0)
+    push(_win[_winLen - 1]);
+  _winLen = 0;
+}
+
+void TrackSimplifier::vertex(size_t i, int32_t &latE7, int32_t &lngE7) const
+{
+  geoFromLocalCm(_refLatE7, _refLngE7, _out[i].eastCm, _out[i].northCm, latE7, lngE7);
+}
+
+void TrackSimplifier::push(const Vertex &v)
+{
+  while (_count >= _capacity)
+    coarsen();
+  _out[_count++] = v;
+}
+
+// 容差加倍，按同样的开窗法把已有顶点原地再抽稀一遍。写位置不超过读位置，可以原地进行；
+// 首尾顶点保留，正在进行的窗口仍以最后一个顶点为锚点。一次腾出至少四分之一的空间，
+// 避免之后每来一个顶点就重做一遍
+void TrackSimplifier::coarsen()
+{
+  size_t target = _capacity - _capacity / 4;
+  do
+  {
+    _tol = _tol > 0x7FFFFFFF ? 0xFFFFFFFF : _tol * 2;
+    size_t kept = 1;
+    size_t start = 1;   // 窗口为 [start, i)，直接在原数组上读取
+    size_t pending = 0; // 窗口中的点数
+    for (size_t i = 1; i < _count; i++)
+    {
+      if (pending > 0)
+      {
+        const Vertex &anchor = _out[kept - 1];
+        uint64_t len = segmentLength(anchor, _out[i]);
+        bool cut = pending == TRACK_SIMPLIFY_WINDOW;
+        for (size_t j = start; !cut && j < i; j++)
+          cut = beyond(anchor, _out[i], len, _out[j], _tol);
+        if (cut)
+        {
+          _out[kept++] = _out[i - 1];
+          start = i;
+          pending = 0;
+        }
+      }
+      pending++;
+    }
+    if (_count > 1)
+      _out[kept++] = _out[_count - 1];
+    _count = kept;
+  } while (_count > target && _count > 2);
+}
@@ -0,0 +1,51 @@
+#pragma once
+// 流式轨迹抽稀，用于地图预览：按顺序输入定位点，只保留形状上必要的顶点。
+//
+// 开窗法：从上一个顶点（锚点）出发，把后续点暂存在固定大小的窗口中，每来一个点检查
+// 窗口内各点到线段「锚点 → 新点」的距离，有点超出容差时把窗口中最后一点定为顶点、
+// 作为新的锚点。窗口装满时同样强制出顶点，每点的代价有上限。
+//
+// 顶点存入调用方提供的定长数组（点数上限）。数组满时容差加倍，把已有顶点按新容差原地
+// 再抽稀一遍后继续，因此只需遍历一次数据，内存与轨迹长度无关；最终误差不超过最终容差
+// 的两倍。坐标为以首点为原点的局部平面厘米（等距矩形近似），只用整数运算。
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACK_SIMPLIFY_WINDOW 32
+
+class TrackSimplifier
+{
+public:
+  struct Vertex
+  {
+    int32_t eastCm;
+    int32_t northCm;
+  };
+
+  // out 至少 3 个元素
+  TrackSimplifier(Vertex *out, size_t capacity, uint32_t toleranceCm);
+
+  void add(int32_t latE7, int32_t lngE7);
+  // 输入结束：保留最后一个点
+  void finish();
+
+  size_t size() const { return _count; }
+  uint32_t toleranceCm() const { return _tol; }
+  uint32_t inputPoints() const { return _inputs; }
+  // 第 i 个顶点的坐标（1e-7 度）
+  void vertex(size_t i, int32_t &latE7, int32_t &lngE7) const;
+
+private:
+  void push(const Vertex &v);
+  void coarsen();
+
+  Vertex *_out;
+  size_t _capacity;
+  size_t _count = 0;
+  uint32_t _tol;
+  uint32_t _inputs = 0;
+  int32_t _refLatE7 = 0;
+  int32_t _refLngE7 = 0;
+  Vertex _win[TRACK_SIMPLIFY_WINDOW];
+  uint8_t _winLen = 0;
+};
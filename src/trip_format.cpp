@@ -0,0 +1,511 @@
+#include "trip_format.h"
+#include <stdio.h>
+#include <string.h>
+
+// 2020-01-01，早于此的开始时间视为未校时
+#define TRIP_MIN_VALID_EPOCH 1577836800UL
+
+static inline void wrU2(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+static inline void wrU4(uint8_t *p, uint32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = (v >> (8 * i)) & 0xFF;
+}
+static inline uint16_t rdU2(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t rdU4(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// snprintf 返回值换算为实际写入长度
+static inline size_t clampLen(int n, size_t size) { return n < 0 ? 0 : ((size_t)n < size ? n : size - 1); }
+
+static const uint16_t SLOT_KEY = 0xFFFF;
+static const uint16_t SLOT_GAP = 0xFFFE;
+static const uint16_t SLOT_ZONE = 0xFFFD;
+static const uint16_t MAX_DT = 0xFFFC;
+
+size_t tripWriteHeader(const TripHeader &h, uint8_t *out)
+{
+  memset(out, 0, TRIP_HEADER_SIZE);
+  memcpy(out, TRIP_FILE_MAGIC, 4);
+  out[4] = h.version;
+  out[5] = TRIP_SLOT_SIZE;
+  wrU4(out + 8, h.startEpoch);
+  wrU4(out + 12, h.startMillis);
+  return TRIP_HEADER_SIZE;
+}
+
+bool tripReadHeader(const uint8_t *in, TripHeader &h)
+{
+  if (memcmp(in, TRIP_FILE_MAGIC, 4) != 0 || in[4] < 1 || in[4] > TRIP_FORMAT_VERSION || in[5] != TRIP_SLOT_SIZE)
+    return false;
+  h.version = in[4];
+  h.startEpoch = rdU4(in + 8);
+  h.startMillis = rdU4(in + 12);
+  return true;
+}
+
+static inline bool fitsI16(int32_t v) { return v >= -32768 && v <= 32767; }
+
+size_t TripEncoder::encode(const TripPoint &p, uint8_t *out)
+{
+  memset(out, 0, TRIP_MAX_RECORD);
+  if (!p.valid)
+  {
+    wrU2(out, SLOT_GAP);
+    wrU4(out + 2, p.tMs);
+    _needKey = true;
+    return TRIP_SLOT_SIZE;
+  }
+
+  int32_t dLat = p.latE6 - _last.latE6;
+  int32_t dLng = p.lngE6 - _last.lngE6;
+  int32_t dAlt = p.altCm - _last.altCm;
+  uint32_t dt = p.tMs - _last.tMs;
+  bool key = _needKey || _sinceKey >= TRIP_KEYFRAME_INTERVAL || p.tMs < _last.tMs || dt > MAX_DT ||
+             !fitsI16(dLat) || !fitsI16(dLng) || !fitsI16(dAlt);
+  _last = p;
+
+  if (key)
+  {
+    _needKey = false;
+    _sinceKey = 0;
+    wrU2(out, SLOT_KEY);
+    wrU4(out + 2, p.tMs);
+    wrU4(out + 6, (uint32_t)p.latE6);
+    wrU4(out + 10, (uint32_t)p.lngE6);
+    wrU4(out + 14, (uint32_t)p.altCm);
+    wrU2(out + 18, p.speedCmps);
+    return 2 * TRIP_SLOT_SIZE;
+  }
+
+  _sinceKey++;
+  wrU2(out, (uint16_t)dt);
+  wrU2(out + 2, (uint16_t)(int16_t)dLat);
+  wrU2(out + 4, (uint16_t)(int16_t)dLng);
+  wrU2(out + 6, (uint16_t)(int16_t)dAlt);
+  wrU2(out + 8, p.speedCmps);
+  return TRIP_SLOT_SIZE;
+}
+
+size_t TripEncoder::encodeZoneEvent(const TripZoneEvent &e, uint8_t *out)
+{
+  memset(out, 0, TRIP_SLOT_SIZE);
+  wrU2(out, SLOT_ZONE);
+  wrU4(out + 2, e.tMs);
+  wrU2(out + 6, e.zoneId);
+  out[8] = e.enter ? 1 : 0;
+  return TRIP_SLOT_SIZE;
+}
+
+int TripDecoder::decodeSlot(const uint8_t *slot, TripPoint &out)
+{
+  if (_pendingKey)
+  {
+    // 关键帧第二个槽位
+    _pendingKey = false;
+    _last.lngE6 = (int32_t)rdU4(slot);
+    _last.altCm = (int32_t)rdU4(slot + 4);
+    _last.speedCmps = rdU2(slot + 8);
+    _last.valid = true;
+    _haveKey = true;
+    out = _last;
+    return 1;
+  }
+
+  uint16_t tag = rdU2(slot);
+  if (tag == SLOT_KEY)
+  {
+    _last.tMs = rdU4(slot + 2);
+    _last.latE6 = (int32_t)rdU4(slot + 6);
+    _pendingKey = true;
+    return 0;
+  }
+  if (tag == SLOT_ZONE)
+  {
+    _event.tMs = rdU4(slot + 2);
+    _event.zoneId = rdU2(slot + 6);
+    _event.enter = slot[8] != 0;
+    return 2;
+  }
+  if (tag == SLOT_GAP)
+  {
+    _haveKey = false;
+    out = TripPoint();
+    out.tMs = rdU4(slot + 2);
+    _last.tMs = out.tMs;
+    return 1;
+  }
+  if (!_haveKey)
+    return -1;
+
+  _last.tMs += tag;
+  _last.latE6 += (int16_t)rdU2(slot + 2);
+  _last.lngE6 += (int16_t)rdU2(slot + 4);
+  _last.altCm += (int16_t)rdU2(slot + 6);
+  _last.speedCmps = rdU2(slot + 8);
+  out = _last;
+  return 1;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+size_t tripCheckpointEncode(const TripCheckpoint &c, uint8_t *out)
+{
+  memset(out, 0, TRIP_CHECKPOINT_SIZE);
+  memcpy(out, TRIP_CHECKPOINT_MAGIC, 4);
+  out[4] = TRIP_CHECKPOINT_VERSION;
+  wrU4(out + 8, c.flushedBytes);
+  wrU4(out + 12, c.lastTMs);
+  const uint32_t totals[8] = {c.stats.distanceCm, c.stats.movingMs,  c.stats.stoppedMs, c.stats.maxSpeedCmps,
+                              c.stats.ascentCm,   c.stats.descentCm, c.stats.points,    c.stats.rejected};
+  for (int i = 0; i < 8; i++)
+    wrU4(out + 16 + 4 * i, totals[i]);
+  // 名称区已清零，最多复制 27 字节，保证以 0 结尾
+  memcpy(out + 48, c.fileName, strnlen(c.fileName, TRIP_CHECKPOINT_NAME_MAX));
+  wrU4(out + 76, crc32(out, 76));
+  return TRIP_CHECKPOINT_SIZE;
+}
+
+bool tripCheckpointDecode(const uint8_t *in, TripCheckpoint &c)
+{
+  if (memcmp(in, TRIP_CHECKPOINT_MAGIC, 4) != 0 || in[4] != TRIP_CHECKPOINT_VERSION ||
+      rdU4(in + 76) != crc32(in, 76) || in[48 + TRIP_CHECKPOINT_NAME_MAX] != 0)
+    return false;
+  c.flushedBytes = rdU4(in + 8);
+  c.lastTMs = rdU4(in + 12);
+  uint32_t *totals[8] = {&c.stats.distanceCm, &c.stats.movingMs,  &c.stats.stoppedMs, &c.stats.maxSpeedCmps,
+                         &c.stats.ascentCm,   &c.stats.descentCm, &c.stats.points,    &c.stats.rejected};
+  for (int i = 0; i < 8; i++)
+    *totals[i] = rdU4(in + 16 + 4 * i);
+  memcpy(c.fileName, in + 48, TRIP_CHECKPOINT_NAME_MAX + 1);
+  return true;
+}
+
+bool TripTailScanner::feedSlot(const uint8_t *slot)
+{
+  if (_bad)
+    return false;
+  _pos += TRIP_SLOT_SIZE;
+  if (_pendingKey)
+  {
+    // 关键帧第二个槽位：坐标可以是任意值
+    _pendingKey = false;
+    _lastTMs = _keyTMs;
+    _validEnd = _pos;
+    return true;
+  }
+  uint16_t tag = rdU2(slot);
+  if (tag == SLOT_KEY)
+  {
+    _keyTMs = rdU4(slot + 2);
+    _pendingKey = true;
+    return true;
+  }
+  if (tag == SLOT_GAP)
+  {
+    // 无定位槽位的填充字节必为 0
+    if (rdU4(slot + 6) != 0)
+    {
+      _bad = true;
+      return false;
+    }
+    _lastTMs = rdU4(slot + 2);
+    _validEnd = _pos;
+    return true;
+  }
+  if (tag == SLOT_ZONE)
+  {
+    if (slot[8] > 1 || slot[9] != 0)
+    {
+      _bad = true;
+      return false;
+    }
+    // 事件时间不参与增量累加，_lastTMs 仍是最后一个点的时间
+    _validEnd = _pos;
+    return true;
+  }
+  _lastTMs += tag;
+  _validEnd = _pos;
+  return true;
+}
+
+void TripLastTime::feedSlot(const uint8_t *slot)
+{
+  uint16_t tag = rdU2(slot);
+  if (!_synced && _havePrev && _prevTag != SLOT_KEY)
+    _synced = true;
+  _havePrev = true;
+  _prevTag = tag;
+  if (!_synced)
+    return;
+  TripPoint p;
+  int r = _decoder.decodeSlot(slot, p);
+  if (r == 1)
+  {
+    _tMs = p.tMs;
+    _found = true;
+  }
+  else if (r == 2)
+  {
+    // 围栏事件带绝对时间，尾部事件较多、关键帧落在窗口外时也能得到时长
+    _tMs = _decoder.zoneEvent().tMs;
+    _found = true;
+  }
+}
+
+size_t formatFixed(char *buf, size_t size, int32_t value, uint8_t decimals)
+{
+  static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+  uint32_t mag = value < 0 ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+  uint32_t div = pow10[decimals];
+  int n;
+  if (decimals == 0)
+    n = snprintf(buf, size, "%s%lu", value < 0 ? "-" : "", (unsigned long)mag);
+  else
+    n = snprintf(buf, size, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(mag / div), decimals,
+                 (unsigned long)(mag % div));
+  return clampLen(n, size);
+}
+
+// km/h 的百分之一：cm/s × 0.036 × 100
+static inline int32_t speedKmphX100(uint16_t cmps) { return (int32_t)((cmps * 36UL + 5) / 10); }
+
+size_t tripCsvHeader(char *buf, size_t size)
+{
+  return clampLen(snprintf(buf, size, "timestamp,latitude,longitude,altitude,speed_kmph,zone_event\n"), size);
+}
+
+size_t tripCsvRow(const TripHeader &h, const TripPoint &p, char *buf, size_t size)
+{
+  unsigned long ts = (unsigned long)(h.startMillis + p.tMs);
+  if (!p.valid)
+  {
+    int n = snprintf(buf, size, "%lu,,,,,\n", ts);
+    return clampLen(n, size);
+  }
+  char lat[16], lng[16], alt[16], spd[16];
+  formatFixed(lat, sizeof(lat), p.latE6, 6);
+  formatFixed(lng, sizeof(lng), p.lngE6, 6);
+  formatFixed(alt, sizeof(alt), p.altCm, 2);
+  formatFixed(spd, sizeof(spd), speedKmphX100(p.speedCmps), 2);
+  int n = snprintf(buf, size, "%lu,%s,%s,%s,%s,\n", ts, lat, lng, alt, spd);
+  return clampLen(n, size);
+}
+
+size_t tripCsvZoneEvent(const TripHeader &h, const TripZoneEvent &e, char *buf, size_t size)
+{
+  int n = snprintf(buf, size, "%lu,,,,,%s:%u\n", (unsigned long)(h.startMillis + e.tMs), e.enter ? "enter" : "exit",
+                   e.zoneId);
+  return clampLen(n, size);
+}
+
+size_t tripGpxHeader(char *buf, size_t size)
+{
+  int n = snprintf(buf, size,
+                   "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                   "<gpx version=\"1.1\" creator=\"esp-neo6mv2\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+                   "<trk><trkseg>\n");
+  return clampLen(n, size);
+}
+
+// ISO 8601 UTC 时间，精确到毫秒：2025-01-01T12:00:00.250Z
+static void formatIsoTime(const TripHeader &h, const TripPoint &p, char *buf, size_t size)
+{
+  time_t t = (time_t)(h.startEpoch + p.tMs / 1000);
+  struct tm utc;
+  gmtime_r(&t, &utc);
+  char iso[24];
+  strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%S", &utc);
+  snprintf(buf, size, "%s.%03luZ", iso, (unsigned long)(p.tMs % 1000));
+}
+
+size_t tripGpxPoint(const TripHeader &h, const TripPoint &p, char *buf, size_t size)
+{
+  if (!p.valid)
+    return 0;
+  char lat[16], lng[16], alt[16], tm[48] = "";
+  formatFixed(lat, sizeof(lat), p.latE6, 6);
+  formatFixed(lng, sizeof(lng), p.lngE6, 6);
+  formatFixed(alt, sizeof(alt), p.altCm, 2);
+  if (h.startEpoch >= TRIP_MIN_VALID_EPOCH)
+  {
+    char iso[32];
+    formatIsoTime(h, p, iso, sizeof(iso));
+    snprintf(tm, sizeof(tm), "<time>%s</time>", iso);
+  }
+  int n = snprintf(buf, size, "<trkpt lat=\"%s\" lon=\"%s\"><ele>%s</ele>%s</trkpt>\n", lat, lng, alt, tm);
+  return clampLen(n, size);
+}
+
+size_t tripGpxFooter(char *buf, size_t size)
+{
+  return clampLen(snprintf(buf, size, "</trkseg></trk>\n</gpx>\n"), size);
+}
+
+bool tripExportParse(const char *name, TripExportFormat &fmt)
+{
+  if (!name || !*name || strcmp(name, "csv") == 0)
+    fmt = TripExportFormat::Csv;
+  else if (strcmp(name, "gpx") == 0)
+    fmt = TripExportFormat::Gpx;
+  else if (strcmp(name, "geojson") == 0)
+    fmt = TripExportFormat::GeoJson;
+  else if (strcmp(name, "kml") == 0)
+    fmt = TripExportFormat::Kml;
+  else
+    return false;
+  return true;
+}
+
+const char *tripExportMime(TripExportFormat fmt)
+{
+  switch (fmt)
+  {
+  case TripExportFormat::Gpx:
+    return "application/gpx+xml";
+  case TripExportFormat::GeoJson:
+    return "application/geo+json";
+  case TripExportFormat::Kml:
+    return "application/vnd.google-earth.kml+xml";
+  default:
+    return "text/csv";
+  }
+}
+
+const char *tripExportExt(TripExportFormat fmt)
+{
+  switch (fmt)
+  {
+  case TripExportFormat::Gpx:
+    return ".gpx";
+  case TripExportFormat::GeoJson:
+    return ".geojson";
+  case TripExportFormat::Kml:
+    return ".kml";
+  default:
+    return ".csv";
+  }
+}
+
+TripExporter::TripExporter(TripExportFormat fmt, const TripHeader &h, const char *name)
+    : _fmt(fmt), _h(h), _timed(h.startEpoch >= TRIP_MIN_VALID_EPOCH)
+{
+  snprintf(_name, sizeof(_name), "%s", name);
+}
+
+uint8_t TripExporter::passes() const
+{
+  return _timed && (_fmt == TripExportFormat::GeoJson || _fmt == TripExportFormat::Kml) ? 2 : 1;
+}
+
+size_t TripExporter::header(char *buf, size_t size)
+{
+  int n = 0;
+  switch (_fmt)
+  {
+  case TripExportFormat::Csv:
+    return tripCsvHeader(buf, size);
+  case TripExportFormat::Gpx:
+    return tripGpxHeader(buf, size);
+  case TripExportFormat::GeoJson:
+    n = snprintf(buf, size,
+                 "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\","
+                 "\"geometry\":{\"type\":\"LineString\",\"coordinates\":[\n");
+    break;
+  case TripExportFormat::Kml:
+    n = snprintf(buf, size,
+                 "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                 "<kml xmlns=\"http://www.opengis.net/kml/2.2\" xmlns:gx=\"http://www.google.com/kml/ext/2.2\">\n"
+                 "<Document><name>%s</name><Placemark><name>%s</name>\n%s",
+                 _name, _name,
+                 _timed ? "<gx:Track><altitudeMode>absolute</altitudeMode>\n"
+                        : "<LineString><altitudeMode>absolute</altitudeMode><coordinates>\n");
+    break;
+  }
+  return clampLen(n, size);
+}
+
+size_t TripExporter::beginPass(uint8_t pass, char *buf, size_t size)
+{
+  _pass = pass;
+  _first = true;
+  // 第一遍为时间，第二遍为坐标（KML）；GeoJSON 先坐标后 coordTimes
+  if (pass == 1 && _fmt == TripExportFormat::GeoJson)
+    return clampLen(snprintf(buf, size, "]},\"properties\":{\"name\":\"%s\",\"coordTimes\":[\n", _name), size);
+  return 0;
+}
+
+size_t TripExporter::zoneEvent(const TripZoneEvent &e, char *buf, size_t size)
+{
+  return _fmt == TripExportFormat::Csv ? tripCsvZoneEvent(_h, e, buf, size) : 0;
+}
+
+size_t TripExporter::point(const TripPoint &p, char *buf, size_t size)
+{
+  if (_fmt == TripExportFormat::Csv)
+    return tripCsvRow(_h, p, buf, size);
+  if (_fmt == TripExportFormat::Gpx)
+    return tripGpxPoint(_h, p, buf, size);
+  if (!p.valid)
+    return 0;
+  const char *sep = _first ? "" : ",";
+  _first = false;
+  int n;
+  bool times = _fmt == TripExportFormat::GeoJson ? _pass == 1 : (_timed && _pass == 0);
+  if (times)
+  {
+    char iso[32];
+    formatIsoTime(_h, p, iso, sizeof(iso));
+    n = _fmt == TripExportFormat::GeoJson ? snprintf(buf, size, "%s\"%s\"\n", sep, iso)
+                                          : snprintf(buf, size, "<when>%s</when>\n", iso);
+    return clampLen(n, size);
+  }
+  char lng[16], lat[16], alt[16];
+  formatFixed(lng, sizeof(lng), p.lngE6, 6);
+  formatFixed(lat, sizeof(lat), p.latE6, 6);
+  formatFixed(alt, sizeof(alt), p.altCm, 2);
+  if (_fmt == TripExportFormat::GeoJson)
+    n = snprintf(buf, size, "%s[%s,%s,%s]\n", sep, lng, lat, alt);
+  else if (_timed)
+    n = snprintf(buf, size, "<gx:coord>%s %s %s</gx:coord>\n", lng, lat, alt);
+  else
+    n = snprintf(buf, size, "%s,%s,%s\n", lng, lat, alt);
+  return clampLen(n, size);
+}
+
+size_t TripExporter::footer(char *buf, size_t size)
+{
+  int n = 0;
+  switch (_fmt)
+  {
+  case TripExportFormat::Csv:
+    return 0;
+  case TripExportFormat::Gpx:
+    return tripGpxFooter(buf, size);
+  case TripExportFormat::GeoJson:
+    n = _timed ? snprintf(buf, size, "]}}]}\n")
+               : snprintf(buf, size, "]},\"properties\":{\"name\":\"%s\"}}]}\n", _name);
+    break;
+  case TripExportFormat::Kml:
+    n = snprintf(buf, size, "%s</Placemark></Document></kml>\n",
+                 _timed ? "</gx:Track>" : "</coordinates></LineString>");
+    break;
+  }
+  return clampLen(n, size);
+}
@@ -0,0 +1,202 @@
+#pragma once
+// 码表二进制记录格式（.bin）
+//
+// 文件 = 16 字节文件头 + 若干 10 字节定长槽位（小端）：
+//   增量槽：u16 dt(ms, ≤0xFFFC) | i16 dLat(微度) | i16 dLng(微度) | i16 dAlt(cm) | u16 速度(cm/s)
+//   关键帧：两个槽位
+//           槽1：u16 0xFFFF | u32 t(ms) | i32 lat(微度)
+//           槽2：i32 lng(微度) | i32 alt(cm) | u16 速度(cm/s)
+//   无定位：u16 0xFFFE | u32 t(ms) | 4 字节 0
+//   围栏事件：u16 0xFFFD | u32 t(ms) | u16 区域编号 | u8 1 进入 / 0 离开 | u8 0
+//           不是定位点，不影响前后增量的解码
+// t 为相对码表开始的毫秒数。首个点、无定位之后、增量溢出时以及每
+// TRIP_KEYFRAME_INTERVAL 个点写一次关键帧，损坏只影响到下一个关键帧。
+// 典型每点 10 字节，原 CSV 约 45 字节。
+// 版本 2 增加围栏事件，增量 dt 上限相应减一；版本 1 文件每秒至少一条记录，dt 不会用到 0xFFFD，照常读取。
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "trip_stats.h"
+
+#define TRIP_FILE_MAGIC "GTRP"
+#define TRIP_FORMAT_VERSION 2
+#define TRIP_HEADER_SIZE 16
+#define TRIP_SLOT_SIZE 10
+#define TRIP_MAX_RECORD (2 * TRIP_SLOT_SIZE)
+#define TRIP_KEYFRAME_INTERVAL 600
+
+struct TripHeader
+{
+  uint8_t version = TRIP_FORMAT_VERSION;
+  uint32_t startEpoch = 0;  // 码表开始的 Unix 时间（未校时为 0）
+  uint32_t startMillis = 0; // 码表开始时的 millis()，CSV 时间戳列沿用旧格式
+};
+
+struct TripPoint
+{
+  uint32_t tMs = 0; // 相对码表开始的毫秒数
+  int32_t latE6 = 0;
+  int32_t lngE6 = 0;
+  int32_t altCm = 0;
+  uint16_t speedCmps = 0;
+  bool valid = false; // false 表示该时刻无定位，仅有时间戳
+};
+
+struct TripZoneEvent
+{
+  uint32_t tMs = 0;
+  uint16_t zoneId = 0; // 围栏文件中的区域编号
+  bool enter = false;
+};
+
+size_t tripWriteHeader(const TripHeader &h, uint8_t *out);
+// 解析文件头，失败（魔数/版本/槽宽不符）返回 false
+bool tripReadHeader(const uint8_t *in, TripHeader &h);
+
+class TripEncoder
+{
+public:
+  void reset() { _needKey = true; }
+  // 编码一个点，返回写入 out 的字节数（10 或 20），out 至少 TRIP_MAX_RECORD 字节
+  size_t encode(const TripPoint &p, uint8_t *out);
+  // 围栏事件占一个槽位，不改变编码状态
+  static size_t encodeZoneEvent(const TripZoneEvent &e, uint8_t *out);
+
+private:
+  bool _needKey = true;
+  uint16_t _sinceKey = 0;
+  TripPoint _last;
+};
+
+class TripDecoder
+{
+public:
+  void reset()
+  {
+    _haveKey = false;
+    _pendingKey = false;
+  }
+  // 输入一个槽位；返回 1 表示 out 得到一个完整点，0 表示需要下一个槽位，
+  // 2 表示围栏事件（zoneEvent() 读取，out 不变），-1 表示数据损坏（缺少关键帧），已跳过该槽位
+  int decodeSlot(const uint8_t *slot, TripPoint &out);
+  const TripZoneEvent &zoneEvent() const { return _event; }
+
+private:
+  bool _haveKey = false;
+  bool _pendingKey = false;
+  TripPoint _last;
+  TripZoneEvent _event;
+};
+
+// 断电恢复检查点（80 字节，小端）：
+//   "GTCK" | u8 版本 | 3 字节 0 | u32 已刷新的文件长度 | u32 最后一点的 t(ms) |
+//   8 × u32 统计累计值 | 28 字节文件名（0 填充）| u32 CRC32（前 76 字节）
+#define TRIP_CHECKPOINT_MAGIC "GTCK"
+#define TRIP_CHECKPOINT_VERSION 1
+#define TRIP_CHECKPOINT_SIZE 80
+#define TRIP_CHECKPOINT_NAME_MAX 27
+
+struct TripCheckpoint
+{
+  char fileName[TRIP_CHECKPOINT_NAME_MAX + 1] = "";
+  uint32_t flushedBytes = 0; // 该长度之前的数据已确认写入 flash，且位于记录边界
+  uint32_t lastTMs = 0;      // flushedBytes 之前最后一条记录的时间
+  TripStats::Totals stats;
+};
+
+size_t tripCheckpointEncode(const TripCheckpoint &c, uint8_t *out);
+// 魔数/版本/CRC 不符返回 false
+bool tripCheckpointDecode(const uint8_t *in, TripCheckpoint &c);
+
+// 检查点之后追加部分的逐槽校验：从记录边界开始输入槽位，
+// 只有完整的记录才计入 validEnd()，遇到不可能出现的槽位后不再接受输入
+class TripTailScanner
+{
+public:
+  TripTailScanner(uint32_t offset, uint32_t lastTMs) : _pos(offset), _validEnd(offset), _lastTMs(lastTMs) {}
+  // 返回 false 表示数据损坏，之后的内容不可信
+  bool feedSlot(const uint8_t *slot);
+  uint32_t validEnd() const { return _validEnd; } // 最后一条完整记录之后的文件偏移
+  uint32_t lastTMs() const { return _lastTMs; }   // 最后一条完整记录的时间
+
+private:
+  uint32_t _pos;
+  uint32_t _validEnd;
+  uint32_t _lastTMs;
+  uint32_t _keyTMs = 0;
+  bool _pendingKey = false;
+  bool _bad = false;
+};
+
+// 从文件中任意槽位开始求最后一条记录的时间，用于不读全文件得到码表时长。
+// 前一槽位不是关键帧首槽（标记 0xFFFF）的位置必为记录边界，从那里开始解码；
+// 输入覆盖 TRIP_KEYFRAME_INTERVAL + 3 个槽位即可保证遇到关键帧或无定位记录
+class TripLastTime
+{
+public:
+  // atBoundary：第一个槽位已知是记录边界（紧跟文件头）
+  explicit TripLastTime(bool atBoundary) : _synced(atBoundary) {}
+  void feedSlot(const uint8_t *slot);
+  bool found() const { return _found; }
+  uint32_t tMs() const { return _tMs; }
+
+private:
+  bool _synced;
+  bool _havePrev = false;
+  uint16_t _prevTag = 0;
+  TripDecoder _decoder;
+  bool _found = false;
+  uint32_t _tMs = 0;
+};
+
+// 流式导出：每个函数把一段文本写入 buf，返回长度（不含结尾 0）
+size_t tripCsvHeader(char *buf, size_t size);
+size_t tripCsvRow(const TripHeader &h, const TripPoint &p, char *buf, size_t size);
+// 围栏事件行：坐标列为空，最后一列为 enter:编号 / exit:编号
+size_t tripCsvZoneEvent(const TripHeader &h, const TripZoneEvent &e, char *buf, size_t size);
+size_t tripGpxHeader(char *buf, size_t size);
+size_t tripGpxPoint(const TripHeader &h, const TripPoint &p, char *buf, size_t size);
+size_t tripGpxFooter(char *buf, size_t size);
+
+enum class TripExportFormat : uint8_t
+{
+  Csv,
+  Gpx,
+  GeoJson,
+  Kml,
+};
+
+// "csv"/"gpx"/"geojson"/"kml"，空串为 CSV；不认识的返回 false
+bool tripExportParse(const char *name, TripExportFormat &fmt);
+const char *tripExportMime(TripExportFormat fmt);
+const char *tripExportExt(TripExportFormat fmt);
+
+// 按格式组织导出文本。GeoJSON 的 coordTimes 和 KML gx:Track 的 <when> 必须与坐标分开
+// 成组列出，这两种格式在有时间时需遍历记录两遍（passes() 为 2），仍只用固定缓冲区。
+// 用法：header()，每遍 beginPass(i) 后对每条记录调用 point()，最后 footer()。
+// 每次输出不超过 TRIP_EXPORT_MAX_CHUNK 字节
+#define TRIP_EXPORT_MAX_CHUNK 320
+class TripExporter
+{
+public:
+  // name 为不含扩展名的码表名，写入 GeoJSON/KML 的名称字段
+  TripExporter(TripExportFormat fmt, const TripHeader &h, const char *name);
+  uint8_t passes() const;
+  size_t header(char *buf, size_t size);
+  size_t beginPass(uint8_t pass, char *buf, size_t size);
+  size_t point(const TripPoint &p, char *buf, size_t size);
+  // 围栏事件只在 CSV 中输出一行，其他格式只含轨迹
+  size_t zoneEvent(const TripZoneEvent &e, char *buf, size_t size);
+  size_t footer(char *buf, size_t size);
+
+private:
+  TripExportFormat _fmt;
+  TripHeader _h;
+  char _name[32];
+  bool _timed;
+  uint8_t _pass = 0;
+  bool _first = true;
+};
+
+// 定点数格式化：value / 10^decimals，例如 (1234567, 6) -> "1.234567"
+size_t formatFixed(char *buf, size_t size, int32_t value, uint8_t decimals);
@@ -0,0 +1,108 @@
+#include "trip_index.h"
+#include <algorithm>
+#include "trip_format.h"
+
+// 文件名倒序：trip_YYYYmmdd_HHMMSS 越新越靠前
+static bool newerFirst(const TripIndexEntry &a, const TripIndexEntry &b) { return strcmp(a.name, b.name) > 0; }
+
+static bool isTripFile(const String &name)
+{
+  return name.startsWith("/trip_") && (name.endsWith(".bin") || name.endsWith(".csv"));
+}
+
+void TripIndex::build(FS &fs)
+{
+  _entries.clear();
+  File root = fs.open("/", "r");
+  if (root)
+  {
+    File file = root.openNextFile();
+    while (file)
+    {
+      // name() 在新版核心中不带前导斜杠
+      String name = file.name();
+      if (!name.startsWith("/"))
+        name = "/" + name;
+      bool dir = file.isDirectory();
+      file.close();
+      TripIndexEntry e;
+      if (!dir && isTripFile(name) && describe(fs, name, e))
+        _entries.push_back(e);
+      file = root.openNextFile();
+    }
+    root.close();
+  }
+  std::sort(_entries.begin(), _entries.end(), newerFirst);
+  _version++;
+}
+
+void TripIndex::put(const TripIndexEntry &e)
+{
+  auto it = std::lower_bound(_entries.begin(), _entries.end(), e, newerFirst);
+  if (it != _entries.end() && strcmp(it->name, e.name) == 0)
+    *it = e;
+  else
+    _entries.insert(it, e);
+  _version++;
+}
+
+bool TripIndex::remove(const String &name)
+{
+  for (auto it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    if (name == it->name)
+    {
+      _entries.erase(it);
+      _version++;
+      return true;
+    }
+  }
+  return false;
+}
+
+TripIndexEntry *TripIndex::find(const String &name)
+{
+  for (auto &e : _entries)
+  {
+    if (name == e.name)
+      return &e;
+  }
+  return nullptr;
+}
+
+bool TripIndex::describe(FS &fs, const String &name, TripIndexEntry &e)
+{
+  if (name.length() > TRIP_INDEX_NAME_MAX)
+    return false;
+  File f = fs.open(name, "r");
+  if (!f)
+    return false;
+  e = TripIndexEntry();
+  strncpy(e.name, name.c_str(), TRIP_INDEX_NAME_MAX);
+  e.size = f.size();
+  e.summary = fs.exists(name.substring(0, name.length() - 4) + ".json");
+
+  uint8_t hdr[TRIP_HEADER_SIZE];
+  TripHeader header;
+  if (name.endsWith(".bin") && f.read(hdr, sizeof(hdr)) == sizeof(hdr) && tripReadHeader(hdr, header))
+  {
+    e.startEpoch = header.startEpoch;
+    // 只读尾部：其中必有关键帧或无定位记录，时长与码表长度无关地求出
+    uint32_t slots = (e.size - TRIP_HEADER_SIZE) / TRIP_SLOT_SIZE;
+    uint32_t window = slots < TRIP_KEYFRAME_INTERVAL + 3 ? slots : TRIP_KEYFRAME_INTERVAL + 3;
+    uint32_t skip = slots - window;
+    TripLastTime last(skip == 0);
+    f.seek(TRIP_HEADER_SIZE + skip * TRIP_SLOT_SIZE);
+    uint8_t buf[32 * TRIP_SLOT_SIZE];
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) >= TRIP_SLOT_SIZE)
+    {
+      for (size_t off = 0; off + TRIP_SLOT_SIZE <= n; off += TRIP_SLOT_SIZE)
+        last.feedSlot(buf + off);
+    }
+    if (last.found())
+      e.durationS = last.tMs() / 1000;
+  }
+  f.close();
+  return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+// 码表文件索引：开机时扫描一次根目录，之后在码表开始/结束/删除时增量更新。
+// 下载列表按页直接读内存，每页耗时只与页大小有关，不再每次遍历 LittleFS。
+// version() 在内容变化时改变，初值取随机数，重启后不会与旧值相同，可直接用作 ETag。
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+
+#define TRIP_INDEX_NAME_MAX 31
+
+struct TripIndexEntry
+{
+  char name[TRIP_INDEX_NAME_MAX + 1] = ""; // 带前导斜杠，如 /trip_20250101_120000.bin
+  uint32_t size = 0;
+  uint32_t startEpoch = 0; // 0 表示未知（未校时或旧版 CSV 码表）
+  uint32_t durationS = 0;
+  bool active = false;  // 正在记录：大小和时长在结束时更新
+  bool summary = false; // 有同名 .json 统计
+};
+
+class TripIndex
+{
+public:
+  // 扫描根目录下的码表文件（.bin 及旧版 .csv），按文件名倒序（最新在前）
+  void build(FS &fs);
+  // 插入或按文件名替换
+  void put(const TripIndexEntry &e);
+  bool remove(const String &name);
+  TripIndexEntry *find(const String &name);
+
+  size_t size() const { return _entries.size(); }
+  const TripIndexEntry &at(size_t i) const { return _entries[i]; }
+  uint32_t version() const { return _version; }
+  // 条目被就地修改后调用
+  void touch() { _version++; }
+
+  // 读取码表文件的元数据：大小、文件头中的开始时间，以及尾部（最多一个关键帧间隔）
+  // 最后一条记录的时间作为时长
+  static bool describe(FS &fs, const String &name, TripIndexEntry &e);
+
+private:
+  std::vector<TripIndexEntry> _entries;
+  uint32_t _version = esp_random();
+};
@@ -0,0 +1,120 @@
+#include "trip_stats.h"
+#include "geo_fixed.h"
+
+// 连续这么多个跳点后认为锚点本身有误，直接以新点重新建锚
+#define TRIP_STATS_MAX_JUMP_RUN 3
+
+void TripStats::addFix(const GpsFix &fix, uint32_t nowMs)
+{
+  if (fix.hdopX100 > TRIP_STATS_MAX_HDOP_X100)
+  {
+    _rejected++;
+    return;
+  }
+  _points++;
+  bool moving = fix.speedCmps >= TRIP_STATS_STOP_CMPS;
+
+  // 运动/静止时间
+  if (_haveLast)
+  {
+    uint32_t dt = nowMs - _lastMs;
+    if (dt <= TRIP_STATS_MAX_DT_MS)
+    {
+      if (moving)
+        _movingMs += dt;
+      else
+        _stoppedMs += dt;
+    }
+  }
+  _haveLast = true;
+  _lastMs = nowMs;
+
+  if (fix.speedCmps <= TRIP_STATS_MAX_CMPS && fix.speedCmps > _maxSpeedCmps)
+    _maxSpeedCmps = fix.speedCmps;
+
+  // 里程
+  if (!_haveAnchor)
+  {
+    _haveAnchor = true;
+    _anchorLatE7 = fix.latE7;
+    _anchorLngE7 = fix.lngE7;
+    _anchorMs = nowMs;
+  }
+  else if (moving)
+  {
+    uint32_t d = geoEquirectCm(_anchorLatE7, _anchorLngE7, fix.latE7, fix.lngE7);
+    if (d >= TRIP_STATS_MIN_STEP_CM)
+    {
+      uint32_t dt = nowMs - _anchorMs;
+      bool jump = (uint64_t)d * 1000 > (uint64_t)TRIP_STATS_MAX_CMPS * dt + (uint64_t)TRIP_STATS_MIN_STEP_CM * 1000;
+      if (jump && ++_jumpRun < TRIP_STATS_MAX_JUMP_RUN)
+      {
+        _rejected++;
+      }
+      else
+      {
+        if (!jump)
+          _distanceCm += d;
+        _jumpRun = 0;
+        _anchorLatE7 = fix.latE7;
+        _anchorLngE7 = fix.lngE7;
+        _anchorMs = nowMs;
+      }
+    }
+  }
+
+  // 爬升/下降（滞回）
+  if (!_haveAlt)
+  {
+    _haveAlt = true;
+    _altAnchorCm = fix.altCm;
+  }
+  else
+  {
+    int32_t dAlt = fix.altCm - _altAnchorCm;
+    if (dAlt >= TRIP_STATS_CLIMB_CM)
+    {
+      _ascentCm += dAlt;
+      _altAnchorCm = fix.altCm;
+    }
+    else if (dAlt <= -TRIP_STATS_CLIMB_CM)
+    {
+      _descentCm += -dAlt;
+      _altAnchorCm = fix.altCm;
+    }
+  }
+}
+
+void TripStats::addGap()
+{
+  _haveLast = false;
+  _haveAnchor = false;
+  _jumpRun = 0;
+}
+
+TripStats::Totals TripStats::totals() const
+{
+  Totals t;
+  t.distanceCm = _distanceCm;
+  t.movingMs = _movingMs;
+  t.stoppedMs = _stoppedMs;
+  t.maxSpeedCmps = _maxSpeedCmps;
+  t.ascentCm = _ascentCm;
+  t.descentCm = _descentCm;
+  t.points = _points;
+  t.rejected = _rejected;
+  return t;
+}
+
+void TripStats::restore(const Totals &t)
+{
+  reset();
+  _distanceCm = t.distanceCm;
+  _movingMs = t.movingMs;
+  _stoppedMs = t.stoppedMs;
+  _maxSpeedCmps = t.maxSpeedCmps;
+  _ascentCm = t.ascentCm;
+  _descentCm = t.descentCm;
+  _points = t.points;
+  _rejected = t.rejected;
+}
@@ -0,0 +1,92 @@
+#pragma once
+// 码表统计：每个定位点以常数时间和内存更新里程、运动/静止时间、
+// 最高/平均速度以及累计爬升/下降。全部为整数运算（距离见 geo_fixed.h），
+// 只依赖标准库，可在主机上用录制轨迹验证。
+//
+// 抗漂移：
+//   - HDOP 过大的点不参与统计；
+//   - 里程按“锚点”累加：当前点距锚点超过 TRIP_STATS_MIN_STEP_CM 且处于运动状态
+//     才计入并移动锚点，静止时的定位抖动不会累积成里程；
+//   - 相对锚点的隐含速度超过 TRIP_STATS_MAX_CMPS 视为跳点丢弃，连续多次则重新建锚；
+//   - 海拔用 TRIP_STATS_CLIMB_CM 的滞回阈值统计爬升/下降。
+#include <stdint.h>
+#include "gps_fix.h"
+
+#ifndef TRIP_STATS_MIN_STEP_CM
+#define TRIP_STATS_MIN_STEP_CM 500 // 5 m
+#endif
+#ifndef TRIP_STATS_STOP_CMPS
+#define TRIP_STATS_STOP_CMPS 50 // 低于 1.8 km/h 视为静止
+#endif
+#ifndef TRIP_STATS_MAX_CMPS
+#define TRIP_STATS_MAX_CMPS 6000 // 216 km/h
+#endif
+#ifndef TRIP_STATS_MAX_HDOP_X100
+#define TRIP_STATS_MAX_HDOP_X100 500
+#endif
+#ifndef TRIP_STATS_CLIMB_CM
+#define TRIP_STATS_CLIMB_CM 300
+#endif
+#ifndef TRIP_STATS_MAX_DT_MS
+#define TRIP_STATS_MAX_DT_MS 5000 // 两点间隔更长时不计入运动/静止时间
+#endif
+
+class TripStats
+{
+public:
+  // 累计值快照，写入码表检查点，断电重启后恢复
+  struct Totals
+  {
+    uint32_t distanceCm = 0;
+    uint32_t movingMs = 0;
+    uint32_t stoppedMs = 0;
+    uint32_t maxSpeedCmps = 0;
+    uint32_t ascentCm = 0;
+    uint32_t descentCm = 0;
+    uint32_t points = 0;
+    uint32_t rejected = 0;
+  };
+
+  void reset() { *this = TripStats(); }
+  Totals totals() const;
+  // 恢复累计值；锚点等瞬时状态不恢复，相当于恢复后先经历一次定位中断
+  void restore(const Totals &t);
+  // 输入一个有效定位，nowMs 为到达时间（毫秒，允许回绕）
+  void addFix(const GpsFix &fix, uint32_t nowMs);
+  // 定位中断：下一个点重新建立锚点，中断期间不计时间和里程
+  void addGap();
+
+  uint32_t distanceCm() const { return _distanceCm; }
+  uint32_t movingMs() const { return _movingMs; }
+  uint32_t stoppedMs() const { return _stoppedMs; }
+  uint32_t maxSpeedCmps() const { return _maxSpeedCmps; }
+  // 运动时间内的平均速度
+  uint32_t avgSpeedCmps() const
+  {
+    return _movingMs ? (uint32_t)((uint64_t)_distanceCm * 1000 / _movingMs) : 0;
+  }
+  uint32_t ascentCm() const { return _ascentCm; }
+  uint32_t descentCm() const { return _descentCm; }
+  uint32_t points() const { return _points; }
+  uint32_t rejected() const { return _rejected; }
+
+private:
+  bool _haveLast = false;
+  bool _haveAnchor = false;
+  bool _haveAlt = false;
+  uint32_t _lastMs = 0;
+  int32_t _anchorLatE7 = 0;
+  int32_t _anchorLngE7 = 0;
+  uint32_t _anchorMs = 0;
+  int32_t _altAnchorCm = 0;
+  uint8_t _jumpRun = 0;
+
+  uint32_t _distanceCm = 0;
+  uint32_t _movingMs = 0;
+  uint32_t _stoppedMs = 0;
+  uint32_t _maxSpeedCmps = 0;
+  uint32_t _ascentCm = 0;
+  uint32_t _descentCm = 0;
+  uint32_t _points = 0;
+  uint32_t _rejected = 0;
+};
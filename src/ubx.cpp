@@ -0,0 +1,264 @@
+#include "ubx.h"
+#include <string.h>
+
+static inline uint16_t rdU2(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t rdU4(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline int32_t rdI4(const uint8_t *p) { return (int32_t)rdU4(p); }
+
+static inline void wrU2(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+static inline void wrU4(uint8_t *p, uint32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+size_t ubxBuildFrame(uint8_t *out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+  out[0] = UBX_SYNC1;
+  out[1] = UBX_SYNC2;
+  out[2] = cls;
+  out[3] = id;
+  wrU2(out + 4, len);
+  memcpy(out + 6, payload, len);
+  // Fletcher 校验覆盖 class、id、长度和负载
+  uint8_t a = 0, b = 0;
+  for (uint16_t i = 2; i < 6 + len; i++)
+  {
+    a += out[i];
+    b += a;
+  }
+  out[6 + len] = a;
+  out[7 + len] = b;
+  return 8 + len;
+}
+
+size_t ubxBuildCfgPrt(uint8_t *out, uint32_t baud)
+{
+  uint8_t p[20] = {0};
+  p[0] = 1;                // portID：UART1
+  wrU4(p + 4, 0x000008D0); // mode：8 数据位，无校验，1 停止位
+  wrU4(p + 8, baud);       // baudRate
+  wrU2(p + 12, 0x0003);    // inProtoMask：UBX + NMEA
+  wrU2(p + 14, 0x0001);    // outProtoMask：仅 UBX，关闭所有 NMEA 语句
+  return ubxBuildFrame(out, UBX_CLASS_CFG, UBX_CFG_PRT, p, sizeof(p));
+}
+
+size_t ubxBuildCfgRate(uint8_t *out, uint16_t measRateMs)
+{
+  uint8_t p[6];
+  wrU2(p, measRateMs);
+  wrU2(p + 2, 1); // navRate：每次测量一个解
+  wrU2(p + 4, 1); // timeRef：GPS 时间
+  return ubxBuildFrame(out, UBX_CLASS_CFG, UBX_CFG_RATE, p, sizeof(p));
+}
+
+size_t ubxBuildCfgMsg(uint8_t *out, uint8_t cls, uint8_t id, uint8_t rate)
+{
+  uint8_t p[3] = {cls, id, rate};
+  return ubxBuildFrame(out, UBX_CLASS_CFG, UBX_CFG_MSG, p, sizeof(p));
+}
+
+bool UbxDecoder::feed(uint8_t b)
+{
+  switch (_state)
+  {
+  case SYNC1:
+    if (b == UBX_SYNC1)
+      _state = SYNC2;
+    return false;
+  case SYNC2:
+    _state = (b == UBX_SYNC2) ? CLASS : (b == UBX_SYNC1 ? SYNC2 : SYNC1);
+    return false;
+  case CLASS:
+    _cls = b;
+    _ckA = b;
+    _ckB = _ckA;
+    _state = ID;
+    return false;
+  case ID:
+    _id = b;
+    _ckA += b;
+    _ckB += _ckA;
+    _state = LEN1;
+    return false;
+  case LEN1:
+    _len = b;
+    _ckA += b;
+    _ckB += _ckA;
+    _state = LEN2;
+    return false;
+  case LEN2:
+    _len |= (uint16_t)b << 8;
+    _ckA += b;
+    _ckB += _ckA;
+    _pos = 0;
+    // 长度异常（噪声误同步）时直接丢弃，避免吞掉后续大量数据
+    if (_len > 1024)
+      _state = SYNC1;
+    else
+      _state = _len ? PAYLOAD : CK_A;
+    return false;
+  case PAYLOAD:
+    if (_sky && _cls == UBX_CLASS_NAV && _id == UBX_NAV_SVINFO)
+      feedSvInfo(b);
+    else if (_pos < MAX_PAYLOAD)
+      _payload[_pos] = b;
+    _pos++;
+    _ckA += b;
+    _ckB += _ckA;
+    if (_pos == _len)
+      _state = CK_A;
+    return false;
+  case CK_A:
+    _rxCkA = b;
+    _state = CK_B;
+    return false;
+  case CK_B:
+    _state = SYNC1;
+    if (_rxCkA != _ckA || b != _ckB)
+    {
+      _checksumErrors++;
+      return false;
+    }
+    _framesOk++;
+    return handleFrame();
+  }
+  return false;
+}
+
+// NAV-SVINFO 长度随通道数变化（8 + 12×numCh），按 12 字节一组边收边解，不需要整帧缓冲；
+// 卫星先进暂存区，整帧校验通过后才提交
+void UbxDecoder::feedSvInfo(uint8_t b)
+{
+  if (_pos == 0)
+    _sky->beginCycle(SAT_SOURCE_UBX);
+  if (_pos < 8)
+    return;
+  uint16_t k = (_pos - 8) % 12;
+  _payload[k] = b;
+  if (k < 11)
+    return;
+  const uint8_t *p = _payload;
+  SatInfo s;
+  uint8_t svid = p[1];
+  // SBAS 120..158 换算为 NMEA 编号 33..
+  s.prn = (svid >= 120 && svid <= 158) ? svid - 87 : svid;
+  s.system = (svid >= 120 && svid <= 158) ? SatSystem::Sbas
+             : svid <= 32                 ? SatSystem::Gps
+             : svid >= 65 && svid <= 96   ? SatSystem::Glonass
+             : svid >= 193 && svid <= 197 ? SatSystem::Qzss
+                                          : SatSystem::Unknown;
+  s.used = p[2] & 0x01; // flags.svUsed
+  s.snr = p[4];         // cno，dB-Hz
+  // flags.orbitAvail 未置位时仰角和方位角无意义
+  if (p[2] & 0x04)
+  {
+    int8_t elev = (int8_t)p[5];
+    int16_t az = (int16_t)rdU2(p + 6);
+    s.elevDeg = elev < 0 ? 0 : elev;
+    s.azDeg = (az < 0 || az > 359) ? 0xFFFF : az;
+  }
+  if (s.prn != 0)
+    _sky->add(s);
+}
+
+bool UbxDecoder::handleFrame()
+{
+  if (_cls == UBX_CLASS_ACK)
+  {
+    if (_id == UBX_ACK_ACK)
+      _acks++;
+    else if (_id == UBX_ACK_NAK)
+      _naks++;
+    return false;
+  }
+  if (_cls != UBX_CLASS_NAV)
+    return false;
+  if (_id == UBX_NAV_SVINFO)
+  {
+    if (_sky && _len >= 8 && (_len - 8) % 12 == 0)
+      _sky->commitCycle();
+    return false;
+  }
+  if (_id == UBX_NAV_DOP && _len == 18)
+  {
+    if (_sky)
+    {
+      SatDop dop;
+      dop.pdopX100 = rdU2(_payload + 6);
+      dop.vdopX100 = rdU2(_payload + 10);
+      dop.hdopX100 = rdU2(_payload + 12);
+      dop.fixType = _fixType;
+      _sky->setDop(dop);
+    }
+    return false;
+  }
+  if (_len > MAX_PAYLOAD)
+    return false;
+
+  uint8_t bit;
+  if (_id == UBX_NAV_POSLLH && _len == 28)
+    bit = 0x01;
+  else if (_id == UBX_NAV_VELNED && _len == 36)
+    bit = 0x02;
+  else if (_id == UBX_NAV_SOL && _len == 52)
+    bit = 0x04;
+  else
+    return false;
+
+  // 新的 iTOW 开始一个新历元
+  uint32_t tow = rdU4(_payload);
+  if (tow != _epochTow)
+  {
+    _epochTow = tow;
+    _epochMask = 0;
+  }
+
+  const uint8_t *p = _payload;
+  switch (bit)
+  {
+  case 0x01:
+    _fix.lngE7 = rdI4(p + 4);
+    _fix.latE7 = rdI4(p + 8);
+    _fix.altCm = rdI4(p + 16) / 10; // hMSL，毫米
+    break;
+  case 0x02:
+    _fix.speedCmps = rdU4(p + 20); // gSpeed，厘米/秒
+    {
+      // heading，1e-5 度
+      int32_t heading = rdI4(p + 24) % 36000000;
+      _fix.courseCdeg = (uint16_t)((heading < 0 ? heading + 36000000 : heading) / 1000);
+    }
+    break;
+  case 0x04:
+  {
+    uint8_t gpsFix = p[10];
+    uint8_t flags = p[11];
+    // 2D/3D 定位且 gpsFixOK 置位才算有效
+    _solOk = (gpsFix == 2 || gpsFix == 3) && (flags & 0x01);
+    _fixType = !_solOk ? 1 : (gpsFix == 2 ? 2 : 3);
+    // NAV-SOL 只有 pDOP；作为 HDOP 的保守上界使用
+    _fix.hdopX100 = rdU2(p + 44);
+    _fix.satellites = p[47];
+    break;
+  }
+  }
+
+  if (_epochMask & 0x80)
+    return false; // 本历元已输出
+  _epochMask |= bit;
+  if (_epochMask == 0x07)
+  {
+    _epochMask |= 0x80;
+    _fix.valid = _solOk;
+    return true;
+  }
+  return false;
+}
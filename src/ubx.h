@@ -0,0 +1,97 @@
+#pragma once
+// u-blox UBX 二进制协议：NEO-6M 配置报文生成与定长导航报文解码
+// 只依赖标准库，可在主机上用录制的 UBX 数据回放验证。
+#include <stddef.h>
+#include <stdint.h>
+#include "gps_fix.h"
+#include "sat_view.h"
+
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_ACK 0x05
+#define UBX_CLASS_CFG 0x06
+
+#define UBX_NAV_POSLLH 0x02
+#define UBX_NAV_DOP 0x04
+#define UBX_NAV_SOL 0x06
+#define UBX_NAV_VELNED 0x12
+#define UBX_NAV_SVINFO 0x30
+#define UBX_ACK_NAK 0x00
+#define UBX_ACK_ACK 0x01
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+
+// 最长的配置报文（CFG-PRT，20 字节负载）加 8 字节帧头尾
+#define UBX_MAX_FRAME 28
+
+// 生成配置报文，返回帧长度；out 至少 UBX_MAX_FRAME 字节
+size_t ubxBuildFrame(uint8_t *out, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len);
+// UART1：8N1，指定波特率；输入 UBX+NMEA，输出仅 UBX
+size_t ubxBuildCfgPrt(uint8_t *out, uint32_t baud);
+// 测量周期（毫秒），每次测量输出一次导航解
+size_t ubxBuildCfgRate(uint8_t *out, uint16_t measRateMs);
+// 设置当前端口上某条消息的输出频率（0 关闭）
+size_t ubxBuildCfgMsg(uint8_t *out, uint8_t cls, uint8_t id, uint8_t rate);
+
+// 逐字节解码 UBX 帧，只保留 NAV-POSLLH / NAV-VELNED / NAV-SOL。
+// 同一 iTOW 的三条报文都收到后视为一个完整历元。
+// 设置了卫星视图时另外解码 NAV-SVINFO（可见卫星）和 NAV-DOP。
+class UbxDecoder
+{
+public:
+  void setSatView(SatView *view) { _sky = view; }
+  // 返回 true 表示刚完成一个导航历元，可调用 fix() 读取
+  bool feed(uint8_t b);
+  const GpsFix &fix() const { return _fix; }
+  // 最近一个历元的 GPS 周内时间（毫秒）
+  uint32_t epochTow() const { return _epochTow; }
+
+  uint32_t framesOk() const { return _framesOk; }
+  uint32_t checksumErrors() const { return _checksumErrors; }
+  uint32_t acks() const { return _acks; }
+  uint32_t naks() const { return _naks; }
+
+private:
+  enum State : uint8_t
+  {
+    SYNC1,
+    SYNC2,
+    CLASS,
+    ID,
+    LEN1,
+    LEN2,
+    PAYLOAD,
+    CK_A,
+    CK_B
+  };
+  // NAV-SOL 负载最长（52 字节）；更长的报文只校验不保存
+  static const uint16_t MAX_PAYLOAD = 52;
+
+  bool handleFrame();
+  void feedSvInfo(uint8_t b);
+
+  State _state = SYNC1;
+  uint8_t _cls = 0;
+  uint8_t _id = 0;
+  uint16_t _len = 0;
+  uint16_t _pos = 0;
+  uint8_t _ckA = 0;
+  uint8_t _ckB = 0;
+  uint8_t _rxCkA = 0;
+  uint8_t _payload[MAX_PAYLOAD];
+
+  uint32_t _epochTow = 0;
+  uint8_t _epochMask = 0;
+  bool _solOk = false;
+  uint8_t _fixType = 0; // NAV-SOL gpsFix，换算为 GSA 定位模式写入 DOP
+  GpsFix _fix;
+  SatView *_sky = nullptr;
+
+  uint32_t _framesOk = 0;
+  uint32_t _checksumErrors = 0;
+  uint32_t _acks = 0;
+  uint32_t _naks = 0;
+};